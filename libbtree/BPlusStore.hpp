@@ -11,9 +11,16 @@
 #include <exception>
 #include <variant>
 #include <unordered_map>
+#include <algorithm>
+#include <type_traits>
 #include "CacheErrorCodes.h"
+#include "CacheStats.h"
+#include "CheckpointProgress.h"
 #include "ErrorCodes.h"
 #include "VariadicNthType.h"
+#include "OptimisticLock.hpp"
+#include "ObjectPin.hpp"
+#include "WriteAheadLog.hpp"
 #include <tuple>
 #include <vector>
 #include <stdexcept>
@@ -43,9 +50,36 @@ private:
     uint32_t m_nDegree;
     std::shared_ptr<CacheType> m_ptrCache;
     std::optional<ObjectUIDType> m_uidRootNode;
+    size_t m_nHeight;   // number of levels, the leaves included.
+
+#ifdef __TREE_WITH_CACHE__
+    typedef WriteAheadLog<KeyType, ValueType> LogType;
+
+    std::unique_ptr<LogType> m_ptrLog;  // see openLog
+    uint64_t m_nCommittedLSN;           // of the last logged operation the committed tree takes in
+#endif __TREE_WITH_CACHE__
 
 #ifdef __CONCURRENT__
-    mutable std::shared_mutex m_mutex;
+    mutable std::shared_mutex m_mutex;      // shared by inserts and lookups, unique for the operations that restructure the tree.
+    mutable std::shared_mutex m_mtxRoot;    // guards m_uidRootNode and m_nHeight while m_mutex is only held shared.
+    OptimisticLock m_lckRoot;   // versions m_uidRootNode for the optimistic descents; taken together with m_mtxRoot.
+    OptimisticGate m_gate;      // closed whenever node memory is released (removes, bulk loads, batch inserts, growing a node).
+
+#ifndef __TREE_WITH_CACHE__
+    // Keys and values are read without locks on the optimistic paths, so torn copies have to be harmless.
+    static constexpr bool OPTIMISTIC = std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value;
+    static const size_t OPTIMISTIC_ATTEMPTS = 16;
+#else __TREE_WITH_CACHE__
+    // Versions the child slots (and m_uidRootNode) that fetchNode rewrites while their node is only held shared,
+    // striped by the parent; see readChildSlot.
+    struct alignas(64) SlotLatch
+    {
+        OptimisticLock m_lckSlots;
+    };
+
+    static const size_t SLOT_LATCHES = 64;
+    SlotLatch m_arrSlotLatches[SLOT_LATCHES];
+#endif __TREE_WITH_CACHE__
 #endif __CONCURRENT__
 
 public:
@@ -57,6 +91,10 @@ public:
     BPlusStore(uint32_t nDegree, CacheArgs... args)
         : m_nDegree(nDegree)
         , m_uidRootNode(std::nullopt)
+        , m_nHeight(0)
+#ifdef __TREE_WITH_CACHE__
+        , m_nCommittedLSN(0)
+#endif __TREE_WITH_CACHE__
     {
         m_ptrCache = std::make_shared<CacheType>(args...);
     }
@@ -69,23 +107,121 @@ public:
 #endif __TREE_WITH_CACHE__
 
         m_ptrCache->template createObjectOfType<DefaultNodeType>(m_uidRootNode);
+        m_nHeight = 1;
+    }
+
+#ifdef __TREE_WITH_CACHE__
+    /*
+     * Instead of init, for a store with a committed root (e.g. a FileStorage reopened from its file), see commit. The
+     * degree is the committed one, not the one the tree was constructed with; the nodes are loaded as the operations
+     * reach them.
+     */
+    ErrorCode open()
+    {
+        m_ptrCache->init(this);
+
+        ObjectUIDType uidRootNode;
+        uint32_t nDegree = 0;
+        size_t nHeight = 0;
+        uint64_t nLogSequence = 0;
+
+        if (m_ptrCache->getCommittedRoot(uidRootNode, nDegree, nHeight, nLogSequence) != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+
+        m_nDegree = nDegree;
+        m_nHeight = nHeight;
+        m_uidRootNode = uidRootNode;
+        m_nCommittedLSN = nLogSequence;
+
+        return ErrorCode::Success;
+    }
+
+    /*
+     * From here on every insert and remove is appended to the log at stFilename and returns once it is as durable as
+     * nSyncMode makes it; commit empties the log. The operations the log holds past the committed tree are replayed
+     * first. Called after init or open, before the tree is shared between threads. After init nothing is committed,
+     * so the whole log is replayed: it must be one that no commit has emptied.
+     */
+    ErrorCode openLog(const std::string& stFilename, WALSyncMode nSyncMode)
+    {
+        std::unique_ptr<LogType> ptrLog = std::make_unique<LogType>(stFilename, nSyncMode);
+
+        // m_ptrLog is not set yet, the operations are not logged a second time.
+        CacheErrorCode errCode = ptrLog->replay(m_nCommittedLSN,
+            [this](typename LogType::Operation nOperation, const KeyType& key, const ValueType& value)
+            {
+                if (nOperation == LogType::Operation::Insert)
+                {
+                    insert(key, value);
+                }
+                else
+                {
+                    remove(key);
+                }
+            });
+
+        if (errCode != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+
+        m_ptrLog = std::move(ptrLog);
+
+        return ErrorCode::Success;
+    }
+
+    void getLogStats(uint64_t& nRecords, uint64_t& nSyncs)
+    {
+        nRecords = nSyncs = 0;
+
+        if (m_ptrLog != nullptr)
+        {
+            m_ptrLog->getStats(nRecords, nSyncs);
+        }
     }
+#endif __TREE_WITH_CACHE__
 
     ErrorCode insert(const KeyType& key, const ValueType& value, bool print = false)
     {
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+        if constexpr (OPTIMISTIC)
+        {
+            ErrorCode errCode = ErrorCode::Error;
+            if (insertOptimistic(key, value, errCode))
+            {
+                return errCode;
+            }
+        }
+
+        return insertLinked(key, value);
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
         std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
 
+#ifdef __TREE_WITH_CACHE__
+        uint64_t nLSN = 0;
+#endif __TREE_WITH_CACHE__
+
 #ifdef __CONCURRENT__
-        std::vector<std::unique_lock<std::shared_mutex>> vtLocks;
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+
+        // Besides the mutexes, the version of every node on the path is locked so the optimistic readers restart.
+        std::vector<ExclusiveLock<std::shared_mutex>> vtLocks;
+        vtLocks.reserve(8);
 #endif __CONCURRENT__
 
         ObjectUIDType uidLastNode, uidCurrentNode;  // TODO: make Optional!
         ObjectTypePtr ptrLastNode = nullptr, ptrCurrentNode = nullptr;
+        size_t nChildIdx = 0;   // slot of uidCurrentNode in ptrLastNode
 
         std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtNodes;
 
 #ifdef __CONCURRENT__
-        vtLocks.push_back(std::unique_lock<std::shared_mutex>(m_mutex));
+        vtLocks.emplace_back(m_mtxRoot, m_lckRoot);
 #endif __CONCURRENT__
         int i=0;
         uidCurrentNode = m_uidRootNode.value();
@@ -96,45 +232,10 @@ public:
 //            if (print) { std::this_thread::sleep_for(10ms);
 //std::cout << uidCurrentNode.toString().c_str() << std::endl;}
 
-#ifdef __TREE_WITH_CACHE__
-            std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode, uidUpdated);    //TODO: lock
-
-            if (uidUpdated != std::nullopt)
-            {
-                //if (print) { std::cout << "1.1" << std::endl;}
-
-                if (ptrLastNode != nullptr)
-                {
-                    if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data))
-                    {
-                        //if (print) { std::cout << "1.1.1" << std::endl;}
-                        std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data);
-                        ptrIndexNode->updateChildUID(uidCurrentNode, *uidUpdated);
-                        ptrLastNode->dirty = true;
-                    }
-                    else //if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrLastNode->data))
-                    {
-                        //if (print) { std::cout << "1.1.2" << std::endl;}
-                        throw new std::logic_error("should not occur!");
-                    }
-                }
-                else
-                {
-                       // if (print) { std::cout << "1.1.3" << std::endl;}
-                    //ptrLastNode->dirty = true; //do ths ame for root!
-                    assert(uidCurrentNode == *m_uidRootNode);
-                    m_uidRootNode = uidUpdated;
-                }
-
-                uidCurrentNode = *uidUpdated;
-            }
-#else __TREE_WITH_CACHE__
-            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode);    //TODO: lock
-#endif __TREE_WITH_CACHE__
+            ptrCurrentNode = fetchNode(uidCurrentNode, ptrLastNode, nChildIdx);    //TODO: lock
 
 #ifdef __CONCURRENT__
-            vtLocks.push_back(std::unique_lock<std::shared_mutex>(ptrCurrentNode->mutex));
+            vtLocks.emplace_back(ptrCurrentNode->mutex, ptrCurrentNode->version);
 #endif __CONCURRENT__
 
             if (ptrCurrentNode == nullptr)
@@ -165,7 +266,8 @@ public:
                 uidLastNode = uidCurrentNode;
                 ptrLastNode = ptrCurrentNode;
 
-                uidCurrentNode = ptrIndexNode->getChild(key);
+                nChildIdx = ptrIndexNode->getChildNodeIdx(key);
+                uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
             }
             else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrCurrentNode->data))
             {
@@ -176,6 +278,10 @@ public:
                 ptrCurrentNode->dirty = true;
 #endif __TREE_WITH_CACHE__
 
+#ifdef __CONCURRENT__
+                ensureCapacity(ptrDataNode.get());
+#endif __CONCURRENT__
+
                 if (ptrDataNode->insert(key, value) != ErrorCode::Success)
                 {
                     vtNodes.clear();
@@ -186,6 +292,10 @@ public:
                     return ErrorCode::InsertFailed;
                 }
 
+#ifdef __TREE_WITH_CACHE__
+                nLSN = appendToLog(LogType::Operation::Insert, key, value);
+#endif __TREE_WITH_CACHE__
+
                 if (ptrDataNode->requireSplit(m_nDegree))
                 {
                     vtNodes.push_back(std::pair<ObjectUIDType, ObjectTypePtr>(uidLastNode, ptrLastNode));
@@ -194,6 +304,7 @@ public:
                 else
                 {
 #ifdef __CONCURRENT__
+                    vtLocks.back().setModified();
                     vtLocks.clear();
 #endif __CONCURRENT__
                     vtNodes.clear(); //TODO: release locks
@@ -220,6 +331,7 @@ public:
                 }
 
                 m_ptrCache->template createObjectOfType<IndexNodeType>(m_uidRootNode, pivotKey, uidLHSNode, *uidRHSNode);
+                m_nHeight++;
 
                 int idx = 0;
                 auto it_a = vtAccessedNodes.begin();
@@ -258,6 +370,10 @@ public:
                     it_a++;
                 }
 
+#ifdef __CONCURRENT__
+                ensureCapacity(ptrIndexNode.get());
+#endif __CONCURRENT__
+
                 if (ptrIndexNode->insert(pivotKey, *uidRHSNode) != ErrorCode::Success)
                 {
                     // TODO: Should update be performed on cloned objects first?
@@ -304,61 +420,62 @@ public:
             vtNodes.pop_back();
         }
 
+#ifdef __CONCURRENT__
+        // Whatever is still locked took part in the split (the topmost one received the last pivot).
+        for (auto& lock : vtLocks)
+        {
+            lock.setModified();
+        }
+#endif __CONCURRENT__
+
         m_ptrCache->reorder(vtAccessedNodes);
         vtAccessedNodes.clear();
 
+#ifdef __TREE_WITH_CACHE__
+#ifdef __CONCURRENT__
+        vtLocks.clear();
+        lock_tree.unlock();
+#endif __CONCURRENT__
+
+        return syncLog(nLSN);
+#else __TREE_WITH_CACHE__
         return ErrorCode::Success;
+#endif __TREE_WITH_CACHE__
     }
 
     ErrorCode search(const KeyType& key, ValueType& value)
     {
         ErrorCode errCode = ErrorCode::Error;
 
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+        if constexpr (OPTIMISTIC)
+        {
+            if (searchOptimistic(key, value, errCode))
+            {
+                return errCode;
+            }
+        }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
         std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
 
 #ifdef __CONCURRENT__
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+
         std::vector<std::shared_lock<std::shared_mutex>> vtLocks;
-        vtLocks.push_back(std::shared_lock<std::shared_mutex>(m_mutex));
+        vtLocks.push_back(std::shared_lock<std::shared_mutex>(m_mtxRoot));
 #endif __CONCURRENT__
 
         ObjectUIDType uidCurrentNode = *m_uidRootNode;
+        ObjectTypePtr ptrLastNode = nullptr;
+        size_t nChildIdx = 0;   // slot of uidCurrentNode in ptrLastNode
         do
         {
             ObjectTypePtr prNodeDetails = nullptr;
 
-#ifdef __TREE_WITH_CACHE__
-            std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-            m_ptrCache->getObject(uidCurrentNode, prNodeDetails, uidUpdated);    //TODO: lock
-
-            if (uidUpdated != std::nullopt)
-            {
-                ObjectTypePtr ptrLastNode = vtAccessedNodes.size() > 0 ? vtAccessedNodes[vtAccessedNodes.size() - 1].second : nullptr;
-                if (ptrLastNode != nullptr)
-                {
-                    if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data))
-                    {
-                        std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data);
-                        ptrIndexNode->updateChildUID(uidCurrentNode, *uidUpdated);
-
-                        ptrLastNode->dirty = true;
-                    }
-                    else //if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrLastNode->data))
-                    {
-                        throw new std::logic_error("should not occur!");
-                    }
-                }
-                else
-                {
-                    //ptrLastNode->dirty = true;  do the same thing here... atm root never leaves cache. but later fix this.
-                    assert(uidCurrentNode == *m_uidRootNode);
-                    m_uidRootNode = uidUpdated;
-                }
-
-                uidCurrentNode = *uidUpdated;
-            }
-#else __TREE_WITH_CACHE__
-            m_ptrCache->getObject(uidCurrentNode, prNodeDetails);    //TODO: lock
-#endif __TREE_WITH_CACHE__
+            prNodeDetails = fetchNode(uidCurrentNode, ptrLastNode, nChildIdx);    //TODO: lock
 
 
 #ifdef __CONCURRENT__
@@ -371,13 +488,26 @@ public:
                 throw new std::logic_error("should not occur!");
             }
 
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+            ObjectUIDType uidRight;
+            if (isBeyondHighKey(prNodeDetails, key, uidRight))
+            {
+                uidCurrentNode = uidRight;
+                continue;
+            }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
             vtAccessedNodes.push_back(std::make_pair(uidCurrentNode, prNodeDetails));
 
             if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*prNodeDetails->data))
             {
                 std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*prNodeDetails->data);
 
-                uidCurrentNode = ptrIndexNode->getChild(key);
+                ptrLastNode = prNodeDetails;
+                nChildIdx = ptrIndexNode->getChildNodeIdx(key);
+                uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
             }
             else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*prNodeDetails->data))
             {
@@ -397,64 +527,206 @@ public:
         return errCode;
     }
 
-    ErrorCode remove(const KeyType& key)
-    {   
+    /*
+     * Pins the leaf key falls into, it stays resident until pin is released (e.g. under a cursor). The leaf that key
+     * falls into may change once the tree is modified, the pin keeps the node it was taken on.
+     */
+    ErrorCode pinLeaf(const KeyType& key, ObjectPin<ObjectTypePtr>& pin)
+    {
         std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
 
 #ifdef __CONCURRENT__
-        std::vector<std::unique_lock<std::shared_mutex>> vtLocks;
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+        std::shared_lock<std::shared_mutex> lock_root(m_mtxRoot);
 #endif __CONCURRENT__
 
-        ObjectUIDType uidLastNode, uidCurrentNode;
-        ObjectTypePtr ptrLastNode = nullptr, ptrCurrentNode = nullptr;
+        ObjectUIDType uidCurrentNode = *m_uidRootNode;
+        ObjectTypePtr ptrLastNode = nullptr;
+        size_t nChildIdx = 0;
+        do
+        {
+            ObjectTypePtr ptrCurrentNode = fetchNode(uidCurrentNode, ptrLastNode, nChildIdx);
+            if (ptrCurrentNode == nullptr)
+            {
+                throw new std::logic_error("should not occur!");
+            }
 
-        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtNodes;
+            vtAccessedNodes.push_back(std::make_pair(uidCurrentNode, ptrCurrentNode));
+
+            if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrCurrentNode->data))
+            {
+                pin = ObjectPin<ObjectTypePtr>(ptrCurrentNode);
+                break;
+            }
+
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data);
+
+            ptrLastNode = ptrCurrentNode;
+            nChildIdx = ptrIndexNode->getChildNodeIdx(key);
+            uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
+        } while (true);
+
+        m_ptrCache->reorder(vtAccessedNodes);
+
+        return ErrorCode::Success;
+    }
+
+    /*
+     * Inserts a batch of (key, value) pairs. The batch is sorted and the tree is walked once: every node on the way is
+     * visited a single time, all the keys that land in the same leaf are merged into it together, and the nodes that
+     * overflow are split once into as many siblings as needed.
+     */
+    ErrorCode insertBatch(const std::vector<std::pair<KeyType, ValueType>>& vtEntries)
+    {
+        if (vtEntries.size() == 0)
+        {
+            return ErrorCode::Success;
+        }
+
+        std::vector<std::pair<KeyType, ValueType>> vtSorted(vtEntries);
+        std::stable_sort(vtSorted.begin(), vtSorted.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
+        std::vector<std::pair<KeyType, ObjectUIDType>> vtSiblings;
 
 #ifdef __CONCURRENT__
-        vtLocks.push_back(std::unique_lock<std::shared_mutex>(m_mutex));
+        std::unique_lock<std::shared_mutex> lock_tree(m_mutex);
+        ClosedGate lock_gate(m_gate);   // the nodes are rewritten in place without bumping their versions.
 #endif __CONCURRENT__
 
-        uidCurrentNode = m_uidRootNode.value();
+        ObjectUIDType uidRootNode = *m_uidRootNode;
+        ObjectTypePtr ptrRootNode = fetchNode(uidRootNode, nullptr);
 
-        do
+        insertRange(uidRootNode, ptrRootNode, vtSorted.cbegin(), vtSorted.cend(), vtSiblings, vtAccessedNodes);
+
+        // Grow the tree until the root no longer overflows.
+        std::vector<KeyType> vtPivots;
+        std::vector<ObjectUIDType> vtChildren;
+        while (vtSiblings.size() > 0)
         {
-#ifdef __TREE_WITH_CACHE__
-            std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode, uidUpdated);    //TODO: lock
+            vtPivots.clear();
+            vtChildren.clear();
+
+            vtChildren.push_back(*m_uidRootNode);
+            for (const auto& prSibling : vtSiblings)
+            {
+                vtPivots.push_back(prSibling.first);
+                vtChildren.push_back(prSibling.second);
+            }
+
+            vtSiblings.clear();
 
-            if (uidUpdated != std::nullopt)
+            m_ptrCache->template createObjectOfType<IndexNodeType>(m_uidRootNode, vtPivots.cbegin(), vtPivots.cend(), vtChildren.cbegin(), vtChildren.cend());
+            m_nHeight++;
+
+            uidRootNode = *m_uidRootNode;
+            ptrRootNode = fetchNode(uidRootNode, nullptr);
+
+            vtAccessedNodes.insert(vtAccessedNodes.begin(), std::make_pair(uidRootNode, ptrRootNode));
+
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrRootNode->data);
+            if (ptrIndexNode->requireSplit(m_nDegree))
             {
-                if (ptrLastNode != nullptr)
+                if (ptrIndexNode->template multiSplit<std::shared_ptr<CacheType>>(m_ptrCache, m_nDegree, vtSiblings) != ErrorCode::Success)
                 {
-                    if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data))
-                    {
-                        std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrLastNode->data);
-                        ptrIndexNode->updateChildUID(uidCurrentNode, *uidUpdated);
-                        ptrLastNode->dirty = true;
-                    }
-                    else //if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrLastNode->data))
-                    {
-                        throw new std::logic_error("should not occur!");
-                    }
+                    throw new std::logic_error("should not occur!"); // for the time being!
                 }
-                else
+
+                for (const auto& prSibling : vtSiblings)
                 {
-                    // ptrLastNode->dirty = true; todo: do for parent as well..
-                    assert(uidCurrentNode == *m_uidRootNode);
-                    m_uidRootNode = uidUpdated;
+                    vtAccessedNodes.insert(vtAccessedNodes.begin() + 1, std::make_pair(prSibling.second, nullptr));
                 }
-
-                uidCurrentNode = *uidUpdated;
             }
+        }
+
+        m_ptrCache->reorder(vtAccessedNodes, false);
+        vtAccessedNodes.clear();
+
+#ifdef __TREE_WITH_CACHE__
+        // In the order insertRange merged them, equal keys included.
+        uint64_t nLSN = 0;
+        for (const auto& prEntry : vtSorted)
+        {
+            nLSN = appendToLog(LogType::Operation::Insert, prEntry.first, prEntry.second);
+        }
+
+#ifdef __CONCURRENT__
+        lock_tree.unlock();
+#endif __CONCURRENT__
+
+        return syncLog(nLSN);
 #else __TREE_WITH_CACHE__
-            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode);    //TODO: lock
+        return ErrorCode::Success;
 #endif __TREE_WITH_CACHE__
+    }
+
+    /*
+     * Looks up a batch of keys with a single walk over the tree. vtValues and vtResults are filled in the order of vtKeys.
+     */
+    ErrorCode searchBatch(const std::vector<KeyType>& vtKeys, std::vector<ValueType>& vtValues, std::vector<ErrorCode>& vtResults)
+    {
+        vtValues.resize(vtKeys.size());
+        vtResults.assign(vtKeys.size(), ErrorCode::KeyDoesNotExist);
+
+        if (vtKeys.size() == 0)
+        {
+            return ErrorCode::Success;
+        }
+
+        std::vector<size_t> vtOrder(vtKeys.size());
+        for (size_t nIdx = 0; nIdx < vtOrder.size(); nIdx++)
+        {
+            vtOrder[nIdx] = nIdx;
+        }
+
+        std::sort(vtOrder.begin(), vtOrder.end(), [&vtKeys](size_t lhs, size_t rhs) { return vtKeys[lhs] < vtKeys[rhs]; });
+
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
+
+#ifdef __CONCURRENT__
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+        std::shared_lock<std::shared_mutex> lock_root(m_mtxRoot);
+#endif __CONCURRENT__
+
+        ObjectUIDType uidRootNode = *m_uidRootNode;
+        ObjectTypePtr ptrRootNode = fetchNode(uidRootNode, nullptr);
+
+        searchRange(uidRootNode, ptrRootNode, vtKeys, vtOrder.cbegin(), vtOrder.cend(), vtValues, vtResults, vtAccessedNodes);
+
+        m_ptrCache->reorder(vtAccessedNodes, false);
+        vtAccessedNodes.clear();
+
+        return ErrorCode::Success;
+    }
+
+    ErrorCode remove(const KeyType& key)
+    {   
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
+
+        ObjectUIDType uidLastNode, uidCurrentNode;
+        ObjectTypePtr ptrLastNode = nullptr, ptrCurrentNode = nullptr;
+        size_t nChildIdx = 0;   // slot of uidCurrentNode in ptrLastNode
+
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtNodes;
 
+#ifdef __TREE_WITH_CACHE__
+        uint64_t nLSN = 0;
+#endif __TREE_WITH_CACHE__
 
 #ifdef __CONCURRENT__
-            vtLocks.push_back(std::unique_lock<std::shared_mutex>(ptrCurrentNode->mutex));
+        // Removes run alone: a merge reaches siblings off the path, and the inserts do not keep their ancestors locked
+        // while a split is posted to the parent, so no set of node locks taken on the way down would cover it.
+        std::unique_lock<std::shared_mutex> lock_tree(m_mutex);
+        ClosedGate lock_gate(m_gate);   // merges free nodes that an optimistic descent might be reading.
 #endif __CONCURRENT__
 
+        uidCurrentNode = m_uidRootNode.value();
+
+        do
+        {
+            ptrCurrentNode = fetchNode(uidCurrentNode, ptrLastNode, nChildIdx);    //TODO: lock
+
+
             if (ptrCurrentNode == nullptr)
             {
                 throw new std::logic_error("should not occur!");
@@ -472,19 +744,14 @@ public:
                 }
                 else
                 {
-#ifdef __CONCURRENT__
-                    if (vtLocks.size() > 3) //TODO: 3 seems to be working.. but how and why.. investiage....!
-                    {
-                        vtLocks.erase(vtLocks.begin());
-                    }
-#endif __CONCURRENT__
-                    vtNodes.clear(); //TODO: release locks
+                    vtNodes.clear();
                 }
 
                 uidLastNode = uidCurrentNode;
                 ptrLastNode = ptrCurrentNode;
 
-                uidCurrentNode = ptrIndexNode->getChild(key); // fid it.. there are two kinds of methods..
+                nChildIdx = ptrIndexNode->getChildNodeIdx(key);
+                uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
             }
             else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrCurrentNode->data))
             {
@@ -497,6 +764,8 @@ public:
 
 #ifdef __TREE_WITH_CACHE__
                 ptrCurrentNode->dirty = true;
+
+                nLSN = appendToLog(LogType::Operation::Remove, key, ValueType());
 #endif __TREE_WITH_CACHE__
 
                 if (ptrDataNode->requireMerge(m_nDegree))
@@ -506,10 +775,7 @@ public:
                 }
                 else
                 {
-#ifdef __CONCURRENT__
-                    vtLocks.clear();
-#endif __CONCURRENT__
-                    vtNodes.clear(); //TODO: release locks
+                    vtNodes.clear();
                 }
 
                 break;
@@ -555,6 +821,7 @@ public:
                         ObjectUIDType _tmp = ptrInnerNode->getChildAt(0);
                         m_ptrCache->remove(*m_uidRootNode);
                         m_uidRootNode = _tmp;
+                        m_nHeight--;
 
 #ifdef __TREE_WITH_CACHE__
                         ptrCurrentRoot->dirty = true;
@@ -594,23 +861,6 @@ public:
 
                         if (uidToDelete)
                         {
-#ifdef __CONCURRENT__
-                            if (*uidToDelete == uidChildNode)
-                            {
-                                auto it = vtLocks.begin();
-                                while (it != vtLocks.end()) {
-                                    if ((*it).mutex() == &ptrChildNode->mutex)
-                                    {
-                                        break;
-                                    }
-                                    it++;
-                                }
-
-                                if (it != vtLocks.end())
-                                    vtLocks.erase(it);
-                            }
-#endif __CONCURRENT__
-
                             m_ptrCache->remove(*uidToDelete);
                         }
                     }
@@ -630,23 +880,6 @@ public:
 
                     if (uidToDelete)
                     {
-#ifdef __CONCURRENT__
-                        if (*uidToDelete == uidChildNode)
-                        {
-                            auto it = vtLocks.begin();
-                            while (it != vtLocks.end()) {
-                                if ((*it).mutex() == &ptrChildNode->mutex)
-                                {
-                                    break;
-                                }
-                                it++;
-                            }
-
-                            if (it != vtLocks.end())
-                                vtLocks.erase(it);
-                        }
-#endif __CONCURRENT__
-
                         m_ptrCache->remove(*uidToDelete);
                     }
                 }
@@ -660,59 +893,1340 @@ public:
         m_ptrCache->reorder(vtAccessedNodes, false);
         vtAccessedNodes.clear();
 
-        return ErrorCode::Success;
-    }
+#ifdef __TREE_WITH_CACHE__
+#ifdef __CONCURRENT__
+        // The gate is only entered without a cache, it may stay closed meanwhile.
+        lock_tree.unlock();
+#endif __CONCURRENT__
+
+        return syncLog(nLSN);
+#else __TREE_WITH_CACHE__
+        return ErrorCode::Success;
+#endif __TREE_WITH_CACHE__
+    }
+
+    /*
+     * Visits the entries in [keyBegin, keyEnd) in ascending order. The callback receives (key, value) and
+     * returns false to stop the scan early. The tree is descended only once; adjacent leaves are reached
+     * through the parents that are kept on the path stack.
+     */
+    template <typename CallbackType>
+    ErrorCode scan(const KeyType& keyBegin, const KeyType& keyEnd, CallbackType fnCallback)
+    {
+        return traverse(keyBegin, keyEnd, fnCallback, false);
+    }
+
+    /*
+     * Same as scan but visits the entries in [keyBegin, keyEnd) in descending order.
+     */
+    template <typename CallbackType>
+    ErrorCode reverseScan(const KeyType& keyBegin, const KeyType& keyEnd, CallbackType fnCallback)
+    {
+        return traverse(keyBegin, keyEnd, fnCallback, true);
+    }
+
+    /*
+     * Builds the tree bottom-up from a range of (key, value) pairs sorted in strictly ascending order.
+     * The tree must be empty. Every node is filled up to fFillFactor of its capacity and the entries are
+     * spread evenly across the nodes of a level. With a cache, all nodes except the root are written straight
+     * to the storage; the root is kept in the cache.
+     */
+    template <typename IteratorType>
+    ErrorCode bulkLoad(IteratorType itBegin, IteratorType itEnd, float fFillFactor = 1.0f)
+    {
+#ifdef __CONCURRENT__
+        std::unique_lock<std::shared_mutex> lock_tree(m_mutex);
+        ClosedGate lock_gate(m_gate);   // the old root is freed.
+#endif __CONCURRENT__
+
+        if (fFillFactor <= 0.0f || fFillFactor > 1.0f)
+        {
+            return ErrorCode::Error;
+        }
+
+        ObjectUIDType uidRootNode = *m_uidRootNode;
+        ObjectTypePtr ptrRootNode = fetchNode(uidRootNode, nullptr);
+
+        if (!std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrRootNode->data)
+            || std::get<std::shared_ptr<DataNodeType>>(*ptrRootNode->data)->getKeysCount() > 0)
+        {
+            return ErrorCode::Error;
+        }
+
+        ptrRootNode = nullptr;
+
+        size_t nTotal = std::distance(itBegin, itEnd);
+        if (nTotal == 0)
+        {
+            return ErrorCode::Success;
+        }
+
+        size_t nLeafCapacity = std::max<size_t>(1, m_nDegree * fFillFactor);
+        size_t nIndexCapacity = std::max<size_t>(3, std::min<size_t>(m_nDegree + 1, (m_nDegree + 1) * fFillFactor));
+
+        // (lowest key, uid) of every node of the level that was built last.
+        std::vector<std::pair<KeyType, ObjectUIDType>> vtLevel;
+
+        size_t nNodes = (nTotal + nLeafCapacity - 1) / nLeafCapacity;
+        vtLevel.reserve(nNodes);
+
+        std::vector<KeyType> vtKeys;
+        std::vector<ValueType> vtValues;
+        std::optional<KeyType> keyLast;
+
+        IteratorType it = itBegin;
+        for (size_t nNode = 0; nNode < nNodes; nNode++)
+        {
+            size_t nEntries = nTotal / nNodes + (nNode < nTotal % nNodes ? 1 : 0);
+
+            vtKeys.clear();
+            vtValues.clear();
+
+            for (size_t nIdx = 0; nIdx < nEntries; nIdx++, it++)
+            {
+                if (keyLast && !(*keyLast < it->first))
+                {
+                    return ErrorCode::Error;    // input is not sorted; the nodes written so far are not reachable.
+                }
+
+                keyLast = it->first;
+
+                vtKeys.push_back(it->first);
+                vtValues.push_back(it->second);
+            }
+
+            std::optional<ObjectUIDType> uidNode;
+            createBulkNode<DataNodeType>(uidNode, nNodes == 1, vtKeys.cbegin(), vtKeys.cend(), vtValues.cbegin(), vtValues.cend());
+
+            vtLevel.push_back(std::make_pair(vtKeys.front(), *uidNode));
+        }
+
+        linkLevel<DataNodeType>(vtLevel);
+
+        std::vector<ObjectUIDType> vtChildren;
+        std::vector<std::pair<KeyType, ObjectUIDType>> vtParentLevel;
+
+        size_t nHeight = 1;
+        while (vtLevel.size() > 1)
+        {
+            nNodes = (vtLevel.size() + nIndexCapacity - 1) / nIndexCapacity;
+
+            vtParentLevel.clear();
+            vtParentLevel.reserve(nNodes);
+
+            auto itChild = vtLevel.begin();
+            for (size_t nNode = 0; nNode < nNodes; nNode++)
+            {
+                size_t nEntries = vtLevel.size() / nNodes + (nNode < vtLevel.size() % nNodes ? 1 : 0);
+
+                vtKeys.clear();
+                vtChildren.clear();
+
+                KeyType keyLowest = itChild->first;
+                vtChildren.push_back(itChild->second);
+                itChild++;
+
+                for (size_t nIdx = 1; nIdx < nEntries; nIdx++, itChild++)
+                {
+                    vtKeys.push_back(itChild->first);
+                    vtChildren.push_back(itChild->second);
+                }
+
+                std::optional<ObjectUIDType> uidNode;
+                createBulkNode<IndexNodeType>(uidNode, nNodes == 1, vtKeys.cbegin(), vtKeys.cend(), vtChildren.cbegin(), vtChildren.cend());
+
+                vtParentLevel.push_back(std::make_pair(keyLowest, *uidNode));
+            }
+
+            linkLevel<IndexNodeType>(vtParentLevel);
+
+            vtLevel.swap(vtParentLevel);
+            nHeight++;
+        }
+
+        m_ptrCache->remove(*m_uidRootNode);
+        m_uidRootNode = vtLevel.front().second;
+        m_nHeight = nHeight;
+
+#ifdef __TREE_WITH_CACHE__
+        // Replayed as single inserts; a commit right after the load keeps them out of the log.
+        uint64_t nLSN = 0;
+        for (it = itBegin; it != itEnd; it++)
+        {
+            nLSN = appendToLog(LogType::Operation::Insert, it->first, it->second);
+        }
+
+#ifdef __CONCURRENT__
+        lock_tree.unlock();
+#endif __CONCURRENT__
+
+        return syncLog(nLSN);
+#else __TREE_WITH_CACHE__
+        return ErrorCode::Success;
+#endif __TREE_WITH_CACHE__
+    }
+
+    void print(std::ofstream & out)
+    {
+        int nSpace = 7;
+
+        std::string prefix;
+
+        out << prefix << "|" << std::endl;
+        out << prefix << "|" << std::string(nSpace, '-').c_str() << "(root)";
+
+        out << std::endl;
+
+        ObjectTypePtr ptrRootNode = nullptr;
+        std::optional<ObjectUIDType> uidUpdated = std::nullopt;
+        m_ptrCache->getObject(m_uidRootNode.value(), ptrRootNode, uidUpdated);
+
+        if (uidUpdated != std::nullopt)
+        {
+#ifdef __CONCURRENT__
+            m_ptrCache->dropUpdatedUID(*m_uidRootNode);
+#endif __CONCURRENT__
+
+            m_uidRootNode = uidUpdated;
+        }
+
+        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrRootNode->data))
+        {
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrRootNode->data);
+
+            ptrIndexNode->template print<std::shared_ptr<CacheType>, ObjectTypePtr, DataNodeType>(out, m_ptrCache, 0, prefix);
+        }
+        else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrRootNode->data))
+        {
+            std::shared_ptr<DataNodeType> ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrRootNode->data);
+
+            ptrDataNode->print(out, 0, prefix);
+        }
+    }
+
+    void getCacheState(size_t& lru, size_t& map)
+    {
+        return m_ptrCache->getCacheState(lru, map);
+    }
+
+    void setCacheByteBudget(size_t nHighWatermarkBytes, size_t nLowWatermarkBytes)
+    {
+        m_ptrCache->setByteBudget(nHighWatermarkBytes, nLowWatermarkBytes);
+    }
+
+    void getCacheStats(CacheStats& stats)
+    {
+        m_ptrCache->getCacheStats(stats);
+    }
+
+#ifdef __CONCURRENT__
+#ifdef __TREE_WITH_CACHE__
+    /*
+     * Has the cache write out the dirty nodes in the background, while the operations go on; see LRUCache::checkpoint.
+     * Returns the epoch to wait for. A checkpoint does not make the tree the one open finds, commit does that.
+     */
+    size_t checkpoint()
+    {
+        return m_ptrCache->checkpoint();
+    }
+
+    void waitForCheckpoint(size_t nEpoch)
+    {
+        m_ptrCache->waitForCheckpoint(nEpoch);
+    }
+
+    void setCheckpointRate(size_t nRate)
+    {
+        m_ptrCache->setCheckpointRate(nRate);
+    }
+
+    void getCheckpointProgress(CheckpointProgress& progress)
+    {
+        m_ptrCache->getCheckpointProgress(progress);
+    }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+private:
+    template <typename Type, typename... ArgsType>
+    inline void createBulkNode(std::optional<ObjectUIDType>& uidNode, bool bRoot, const ArgsType... args)
+    {
+#ifdef __TREE_WITH_CACHE__
+        if (!bRoot)
+        {
+            m_ptrCache->template createObjectOfTypeInStorage<Type>(uidNode, args...);
+        }
+        else
+#endif __TREE_WITH_CACHE__
+        {
+            m_ptrCache->template createObjectOfType<Type>(uidNode, args...);
+        }
+
+        if (!uidNode)
+        {
+            throw new std::logic_error("should not occur!");   // TODO: critical log.
+        }
+    }
+
+    /*
+     * Sets the high key and right link of every node of a freshly built level. Nodes the bulk loader wrote straight
+     * to the storage are left alone; the links are not persisted.
+     */
+    template <typename NodeType, typename LevelType>
+    inline void linkLevel(const LevelType& vtLevel)
+    {
+#ifndef __TREE_WITH_CACHE__
+        for (size_t nIdx = 0; nIdx + 1 < vtLevel.size(); nIdx++)
+        {
+            ObjectTypePtr ptrNode = nullptr;
+            m_ptrCache->getObject(vtLevel[nIdx].second, ptrNode);
+
+            std::get<std::shared_ptr<NodeType>>(*ptrNode->data)->setRightSibling(vtLevel[nIdx + 1].first, vtLevel[nIdx + 1].second);
+        }
+#endif __TREE_WITH_CACHE__
+    }
+
+    /*
+     * Fetches the node uidNode refers to; nChildIdx is its slot in ptrParentNode, which is nullptr for the root. Without
+     * __CONCURRENT__ a resident child is reached through the reference swizzled into the parent on an earlier fetch,
+     * skipping the cache's object map and relocation table.
+     */
+    inline ObjectTypePtr fetchNode(ObjectUIDType& uidNode, ObjectTypePtr ptrParentNode, size_t nChildIdx = 0)
+    {
+        ObjectTypePtr ptrNode = nullptr;
+
+#ifdef __TREE_WITH_CACHE__
+#ifndef __CONCURRENT__
+        if (ptrParentNode != nullptr)
+        {
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrParentNode->data);
+
+            ptrNode = ptrIndexNode->template getSwizzledChildAt<ObjectTypePtr>(nChildIdx);
+            if (ptrNode != nullptr)
+            {
+                return ptrNode;
+            }
+        }
+#endif __CONCURRENT__
+
+#ifdef __CONCURRENT__
+        // The caller read the slot without its latch, the copy may be torn.
+        uidNode = readChildSlot(ptrParentNode, nChildIdx);
+#endif __CONCURRENT__
+
+        std::optional<ObjectUIDType> uidUpdated = std::nullopt;
+        m_ptrCache->getObject(uidNode, ptrNode, uidUpdated);
+
+#ifdef __CONCURRENT__
+        // Threads sharing the parent race to apply the relocation of uidNode. The cache keeps it listed until it has
+        // been applied (dropUpdatedUID below), so a thread that no longer finds it sees the new uid in the parent
+        // and reads that instead of a copy the relocation replaced. A volatile uid is not found either while its
+        // node is being written out and not listed as relocated yet.
+        while (uidUpdated == std::nullopt)
+        {
+            ObjectUIDType uidCurrent = readChildSlot(ptrParentNode, nChildIdx);
+
+            if (uidCurrent == uidNode && (ptrNode != nullptr || uidNode.m_uid.m_nMediaType != ObjectUIDType::Volatile))
+            {
+                break;
+            }
+
+            std::this_thread::yield();
+
+            uidNode = uidCurrent;
+            ptrNode = nullptr;
+            m_ptrCache->getObject(uidNode, ptrNode, uidUpdated);
+        }
+#endif __CONCURRENT__
+
+        if (uidUpdated != std::nullopt)
+        {
+#ifdef __CONCURRENT__
+            OptimisticLock& lckSlots = getSlotLatch(ptrParentNode);
+            lckSlots.lock();
+#endif __CONCURRENT__
+
+            // Under __CONCURRENT__ another thread sharing the parent may have applied it already.
+            if (ptrParentNode != nullptr)
+            {
+                std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrParentNode->data);
+                if (ptrIndexNode->getChildAt(nChildIdx) == uidNode)
+                {
+                    ptrIndexNode->updateChildUID(uidNode, *uidUpdated);
+                    ptrParentNode->dirty = true;
+                }
+            }
+            else
+            {
+                assert(uidNode == *m_uidRootNode || *uidUpdated == *m_uidRootNode);
+                m_uidRootNode = uidUpdated;
+            }
+
+#ifdef __CONCURRENT__
+            lckSlots.unlock();
+
+            m_ptrCache->dropUpdatedUID(uidNode);
+#endif __CONCURRENT__
+
+            uidNode = *uidUpdated;
+        }
+#else __TREE_WITH_CACHE__
+        m_ptrCache->getObject(uidNode, ptrNode);
+#endif __TREE_WITH_CACHE__
+
+        if (ptrNode == nullptr)
+        {
+            throw new std::logic_error("should not occur!");   // TODO: critical log.
+        }
+
+#ifdef __TREE_WITH_CACHE__
+#ifndef __CONCURRENT__
+        if (ptrParentNode != nullptr)
+        {
+            std::get<std::shared_ptr<IndexNodeType>>(*ptrParentNode->data)->swizzleChildAt(nChildIdx, ptrNode);
+        }
+#endif __CONCURRENT__
+#endif __TREE_WITH_CACHE__
+
+        return ptrNode;
+    }
+
+#ifdef __CONCURRENT__
+#ifdef __TREE_WITH_CACHE__
+    inline OptimisticLock& getSlotLatch(const ObjectTypePtr& ptrParentNode)
+    {
+        return m_arrSlotLatches[(reinterpret_cast<uintptr_t>(ptrParentNode.get()) >> 6) % SLOT_LATCHES].m_lckSlots;
+    }
+
+    /*
+     * Reads the child slot nChildIdx of ptrParentNode, or m_uidRootNode for a nullptr parent. The readers that share
+     * the parent rewrite the slot when they apply a relocation (see fetchNode), so the copy is retried until no
+     * such write overlapped it.
+     */
+    inline ObjectUIDType readChildSlot(const ObjectTypePtr& ptrParentNode, size_t nChildIdx)
+    {
+        OptimisticLock& lckSlots = getSlotLatch(ptrParentNode);
+
+        while (true)
+        {
+            uint64_t nVersion;
+            if (lckSlots.readLock(nVersion))
+            {
+                ObjectUIDType uidSlot = ptrParentNode != nullptr
+                    ? std::get<std::shared_ptr<IndexNodeType>>(*ptrParentNode->data)->getChildAt(nChildIdx)
+                    : *m_uidRootNode;
+
+                if (lckSlots.validate(nVersion))
+                {
+                    return uidSlot;
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+    /*
+     * Optimistic lock coupling: the descent reads the nodes without locking them and a child is only entered after
+     * the version of its parent has been validated. Any failed validation restarts the operation. Both methods
+     * return false when the caller has to take the pessimistic path instead, i.e. after OPTIMISTIC_ATTEMPTS
+     * restarts or, for insert, when the leaf would have to split or grow its arrays.
+     */
+    bool searchOptimistic(const KeyType& key, ValueType& value, ErrorCode& errCode)
+    {
+        for (size_t nAttempt = 0; nAttempt < OPTIMISTIC_ATTEMPTS; nAttempt++)
+        {
+            bool bDone = false;
+
+            m_gate.enter();
+
+            uint64_t nVersion;
+            ObjectTypePtr ptrLeafNode = descendOptimistic(key, nVersion);
+
+            if (ptrLeafNode != nullptr)
+            {
+                const DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrLeafNode->data).get();
+
+                ValueType valueRead = value;
+                ErrorCode errRead = ptrDataNode->getValue(key, valueRead);
+
+                if (ptrLeafNode->version.validate(nVersion))
+                {
+                    value = valueRead;
+                    errCode = errRead;
+                    bDone = true;
+                }
+            }
+
+            m_gate.leave();
+
+            if (bDone)
+            {
+                return true;
+            }
+
+            std::this_thread::yield();
+        }
+
+        return false;
+    }
+
+    bool insertOptimistic(const KeyType& key, const ValueType& value, ErrorCode& errCode)
+    {
+        for (size_t nAttempt = 0; nAttempt < OPTIMISTIC_ATTEMPTS; nAttempt++)
+        {
+            bool bDone = false, bPessimistic = false;
+
+            m_gate.enter();
+
+            uint64_t nVersion;
+            ObjectTypePtr ptrLeafNode = descendOptimistic(key, nVersion);
+
+            if (ptrLeafNode != nullptr)
+            {
+                DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrLeafNode->data).get();
+
+                if (ptrDataNode->canTriggerSplit(m_nDegree) || !ptrDataNode->canInsertInPlace())
+                {
+                    bPessimistic = true;
+                }
+                else if (ptrLeafNode->mutex.try_lock())
+                {
+                    // Only the leaf is locked; its parent is untouched as long as the leaf does not split.
+                    if (ptrLeafNode->version.tryUpgrade(nVersion))
+                    {
+                        errCode = ptrDataNode->insert(key, value);
+
+                        ptrLeafNode->version.unlock();
+                        bDone = true;
+                    }
+
+                    ptrLeafNode->mutex.unlock();
+                }
+            }
+
+            m_gate.leave();
+
+            if (bDone || bPessimistic)
+            {
+                return bDone;
+            }
+
+            std::this_thread::yield();
+        }
+
+        return false;
+    }
+
+    /*
+     * Returns the leaf that covers key along with the version it was read at, or nullptr if the caller has to restart.
+     * Must be called with the gate entered.
+     */
+    inline ObjectTypePtr descendOptimistic(const KeyType& key, uint64_t& nVersion)
+    {
+        uint64_t nParentVersion;
+        const OptimisticLock* ptrParentVersion = &m_lckRoot;
+
+        if (!m_lckRoot.readLock(nParentVersion))
+        {
+            return nullptr;
+        }
+
+        ObjectUIDType uidCurrentNode = *m_uidRootNode;
+
+        while (true)
+        {
+            ObjectTypePtr ptrCurrentNode = nullptr;
+            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode);
+
+            if (!ptrCurrentNode->version.readLock(nVersion) || !ptrParentVersion->validate(nParentVersion))
+            {
+                return nullptr;
+            }
+
+            ObjectUIDType uidRight;
+            if (isBeyondHighKey(ptrCurrentNode, key, uidRight))
+            {
+                if (!ptrCurrentNode->version.validate(nVersion))
+                {
+                    return nullptr;
+                }
+
+                // The left sibling stands in for the parent of the node reached through its link.
+                uidCurrentNode = uidRight;
+                ptrParentVersion = &ptrCurrentNode->version;
+                nParentVersion = nVersion;
+                continue;
+            }
+
+            if (!std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data))
+            {
+                return ptrCurrentNode;
+            }
+
+            const IndexNodeType* ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data).get();
+            uidCurrentNode = ptrIndexNode->getChild(key);
+
+            // The child uid may be garbage if the node changed while it was read; it must not be followed before this check.
+            if (!ptrCurrentNode->version.validate(nVersion))
+            {
+                return nullptr;
+            }
+
+            ptrParentVersion = &ptrCurrentNode->version;
+            nParentVersion = nVersion;
+        }
+    }
+
+    /*
+     * B-link insert (Lehman and Yao): at most one node is locked at a time. A split links the new sibling into its
+     * level and releases the node before the pivot is posted to the parent, so for a while the sibling can only be
+     * reached through the right link; every descent therefore moves right when the key is at or past the high key
+     * of a node. m_mutex is held shared until the split has been posted to keep remove out.
+     */
+    ErrorCode insertLinked(const KeyType& key, const ValueType& value)
+    {
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+
+        // The index node passed on every level, from the root down; the pivots of the splits go back up through these.
+        std::vector<ObjectTypePtr> vtPath;
+
+        ObjectUIDType uidCurrentNode;
+        {
+            std::shared_lock<std::shared_mutex> lock_root(m_mtxRoot);
+            uidCurrentNode = *m_uidRootNode;
+        }
+
+        ObjectTypePtr ptrCurrentNode = nullptr;
+        while (true)
+        {
+            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode);
+
+            std::shared_lock<std::shared_mutex> lock_node(ptrCurrentNode->mutex);
+
+            ObjectUIDType uidRight;
+            if (isBeyondHighKey(ptrCurrentNode, key, uidRight))
+            {
+                uidCurrentNode = uidRight;
+                continue;
+            }
+
+            if (!std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data))
+            {
+                break;
+            }
+
+            vtPath.push_back(ptrCurrentNode);
+            uidCurrentNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data)->getChild(key);
+        }
+
+        ErrorCode errCode = ErrorCode::Error;
+
+        KeyType pivotKey;
+        std::optional<ObjectUIDType> uidSibling;
+        {
+            ExclusiveLock<std::shared_mutex> lock_node = lockCovering(ptrCurrentNode, key);
+
+            DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrCurrentNode->data).get();
+
+            ensureCapacity(ptrDataNode);
+
+            errCode = ptrDataNode->insert(key, value);
+            lock_node.setModified();
+
+            if (errCode != ErrorCode::Success || !ptrDataNode->requireSplit(m_nDegree))
+            {
+                return errCode;
+            }
+
+            if (ptrDataNode->template split<std::shared_ptr<CacheType>, ObjectUIDType>(m_ptrCache, uidSibling, pivotKey) != ErrorCode::Success)
+            {
+                throw new std::logic_error("should not occur!"); // for the time being!
+            }
+        }
+
+        postSplit(vtPath, 0, pivotKey, *uidSibling);
+
+        return errCode;
+    }
+
+    /*
+     * Adds (pivotKey, uidSibling), the result of a split on level nLevel, to the parent level and carries on upwards
+     * for as long as the parents split in turn. No node is locked by the caller.
+     */
+    void postSplit(std::vector<ObjectTypePtr>& vtPath, size_t nLevel, KeyType pivotKey, ObjectUIDType uidSibling)
+    {
+        while (true)
+        {
+            ObjectTypePtr ptrParentNode = nullptr;
+
+            if (vtPath.size() > 0)
+            {
+                ptrParentNode = vtPath.back();
+                vtPath.pop_back();
+            }
+            else if (growRoot(nLevel))
+            {
+                return;
+            }
+            else
+            {
+                // The tree has grown since the descent.
+                ptrParentNode = descendToLevel(pivotKey, nLevel + 1);
+            }
+
+            ExclusiveLock<std::shared_mutex> lock_parent = lockCovering(ptrParentNode, pivotKey);
+
+            IndexNodeType* ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrParentNode->data).get();
+
+            // A root built over the whole level already holds the pivots of the splits that were still in flight.
+            if (ptrIndexNode->getChild(pivotKey) == uidSibling)
+            {
+                return;
+            }
+
+            ensureCapacity(ptrIndexNode);
+
+            ptrIndexNode->insert(pivotKey, uidSibling);
+            lock_parent.setModified();
+
+            if (!ptrIndexNode->requireSplit(m_nDegree))
+            {
+                return;
+            }
+
+            std::optional<ObjectUIDType> uidNewSibling;
+            if (ptrIndexNode->template split<std::shared_ptr<CacheType>>(m_ptrCache, uidNewSibling, pivotKey) != ErrorCode::Success)
+            {
+                throw new std::logic_error("should not occur!"); // for the time being!
+            }
+
+            uidSibling = *uidNewSibling;
+            nLevel++;
+        }
+    }
+
+    /*
+     * Puts a new root over the top level if a node on level nLevel has split while that level was the top one.
+     * The new root takes every node of the level, so the splits that have not been posted yet are covered as well.
+     */
+    bool growRoot(size_t nLevel)
+    {
+        ExclusiveLock<std::shared_mutex> lock_root(m_mtxRoot, m_lckRoot);
+
+        if (m_nHeight != nLevel + 1)
+        {
+            return false;
+        }
+
+        std::vector<KeyType> vtPivots;
+        std::vector<ObjectUIDType> vtChildren;
+
+        ObjectUIDType uidNode = *m_uidRootNode;
+        while (true)
+        {
+            vtChildren.push_back(uidNode);
+
+            ObjectTypePtr ptrNode = nullptr;
+            m_ptrCache->getObject(uidNode, ptrNode);
+
+            std::shared_lock<std::shared_mutex> lock_node(ptrNode->mutex);
+
+            std::optional<KeyType> keyHigh;
+            std::optional<ObjectUIDType> uidRight;
+            getSiblingLink(ptrNode, keyHigh, uidRight);
+
+            if (!uidRight)
+            {
+                break;
+            }
+
+            vtPivots.push_back(*keyHigh);
+            uidNode = *uidRight;
+        }
+
+        m_ptrCache->template createObjectOfType<IndexNodeType>(m_uidRootNode, vtPivots.cbegin(), vtPivots.cend(), vtChildren.cbegin(), vtChildren.cend());
+        m_nHeight++;
+
+        lock_root.setModified();
+
+        return true;
+    }
+
+    /*
+     * Returns the node on level nLevel (0 being the leaves) whose range holds key, or one to its left.
+     */
+    ObjectTypePtr descendToLevel(const KeyType& key, size_t nLevel)
+    {
+        ObjectUIDType uidCurrentNode;
+        size_t nCurrentLevel;
+        {
+            std::shared_lock<std::shared_mutex> lock_root(m_mtxRoot);
+            uidCurrentNode = *m_uidRootNode;
+            nCurrentLevel = m_nHeight - 1;
+        }
+
+        while (true)
+        {
+            ObjectTypePtr ptrCurrentNode = nullptr;
+            m_ptrCache->getObject(uidCurrentNode, ptrCurrentNode);
+
+            if (nCurrentLevel == nLevel)
+            {
+                return ptrCurrentNode;
+            }
+
+            std::shared_lock<std::shared_mutex> lock_node(ptrCurrentNode->mutex);
+
+            ObjectUIDType uidRight;
+            if (isBeyondHighKey(ptrCurrentNode, key, uidRight))
+            {
+                uidCurrentNode = uidRight;
+                continue;
+            }
+
+            uidCurrentNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data)->getChild(key);
+            nCurrentLevel--;
+        }
+    }
+
+    /*
+     * Locks ptrNode exclusively, moving right along the level until the node that holds key is reached.
+     */
+    inline ExclusiveLock<std::shared_mutex> lockCovering(ObjectTypePtr& ptrNode, const KeyType& key)
+    {
+        while (true)
+        {
+            ExclusiveLock<std::shared_mutex> lock_node(ptrNode->mutex, ptrNode->version);
+
+            ObjectUIDType uidRight;
+            if (!isBeyondHighKey(ptrNode, key, uidRight))
+            {
+                return lock_node;
+            }
+
+            m_ptrCache->getObject(uidRight, ptrNode);
+        }
+    }
+
+    /*
+     * True if key has moved to a right sibling of the node, which is then returned in uidRight.
+     */
+    inline bool isBeyondHighKey(ObjectTypePtr ptrNode, const KeyType& key, ObjectUIDType& uidRight) const
+    {
+        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrNode->data))
+        {
+            const IndexNodeType* ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrNode->data).get();
+            if (!ptrIndexNode->isBeyondHighKey(key))
+            {
+                return false;
+            }
 
-    void print(std::ofstream & out)
+            uidRight = *ptrIndexNode->getRightSibling();
+            return true;
+        }
+
+        const DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrNode->data).get();
+        if (!ptrDataNode->isBeyondHighKey(key))
+        {
+            return false;
+        }
+
+        uidRight = *ptrDataNode->getRightSibling();
+        return true;
+    }
+
+    inline void getSiblingLink(ObjectTypePtr ptrNode, std::optional<KeyType>& keyHigh, std::optional<ObjectUIDType>& uidRight) const
     {
-        int nSpace = 7;
+        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrNode->data))
+        {
+            const IndexNodeType* ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrNode->data).get();
+            keyHigh = ptrIndexNode->getHighKey();
+            uidRight = ptrIndexNode->getRightSibling();
+        }
+        else
+        {
+            const DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrNode->data).get();
+            keyHigh = ptrDataNode->getHighKey();
+            uidRight = ptrDataNode->getRightSibling();
+        }
+    }
 
-        std::string prefix;
+    /*
+     * Visits the entries of the leaves chained to the right of a leaf (given by its high key and right link) up to
+     * uidStop. These are leaves split off while the scan was running whose parents do not list them yet. In reverse
+     * they are collected first and handed out backwards. Returns true if the scan is over.
+     */
+    template <typename CallbackType>
+    bool visitUnpostedLeaves(std::optional<KeyType> keyHigh, std::optional<ObjectUIDType> uidRight, const std::optional<ObjectUIDType>& uidStop
+        , const KeyType& keyBegin, const KeyType& keyEnd, CallbackType& fnCallback, bool bReverse)
+    {
+        std::vector<std::pair<KeyType, ValueType>> vtEntries;
 
-        out << prefix << "|" << std::endl;
-        out << prefix << "|" << std::string(nSpace, '-').c_str() << "(root)";
+        bool bEnd = false;
+        while (!bEnd && uidRight && uidRight != uidStop && *keyHigh < keyEnd)
+        {
+            ObjectTypePtr ptrNode = nullptr;
+            m_ptrCache->getObject(*uidRight, ptrNode);
 
-        out << std::endl;
+            std::shared_lock<std::shared_mutex> lock_node(ptrNode->mutex);
 
-        ObjectTypePtr ptrRootNode = nullptr;
-        std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-        m_ptrCache->getObject(m_uidRootNode.value(), ptrRootNode, uidUpdated);
+            const DataNodeType* ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrNode->data).get();
 
-        if (uidUpdated != std::nullopt)
+            for (size_t nIdx = ptrDataNode->getLowerBoundIdx(keyBegin); !bEnd && nIdx < ptrDataNode->getKeysCount(); nIdx++)
+            {
+                const KeyType& key = ptrDataNode->getKeyAt(nIdx);
+                if (!(key < keyEnd))
+                {
+                    bEnd = true;
+                }
+                else if (bReverse)
+                {
+                    vtEntries.push_back(std::make_pair(key, ptrDataNode->getValueAt(nIdx)));
+                }
+                else if (!fnCallback(key, ptrDataNode->getValueAt(nIdx)))
+                {
+                    return true;
+                }
+            }
+
+            keyHigh = ptrDataNode->getHighKey();
+            uidRight = ptrDataNode->getRightSibling();
+        }
+
+        if (bReverse)
         {
-            m_uidRootNode = uidUpdated;
+            return emitBackwards(vtEntries, fnCallback);
         }
 
-        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrRootNode->data))
+        return bEnd;
+    }
+
+    /*
+     * Hands out vtEntries last to first; returns true if the callback stopped the scan.
+     */
+    template <typename CallbackType>
+    inline bool emitBackwards(const std::vector<std::pair<KeyType, ValueType>>& vtEntries, CallbackType& fnCallback)
+    {
+        for (auto it = vtEntries.rbegin(); it != vtEntries.rend(); it++)
         {
-            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrRootNode->data);
+            if (!fnCallback(it->first, it->second))
+            {
+                return true;
+            }
+        }
 
-            ptrIndexNode->template print<std::shared_ptr<CacheType>, ObjectTypePtr, DataNodeType>(out, m_ptrCache, 0, prefix);
+        return false;
+    }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+#ifdef __CONCURRENT__
+    /*
+     * Makes room for one more entry in a node locked by the caller. Growing frees the old buffers, so it is done with
+     * the gate closed; the node is sized for a full node at once so that this happens at most once per node.
+     */
+    template <typename NodeType>
+    inline void ensureCapacity(NodeType* ptrNode)
+    {
+        if (!ptrNode->canInsertInPlace())
+        {
+            ClosedGate lock_gate(m_gate);
+            ptrNode->reserve(std::max<size_t>(m_nDegree + 1, ptrNode->getKeysCount() + 1));
         }
-        else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*ptrRootNode->data))
+    }
+#endif __CONCURRENT__
+
+    template <typename CallbackType>
+    ErrorCode traverse(const KeyType& keyBegin, const KeyType& keyEnd, CallbackType& fnCallback, bool bReverse)
+    {
+        if (!(keyBegin < keyEnd))
         {
-            std::shared_ptr<DataNodeType> ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrRootNode->data);
+            return ErrorCode::Success;
+        }
 
-            ptrDataNode->print(out, 0, prefix);
+        // Nodes on the path from the root to the current leaf, along with the child slot taken at each index node.
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtAccessedNodes;
+        std::vector<size_t> vtChildIdx;
+
+#ifdef __CONCURRENT__
+        std::vector<std::shared_lock<std::shared_mutex>> vtLocks;
+        std::shared_lock<std::shared_mutex> lock_tree(m_mutex);
+        std::shared_lock<std::shared_mutex> lock_root(m_mtxRoot);
+#endif __CONCURRENT__
+
+        ObjectUIDType uidCurrentNode = *m_uidRootNode;
+        ObjectTypePtr ptrCurrentNode = fetchNode(uidCurrentNode, nullptr);
+
+#ifdef __CONCURRENT__
+        vtLocks.push_back(std::shared_lock<std::shared_mutex>(ptrCurrentNode->mutex));
+        lock_root.unlock();
+
+#ifndef __TREE_WITH_CACHE__
+        // Link of the last leaf visited; the leaves it has split off since are not necessarily in its parent yet.
+        std::optional<ObjectUIDType> uidLastLeaf;
+        std::optional<KeyType> keyLastHigh;
+        std::optional<ObjectUIDType> uidLastRight;
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+        vtAccessedNodes.push_back(std::make_pair(uidCurrentNode, ptrCurrentNode));
+
+        // The first leaf is located by key, every following one is the leftmost (or rightmost) leaf of the next subtree.
+        bool bByKey = true;
+        const KeyType& keyAnchor = bReverse ? keyEnd : keyBegin;
+
+        bool bDone = false;
+
+        while (!bDone)
+        {
+            while (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data))
+            {
+                std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrCurrentNode->data);
+
+                size_t nChildIdx = bByKey ? ptrIndexNode->getChildNodeIdx(keyAnchor) : (bReverse ? ptrIndexNode->getChildrenCount() - 1 : 0);
+                vtChildIdx.push_back(nChildIdx);
+
+                uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
+                ptrCurrentNode = fetchNode(uidCurrentNode, ptrCurrentNode, nChildIdx);
+
+#ifdef __CONCURRENT__
+                vtLocks.push_back(std::shared_lock<std::shared_mutex>(ptrCurrentNode->mutex));
+#endif __CONCURRENT__
+
+                vtAccessedNodes.push_back(std::make_pair(uidCurrentNode, ptrCurrentNode));
+            }
+
+            std::shared_ptr<DataNodeType> ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrCurrentNode->data);
+
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+            // Leaves not posted to a parent yet lie between this leaf and the previous one.
+            if (bReverse)
+            {
+                bDone = visitUnpostedLeaves(ptrDataNode->getHighKey(), ptrDataNode->getRightSibling(), uidLastLeaf, keyBegin, keyEnd, fnCallback, true);
+            }
+            else if (!bByKey)
+            {
+                bDone = visitUnpostedLeaves(keyLastHigh, uidLastRight, uidCurrentNode, keyBegin, keyEnd, fnCallback, false);
+            }
+
+            uidLastLeaf = uidCurrentNode;
+            keyLastHigh = ptrDataNode->getHighKey();
+            uidLastRight = ptrDataNode->getRightSibling();
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+            size_t nKeysCount = ptrDataNode->getKeysCount();
+            size_t nIdx = bByKey ? ptrDataNode->getLowerBoundIdx(keyAnchor) : (bReverse ? nKeysCount : 0);
+
+            if (bReverse)
+            {
+                while (!bDone && nIdx > 0)
+                {
+                    nIdx--;
+
+                    const KeyType& key = ptrDataNode->getKeyAt(nIdx);
+                    bDone = key < keyBegin || !fnCallback(key, ptrDataNode->getValueAt(nIdx));
+                }
+            }
+            else
+            {
+                for (; !bDone && nIdx < nKeysCount; nIdx++)
+                {
+                    const KeyType& key = ptrDataNode->getKeyAt(nIdx);
+                    bDone = !(key < keyEnd) || !fnCallback(key, ptrDataNode->getValueAt(nIdx));
+                }
+            }
+
+            bByKey = false;
+
+            // Keep the path ahead of the visited leaves in the LRU so that a long scan does not stall eviction.
+            std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtReorder(vtAccessedNodes);
+            m_ptrCache->reorder(vtReorder, false);
+
+            vtAccessedNodes.pop_back();
+
+#ifdef __CONCURRENT__
+            vtLocks.pop_back();
+#endif __CONCURRENT__
+
+            // Climb until a parent still has an unvisited child in the scan direction.
+            while (!bDone && vtChildIdx.size() > 0)
+            {
+                std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*vtAccessedNodes.back().second->data);
+
+                size_t& nChildIdx = vtChildIdx.back();
+                if (bReverse ? nChildIdx > 0 : nChildIdx + 1 < ptrIndexNode->getChildrenCount())
+                {
+                    nChildIdx = bReverse ? nChildIdx - 1 : nChildIdx + 1;
+
+                    uidCurrentNode = ptrIndexNode->getChildAt(nChildIdx);
+                    ptrCurrentNode = fetchNode(uidCurrentNode, vtAccessedNodes.back().second, nChildIdx);
+
+#ifdef __CONCURRENT__
+                    vtLocks.push_back(std::shared_lock<std::shared_mutex>(ptrCurrentNode->mutex));
+#endif __CONCURRENT__
+
+                    vtAccessedNodes.push_back(std::make_pair(uidCurrentNode, ptrCurrentNode));
+                    break;
+                }
+
+                vtChildIdx.pop_back();
+                vtAccessedNodes.pop_back();
+
+#ifdef __CONCURRENT__
+                vtLocks.pop_back();
+#endif __CONCURRENT__
+            }
+
+#ifdef __CONCURRENT__
+#ifndef __TREE_WITH_CACHE__
+            if (!bDone && !bReverse && vtChildIdx.size() == 0)
+            {
+                visitUnpostedLeaves(keyLastHigh, uidLastRight, std::nullopt, keyBegin, keyEnd, fnCallback, false);
+            }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+            bDone = bDone || vtChildIdx.size() == 0;
         }
+
+        return ErrorCode::Success;
     }
 
-    void getCacheState(size_t& lru, size_t& map)
+    typedef typename std::vector<std::pair<KeyType, ValueType>>::const_iterator EntryIterator;
+    typedef typename std::vector<size_t>::const_iterator OrderIterator;
+
+    void insertRange(ObjectUIDType uidNode, ObjectTypePtr ptrNode, EntryIterator itBegin, EntryIterator itEnd
+        , std::vector<std::pair<KeyType, ObjectUIDType>>& vtSiblings, std::vector<std::pair<ObjectUIDType, ObjectTypePtr>>& vtAccessedNodes)
     {
-        return m_ptrCache->getCacheState(lru, map);
+#ifdef __CONCURRENT__
+        std::unique_lock<std::shared_mutex> lock_node(ptrNode->mutex);
+#endif __CONCURRENT__
+
+        size_t nAccessIdx = vtAccessedNodes.size();
+        vtAccessedNodes.push_back(std::make_pair(uidNode, ptrNode));
+
+#ifdef __TREE_WITH_CACHE__
+        ptrNode->dirty = true;
+#endif __TREE_WITH_CACHE__
+
+        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrNode->data))
+        {
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrNode->data);
+
+            // Children are visited right to left so that the siblings added to this node do not shift the pending slots.
+            std::vector<std::pair<KeyType, ObjectUIDType>> vtChildSiblings;
+            while (itBegin != itEnd)
+            {
+                size_t nChildIdx = ptrIndexNode->getChildNodeIdx((itEnd - 1)->first);
+
+                EntryIterator itChildBegin = itBegin;
+                if (nChildIdx > 0)
+                {
+                    const KeyType& keyPivot = ptrIndexNode->getPivotAt(nChildIdx - 1);
+                    itChildBegin = std::lower_bound(itBegin, itEnd, keyPivot, [](const auto& entry, const KeyType& key) { return entry.first < key; });
+                }
+
+                ObjectUIDType uidChildNode = ptrIndexNode->getChildAt(nChildIdx);
+                ObjectTypePtr ptrChildNode = fetchNode(uidChildNode, ptrNode, nChildIdx);
+
+                vtChildSiblings.clear();
+                insertRange(uidChildNode, ptrChildNode, itChildBegin, itEnd, vtChildSiblings, vtAccessedNodes);
+
+                if (vtChildSiblings.size() > 0)
+                {
+                    ptrIndexNode->insert(nChildIdx, vtChildSiblings);
+                }
+
+                itEnd = itChildBegin;
+            }
+
+            if (ptrIndexNode->requireSplit(m_nDegree))
+            {
+                if (ptrIndexNode->template multiSplit<std::shared_ptr<CacheType>>(m_ptrCache, m_nDegree, vtSiblings) != ErrorCode::Success)
+                {
+                    throw new std::logic_error("should not occur!"); // for the time being!
+                }
+            }
+        }
+        else
+        {
+            std::shared_ptr<DataNodeType> ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrNode->data);
+
+            ptrDataNode->insert(itBegin, itEnd);
+
+            if (ptrDataNode->requireSplit(m_nDegree))
+            {
+                if (ptrDataNode->template multiSplit<std::shared_ptr<CacheType>, ObjectUIDType>(m_ptrCache, m_nDegree, vtSiblings) != ErrorCode::Success)
+                {
+                    throw new std::logic_error("should not occur!"); // for the time being!
+                }
+            }
+        }
+
+        // The siblings go right after this node and ahead of its subtree, since they adopted part of it.
+        std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtSiblingNodes;
+        for (const auto& prSibling : vtSiblings)
+        {
+            vtSiblingNodes.push_back(std::make_pair(prSibling.second, nullptr));
+        }
+
+        vtAccessedNodes.insert(vtAccessedNodes.begin() + nAccessIdx + 1, vtSiblingNodes.begin(), vtSiblingNodes.end());
+    }
+
+    void searchRange(ObjectUIDType uidNode, ObjectTypePtr ptrNode, const std::vector<KeyType>& vtKeys, OrderIterator itBegin, OrderIterator itEnd
+        , std::vector<ValueType>& vtValues, std::vector<ErrorCode>& vtResults, std::vector<std::pair<ObjectUIDType, ObjectTypePtr>>& vtAccessedNodes)
+    {
+#ifdef __CONCURRENT__
+        std::shared_lock<std::shared_mutex> lock_node(ptrNode->mutex);
+
+#ifndef __TREE_WITH_CACHE__
+        // The keys at or past the high key went to a right sibling that the parent may not list yet.
+        std::optional<KeyType> keyHigh;
+        std::optional<ObjectUIDType> uidRight;
+        getSiblingLink(ptrNode, keyHigh, uidRight);
+
+        if (keyHigh)
+        {
+            OrderIterator itRight = std::lower_bound(itBegin, itEnd, *keyHigh, [&vtKeys](size_t nIdx, const KeyType& key) { return vtKeys[nIdx] < key; });
+            if (itRight != itEnd)
+            {
+                ObjectTypePtr ptrRightNode = nullptr;
+                m_ptrCache->getObject(*uidRight, ptrRightNode);
+
+                searchRange(*uidRight, ptrRightNode, vtKeys, itRight, itEnd, vtValues, vtResults, vtAccessedNodes);
+                itEnd = itRight;
+            }
+        }
+#endif __TREE_WITH_CACHE__
+#endif __CONCURRENT__
+
+        vtAccessedNodes.push_back(std::make_pair(uidNode, ptrNode));
+
+        if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrNode->data))
+        {
+            std::shared_ptr<IndexNodeType> ptrIndexNode = std::get<std::shared_ptr<IndexNodeType>>(*ptrNode->data);
+
+            while (itBegin != itEnd)
+            {
+                size_t nChildIdx = ptrIndexNode->getChildNodeIdx(vtKeys[*itBegin]);
+
+                OrderIterator itChildEnd = itEnd;
+                if (nChildIdx < ptrIndexNode->getChildrenCount() - 1)
+                {
+                    const KeyType& keyPivot = ptrIndexNode->getPivotAt(nChildIdx);
+                    itChildEnd = std::lower_bound(itBegin, itEnd, keyPivot, [&vtKeys](size_t nIdx, const KeyType& key) { return vtKeys[nIdx] < key; });
+                }
+
+                ObjectUIDType uidChildNode = ptrIndexNode->getChildAt(nChildIdx);
+                ObjectTypePtr ptrChildNode = fetchNode(uidChildNode, ptrNode, nChildIdx);
+
+                searchRange(uidChildNode, ptrChildNode, vtKeys, itBegin, itChildEnd, vtValues, vtResults, vtAccessedNodes);
+
+                itBegin = itChildEnd;
+            }
+        }
+        else
+        {
+            std::shared_ptr<DataNodeType> ptrDataNode = std::get<std::shared_ptr<DataNodeType>>(*ptrNode->data);
+
+            for (OrderIterator it = itBegin; it != itEnd; it++)
+            {
+                vtResults[*it] = ptrDataNode->getValue(vtKeys[*it], vtValues[*it]);
+            }
+        }
     }
 
 #ifdef __TREE_WITH_CACHE__
 public:
     ErrorCode flush()
     {
+        return m_ptrCache->flush() == CacheErrorCode::Success ? ErrorCode::Success : ErrorCode::Error;
+    }
+
+    /*
+     * Writes out the dirty nodes, children before their parents and each to new blocks, and makes the tree they form
+     * the one open finds: once they are synced the storage writes the root record the previous commit did not use,
+     * see FileStorage::commit. The blocks of the previous tree are not reused before that is durable, so a crash leaves
+     * one of the two. The root record carries the LSN of the last logged operation, the log is emptied once it is
+     * durable; a crash in between replays nothing up to that LSN. Under __CONCURRENT__ the operations go on while the
+     * cache writes out most of the dirty nodes; they are held off only for a last pass over what they dirtied since.
+     */
+    ErrorCode commit()
+    {
+#ifdef __CONCURRENT__
+        // Leaves behind what is in use or dirtied meanwhile, the pass below catches up on that.
         m_ptrCache->flush();
 
+        std::unique_lock<std::shared_mutex> lock_tree(m_mutex);
+
+        // A relocation of the root not applied yet would be followed by a copy of it.
+        ObjectUIDType uidCurrentRoot = *m_uidRootNode;
+        fetchNode(uidCurrentRoot, nullptr);
+
+        if (m_ptrCache->flush(true) != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+#else __CONCURRENT__
+        if (m_ptrCache->flush() != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+#endif __CONCURRENT__
+
+        // The flush relocated the root too, fetching it applies that.
+        ObjectUIDType uidRootNode = *m_uidRootNode;
+        fetchNode(uidRootNode, nullptr);
+
+        uint64_t nLSN = m_ptrLog != nullptr ? m_ptrLog->getLastLSN() : m_nCommittedLSN;
+
+        if (m_ptrCache->commit(*m_uidRootNode, m_nDegree, m_nHeight, nLSN) != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+
+        m_nCommittedLSN = nLSN;
+
+        if (m_ptrLog != nullptr && m_ptrLog->truncate() != CacheErrorCode::Success)
+        {
+            return ErrorCode::Error;
+        }
+
         return ErrorCode::Success;
     }
 
+private:
+    // Under the locks that order the operation on its key, so the log replays the operations on a key in the order
+    // they were applied. 0 if there is no log.
+    inline uint64_t appendToLog(LogType::Operation nOperation, const KeyType& key, const ValueType& value)
+    {
+        return m_ptrLog != nullptr ? m_ptrLog->append(nOperation, key, value) : 0;
+    }
+
+    // After the locks are released, for the writers that log meanwhile to share the sync.
+    inline ErrorCode syncLog(uint64_t nLSN)
+    {
+        if (nLSN == 0)
+        {
+            return ErrorCode::Success;
+        }
+
+        return m_ptrLog->sync(nLSN) == CacheErrorCode::Success ? ErrorCode::Success : ErrorCode::Error;
+    }
+
+public:
+
+    // The relocations applied are left in mpUIDUpdates and reported in vtAppliedUIDs, the cache retires them.
     void applyExistingUpdates(std::shared_ptr<ObjectType> ptrObject
-        , std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates)
+        , std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates
+        , std::vector<ObjectUIDType>& vtAppliedUIDs)
     {
         if (std::holds_alternative<std::shared_ptr<IndexNodeType>>(*ptrObject->data))
         {
@@ -723,12 +2237,10 @@ public:
             {
                 if (mpUIDUpdates.find(*it) != mpUIDUpdates.end())
                 {
-                    ObjectUIDType uidTemp = *it;
+                    vtAppliedUIDs.push_back(*it);
 
                     *it = *(mpUIDUpdates[*it].first);
 
-                    mpUIDUpdates.erase(uidTemp);
-
                     ptrObject->dirty = true;
                 }
                 it++;
@@ -741,7 +2253,8 @@ public:
     }
 
     void applyExistingUpdates(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
-        , std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates)
+        , std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates
+        , std::vector<ObjectUIDType>& vtAppliedUIDs)
     {
         auto it = vtNodes.begin();
         while (it != vtNodes.end())
@@ -755,12 +2268,10 @@ public:
                 {
                     if (mpUIDUpdates.find(*it_children) != mpUIDUpdates.end())
                     {
-                        ObjectUIDType uidTemp = *it_children;
+                        vtAppliedUIDs.push_back(*it_children);
 
                         *it_children = *(mpUIDUpdates[*it_children].first);
 
-                        mpUIDUpdates.erase(uidTemp);
-
                         (*it).second.second->dirty = true;
                     }
                     it_children++;
@@ -775,7 +2286,7 @@ public:
     }
 
     void prepareFlush(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
-        , size_t& nPos, size_t nBlockSize, ObjectUIDType::Media nMediaType)
+        , BlockAllocator& allocator, size_t nBlockSize, ObjectUIDType::Media nMediaType, std::vector<ObjectUIDType>& vtAppliedUIDs)
     {
         std::vector<bool> vtAppliedUpdates;
         vtAppliedUpdates.resize(vtNodes.size(), false);
@@ -800,6 +2311,7 @@ public:
                             vtNodes[idx].second.second->dirty = true;
 
                             vtAppliedUpdates[jdx] = true;
+                            vtAppliedUIDs.push_back(vtNodes[jdx].first);
                             break;
                         }
                     }
@@ -808,23 +2320,27 @@ public:
 
                 if (!vtNodes[idx].second.second->dirty)
                 {
-                    vtNodes.erase(vtNodes.begin() + idx); idx--;
+                    vtNodes.erase(vtNodes.begin() + idx); vtAppliedUpdates.erase(vtAppliedUpdates.begin() + idx); idx--;
                     continue;
                 }
 
                 size_t nNodeSize = ptrIndexNode->getSize();
 
-                ObjectUIDType uidUpdated = ObjectUIDType::createAddressFromArgs(nMediaType, nPos, nBlockSize, nNodeSize);
+                size_t nBlock = 0;
+                if (allocator.allocate(std::ceil(nNodeSize / (float)nBlockSize), nBlock) != CacheErrorCode::Success)
+                {
+                    throw new std::logic_error("should not occur!");   // TODO: critical log.
+                }
 
-                vtNodes[idx].second.first = uidUpdated;
+                ObjectUIDType uidUpdated = ObjectUIDType::createAddressFromArgs(nMediaType, nBlock, nBlockSize, nNodeSize);
 
-                nPos += std::ceil(nNodeSize / (float)nBlockSize);
+                vtNodes[idx].second.first = uidUpdated;
             }
             else if (std::holds_alternative<std::shared_ptr<DataNodeType>>(*vtNodes[idx].second.second->data))
             {
                 if (!vtNodes[idx].second.second->dirty)
                 {
-                    vtNodes.erase(vtNodes.begin() + idx); idx--;
+                    vtNodes.erase(vtNodes.begin() + idx); vtAppliedUpdates.erase(vtAppliedUpdates.begin() + idx); idx--;
                     continue;
                 }
 
@@ -832,11 +2348,15 @@ public:
 
                 size_t nNodeSize = ptrDataNode->getSize();
 
-                ObjectUIDType uidUpdated = ObjectUIDType::createAddressFromArgs(nMediaType, nPos, nBlockSize, nNodeSize);
+                size_t nBlock = 0;
+                if (allocator.allocate(std::ceil(nNodeSize / (float)nBlockSize), nBlock) != CacheErrorCode::Success)
+                {
+                    throw new std::logic_error("should not occur!");   // TODO: critical log.
+                }
 
-                vtNodes[idx].second.first = uidUpdated;
+                ObjectUIDType uidUpdated = ObjectUIDType::createAddressFromArgs(nMediaType, nBlock, nBlockSize, nNodeSize);
 
-                nPos += std::ceil(nNodeSize / (float)nBlockSize);
+                vtNodes[idx].second.first = uidUpdated;
             }
         }
     }
@@ -1,6 +1,7 @@
 #pragma once
 #include "BeTreeIStorage.hpp"
 #include "BeTreeNode.hpp"
+#include "CacheStats.h"
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
@@ -22,9 +23,34 @@ private:
     std::list<std::pair<uint64_t, NodePtr>> cache;
     std::weak_ptr<BeTreeIStorage<KeyType, ValueType>> storage;
 
+    // Internal nodes reserve room for a full message buffer, so they weigh far more than leaves; the byte budget
+    // accounts for that. Once the resident bytes would pass the high watermark, eviction goes down to the low one.
+    size_t highWatermarkBytes;
+    size_t lowWatermarkBytes;
+    size_t residentBytes;
+
+    size_t pinnedSkips;
+    size_t evictionStalls;
+
 public:
     BeTreeLRUCache(size_t capacity, std::shared_ptr<BeTreeIStorage<KeyType, ValueType>> storage = nullptr)
-        : capacity(capacity), storage(storage) {}
+        : capacity(capacity), storage(storage), highWatermarkBytes(0), lowWatermarkBytes(0), residentBytes(0), pinnedSkips(0), evictionStalls(0) {}
+
+    // 0 turns the byte budget off, the capacity (in nodes) applies either way.
+    void setByteBudget(size_t highWatermarkBytes, size_t lowWatermarkBytes) {
+        this->highWatermarkBytes = highWatermarkBytes;
+        this->lowWatermarkBytes = std::min(lowWatermarkBytes, highWatermarkBytes);
+    }
+
+    void getCacheStats(CacheStats& stats) const {
+        stats = CacheStats{};
+        stats.m_nObjects = cache.size();
+        stats.m_nResidentBytes = residentBytes;
+        stats.m_nHighWatermarkBytes = highWatermarkBytes;
+        stats.m_nLowWatermarkBytes = lowWatermarkBytes;
+        stats.m_nPinnedSkips = pinnedSkips;
+        stats.m_nEvictionStalls = evictionStalls;
+    }
 
     void setStorage(std::shared_ptr<BeTreeIStorage<KeyType, ValueType>> storage) {
         this->storage = storage;
@@ -39,16 +65,20 @@ public:
     void put(uint64_t id, NodePtr node) {
         auto it = std::find_if(cache.begin(), cache.end(), [id](const std::pair<uint64_t, NodePtr>& item) { return item.first == id; });
 
+        size_t bytes = node->getSerializedSize();
+
         if (it != cache.end()) {
             // Move the existing item to the front
             cache.splice(cache.begin(), cache, it);
+            residentBytes = residentBytes + bytes - it->second->getSerializedSize();
             it->second = node;
         } else {
             // Add new item
-            if (cache.size() >= capacity) {
-                evictLeastUsed();
+            if (cache.size() >= capacity || (highWatermarkBytes > 0 && residentBytes + bytes > highWatermarkBytes)) {
+                evictLeastUsed(bytes);
             }
             cache.push_front({ id, node });
+            residentBytes += bytes;
         }
     }
 
@@ -68,6 +98,7 @@ public:
     void remove(uint64_t id) {
         auto it = std::find_if(cache.begin(), cache.end(), [id](const std::pair<uint64_t, NodePtr>& item) { return item.first == id; });
         if (it != cache.end()) {
+            residentBytes -= it->second->getSerializedSize();
             cache.erase(it);
         }
     }
@@ -84,15 +115,23 @@ public:
     }
 
 private:
-    void evictLeastUsed() {
+    void evictLeastUsed(size_t incomingBytes) {
         if (cache.empty()) {
             return;
         }
 
-        // Iterate through the cache from the back and remove the first nodes with use_count() == 1 until the cache size is less than the capacity
+        bool overBudget = highWatermarkBytes > 0 && residentBytes + incomingBytes > highWatermarkBytes;
+
+        // Iterate through the cache from the back and remove the nodes that are not pinned until the cache size is less than the capacity.
+        // A node is pinned explicitly (ObjectPin) or by any handle held besides the cache's own.
         auto it = cache.rbegin();
         while (it != cache.rend()) {
-            if (it->second.use_count() > 1 || it->second->isRoot()) {
+            if (it->second->isPinned() || it->second.use_count() > 1) {
+                pinnedSkips++;
+                ++it;
+                continue;
+            }
+            if (it->second->isRoot()) {
                 ++it;
                 continue;
             }
@@ -106,11 +145,14 @@ private:
             }
 
             storage.lock()->saveNode(it->first, it->second);
+            residentBytes -= it->second->getSerializedSize();
             cache.erase(std::next(it).base());
             // also print if it's the root node
-            if (cache.size() < capacity) {
-                break;
+            if (cache.size() < capacity && (!overBudget || residentBytes + incomingBytes <= lowWatermarkBytes)) {
+                return;
             }
         }
+
+        evictionStalls++;
     }
 };
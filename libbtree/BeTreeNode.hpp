@@ -33,6 +33,8 @@ public:
 
     CachePtr cache;
 
+    uint32_t pins; // held by ObjectPin, the cache never evicts a pinned node
+
     enum ChildChangeType {
         None,
         Split,
@@ -50,7 +52,7 @@ public:
 
     virtual ~BeTreeNode() = default;
     BeTreeNode(uint16_t fanout, CachePtr cache, uint64_t parent = 0)
-        : fanout(fanout), parent(parent), cache(cache), id(0), leftSibling(0), rightSibling(0) {}
+        : fanout(fanout), parent(parent), cache(cache), id(0), leftSibling(0), rightSibling(0), pins(0) {}
 
     virtual ErrorCode applyMessage(MessagePtr message, uint16_t indexInParent, ChildChange& oldChild) = 0;
     virtual ErrorCode insert(MessagePtr message, ChildChange& newChild) = 0;
@@ -60,6 +62,9 @@ public:
     // Helper functions
     virtual bool isLeaf() const = 0;
     bool isRoot() const { return this->parent == 0; }
+    void pin() { this->pins++; }
+    void unpin() { this->pins--; }
+    bool isPinned() const { return this->pins > 0; }
     uint16_t size() const { return this->keys.size(); }
     bool isUnderflowing() const { return size() < (this->fanout - 1) / 2; }
     bool isMergeable() const { return size() == this->fanout / 2; }
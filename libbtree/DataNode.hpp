@@ -5,11 +5,13 @@
 #include <map>
 #include <cmath>
 #include <optional>
+#include <algorithm>
 
 #include <iostream>
 #include <fstream>
 #include <assert.h>
 #include "ErrorCodes.h"
+#include "KeySearch.hpp"
 
 template <typename KeyType, typename ValueType, typename ObjectUIDType, uint8_t TYPE_UID>
 class DataNode
@@ -27,6 +29,11 @@ private:
 	{
 		std::vector<KeyType> m_vtKeys;
 		std::vector<ValueType> m_vtValues;
+
+		// B-link sibling link: the node holds the keys below m_keyHigh and anything from m_keyHigh onwards has moved
+		// to m_uidRight. Both are unset on the rightmost node of the level. They are kept in memory only.
+		std::optional<KeyType> m_keyHigh;
+		std::optional<ObjectUIDType> m_uidRight;
 	};
 
 public:
@@ -56,6 +63,9 @@ public:
 		{
 			m_ptrData->m_vtValues.push_back(ValueType(obj));
 		}
+
+		m_ptrData->m_keyHigh = source.m_ptrData->m_keyHigh;
+		m_ptrData->m_uidRight = source.m_ptrData->m_uidRight;
 	}
 
 	DataNode(const char* szData)
@@ -144,33 +154,70 @@ public:
 		m_ptrData->m_vtValues.assign(itBeginValues, itEndValues);
 	}
 
+	DataNode(KeyTypeIterator itBeginKeys, KeyTypeIterator itEndKeys, ValueTypeIterator itBeginValues, ValueTypeIterator itEndValues,
+		const std::optional<KeyType>& keyHigh, const std::optional<ObjectUIDType>& uidRight)
+		: m_ptrData(std::make_shared<DATANODESTRUCT>())
+	{
+		m_ptrData->m_vtKeys.assign(itBeginKeys, itEndKeys);
+		m_ptrData->m_vtValues.assign(itBeginValues, itEndValues);
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+	}
+
 	inline ErrorCode insert(const KeyType& key, const ValueType& value)
 	{
-		size_t nChildIdx = m_ptrData->m_vtKeys.size();
-		for (int nIdx = 0; nIdx < m_ptrData->m_vtKeys.size(); ++nIdx)
+		size_t nChildIdx = KeySearch::upperBound(m_ptrData->m_vtKeys.data(), m_ptrData->m_vtKeys.size(), key);
+
+		m_ptrData->m_vtKeys.insert(m_ptrData->m_vtKeys.begin() + nChildIdx, key);
+		m_ptrData->m_vtValues.insert(m_ptrData->m_vtValues.begin() + nChildIdx, value);
+
+		return ErrorCode::Success;
+	}
+
+	/*
+	 * Merges a range of (key, value) pairs sorted by key into the node; equal keys are placed after the existing ones, as in insert.
+	 */
+	template <typename IteratorType>
+	inline ErrorCode insert(IteratorType itBegin, IteratorType itEnd)
+	{
+		std::vector<KeyType> vtKeys;
+		std::vector<ValueType> vtValues;
+
+		size_t nTotal = m_ptrData->m_vtKeys.size() + std::distance(itBegin, itEnd);
+		vtKeys.reserve(nTotal);
+		vtValues.reserve(nTotal);
+
+		size_t nIdx = 0;
+		for (IteratorType it = itBegin; it != itEnd; it++)
 		{
-			if (key < m_ptrData->m_vtKeys[nIdx])
+			while (nIdx < m_ptrData->m_vtKeys.size() && !(it->first < m_ptrData->m_vtKeys[nIdx]))
 			{
-				nChildIdx = nIdx;
-				break;
+				vtKeys.push_back(m_ptrData->m_vtKeys[nIdx]);
+				vtValues.push_back(m_ptrData->m_vtValues[nIdx]);
+				nIdx++;
 			}
+
+			vtKeys.push_back(it->first);
+			vtValues.push_back(it->second);
 		}
 
-		m_ptrData->m_vtKeys.insert(m_ptrData->m_vtKeys.begin() + nChildIdx, key);
-		m_ptrData->m_vtValues.insert(m_ptrData->m_vtValues.begin() + nChildIdx, value);
+		vtKeys.insert(vtKeys.end(), m_ptrData->m_vtKeys.begin() + nIdx, m_ptrData->m_vtKeys.end());
+		vtValues.insert(vtValues.end(), m_ptrData->m_vtValues.begin() + nIdx, m_ptrData->m_vtValues.end());
+
+		m_ptrData->m_vtKeys.swap(vtKeys);
+		m_ptrData->m_vtValues.swap(vtValues);
 
 		return ErrorCode::Success;
 	}
 
 	inline ErrorCode remove(const KeyType& key)
 	{
-		KeyTypeIterator it = std::lower_bound(m_ptrData->m_vtKeys.begin(), m_ptrData->m_vtKeys.end(), key);
+		size_t nIdx = KeySearch::lowerBound(m_ptrData->m_vtKeys.data(), m_ptrData->m_vtKeys.size(), key);
 
-		if (it != m_ptrData->m_vtKeys.end() && *it == key)
+		if (nIdx < m_ptrData->m_vtKeys.size() && m_ptrData->m_vtKeys[nIdx] == key)
 		{
-			int index = it - m_ptrData->m_vtKeys.begin();
-			m_ptrData->m_vtKeys.erase(it);
-			m_ptrData->m_vtValues.erase(m_ptrData->m_vtValues.begin() + index);
+			m_ptrData->m_vtKeys.erase(m_ptrData->m_vtKeys.begin() + nIdx);
+			m_ptrData->m_vtValues.erase(m_ptrData->m_vtValues.begin() + nIdx);
 
 			return ErrorCode::Success;
 		}
@@ -183,6 +230,25 @@ public:
 		return m_ptrData->m_vtKeys.size() > nDegree;
 	}
 
+	inline bool canTriggerSplit(size_t nDegree) const
+	{
+		return m_ptrData->m_vtKeys.size() + 1 > nDegree;
+	}
+
+	/*
+	 * True if one more entry fits without growing the arrays; growing frees the buffers an optimistic reader may be scanning.
+	 */
+	inline bool canInsertInPlace() const
+	{
+		return m_ptrData->m_vtKeys.size() < m_ptrData->m_vtKeys.capacity() && m_ptrData->m_vtValues.size() < m_ptrData->m_vtValues.capacity();
+	}
+
+	inline void reserve(size_t nCapacity)
+	{
+		m_ptrData->m_vtKeys.reserve(nCapacity);
+		m_ptrData->m_vtValues.reserve(nCapacity);
+	}
+
 	inline bool requireMerge(size_t nDegree) const
 	{
 		return m_ptrData->m_vtKeys.size() <= std::ceil(nDegree / 2.0f);
@@ -208,11 +274,10 @@ public:
 
 	inline ErrorCode getValue(const KeyType& key, ValueType& value) const
 	{
-		KeyTypeIterator it = std::lower_bound(m_ptrData->m_vtKeys.begin(), m_ptrData->m_vtKeys.end(), key);
-		if (it != m_ptrData->m_vtKeys.end() && *it == key)
+		size_t nIdx = KeySearch::lowerBound(m_ptrData->m_vtKeys.data(), m_ptrData->m_vtKeys.size(), key);
+		if (nIdx < m_ptrData->m_vtKeys.size() && m_ptrData->m_vtKeys[nIdx] == key)
 		{
-			size_t index = it - m_ptrData->m_vtKeys.begin();
-			value = m_ptrData->m_vtValues[index];
+			value = m_ptrData->m_vtValues[nIdx];
 
 			return ErrorCode::Success;
 		}
@@ -220,14 +285,55 @@ public:
 		return ErrorCode::KeyDoesNotExist;
 	}
 
+	inline size_t getLowerBoundIdx(const KeyType& key) const
+	{
+		return KeySearch::lowerBound(m_ptrData->m_vtKeys.data(), m_ptrData->m_vtKeys.size(), key);
+	}
+
+	inline const KeyType& getKeyAt(size_t nIdx) const
+	{
+		return m_ptrData->m_vtKeys[nIdx];
+	}
+
+	inline const ValueType& getValueAt(size_t nIdx) const
+	{
+		return m_ptrData->m_vtValues[nIdx];
+	}
+
+	/*
+	 * True if key has moved to a right sibling that the parent does not know about yet.
+	 */
+	inline bool isBeyondHighKey(const KeyType& key) const
+	{
+		return m_ptrData->m_keyHigh && !(key < *m_ptrData->m_keyHigh);
+	}
+
+	inline const std::optional<KeyType>& getHighKey() const
+	{
+		return m_ptrData->m_keyHigh;
+	}
+
+	inline const std::optional<ObjectUIDType>& getRightSibling() const
+	{
+		return m_ptrData->m_uidRight;
+	}
+
+	inline void setRightSibling(const std::optional<KeyType>& keyHigh, const std::optional<ObjectUIDType>& uidRight)
+	{
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+	}
+
 	template <typename Cache, typename CacheKeyType>
 	inline ErrorCode split(Cache ptrCache, std::optional<CacheKeyType>& uidSibling, KeyType& pivotKeyForParent)
 	{
 		size_t nMid = m_ptrData->m_vtKeys.size() / 2;
 
+		// The sibling takes over the upper end of the range along with the link to the rest of the level.
 		ptrCache->template createObjectOfType<SelfType>(uidSibling,
 			m_ptrData->m_vtKeys.begin() + nMid, m_ptrData->m_vtKeys.end(),
-			m_ptrData->m_vtValues.begin() + nMid, m_ptrData->m_vtValues.end());
+			m_ptrData->m_vtValues.begin() + nMid, m_ptrData->m_vtValues.end(),
+			m_ptrData->m_keyHigh, m_ptrData->m_uidRight);
 
 		if (!uidSibling)
 		{
@@ -239,6 +345,62 @@ public:
 		m_ptrData->m_vtKeys.resize(nMid);
 		m_ptrData->m_vtValues.resize(nMid);
 
+		m_ptrData->m_keyHigh = pivotKeyForParent;
+		m_ptrData->m_uidRight = *uidSibling;
+
+		return ErrorCode::Success;
+	}
+
+	/*
+	 * Splits an overfull node into as many evenly sized nodes as needed to bring each of them within nDegree keys.
+	 * The node keeps the first chunk; the (pivot, uid) of every new right sibling is appended to vtSiblings in key order.
+	 */
+	template <typename Cache, typename CacheKeyType>
+	inline ErrorCode multiSplit(Cache ptrCache, size_t nDegree, std::vector<std::pair<KeyType, CacheKeyType>>& vtSiblings)
+	{
+		size_t nTotal = m_ptrData->m_vtKeys.size();
+		size_t nNodes = (nTotal + nDegree - 1) / nDegree;
+
+		std::vector<size_t> vtOffsets(nNodes + 1, 0);
+		for (size_t nNode = 0; nNode < nNodes; nNode++)
+		{
+			vtOffsets[nNode + 1] = vtOffsets[nNode] + nTotal / nNodes + (nNode < nTotal % nNodes ? 1 : 0);
+		}
+
+		// The siblings are created right to left so that each one can be linked to the one after it.
+		std::optional<KeyType> keyHigh = m_ptrData->m_keyHigh;
+		std::optional<CacheKeyType> uidRight = m_ptrData->m_uidRight;
+
+		size_t nFirst = vtSiblings.size();
+		for (size_t nNode = nNodes - 1; nNode > 0; nNode--)
+		{
+			size_t nOffset = vtOffsets[nNode];
+
+			std::optional<CacheKeyType> uidSibling;
+			ptrCache->template createObjectOfType<SelfType>(uidSibling,
+				m_ptrData->m_vtKeys.cbegin() + nOffset, m_ptrData->m_vtKeys.cbegin() + vtOffsets[nNode + 1],
+				m_ptrData->m_vtValues.cbegin() + nOffset, m_ptrData->m_vtValues.cbegin() + vtOffsets[nNode + 1],
+				keyHigh, uidRight);
+
+			if (!uidSibling)
+			{
+				return ErrorCode::Error;
+			}
+
+			vtSiblings.push_back(std::make_pair(m_ptrData->m_vtKeys[nOffset], *uidSibling));
+
+			keyHigh = m_ptrData->m_vtKeys[nOffset];
+			uidRight = uidSibling;
+		}
+
+		std::reverse(vtSiblings.begin() + nFirst, vtSiblings.end());
+
+		m_ptrData->m_vtKeys.resize(vtOffsets[1]);
+		m_ptrData->m_vtValues.resize(vtOffsets[1]);
+
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+
 		return ErrorCode::Success;
 	}
 
@@ -274,6 +436,8 @@ public:
 		m_ptrData->m_vtValues.insert(m_ptrData->m_vtValues.begin(), value);
 
 		pivotKeyForParent = key;
+
+		ptrLHSSibling->m_ptrData->m_keyHigh = pivotKeyForParent;
 	}
 
 	inline void moveAnEntityFromRHSSibling(std::shared_ptr<SelfType> ptrRHSSibling, KeyType& pivotKeyForParent)
@@ -293,12 +457,17 @@ public:
 		m_ptrData->m_vtValues.push_back(value);
 
 		pivotKeyForParent = ptrRHSSibling->m_ptrData->m_vtKeys.front();
+
+		m_ptrData->m_keyHigh = pivotKeyForParent;
 	}
 
 	inline void mergeNode(std::shared_ptr<SelfType> ptrSibling)
 	{
 		m_ptrData->m_vtKeys.insert(m_ptrData->m_vtKeys.end(), ptrSibling->m_ptrData->m_vtKeys.begin(), ptrSibling->m_ptrData->m_vtKeys.end());
 		m_ptrData->m_vtValues.insert(m_ptrData->m_vtValues.end(), ptrSibling->m_ptrData->m_vtValues.begin(), ptrSibling->m_ptrData->m_vtValues.end());
+
+		m_ptrData->m_keyHigh = ptrSibling->m_ptrData->m_keyHigh;
+		m_ptrData->m_uidRight = ptrSibling->m_ptrData->m_uidRight;
 	}
 
 public:
@@ -331,26 +500,9 @@ public:
 		szBuffer = new char[nBufferSize + 1];
 		memset(szBuffer, 0, nBufferSize + 1);
 
-		size_t nOffset = 0;
-		memcpy(szBuffer, &UID, sizeof(uint8_t));
-		nOffset += sizeof(uint8_t);
-
-		memcpy(szBuffer + nOffset, &nKeyCount, sizeof(size_t));
-		nOffset += sizeof(size_t);
-
-		memcpy(szBuffer + nOffset, &nValueCount, sizeof(size_t));
-		nOffset += sizeof(size_t);
-
-		size_t nKeysSize = nKeyCount * sizeof(KeyType);
-		memcpy(szBuffer + nOffset, m_ptrData->m_vtKeys.data(), nKeysSize);
-		nOffset += nKeysSize;
-
-		size_t nValuesSize = nValueCount * sizeof(ValueType);
-		memcpy(szBuffer + nOffset, m_ptrData->m_vtValues.data(), nValuesSize);
-		nOffset += nValuesSize;
-
-		assert(nBufferSize == nOffset);
+		serializeTo(szBuffer, uidObjectType);
 
+#ifndef NDEBUG
 		SelfType* _t = new SelfType(szBuffer);
 		for (int i = 0; i < _t->m_ptrData->m_vtKeys.size(); i++)
 		{
@@ -361,6 +513,7 @@ public:
 			assert(_t->m_ptrData->m_vtValues[i] == m_ptrData->m_vtValues[i]);
 		}
 		delete _t;
+#endif NDEBUG
 
 		// hint
 		/*
@@ -372,6 +525,45 @@ public:
 		*/
 	}
 
+	/*
+	 * Writes what serialize does into a buffer of the caller's (e.g. an aligned one for O_DIRECT) of at least
+	 * getSize() bytes.
+	 */
+	inline void serializeTo(char* szBuffer, uint8_t& uidObjectType) const
+	{
+		static_assert(
+			std::is_trivial<KeyType>::value &&
+			std::is_standard_layout<KeyType>::value &&
+			std::is_trivial<ValueType>::value &&
+			std::is_standard_layout<ValueType>::value,
+			"Can only deserialize POD types with this function");
+
+		uidObjectType = UID;
+
+		size_t nKeyCount = m_ptrData->m_vtKeys.size();
+		size_t nValueCount = m_ptrData->m_vtValues.size();
+
+		size_t nOffset = 0;
+		memcpy(szBuffer, &uidObjectType, sizeof(uint8_t));
+		nOffset += sizeof(uint8_t);
+
+		memcpy(szBuffer + nOffset, &nKeyCount, sizeof(size_t));
+		nOffset += sizeof(size_t);
+
+		memcpy(szBuffer + nOffset, &nValueCount, sizeof(size_t));
+		nOffset += sizeof(size_t);
+
+		size_t nKeysSize = nKeyCount * sizeof(KeyType);
+		memcpy(szBuffer + nOffset, m_ptrData->m_vtKeys.data(), nKeysSize);
+		nOffset += nKeysSize;
+
+		size_t nValuesSize = nValueCount * sizeof(ValueType);
+		memcpy(szBuffer + nOffset, m_ptrData->m_vtValues.data(), nValuesSize);
+		nOffset += nValuesSize;
+
+		assert(getSize() == nOffset);
+	}
+
 	inline void writeToStream(std::fstream& os, uint8_t& uidObjectType, size_t& nDataSize) const
 	{
 		static_assert(
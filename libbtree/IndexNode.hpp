@@ -8,12 +8,15 @@
 #include <iostream>
 #include <cmath>
 #include <optional>
+#include <algorithm>
 
 #include <iostream>
 #include <fstream>
 #include <assert.h>
 
 #include "ErrorCodes.h"
+#include "AccessMode.h"
+#include "KeySearch.hpp"
 
 using namespace std;
 
@@ -29,10 +32,38 @@ private:
 	typedef std::vector<KeyType>::const_iterator KeyTypeIterator;
 	typedef std::vector<ObjectUIDType>::const_iterator CacheKeyTypeIterator;
 
+#ifdef __TREE_WITH_CACHE__
+#ifndef __CONCURRENT__
+	/*
+	 * Swizzled reference to a resident child. It is only followed while the slot still holds m_uid and the cache
+	 * object is alive with the epoch it had when it was swizzled, the cache bumps the epoch when the object is evicted
+	 * or relocated. Anything else falls back to the uid, so the children never have to be unswizzled explicitly.
+	 */
+	struct SwizzledChild
+	{
+		ObjectUIDType m_uid;
+		std::weak_ptr<void> m_ptrObject;
+		size_t m_nEpoch;
+	};
+#endif __CONCURRENT__
+#endif __TREE_WITH_CACHE__
+
 	struct INDEXNODESTRUCT
 	{
 		std::vector<KeyType> m_vtPivots;
 		std::vector<ObjectUIDType> m_vtChildren;
+
+		// B-link sibling link: the node covers the keys below m_keyHigh and anything from m_keyHigh onwards has moved
+		// to m_uidRight. Both are unset on the rightmost node of the level. They are kept in memory only.
+		std::optional<KeyType> m_keyHigh;
+		std::optional<ObjectUIDType> m_uidRight;
+
+#ifdef __TREE_WITH_CACHE__
+#ifndef __CONCURRENT__
+		// Indexed like m_vtChildren but not kept in step with it, a shifted slot fails the uid check. In memory only.
+		std::vector<SwizzledChild> m_vtSwizzled;
+#endif __CONCURRENT__
+#endif __TREE_WITH_CACHE__
 	};
 
 public:
@@ -62,6 +93,9 @@ public:
 		{
 			m_ptrData->m_vtChildren.push_back(ObjectUIDType(obj));
 		}
+
+		m_ptrData->m_keyHigh = source.m_ptrData->m_keyHigh;
+		m_ptrData->m_uidRight = source.m_ptrData->m_uidRight;
 	}
 
 	IndexNode(const char* szData)
@@ -143,6 +177,16 @@ public:
 		m_ptrData->m_vtChildren.assign(itBeginChildren, itEndChildren);
 	}
 
+	IndexNode(KeyTypeIterator itBeginPivots, KeyTypeIterator itEndPivots, CacheKeyTypeIterator itBeginChildren, CacheKeyTypeIterator itEndChildren,
+		const std::optional<KeyType>& keyHigh, const std::optional<ObjectUIDType>& uidRight)
+		: m_ptrData(make_shared<INDEXNODESTRUCT>())
+	{
+		m_ptrData->m_vtPivots.assign(itBeginPivots, itEndPivots);
+		m_ptrData->m_vtChildren.assign(itBeginChildren, itEndChildren);
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+	}
+
 	IndexNode(const KeyType& pivotKey, const ObjectUIDType& ptrLHSNode, const ObjectUIDType& ptrRHSNode)
 		: m_ptrData(make_shared<INDEXNODESTRUCT>())
 	{
@@ -153,15 +197,7 @@ public:
 
 	inline ErrorCode insert(const KeyType& pivotKey, const ObjectUIDType& uidSibling)
 	{
-		size_t nChildIdx = m_ptrData->m_vtPivots.size();
-		for (int nIdx = 0; nIdx < m_ptrData->m_vtPivots.size(); ++nIdx)
-		{
-			if (pivotKey < m_ptrData->m_vtPivots[nIdx])
-			{
-				nChildIdx = nIdx;
-				break;
-			}
-		}
+		size_t nChildIdx = KeySearch::upperBound(m_ptrData->m_vtPivots.data(), m_ptrData->m_vtPivots.size(), pivotKey);
 
 		m_ptrData->m_vtPivots.insert(m_ptrData->m_vtPivots.begin() + nChildIdx, pivotKey);
 		m_ptrData->m_vtChildren.insert(m_ptrData->m_vtChildren.begin() + nChildIdx + 1, uidSibling);
@@ -169,6 +205,29 @@ public:
 		return ErrorCode::Success;
 	}
 
+	/*
+	 * Inserts the (pivot, uid) pairs produced by splitting the child at nChildIdx right after that child.
+	 */
+	inline ErrorCode insert(size_t nChildIdx, const std::vector<std::pair<KeyType, ObjectUIDType>>& vtSiblings)
+	{
+		std::vector<KeyType> vtPivots;
+		std::vector<ObjectUIDType> vtChildren;
+
+		vtPivots.reserve(vtSiblings.size());
+		vtChildren.reserve(vtSiblings.size());
+
+		for (const auto& prSibling : vtSiblings)
+		{
+			vtPivots.push_back(prSibling.first);
+			vtChildren.push_back(prSibling.second);
+		}
+
+		m_ptrData->m_vtPivots.insert(m_ptrData->m_vtPivots.begin() + nChildIdx, vtPivots.begin(), vtPivots.end());
+		m_ptrData->m_vtChildren.insert(m_ptrData->m_vtChildren.begin() + nChildIdx + 1, vtChildren.begin(), vtChildren.end());
+
+		return ErrorCode::Success;
+	}
+
 	template <typename CacheType, typename ObjectCoreType>
 	inline ErrorCode rebalanceIndexNode(CacheType ptrCache, const ObjectUIDType& uidChild, ObjectCoreType ptrChild, const KeyType& key, size_t nDegree, std::optional<ObjectUIDType>& uidObjectToDelete)
 	{
@@ -181,20 +240,21 @@ public:
 		{
 #ifdef __TREE_WITH_CACHE__
 			std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, uidUpdated);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, uidUpdated, AccessMode::Read);    //TODO: lock
 
 			if (uidUpdated != std::nullopt)
 			{
 				m_ptrData->m_vtChildren[nChildIdx - 1] = *uidUpdated;
 			}
 #else __TREE_WITH_CACHE__
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, AccessMode::Read);    //TODO: lock
 #endif __TREE_WITH_CACHE__
 
 			if (ptrLHSNode->getKeysCount() > std::ceil(nDegree / 2.0f))	// TODO: macro?
 			{
 				KeyType key;
 				ptrChild->moveAnEntityFromLHSSibling(ptrLHSNode, m_ptrData->m_vtPivots[nChildIdx - 1], key);
+				ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx - 1]);
 
 				m_ptrData->m_vtPivots[nChildIdx - 1] = key;
 				return ErrorCode::Success;
@@ -205,20 +265,21 @@ public:
 		{
 #ifdef __TREE_WITH_CACHE__
 			std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, uidUpdated);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, uidUpdated, AccessMode::Read);    //TODO: lock
 
 			if (uidUpdated != std::nullopt)
 			{
 				m_ptrData->m_vtChildren[nChildIdx + 1] = *uidUpdated;
 			}
 #else __TREE_WITH_CACHE__
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, AccessMode::Read);    //TODO: lock
 #endif __TREE_WITH_CACHE__
 
 			if (ptrRHSNode->getKeysCount() > std::ceil(nDegree / 2.0f))
 			{
 				KeyType key;
 				ptrChild->moveAnEntityFromRHSSibling(ptrRHSNode, m_ptrData->m_vtPivots[nChildIdx], key);
+				ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx + 1]);
 
 				m_ptrData->m_vtPivots[nChildIdx] = key;
 				return ErrorCode::Success;
@@ -228,6 +289,7 @@ public:
 		if (nChildIdx > 0)
 		{
 			ptrLHSNode->mergeNodes(ptrChild, m_ptrData->m_vtPivots[nChildIdx - 1]);
+			ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx - 1]);
 
 			uidObjectToDelete = m_ptrData->m_vtChildren[nChildIdx];
 			if (uidObjectToDelete != uidChild)
@@ -272,20 +334,21 @@ public:
 		{
 #ifdef __TREE_WITH_CACHE__
 			std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, uidUpdated);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, uidUpdated, AccessMode::Read);    //TODO: lock
 
 			if (uidUpdated != std::nullopt)
 			{
 				m_ptrData->m_vtChildren[nChildIdx - 1] = *uidUpdated;
 			}
 #else __TREE_WITH_CACHE__
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx - 1], ptrLHSNode, AccessMode::Read);    //TODO: lock
 #endif __TREE_WITH_CACHE__
 
 			if (ptrLHSNode->getKeysCount() > std::ceil(nDegree / 2.0f))
 			{
 				KeyType key;
 				ptrChild->moveAnEntityFromLHSSibling(ptrLHSNode, key);
+				ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx - 1]);
 
 				m_ptrData->m_vtPivots[nChildIdx - 1] = key;
 				return ErrorCode::Success;
@@ -296,14 +359,14 @@ public:
 		{
 #ifdef __TREE_WITH_CACHE__
 			std::optional<ObjectUIDType> uidUpdated = std::nullopt;
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, uidUpdated);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, uidUpdated, AccessMode::Read);    //TODO: lock
 
 			if (uidUpdated != std::nullopt)
 			{
 				m_ptrData->m_vtChildren[nChildIdx + 1] = *uidUpdated;
 			}
 #else __TREE_WITH_CACHE__
-			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode);    //TODO: lock
+			ptrCache->template getObjectOfType<ObjectCoreType>(m_ptrData->m_vtChildren[nChildIdx + 1], ptrRHSNode, AccessMode::Read);    //TODO: lock
 #endif __TREE_WITH_CACHE__
 
 
@@ -311,6 +374,7 @@ public:
 			{
 				KeyType key;
 				ptrChild->moveAnEntityFromRHSSibling(ptrRHSNode, key);
+				ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx + 1]);
 
 				m_ptrData->m_vtPivots[nChildIdx] = key;
 				return ErrorCode::Success;
@@ -320,6 +384,7 @@ public:
 		if (nChildIdx > 0)
 		{
 			ptrLHSNode->mergeNode(ptrChild);
+			ptrCache->markDirty(m_ptrData->m_vtChildren[nChildIdx - 1]);
 
 			uidObjectToDelete = m_ptrData->m_vtChildren[nChildIdx];
 			if (uidObjectToDelete != uidChild)
@@ -362,13 +427,7 @@ public:
 		// 	std::cout << m_ptrData->m_vtPivots[idx] << ",";
 		// std::cout << "]]]]" << std::endl;
 
-		size_t nChildIdx = 0;
-		while (nChildIdx < m_ptrData->m_vtPivots.size() && key >= m_ptrData->m_vtPivots[nChildIdx])
-		{
-			nChildIdx++;
-		}
-
-		return nChildIdx;
+		return KeySearch::upperBound(m_ptrData->m_vtPivots.data(), m_ptrData->m_vtPivots.size(), key);
 	}
 
 	inline ObjectUIDType getChildAt(size_t nIdx) const 
@@ -376,11 +435,90 @@ public:
 		return m_ptrData->m_vtChildren[nIdx];
 	}
 
+	inline const KeyType& getPivotAt(size_t nIdx) const
+	{
+		return m_ptrData->m_vtPivots[nIdx];
+	}
+
+	inline size_t getChildrenCount() const
+	{
+		return m_ptrData->m_vtChildren.size();
+	}
+
 	inline ObjectUIDType getChild(const KeyType& key) const
 	{
 		return m_ptrData->m_vtChildren[getChildNodeIdx(key)];
 	}
 
+#ifdef __TREE_WITH_CACHE__
+#ifndef __CONCURRENT__
+	/*
+	 * Returns the cache object of the child at nIdx when the reference swizzled by swizzleChildAt is still valid,
+	 * nullptr otherwise.
+	 */
+	template <typename ObjectTypePtr>
+	inline ObjectTypePtr getSwizzledChildAt(size_t nIdx) const
+	{
+		if (nIdx >= m_ptrData->m_vtSwizzled.size())
+		{
+			return nullptr;
+		}
+
+		const SwizzledChild& swizzle = m_ptrData->m_vtSwizzled[nIdx];
+		if (!(swizzle.m_uid == m_ptrData->m_vtChildren[nIdx]))
+		{
+			return nullptr;
+		}
+
+		ObjectTypePtr ptrObject = std::static_pointer_cast<typename ObjectTypePtr::element_type>(swizzle.m_ptrObject.lock());
+		if (ptrObject == nullptr || ptrObject->epoch != swizzle.m_nEpoch)
+		{
+			return nullptr;
+		}
+
+		return ptrObject;
+	}
+
+	template <typename ObjectTypePtr>
+	inline void swizzleChildAt(size_t nIdx, const ObjectTypePtr& ptrObject)
+	{
+		if (m_ptrData->m_vtSwizzled.size() < m_ptrData->m_vtChildren.size())
+		{
+			m_ptrData->m_vtSwizzled.resize(m_ptrData->m_vtChildren.size());
+		}
+
+		SwizzledChild& swizzle = m_ptrData->m_vtSwizzled[nIdx];
+		swizzle.m_uid = m_ptrData->m_vtChildren[nIdx];
+		swizzle.m_ptrObject = ptrObject;
+		swizzle.m_nEpoch = ptrObject->epoch;
+	}
+#endif __CONCURRENT__
+#endif __TREE_WITH_CACHE__
+
+	/*
+	 * True if key has moved to a right sibling that the parent does not know about yet.
+	 */
+	inline bool isBeyondHighKey(const KeyType& key) const
+	{
+		return m_ptrData->m_keyHigh && !(key < *m_ptrData->m_keyHigh);
+	}
+
+	inline const std::optional<KeyType>& getHighKey() const
+	{
+		return m_ptrData->m_keyHigh;
+	}
+
+	inline const std::optional<ObjectUIDType>& getRightSibling() const
+	{
+		return m_ptrData->m_uidRight;
+	}
+
+	inline void setRightSibling(const std::optional<KeyType>& keyHigh, const std::optional<ObjectUIDType>& uidRight)
+	{
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+	}
+
 	inline bool requireSplit(size_t nDegree) const
 	{
 		return m_ptrData->m_vtPivots.size() > nDegree;
@@ -391,6 +529,20 @@ public:
 		return m_ptrData->m_vtPivots.size() + 1 > nDegree;
 	}
 
+	/*
+	 * True if one more pivot fits without growing the arrays; growing frees the buffers an optimistic reader may be scanning.
+	 */
+	inline bool canInsertInPlace() const
+	{
+		return m_ptrData->m_vtPivots.size() < m_ptrData->m_vtPivots.capacity() && m_ptrData->m_vtChildren.size() < m_ptrData->m_vtChildren.capacity();
+	}
+
+	inline void reserve(size_t nCapacity)
+	{
+		m_ptrData->m_vtPivots.reserve(nCapacity);
+		m_ptrData->m_vtChildren.reserve(nCapacity + 1);
+	}
+
 	inline bool canTriggerMerge(size_t nDegree) const
 	{
 		return m_ptrData->m_vtPivots.size() <= std::ceil(nDegree / 2.0f) + 1;	// TODO: macro!
@@ -407,9 +559,11 @@ public:
 	{
 		size_t nMid = m_ptrData->m_vtPivots.size() / 2;
 
+		// The sibling takes over the upper end of the range along with the link to the rest of the level.
 		ptrCache->template createObjectOfType<SelfType>(uidSibling,
 			m_ptrData->m_vtPivots.begin() + nMid + 1, m_ptrData->m_vtPivots.end(),
-			m_ptrData->m_vtChildren.begin() + nMid + 1, m_ptrData->m_vtChildren.end());
+			m_ptrData->m_vtChildren.begin() + nMid + 1, m_ptrData->m_vtChildren.end(),
+			m_ptrData->m_keyHigh, m_ptrData->m_uidRight);
 
 		if (!uidSibling)
 		{
@@ -421,6 +575,62 @@ public:
 		m_ptrData->m_vtPivots.resize(nMid);
 		m_ptrData->m_vtChildren.resize(nMid + 1);
 
+		m_ptrData->m_keyHigh = pivotKeyForParent;
+		m_ptrData->m_uidRight = *uidSibling;
+
+		return ErrorCode::Success;
+	}
+
+	/*
+	 * Splits an overfull node into as many evenly sized nodes as needed to bring each of them within nDegree pivots.
+	 * The node keeps the first group of children; the pivot pushed up and the uid of every new right sibling are appended to vtSiblings.
+	 */
+	template <typename Cache>
+	inline ErrorCode multiSplit(Cache ptrCache, size_t nDegree, std::vector<std::pair<KeyType, ObjectUIDType>>& vtSiblings)
+	{
+		size_t nTotal = m_ptrData->m_vtChildren.size();
+		size_t nNodes = (nTotal + nDegree) / (nDegree + 1);
+
+		std::vector<size_t> vtOffsets(nNodes + 1, 0);
+		for (size_t nNode = 0; nNode < nNodes; nNode++)
+		{
+			vtOffsets[nNode + 1] = vtOffsets[nNode] + nTotal / nNodes + (nNode < nTotal % nNodes ? 1 : 0);
+		}
+
+		// The siblings are created right to left so that each one can be linked to the one after it.
+		std::optional<KeyType> keyHigh = m_ptrData->m_keyHigh;
+		std::optional<ObjectUIDType> uidRight = m_ptrData->m_uidRight;
+
+		size_t nFirst = vtSiblings.size();
+		for (size_t nNode = nNodes - 1; nNode > 0; nNode--)
+		{
+			size_t nOffset = vtOffsets[nNode];
+
+			std::optional<ObjectUIDType> uidSibling;
+			ptrCache->template createObjectOfType<SelfType>(uidSibling,
+				m_ptrData->m_vtPivots.cbegin() + nOffset, m_ptrData->m_vtPivots.cbegin() + vtOffsets[nNode + 1] - 1,
+				m_ptrData->m_vtChildren.cbegin() + nOffset, m_ptrData->m_vtChildren.cbegin() + vtOffsets[nNode + 1],
+				keyHigh, uidRight);
+
+			if (!uidSibling)
+			{
+				return ErrorCode::Error;
+			}
+
+			vtSiblings.push_back(std::make_pair(m_ptrData->m_vtPivots[nOffset - 1], *uidSibling));
+
+			keyHigh = m_ptrData->m_vtPivots[nOffset - 1];
+			uidRight = uidSibling;
+		}
+
+		std::reverse(vtSiblings.begin() + nFirst, vtSiblings.end());
+
+		m_ptrData->m_vtPivots.resize(vtOffsets[1] - 1);
+		m_ptrData->m_vtChildren.resize(vtOffsets[1]);
+
+		m_ptrData->m_keyHigh = keyHigh;
+		m_ptrData->m_uidRight = uidRight;
+
 		return ErrorCode::Success;
 	}
 
@@ -456,6 +666,8 @@ public:
 		m_ptrData->m_vtChildren.insert(m_ptrData->m_vtChildren.begin(), value);
 
 		pivotKeyForParent = key;
+
+		ptrLHSSibling->m_ptrData->m_keyHigh = pivotKeyForParent;
 	}
 
 	inline void moveAnEntityFromRHSSibling(shared_ptr<SelfType> ptrRHSSibling, KeyType& pivotKeyForEntity, KeyType& pivotKeyForParent)
@@ -475,6 +687,8 @@ public:
 		m_ptrData->m_vtChildren.push_back(value);
 
 		pivotKeyForParent = key;// ptrRHSSibling->m_ptrData->m_vtPivots.front();
+
+		m_ptrData->m_keyHigh = pivotKeyForParent;
 	}
 
 	inline void mergeNodes(shared_ptr<SelfType> ptrSibling, KeyType& pivotKey)
@@ -482,6 +696,9 @@ public:
 		m_ptrData->m_vtPivots.push_back(pivotKey);
 		m_ptrData->m_vtPivots.insert(m_ptrData->m_vtPivots.end(), ptrSibling->m_ptrData->m_vtPivots.begin(), ptrSibling->m_ptrData->m_vtPivots.end());
 		m_ptrData->m_vtChildren.insert(m_ptrData->m_vtChildren.end(), ptrSibling->m_ptrData->m_vtChildren.begin(), ptrSibling->m_ptrData->m_vtChildren.end());
+
+		m_ptrData->m_keyHigh = ptrSibling->m_ptrData->m_keyHigh;
+		m_ptrData->m_uidRight = ptrSibling->m_ptrData->m_uidRight;
 	}
 
 public:
@@ -547,26 +764,9 @@ public:
 		szBuffer = new char[nBufferSize + 1];
 		memset(szBuffer, 0, nBufferSize + 1);
 
-		size_t nOffset = 0;
-		memcpy(szBuffer, &uidObjectType, sizeof(uint8_t));
-		nOffset += sizeof(uint8_t);
-
-		memcpy(szBuffer + nOffset, &nKeyCount, sizeof(size_t));
-		nOffset += sizeof(size_t);
-
-		memcpy(szBuffer + nOffset, &nValueCount, sizeof(size_t));
-		nOffset += sizeof(size_t);
-
-		size_t nKeysSize = nKeyCount * sizeof(KeyType);
-		memcpy(szBuffer + nOffset, m_ptrData->m_vtPivots.data(), nKeysSize);
-		nOffset += nKeysSize;
-
-		size_t nValuesSize = nValueCount * sizeof(typename ObjectUIDType::NodeUID);
-		memcpy(szBuffer + nOffset, m_ptrData->m_vtChildren.data(), nValuesSize);
-		nOffset += nValuesSize;
-
-		assert(nBufferSize == nOffset);
+		serializeTo(szBuffer, uidObjectType);
 
+#ifndef NDEBUG
 		SelfType* _t = new SelfType(szBuffer);
 		for (int i = 0; i < _t->m_ptrData->m_vtPivots.size(); i++)
 		{
@@ -577,6 +777,7 @@ public:
 			assert(_t->m_ptrData->m_vtChildren[i] == m_ptrData->m_vtChildren[i]);
 		}
 		delete _t;
+#endif NDEBUG
 
 		// hint
 		/*
@@ -588,6 +789,45 @@ public:
 		*/
 	}
 
+	/*
+	 * Writes what serialize does into a buffer of the caller's (e.g. an aligned one for O_DIRECT) of at least
+	 * getSize() bytes.
+	 */
+	inline void serializeTo(char* szBuffer, uint8_t& uidObjectType) const
+	{
+		static_assert(
+			std::is_trivial<KeyType>::value &&
+			std::is_standard_layout<KeyType>::value &&
+			std::is_trivial<typename ObjectUIDType::NodeUID>::value &&
+			std::is_standard_layout<typename ObjectUIDType::NodeUID>::value,
+			"Can only deserialize POD types with this function");
+
+		uidObjectType = UID;
+
+		size_t nKeyCount = m_ptrData->m_vtPivots.size();
+		size_t nValueCount = m_ptrData->m_vtChildren.size();
+
+		size_t nOffset = 0;
+		memcpy(szBuffer, &uidObjectType, sizeof(uint8_t));
+		nOffset += sizeof(uint8_t);
+
+		memcpy(szBuffer + nOffset, &nKeyCount, sizeof(size_t));
+		nOffset += sizeof(size_t);
+
+		memcpy(szBuffer + nOffset, &nValueCount, sizeof(size_t));
+		nOffset += sizeof(size_t);
+
+		size_t nKeysSize = nKeyCount * sizeof(KeyType);
+		memcpy(szBuffer + nOffset, m_ptrData->m_vtPivots.data(), nKeysSize);
+		nOffset += nKeysSize;
+
+		size_t nValuesSize = nValueCount * sizeof(typename ObjectUIDType::NodeUID);
+		memcpy(szBuffer + nOffset, m_ptrData->m_vtChildren.data(), nValuesSize);
+		nOffset += nValuesSize;
+
+		assert(getSize() == nOffset);
+	}
+
 	inline size_t getSize() const
 	{
 		return
@@ -654,6 +894,10 @@ public:
 
 			if (uidUpdated != std::nullopt)
 			{
+#ifdef __CONCURRENT__
+				ptrCache->dropUpdatedUID(m_ptrData->m_vtChildren[nIndex]);
+#endif __CONCURRENT__
+
 				m_ptrData->m_vtChildren[nIndex] = *uidUpdated;
 			}
 
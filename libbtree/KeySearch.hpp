@@ -0,0 +1,216 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE4_2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+/*
+ * Search kernels for the sorted key arrays held by DataNode and IndexNode.
+ *
+ * For 32 and 64-bit integer keys the range is first narrowed with a branchless binary search down to a small
+ * window, and the window is then resolved by counting the keys that precede the search key with SIMD compares
+ * (AVX2 when available, SSE otherwise). Any other KeyType falls back to std::lower_bound/std::upper_bound.
+ * The instruction set is picked at compile time.
+ */
+class KeySearch
+{
+private:
+	// Size of the window that is left to the SIMD count (in keys).
+	static const size_t WINDOW = 8;
+
+	template <typename KeyType>
+	static constexpr bool isVectorizable()
+	{
+		return std::is_integral<KeyType>::value && (sizeof(KeyType) == 4 || sizeof(KeyType) == 8);
+	}
+
+public:
+	/*
+	 * Index of the first key that is not less than key (same as std::lower_bound).
+	 */
+	template <typename KeyType>
+	static inline size_t lowerBound(const KeyType* pKeys, size_t nCount, const KeyType& key)
+	{
+		if constexpr (isVectorizable<KeyType>())
+		{
+			return search<KeyType, false>(pKeys, nCount, key);
+		}
+		else
+		{
+			return std::lower_bound(pKeys, pKeys + nCount, key) - pKeys;
+		}
+	}
+
+	/*
+	 * Index of the first key that is greater than key (same as std::upper_bound).
+	 */
+	template <typename KeyType>
+	static inline size_t upperBound(const KeyType* pKeys, size_t nCount, const KeyType& key)
+	{
+		if constexpr (isVectorizable<KeyType>())
+		{
+			return search<KeyType, true>(pKeys, nCount, key);
+		}
+		else
+		{
+			return std::upper_bound(pKeys, pKeys + nCount, key) - pKeys;
+		}
+	}
+
+private:
+	template <typename KeyType, bool bUpper>
+	static inline bool precedes(const KeyType& keyStored, const KeyType& key)
+	{
+		return bUpper ? !(key < keyStored) : keyStored < key;
+	}
+
+	template <typename KeyType, bool bUpper>
+	static inline size_t search(const KeyType* pKeys, size_t nCount, const KeyType& key)
+	{
+		const KeyType* pBase = pKeys;
+
+		// The answer always lies within [pBase, pBase + nCount].
+		while (nCount > WINDOW)
+		{
+			size_t nHalf = nCount / 2;
+			pBase = precedes<KeyType, bUpper>(pBase[nHalf], key) ? pBase + nHalf : pBase;
+			nCount -= nHalf;
+		}
+
+		return (pBase - pKeys) + countPreceding<KeyType, bUpper>(pBase, nCount, key);
+	}
+
+	/*
+	 * Number of keys in pKeys[0, nCount) that go before key; as the keys are sorted this is also the offset of the bound.
+	 */
+	template <typename KeyType, bool bUpper>
+	static inline size_t countPreceding(const KeyType* pKeys, size_t nCount, const KeyType& key)
+	{
+		size_t nIdx = 0;
+		size_t nPreceding = 0;
+
+#if defined(__AVX2__)
+		if constexpr (sizeof(KeyType) == 4)
+		{
+			const __m256i vtKey = broadcast32<KeyType>(key);
+			for (; nIdx + 8 <= nCount; nIdx += 8)
+			{
+				__m256i vtData = flip32<KeyType>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pKeys + nIdx)));
+				__m256i vtMask = bUpper ? _mm256_cmpgt_epi32(vtData, vtKey) : _mm256_cmpgt_epi32(vtKey, vtData);
+				size_t nSet = popcount(_mm256_movemask_ps(_mm256_castsi256_ps(vtMask)));
+				nPreceding += bUpper ? 8 - nSet : nSet;
+			}
+		}
+		else
+		{
+			const __m256i vtKey = broadcast64<KeyType>(key);
+			for (; nIdx + 4 <= nCount; nIdx += 4)
+			{
+				__m256i vtData = flip64<KeyType>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pKeys + nIdx)));
+				__m256i vtMask = bUpper ? _mm256_cmpgt_epi64(vtData, vtKey) : _mm256_cmpgt_epi64(vtKey, vtData);
+				size_t nSet = popcount(_mm256_movemask_pd(_mm256_castsi256_pd(vtMask)));
+				nPreceding += bUpper ? 4 - nSet : nSet;
+			}
+		}
+#elif defined(__SSE4_2__) || defined(__SSE2__) || defined(_M_X64)
+		if constexpr (sizeof(KeyType) == 4)
+		{
+			const __m128i vtKey = broadcast32<KeyType>(key);
+			for (; nIdx + 4 <= nCount; nIdx += 4)
+			{
+				__m128i vtData = flip32<KeyType>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pKeys + nIdx)));
+				__m128i vtMask = bUpper ? _mm_cmpgt_epi32(vtData, vtKey) : _mm_cmpgt_epi32(vtKey, vtData);
+				size_t nSet = popcount(_mm_movemask_ps(_mm_castsi128_ps(vtMask)));
+				nPreceding += bUpper ? 4 - nSet : nSet;
+			}
+		}
+#if defined(__SSE4_2__)
+		else
+		{
+			const __m128i vtKey = broadcast64<KeyType>(key);
+			for (; nIdx + 2 <= nCount; nIdx += 2)
+			{
+				__m128i vtData = flip64<KeyType>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pKeys + nIdx)));
+				__m128i vtMask = bUpper ? _mm_cmpgt_epi64(vtData, vtKey) : _mm_cmpgt_epi64(vtKey, vtData);
+				size_t nSet = popcount(_mm_movemask_pd(_mm_castsi128_pd(vtMask)));
+				nPreceding += bUpper ? 2 - nSet : nSet;
+			}
+		}
+#endif __SSE4_2__
+#endif __AVX2__
+
+		// Scalar tail (and the whole window when no SIMD path applies).
+		for (; nIdx < nCount; nIdx++)
+		{
+			nPreceding += precedes<KeyType, bUpper>(pKeys[nIdx], key) ? 1 : 0;
+		}
+
+		return nPreceding;
+	}
+
+	static inline size_t popcount(int nMask)
+	{
+		size_t nCount = 0;
+		for (unsigned int nBits = static_cast<unsigned int>(nMask); nBits != 0; nBits &= nBits - 1)
+		{
+			nCount++;
+		}
+		return nCount;
+	}
+
+#if defined(__AVX2__)
+	// SIMD compares are signed; unsigned keys are shifted into the signed range by flipping the sign bit.
+	template <typename KeyType>
+	static inline __m256i flip32(__m256i vtData)
+	{
+		return std::is_signed<KeyType>::value ? vtData : _mm256_xor_si256(vtData, _mm256_set1_epi32(INT32_MIN));
+	}
+
+	template <typename KeyType>
+	static inline __m256i flip64(__m256i vtData)
+	{
+		return std::is_signed<KeyType>::value ? vtData : _mm256_xor_si256(vtData, _mm256_set1_epi64x(INT64_MIN));
+	}
+
+	template <typename KeyType>
+	static inline __m256i broadcast32(const KeyType& key)
+	{
+		return flip32<KeyType>(_mm256_set1_epi32(static_cast<int32_t>(key)));
+	}
+
+	template <typename KeyType>
+	static inline __m256i broadcast64(const KeyType& key)
+	{
+		return flip64<KeyType>(_mm256_set1_epi64x(static_cast<int64_t>(key)));
+	}
+#elif defined(__SSE4_2__) || defined(__SSE2__) || defined(_M_X64)
+	// SIMD compares are signed; unsigned keys are shifted into the signed range by flipping the sign bit.
+	template <typename KeyType>
+	static inline __m128i flip32(__m128i vtData)
+	{
+		return std::is_signed<KeyType>::value ? vtData : _mm_xor_si128(vtData, _mm_set1_epi32(INT32_MIN));
+	}
+
+	template <typename KeyType>
+	static inline __m128i flip64(__m128i vtData)
+	{
+		return std::is_signed<KeyType>::value ? vtData : _mm_xor_si128(vtData, _mm_set1_epi64x(INT64_MIN));
+	}
+
+	template <typename KeyType>
+	static inline __m128i broadcast32(const KeyType& key)
+	{
+		return flip32<KeyType>(_mm_set1_epi32(static_cast<int32_t>(key)));
+	}
+
+	template <typename KeyType>
+	static inline __m128i broadcast64(const KeyType& key)
+	{
+		return flip64<KeyType>(_mm_set1_epi64x(static_cast<int64_t>(key)));
+	}
+#endif __AVX2__
+};
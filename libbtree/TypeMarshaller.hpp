@@ -23,6 +23,14 @@ public:
 			}, objVariant);
 	}
 
+	template <typename... ObjectCoreTypes>
+	static void serializeTo(char* szBuffer, const std::variant<std::shared_ptr<ObjectCoreTypes>...>& objVariant, uint8_t& uidObjectType)
+	{
+		std::visit([szBuffer, &uidObjectType](const auto& value) {
+			value->serializeTo(szBuffer, uidObjectType);
+			}, objVariant);
+	}
+
 	template <typename ObjectType, typename... ObjectCoreTypes>
 	static void deserialize(std::fstream& is, std::shared_ptr<ObjectType>& ptrObject)
 	{
@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * How the caller of getObjectOfType is going to use the object. Only AccessMode::Write marks it dirty; an object
+ * fetched for reading that ends up being modified after all is marked with markDirty.
+ */
+enum class AccessMode {
+    Read,
+    Write,
+};
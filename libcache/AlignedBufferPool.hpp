@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Buffers for O_DIRECT I/O, aligned to and sized in multiples of the alignment. Released buffers are kept per size,
+ * up to nMaxRetained of each, so that steady-state reads and flushes do not go to the allocator.
+ */
+class AlignedBufferPool
+{
+public:
+	// Hands its memory back to the pool when it goes out of scope.
+	class Buffer
+	{
+	private:
+		AlignedBufferPool* m_ptrPool;
+		char* m_szData;
+		size_t m_nSize;
+
+	public:
+		Buffer(AlignedBufferPool* ptrPool, char* szData, size_t nSize)
+			: m_ptrPool(ptrPool)
+			, m_szData(szData)
+			, m_nSize(nSize)
+		{
+		}
+
+		Buffer(Buffer&& other) noexcept
+			: m_ptrPool(other.m_ptrPool)
+			, m_szData(other.m_szData)
+			, m_nSize(other.m_nSize)
+		{
+			other.m_szData = nullptr;
+		}
+
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+
+		~Buffer()
+		{
+			if (m_szData != nullptr)
+			{
+				m_ptrPool->release(m_szData, m_nSize);
+			}
+		}
+
+		inline char* data() const
+		{
+			return m_szData;
+		}
+
+		inline size_t size() const
+		{
+			return m_nSize;
+		}
+	};
+
+private:
+	size_t m_nAlignment;
+	size_t m_nMaxRetained;
+
+	std::unordered_map<size_t, std::vector<char*>> m_mpFree;
+
+#ifdef __CONCURRENT__
+	std::mutex m_mtxPool;
+#endif __CONCURRENT__
+
+public:
+	AlignedBufferPool(size_t nAlignment, size_t nMaxRetained = 64)
+		: m_nAlignment(nAlignment)
+		, m_nMaxRetained(nMaxRetained)
+	{
+	}
+
+	~AlignedBufferPool()
+	{
+		for (auto& [nSize, vtBuffers] : m_mpFree)
+		{
+			for (char* szData : vtBuffers)
+			{
+				std::free(szData);
+			}
+		}
+	}
+
+	inline size_t roundUp(size_t nSize) const
+	{
+		return ((nSize + m_nAlignment - 1) / m_nAlignment) * m_nAlignment;
+	}
+
+	// The buffer is at least nSize bytes, rounded up to the alignment; its contents are left as they were.
+	Buffer acquire(size_t nSize)
+	{
+		nSize = roundUp(nSize);
+
+		{
+#ifdef __CONCURRENT__
+			std::unique_lock<std::mutex> lock_pool(m_mtxPool);
+#endif __CONCURRENT__
+
+			auto it = m_mpFree.find(nSize);
+			if (it != m_mpFree.end() && (*it).second.size() > 0)
+			{
+				char* szData = (*it).second.back();
+				(*it).second.pop_back();
+
+				return Buffer(this, szData, nSize);
+			}
+		}
+
+		char* szData = (char*)std::aligned_alloc(m_nAlignment, nSize);
+		if (szData == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return Buffer(this, szData, nSize);
+	}
+
+private:
+	void release(char* szData, size_t nSize)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_pool(m_mtxPool);
+#endif __CONCURRENT__
+
+		std::vector<char*>& vtBuffers = m_mpFree[nSize];
+		if (vtBuffers.size() < m_nMaxRetained)
+		{
+			vtBuffers.push_back(szData);
+			return;
+		}
+
+#ifdef __CONCURRENT__
+		lock_pool.unlock();
+#endif __CONCURRENT__
+
+		std::free(szData);
+	}
+};
@@ -0,0 +1,542 @@
+#pragma once
+#include <memory>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <variant>
+#include <cmath>
+
+#include "ErrorCodes.h"
+#include "IFlushCallback.h"
+#include "IOUring.hpp"
+#include "BlockAllocator.hpp"
+
+/*
+ * FileStorage with its reads and writes going through an io_uring. A miss can be started with getObjectAsync and
+ * collected later, so a caller that needs several nodes has all of their reads in flight at once; a flush queues one
+ * writev per contiguous run and submits them with a single system call. Where io_uring is not available the same
+ * calls fall back to pread/pwritev.
+ */
+template<
+	typename ICallback,
+	typename ObjectUIDType_,
+	template <typename, typename...> typename ObjectType_,
+	typename CoreTypesMarshaller,
+	typename... ObjectCoreTypes
+>
+class AsyncFileStorage
+{
+	typedef AsyncFileStorage<ICallback, ObjectUIDType_, ObjectType_, CoreTypesMarshaller, ObjectCoreTypes...> SelfType;
+
+public:
+	typedef ObjectUIDType_ ObjectUIDType;
+	typedef ObjectType_<CoreTypesMarshaller, ObjectCoreTypes...> ObjectType;
+
+	static const unsigned DEFAULT_QUEUE_DEPTH = 64;
+
+private:
+	// A read or a run of writes, from the moment it is queued until its completion has been reaped.
+	struct AsyncIO
+	{
+		std::unique_ptr<char[]> m_szBuffer;
+		std::vector<struct iovec> m_vtIOVecs;
+		size_t m_nSize;
+		size_t m_nOffset;
+		int m_nResult;
+		bool m_bDone;
+	};
+
+	size_t m_nFileSize;
+	size_t m_nBlockSize;
+
+	std::string m_stFilename;
+	int m_fdStorage;
+
+	BlockAllocator m_allocator;
+
+	// Fills the gaps between the objects of a run, up to their block boundaries.
+	std::vector<char> m_vtPadding;
+
+	ICallback* m_ptrCallback;
+
+	IOUring m_ring;
+
+	// Guards the ring and m_mpInFlight; a request has to outlive its completion even if its caller gave up on it.
+	std::mutex m_mtxRing;
+	std::unordered_map<AsyncIO*, std::shared_ptr<AsyncIO>> m_mpInFlight;
+
+#ifdef __CONCURRENT__
+	// One thread at a time blocks in the kernel for completions; the others wait for it to reap theirs.
+	bool m_bReaping;
+	std::condition_variable m_cvRing;
+#endif __CONCURRENT__
+
+public:
+	~AsyncFileStorage()
+	{
+		std::unique_lock<std::mutex> lock_ring(m_mtxRing);
+		while (m_mpInFlight.size() > 0)
+		{
+			reapOnce(lock_ring);
+		}
+		lock_ring.unlock();
+
+		m_ring.close();
+
+		::close(m_fdStorage);
+	}
+
+	AsyncFileStorage(size_t nBlockSize, size_t nFileSize, const std::string& stFilename, unsigned nQueueDepth = DEFAULT_QUEUE_DEPTH)
+		: m_nFileSize(nFileSize)
+		, m_nBlockSize(nBlockSize)
+		, m_stFilename(stFilename)
+		, m_allocator(nFileSize / nBlockSize)
+		, m_ptrCallback(NULL)
+	{
+		m_vtPadding.resize(nBlockSize, 0);
+
+		m_fdStorage = ::open(stFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (m_fdStorage < 0)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+
+		// Without a ring, every request completes synchronously with pread/pwritev.
+		m_ring.open(nQueueDepth);
+
+#ifdef __CONCURRENT__
+		m_bReaping = false;
+#endif __CONCURRENT__
+	}
+
+	template <typename... InitArgs>
+	CacheErrorCode init(ICallback* ptrCallback, InitArgs... args)
+	{
+		m_ptrCallback = ptrCallback;
+		return CacheErrorCode::Success;
+	}
+
+	inline bool isAsync() const
+	{
+		return m_ring.isOpen();
+	}
+
+	/*
+	 * Submits the read right away; the object is deserialized by whichever thread calls get() on the future, and is
+	 * nullptr if the read failed. The future must be collected before the storage goes away.
+	 */
+	std::future<std::shared_ptr<ObjectType>> getObjectAsync(const ObjectUIDType& uidObject)
+	{
+		std::shared_ptr<AsyncIO> ptrIO = std::make_shared<AsyncIO>();
+		ptrIO->m_nSize = uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize;
+		ptrIO->m_nOffset = uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset;
+		ptrIO->m_szBuffer.reset(new char[ptrIO->m_nSize + 1]);
+		memset(ptrIO->m_szBuffer.get(), 0, ptrIO->m_nSize + 1);
+
+		std::unique_lock<std::mutex> lock_ring(m_mtxRing);
+		queueIO(ptrIO, lock_ring);
+		submit(lock_ring);
+		lock_ring.unlock();
+
+		return std::async(std::launch::deferred, [this, ptrIO]() -> std::shared_ptr<ObjectType>
+			{
+				if (!waitForIO(ptrIO))
+				{
+					return nullptr;
+				}
+
+				std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>((const char*)ptrIO->m_szBuffer.get());
+				ptrObject->dirty = false;
+
+				return ptrObject;
+			});
+	}
+
+	std::shared_ptr<ObjectType> getObject(const ObjectUIDType& uidObject)
+	{
+		return getObjectAsync(uidObject).get();
+	}
+
+	// See FileStorage::remove.
+	CacheErrorCode remove(const ObjectUIDType& uidObject)
+	{
+		if (uidObject.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Success;
+		}
+
+		m_allocator.deallocate(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset / m_nBlockSize, getRequiredBlocks(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize));
+
+		return CacheErrorCode::Success;
+	}
+
+	CacheErrorCode addObject(ObjectUIDType uidObject, std::shared_ptr<ObjectType> ptrObject, ObjectUIDType& uidUpdated)
+	{
+		size_t nBufferSize = 0;
+		uint8_t uidObjectType = 0;
+
+		char* szBuffer = NULL;
+		ptrObject->serialize(szBuffer, uidObjectType, nBufferSize);
+
+		size_t nRequiredBlocks = getRequiredBlocks(nBufferSize + sizeof(uint8_t));
+
+		size_t nBlock = 0;
+		if (m_allocator.allocate(nRequiredBlocks, nBlock) != CacheErrorCode::Success)
+		{
+			delete[] szBuffer;
+			return CacheErrorCode::Error;
+		}
+
+		std::shared_ptr<AsyncIO> ptrIO = std::make_shared<AsyncIO>();
+		ptrIO->m_szBuffer.reset(szBuffer);
+		ptrIO->m_vtIOVecs.push_back({ szBuffer, nBufferSize });
+		ptrIO->m_vtIOVecs.push_back({ m_vtPadding.data(), nRequiredBlocks * m_nBlockSize - nBufferSize });
+		ptrIO->m_nSize = nRequiredBlocks * m_nBlockSize;
+		ptrIO->m_nOffset = nBlock * m_nBlockSize;
+
+		std::unique_lock<std::mutex> lock_ring(m_mtxRing);
+		queueIO(ptrIO, lock_ring);
+		submit(lock_ring);
+		lock_ring.unlock();
+
+		if (!waitForIO(ptrIO))
+		{
+			return CacheErrorCode::Error;
+		}
+
+		uidUpdated = ObjectUIDType::createAddressFromFileOffset(nBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
+
+		return CacheErrorCode::Success;
+	}
+
+	inline size_t getWritePos()
+	{
+		return m_allocator.getFrontier();
+	}
+
+	inline BlockAllocator& getAllocator()
+	{
+		return m_allocator;
+	}
+
+	inline size_t getBlockSize()
+	{
+		return m_nBlockSize;
+	}
+
+	inline ObjectUIDType::Media getMediaType()
+	{
+		return ObjectUIDType::File;
+	}
+
+	/*
+	 * Every contiguous run becomes one writev; they are all queued before a single submit and only then waited for,
+	 * so the device sees the whole flush at once.
+	 */
+	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects)
+	{
+		std::vector<std::pair<size_t, std::unique_ptr<char[]>>> vtBuffers;
+		vtBuffers.reserve(vtObjects.size());
+
+		auto it = vtObjects.begin();
+		while (it != vtObjects.end())
+		{
+			size_t nBufferSize = 0;
+			uint8_t uidObjectType = 0;
+
+			char* szBuffer = NULL;
+			(*it).second.second->serialize(szBuffer, uidObjectType, nBufferSize);
+
+			vtBuffers.emplace_back(nBufferSize, std::unique_ptr<char[]>(szBuffer));
+
+			it++;
+		}
+
+		std::vector<std::shared_ptr<AsyncIO>> vtRuns;
+		size_t nRunEnd = 0;
+
+		for (size_t idx = 0; idx < vtObjects.size(); idx++)
+		{
+			size_t nOffset = (*vtObjects[idx].second.first).m_uid.FATPOINTER.m_ptrFile.m_nOffset;
+			size_t nBufferSize = vtBuffers[idx].first;
+
+			if (vtRuns.size() == 0 || nOffset != nRunEnd || vtRuns.back()->m_vtIOVecs.size() + 2 > IOV_MAX)
+			{
+				vtRuns.push_back(std::make_shared<AsyncIO>());
+				vtRuns.back()->m_nSize = 0;
+				vtRuns.back()->m_nOffset = nOffset;
+			}
+
+			AsyncIO& run = *vtRuns.back();
+			run.m_vtIOVecs.push_back({ vtBuffers[idx].second.get(), nBufferSize });
+
+			// Up to the end of the slot, so that the next object of the run starts on its own block.
+			size_t nSlotSize = ((nBufferSize + m_nBlockSize - 1) / m_nBlockSize) * m_nBlockSize;
+			if (nSlotSize > nBufferSize)
+			{
+				run.m_vtIOVecs.push_back({ m_vtPadding.data(), nSlotSize - nBufferSize });
+			}
+
+			run.m_nSize += nSlotSize;
+			nRunEnd = nOffset + nSlotSize;
+		}
+
+		std::unique_lock<std::mutex> lock_ring(m_mtxRing);
+		for (auto& ptrRun : vtRuns)
+		{
+			queueIO(ptrRun, lock_ring);
+		}
+		submit(lock_ring);
+		lock_ring.unlock();
+
+		// Every run is waited for, even after a failure, as they still point into vtBuffers.
+		bool bWritten = true;
+		for (auto& ptrRun : vtRuns)
+		{
+			bWritten = waitForIO(ptrRun) && bWritten;
+		}
+
+		return bWritten ? CacheErrorCode::Success : CacheErrorCode::Error;
+	}
+
+private:
+	/*
+	 * Puts the request on the submission queue, or, without a ring, carries it out on the spot. Never lets more
+	 * requests be in flight than the ring has entries, so the completion queue cannot overflow.
+	 */
+	void queueIO(std::shared_ptr<AsyncIO> ptrIO, std::unique_lock<std::mutex>& lock_ring)
+	{
+		ptrIO->m_nResult = 0;
+		ptrIO->m_bDone = false;
+
+		if (!m_ring.isOpen())
+		{
+			completeSynchronously(*ptrIO);
+			return;
+		}
+
+		while (m_mpInFlight.size() >= m_ring.getEntries())
+		{
+			submit(lock_ring);
+			reapOnce(lock_ring);
+		}
+
+		bool bQueued = ptrIO->m_vtIOVecs.size() > 0
+			? m_ring.prepareWritev(m_fdStorage, ptrIO->m_vtIOVecs.data(), ptrIO->m_vtIOVecs.size(), ptrIO->m_nOffset, (uint64_t)ptrIO.get())
+			: m_ring.prepareRead(m_fdStorage, ptrIO->m_szBuffer.get(), ptrIO->m_nSize, ptrIO->m_nOffset, (uint64_t)ptrIO.get());
+
+		if (!bQueued)
+		{
+			throw new std::logic_error("should not occur!");
+		}
+
+		m_mpInFlight[ptrIO.get()] = ptrIO;
+	}
+
+	void submit(std::unique_lock<std::mutex>& lock_ring)
+	{
+		if (!m_ring.isOpen())
+		{
+			return;
+		}
+
+		int nResult = m_ring.submit();
+		while (nResult == -EAGAIN || nResult == -EBUSY)
+		{
+			reapOnce(lock_ring);
+			nResult = m_ring.submit();
+		}
+
+		if (nResult < 0)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+	}
+
+	// Returns once at least one completion has been reaped, by this thread or by another.
+	void reapOnce(std::unique_lock<std::mutex>& lock_ring)
+	{
+		if (reapCompletions() > 0)
+		{
+			return;
+		}
+
+#ifdef __CONCURRENT__
+		if (m_bReaping)
+		{
+			m_cvRing.wait(lock_ring);
+			return;
+		}
+
+		m_bReaping = true;
+		lock_ring.unlock();
+
+		m_ring.waitForCompletion();
+
+		lock_ring.lock();
+		m_bReaping = false;
+
+		reapCompletions();
+		m_cvRing.notify_all();
+#else
+		m_ring.waitForCompletion();
+		reapCompletions();
+#endif __CONCURRENT__
+	}
+
+	size_t reapCompletions()
+	{
+		size_t nReaped = 0;
+
+		uint64_t nUserData = 0;
+		int nResult = 0;
+		while (m_ring.popCompletion(nUserData, nResult))
+		{
+			AsyncIO* ptrIO = (AsyncIO*)nUserData;
+			ptrIO->m_nResult = nResult;
+			ptrIO->m_bDone = true;
+
+			m_mpInFlight.erase(ptrIO);
+			nReaped++;
+		}
+
+		return nReaped;
+	}
+
+	/*
+	 * Waits for the completion of the request and finishes a short read or write synchronously. Returns whether all
+	 * of it made it.
+	 */
+	bool waitForIO(std::shared_ptr<AsyncIO> ptrIO)
+	{
+		std::unique_lock<std::mutex> lock_ring(m_mtxRing);
+		while (!ptrIO->m_bDone)
+		{
+			reapOnce(lock_ring);
+		}
+		lock_ring.unlock();
+
+		if (ptrIO->m_nResult < 0)
+		{
+			return false;
+		}
+
+		size_t nDone = ptrIO->m_nResult;
+		if (nDone >= ptrIO->m_nSize)
+		{
+			return true;
+		}
+
+		if (ptrIO->m_vtIOVecs.size() > 0)
+		{
+			return completeRun(ptrIO->m_vtIOVecs, ptrIO->m_nOffset, nDone);
+		}
+
+		if (nDone == 0)
+		{
+			return false;
+		}
+
+		return readAt(ptrIO->m_szBuffer.get() + nDone, ptrIO->m_nSize - nDone, ptrIO->m_nOffset + nDone);
+	}
+
+	void completeSynchronously(AsyncIO& io)
+	{
+		if (io.m_vtIOVecs.size() > 0)
+		{
+			ssize_t nWritten = 0;
+			do
+			{
+				nWritten = ::pwritev(m_fdStorage, io.m_vtIOVecs.data(), io.m_vtIOVecs.size(), io.m_nOffset);
+			} while (nWritten < 0 && errno == EINTR);
+
+			io.m_nResult = nWritten < 0 ? -errno : (int)nWritten;
+		}
+		else
+		{
+			io.m_nResult = readAt(io.m_szBuffer.get(), io.m_nSize, io.m_nOffset) ? (int)io.m_nSize : -EIO;
+		}
+
+		io.m_bDone = true;
+	}
+
+	inline size_t getRequiredBlocks(size_t nSize) const
+	{
+		return std::ceil(nSize / (float)m_nBlockSize);
+	}
+
+	bool readAt(char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nRead = ::pread(m_fdStorage, szBuffer, nSize, nOffset);
+			if (nRead < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nRead <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nRead;
+			nSize -= nRead;
+			nOffset += nRead;
+		}
+
+		return true;
+	}
+
+	bool writeAt(const char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nWritten = ::pwrite(m_fdStorage, szBuffer, nSize, nOffset);
+			if (nWritten < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nWritten <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nWritten;
+			nSize -= nWritten;
+			nOffset += nWritten;
+		}
+
+		return true;
+	}
+
+	// Writes what is left of the run after its first nWritten bytes.
+	bool completeRun(std::vector<struct iovec>& vtRun, size_t nOffset, size_t nWritten)
+	{
+		for (auto& iov : vtRun)
+		{
+			size_t nDone = std::min(nWritten, iov.iov_len);
+			nWritten -= nDone;
+			nOffset += nDone;
+
+			if (nDone < iov.iov_len && !writeAt((const char*)iov.iov_base + nDone, iov.iov_len - nDone, nOffset))
+			{
+				return false;
+			}
+
+			nOffset += iov.iov_len - nDone;
+		}
+
+		return true;
+	}
+};
@@ -0,0 +1,408 @@
+#pragma once
+#include <bit>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstdint>
+#include <stdexcept>
+
+#include "CacheErrorCodes.h"
+#include "CacheStats.h"
+
+/*
+ * Hands out the blocks of a storage as extents (runs of whole blocks) and takes them back. The bitmap records the
+ * blocks in use. Those past the frontier have never been handed out; the free ones below it are kept as maximal
+ * extents, merged with their free neighbours when released and listed by size class (class k holds the extents of
+ * 2^k up to 2^(k+1)-1 blocks). An allocation takes the best fit from the smallest class that can hold it and only
+ * moves the frontier if none can; an extent released next to the frontier pulls the frontier back instead.
+ *
+ * Under __CONCURRENT__ released extents are held back until two more flushes have begun (see advance). A thread that
+ * read an old uid just before its relocation was applied may still go to the storage with it.
+ *
+ * A storage that commits (see FileStorage::commit) keeps the bitmap in pages and writes the ones that changed to one
+ * of two copies in turn. The blocks in use at the last commit are not reused until the next one is durable, a crash
+ * goes back to the last commit whose record made it to the disk.
+ */
+class BlockAllocator
+{
+	static const size_t SIZE_CLASSES = 64;
+
+	size_t m_nBlocks;
+	size_t m_nFrontier;
+	size_t m_nUsedBlocks;
+	size_t m_nFreeBlocks;	// in the free extents
+
+	std::vector<bool> m_vtAllocationTable;
+
+	std::map<size_t, size_t> m_mpExtents;								// first block -> blocks
+	std::set<std::pair<size_t, size_t>> m_arrClasses[SIZE_CLASSES];	// (blocks, first block)
+
+#ifdef __CONCURRENT__
+	// Released since the last advance, and in the period before.
+	std::vector<std::pair<size_t, size_t>> m_vtReleased[2];
+
+	std::mutex m_mtxAllocator;
+#endif __CONCURRENT__
+
+	std::vector<bool> m_vtCommitted;	// in use at the last commit
+	std::vector<std::pair<size_t, size_t>> m_vtDeferred;	// released since the last commit, still referenced by it
+
+	size_t m_nPageBlocks;	// blocks a page of the bitmap covers, 0 if the pages are not tracked
+	std::vector<uint8_t> m_vtStalePages;	// bit n is set if the page differs from copy n
+
+public:
+	BlockAllocator(size_t nBlocks)
+		: m_nBlocks(nBlocks)
+		, m_nFrontier(0)
+		, m_nUsedBlocks(0)
+		, m_nFreeBlocks(0)
+		, m_nPageBlocks(0)
+	{
+		m_vtAllocationTable.resize(nBlocks, false);
+		m_vtCommitted.resize(nBlocks, false);
+	}
+
+	CacheErrorCode allocate(size_t nBlocks, size_t& nBlock)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		bool bFound = false;
+
+		for (size_t nClass = getSizeClass(nBlocks); nClass < SIZE_CLASSES && !bFound; nClass++)
+		{
+			// Every extent of a larger class fits, the first one is the smallest.
+			auto it = m_arrClasses[nClass].lower_bound(std::make_pair(nBlocks, (size_t)0));
+			if (it == m_arrClasses[nClass].end())
+			{
+				continue;
+			}
+
+			nBlock = (*it).second;
+			size_t nExtent = (*it).first;
+
+			removeExtent(m_mpExtents.find(nBlock));
+
+			if (nExtent > nBlocks)
+			{
+				insertExtent(nBlock + nBlocks, nExtent - nBlocks);
+			}
+
+			bFound = true;
+		}
+
+		if (!bFound)
+		{
+			if (m_nFrontier + nBlocks > m_nBlocks)
+			{
+				return CacheErrorCode::Error;
+			}
+
+			nBlock = m_nFrontier;
+			m_nFrontier += nBlocks;
+		}
+
+		for (size_t idx = nBlock; idx < nBlock + nBlocks; idx++)
+		{
+			m_vtAllocationTable[idx] = true;
+		}
+
+		m_nUsedBlocks += nBlocks;
+
+		markStale(nBlock, nBlocks);
+
+		return CacheErrorCode::Success;
+	}
+
+	void deallocate(size_t nBlock, size_t nBlocks)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		for (size_t idx = nBlock; idx < nBlock + nBlocks; idx++)
+		{
+			if (idx >= m_nFrontier || !m_vtAllocationTable[idx])
+			{
+				throw new std::logic_error("should not occur!");	// released twice, or never handed out.
+			}
+
+			m_vtAllocationTable[idx] = false;
+		}
+
+		m_nUsedBlocks -= nBlocks;
+
+		markStale(nBlock, nBlocks);
+
+		// Extents are released as they were handed out, the first block tells for all of them.
+		if (m_vtCommitted[nBlock])
+		{
+			m_vtDeferred.push_back(std::make_pair(nBlock, nBlocks));
+			return;
+		}
+
+#ifdef __CONCURRENT__
+		m_vtReleased[0].push_back(std::make_pair(nBlock, nBlocks));
+#else __CONCURRENT__
+		release(nBlock, nBlocks);
+#endif __CONCURRENT__
+	}
+
+	// Called once the root record of a commit is durable: the extents released since the previous one can be reused.
+	void commit()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		for (auto& prExtent : m_vtDeferred)
+		{
+#ifdef __CONCURRENT__
+			m_vtReleased[0].push_back(prExtent);
+#else __CONCURRENT__
+			release(prExtent.first, prExtent.second);
+#endif __CONCURRENT__
+		}
+
+		m_vtDeferred.clear();
+
+		m_vtCommitted = m_vtAllocationTable;
+	}
+
+#ifdef __CONCURRENT__
+	// Called as a flush begins, before it allocates: the extents released two periods back can be reused.
+	void advance()
+	{
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+
+		for (auto& prExtent : m_vtReleased[1])
+		{
+			release(prExtent.first, prExtent.second);
+		}
+
+		m_vtReleased[1].swap(m_vtReleased[0]);
+		m_vtReleased[0].clear();
+	}
+#endif __CONCURRENT__
+
+	inline size_t getFrontier()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		return m_nFrontier;
+	}
+
+	// Pages of nPageBlocks blocks each, a multiple of 8. All of them start out stale.
+	void trackPages(size_t nPageBlocks)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		m_nPageBlocks = nPageBlocks;
+		m_vtStalePages.assign((m_nBlocks + nPageBlocks - 1) / nPageBlocks, 0x3);
+	}
+
+	/*
+	 * The pages copy nCopy is behind on, as (page, bytes); bit n of a page (LSB first) is its block n. They count as
+	 * written from here on. Returns the frontier they go with.
+	 */
+	size_t getStalePages(size_t nCopy, std::vector<std::pair<size_t, std::vector<uint8_t>>>& vtPages)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		for (size_t nPage = 0; nPage < m_vtStalePages.size(); nPage++)
+		{
+			if ((m_vtStalePages[nPage] & (1 << nCopy)) == 0)
+			{
+				continue;
+			}
+
+			m_vtStalePages[nPage] &= ~(1 << nCopy);
+
+			std::vector<uint8_t> vtPage(m_nPageBlocks / 8, 0);
+
+			size_t nFirst = nPage * m_nPageBlocks;
+			for (size_t idx = nFirst; idx < std::min(nFirst + m_nPageBlocks, m_nBlocks); idx++)
+			{
+				if (m_vtAllocationTable[idx])
+				{
+					vtPage[(idx - nFirst) / 8] |= (uint8_t)(1 << ((idx - nFirst) % 8));
+				}
+			}
+
+			vtPages.push_back(std::make_pair(nPage, std::move(vtPage)));
+		}
+
+		return m_nFrontier;
+	}
+
+	// After a failed write of the pages, neither copy can be relied on.
+	void invalidatePages()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		std::fill(m_vtStalePages.begin(), m_vtStalePages.end(), 0x3);
+	}
+
+	/*
+	 * Takes over a copy of the bitmap, for nBlocks blocks in all, as of the commit it was written for. The free extents
+	 * are rebuilt from it; held back releases did not survive, the bitmap has them free already. The pages, tracked
+	 * already, are stale in both copies again.
+	 */
+	void restore(size_t nBlocks, size_t nFrontier, const uint8_t* szBitmap)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+
+		m_vtReleased[0].clear();
+		m_vtReleased[1].clear();
+#endif __CONCURRENT__
+
+		if (nFrontier > nBlocks)
+		{
+			throw new std::logic_error("should not occur!");
+		}
+
+		m_nBlocks = nBlocks;
+		m_nFrontier = nFrontier;
+		m_nUsedBlocks = 0;
+		m_nFreeBlocks = 0;
+
+		m_mpExtents.clear();
+		for (size_t nClass = 0; nClass < SIZE_CLASSES; nClass++)
+		{
+			m_arrClasses[nClass].clear();
+		}
+
+		m_vtAllocationTable.assign(nBlocks, false);
+
+		m_vtDeferred.clear();
+
+		size_t nExtent = 0;
+		for (size_t idx = 0; idx < nFrontier; idx++)
+		{
+			if (szBitmap[idx / 8] & (1 << (idx % 8)))
+			{
+				m_vtAllocationTable[idx] = true;
+				m_nUsedBlocks++;
+
+				if (nExtent > 0)
+				{
+					insertExtent(idx - nExtent, nExtent);
+					nExtent = 0;
+				}
+			}
+			else
+			{
+				nExtent++;
+			}
+		}
+
+		// A free run at the end of the written blocks is left to the frontier.
+		m_nFrontier -= nExtent;
+
+		m_vtCommitted = m_vtAllocationTable;
+
+		if (m_nPageBlocks > 0)
+		{
+			m_vtStalePages.assign((m_nBlocks + m_nPageBlocks - 1) / m_nPageBlocks, 0x3);
+		}
+	}
+
+	void getStats(CacheStats& stats)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_allocator(m_mtxAllocator);
+#endif __CONCURRENT__
+
+		size_t nLargest = 0;
+		for (size_t nClass = SIZE_CLASSES; nClass > 0 && nLargest == 0; nClass--)
+		{
+			if (m_arrClasses[nClass - 1].size() > 0)
+			{
+				nLargest = (*m_arrClasses[nClass - 1].rbegin()).first;
+			}
+		}
+
+		stats.m_nStorageBlocks = m_nFrontier;
+		stats.m_nStorageUsedBlocks = m_nUsedBlocks;
+		stats.m_nStorageFreeBlocks = m_nFreeBlocks;
+		stats.m_dStorageFragmentation = m_nFreeBlocks > 0 ? 1.0 - (double)nLargest / m_nFreeBlocks : 0.0;
+	}
+
+private:
+	static inline size_t getSizeClass(size_t nBlocks)
+	{
+		return std::bit_width(nBlocks) - 1;
+	}
+
+	// Merges the extent with its free neighbours, or gives it back to the frontier.
+	void release(size_t nBlock, size_t nBlocks)
+	{
+		auto itNext = m_mpExtents.lower_bound(nBlock);
+
+		if (itNext != m_mpExtents.begin())
+		{
+			auto itPrev = std::prev(itNext);
+			if ((*itPrev).first + (*itPrev).second == nBlock)
+			{
+				nBlock = (*itPrev).first;
+				nBlocks += (*itPrev).second;
+				removeExtent(itPrev);
+			}
+		}
+
+		if (itNext != m_mpExtents.end() && (*itNext).first == nBlock + nBlocks)
+		{
+			nBlocks += (*itNext).second;
+			removeExtent(itNext);
+		}
+
+		if (nBlock + nBlocks == m_nFrontier)
+		{
+			m_nFrontier = nBlock;
+			return;
+		}
+
+		insertExtent(nBlock, nBlocks);
+	}
+
+	inline void markStale(size_t nBlock, size_t nBlocks)
+	{
+		if (m_nPageBlocks == 0)
+		{
+			return;
+		}
+
+		for (size_t nPage = nBlock / m_nPageBlocks; nPage <= (nBlock + nBlocks - 1) / m_nPageBlocks; nPage++)
+		{
+			m_vtStalePages[nPage] = 0x3;
+		}
+	}
+
+	inline void insertExtent(size_t nBlock, size_t nBlocks)
+	{
+		m_mpExtents[nBlock] = nBlocks;
+		m_arrClasses[getSizeClass(nBlocks)].insert(std::make_pair(nBlocks, nBlock));
+		m_nFreeBlocks += nBlocks;
+	}
+
+	inline void removeExtent(std::map<size_t, size_t>::iterator it)
+	{
+		m_arrClasses[getSizeClass((*it).second)].erase(std::make_pair((*it).second, (*it).first));
+		m_nFreeBlocks -= (*it).second;
+		m_mpExtents.erase(it);
+	}
+};
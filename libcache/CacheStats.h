@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Occupancy of a cache. The byte figures add up the getSize() of the resident objects as last measured, i.e. their
+ * serialized footprint, not the heap they take up.
+ */
+struct CacheStats
+{
+	size_t m_nObjects;
+	size_t m_nResidentBytes;
+	size_t m_nHighWatermarkBytes;	// 0 when only the object count bounds the cache
+	size_t m_nLowWatermarkBytes;
+
+	// Evictions that had to write the object back vs. those that could just drop it.
+	size_t m_nDirtyEvictions;
+	size_t m_nCleanEvictions;
+
+	// Candidates the eviction passed over because they were pinned, and evictions that had to stop short of the
+	// bounds because nothing unpinned was left.
+	size_t m_nPinnedSkips;
+	size_t m_nEvictionStalls;
+
+	// Background flusher (__CONCURRENT__ only): objects it wrote out, the time it spent on them (their ratio is the
+	// flush rate), its current batch size, and how often and for how long it held back threads it could not keep up with.
+	size_t m_nFlushedObjects;
+	size_t m_nFlushMicroseconds;
+	size_t m_nFlushBatch;
+	size_t m_nWriterStalls;
+	size_t m_nWriterStallMicroseconds;
+
+	// Misses (__CONCURRENT__ only) that waited for another thread's load of the same object instead of reading it.
+	size_t m_nDeduplicatedLoads;
+
+	// Storage space, in blocks: the span handed out so far, what the objects in it take up and what of the rest can be
+	// handed out again (under __CONCURRENT__ the remainder is held back, see BlockAllocator), and how scattered that
+	// is: 1 - largest free extent / free blocks.
+	size_t m_nStorageBlocks;
+	size_t m_nStorageUsedBlocks;
+	size_t m_nStorageFreeBlocks;
+	double m_dStorageFragmentation;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Where the checkpoints of a cache (__CONCURRENT__ only) stand. A checkpoint writes out the objects dirtied since the
+ * one before in passes over the resident objects, each pass in slices; a pass that writes nothing ends it.
+ */
+struct CheckpointProgress
+{
+	size_t m_nEpoch;		// of the checkpoint under way, or of the last one
+	bool m_bActive;			// under way
+
+	// Of the checkpoint: its passes so far, how far the current one got through the objects it covers, and the objects
+	// written. Skipped are the due objects the last pass had to leave dirty, they were in use.
+	size_t m_nPasses;
+	size_t m_nVisited;
+	size_t m_nResident;
+	size_t m_nWritten;
+	size_t m_nSkipped;
+
+	size_t m_nCompleted;	// checkpoints that ran to their end, the superseded ones do not count
+	size_t m_nRate;			// objects per second the background checkpointer is held to, 0 if it is not
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "CheckpointProgress.h"
+
+/*
+ * Paces the checkpoints of a cache under __CONCURRENT__. Each checkpoint gets the next epoch; an object is due for it
+ * if it was dirtied before it began, the ones created later carry its epoch and are left for the next. A checkpoint
+ * begun supersedes the one under way: the background checkpointer drops it and, if asked to, starts over on the new
+ * one, which covers everything the old one would have. The background checkpointer can be held to a rate of objects
+ * written per second, it sleeps between its slices for as long as the rate requires.
+ */
+class CheckpointScheduler
+{
+private:
+	std::mutex m_mtxCheckpointer;
+	std::condition_variable m_cvCheckpointer;
+	std::condition_variable m_cvWaiters;
+
+	bool m_bStop;
+	bool m_bRequested;
+	std::atomic<size_t> m_nEpoch;
+	size_t m_nCompletedEpoch;
+
+	CheckpointProgress m_progress;
+
+public:
+	CheckpointScheduler()
+		: m_bStop(false)
+		, m_bRequested(false)
+		, m_nEpoch(0)
+		, m_nCompletedEpoch(0)
+	{
+		m_progress = {};
+	}
+
+	void stop()
+	{
+		{
+			std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+			m_bStop = true;
+		}
+
+		m_cvCheckpointer.notify_all();
+		m_cvWaiters.notify_all();
+	}
+
+	/*
+	 * Starts a checkpoint, in the background checkpointer if bBackground, and returns its epoch.
+	 */
+	size_t begin(bool bBackground)
+	{
+		size_t nEpoch;
+		{
+			std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+			nEpoch = m_nEpoch.fetch_add(1, std::memory_order_relaxed) + 1;
+
+			m_progress.m_nEpoch = nEpoch;
+			m_progress.m_bActive = true;
+			m_progress.m_nPasses = 0;
+			m_progress.m_nVisited = 0;
+			m_progress.m_nResident = 0;
+			m_progress.m_nWritten = 0;
+			m_progress.m_nSkipped = 0;
+
+			m_bRequested = m_bRequested || bBackground;
+		}
+
+		// Wakes the checkpointer from its sleep between slices too, the checkpoint it is in has just been superseded.
+		m_cvCheckpointer.notify_all();
+
+		return nEpoch;
+	}
+
+	/*
+	 * Blocks the background checkpointer until a checkpoint is asked of it, or the cache goes down (false).
+	 */
+	bool waitForWork(size_t& nEpoch)
+	{
+		std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+		m_cvCheckpointer.wait(lock_checkpointer, [this] { return m_bStop || m_bRequested; });
+
+		m_bRequested = false;
+		nEpoch = m_nEpoch.load(std::memory_order_relaxed);
+
+		return !m_bStop;
+	}
+
+	inline size_t getEpoch() const
+	{
+		return m_nEpoch.load(std::memory_order_relaxed);
+	}
+
+	inline bool isSuperseded(size_t nEpoch) const
+	{
+		return m_nEpoch.load(std::memory_order_relaxed) != nEpoch;
+	}
+
+	void beginPass(size_t nEpoch, size_t nResident)
+	{
+		std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+		if (m_progress.m_nEpoch == nEpoch)
+		{
+			m_progress.m_nPasses++;
+			m_progress.m_nVisited = 0;
+			m_progress.m_nResident = nResident;
+		}
+	}
+
+	/*
+	 * Accounts for a slice that looked at nVisited objects and wrote nWritten of them in tmElapsed. Holds the background
+	 * checkpointer (bThrottle) back until the rate allows for the slice, or the checkpoint is superseded.
+	 */
+	void completeSlice(size_t nEpoch, size_t nVisited, size_t nWritten, std::chrono::steady_clock::duration tmElapsed, bool bThrottle)
+	{
+		std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+		if (m_progress.m_nEpoch == nEpoch)
+		{
+			m_progress.m_nVisited += nVisited;
+			m_progress.m_nWritten += nWritten;
+		}
+
+		if (!bThrottle || m_progress.m_nRate == 0 || nWritten == 0)
+		{
+			return;
+		}
+
+		auto tmDue = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double)nWritten / m_progress.m_nRate));
+		if (tmDue > tmElapsed)
+		{
+			m_cvCheckpointer.wait_for(lock_checkpointer, tmDue - tmElapsed, [this, nEpoch] { return m_bStop || isSuperseded(nEpoch); });
+		}
+	}
+
+	/*
+	 * The checkpoint nEpoch ran to its end, leaving nSkipped due objects dirty.
+	 */
+	void complete(size_t nEpoch, size_t nSkipped)
+	{
+		{
+			std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+			m_nCompletedEpoch = std::max(m_nCompletedEpoch, nEpoch);
+			m_progress.m_nCompleted++;
+
+			if (m_progress.m_nEpoch == nEpoch)
+			{
+				m_progress.m_bActive = false;
+				m_progress.m_nSkipped = nSkipped;
+			}
+		}
+
+		m_cvWaiters.notify_all();
+	}
+
+	/*
+	 * Blocks until the checkpoint nEpoch, or one that superseded it, has completed.
+	 */
+	void waitFor(size_t nEpoch)
+	{
+		std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+
+		m_cvWaiters.wait(lock_checkpointer, [this, nEpoch] { return m_bStop || m_nCompletedEpoch >= nEpoch; });
+	}
+
+	/*
+	 * Objects per second, 0 lifts the limit.
+	 */
+	void setRate(size_t nRate)
+	{
+		{
+			std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+			m_progress.m_nRate = nRate;
+		}
+
+		m_cvCheckpointer.notify_all();
+	}
+
+	void getProgress(CheckpointProgress& progress)
+	{
+		std::unique_lock<std::mutex> lock_checkpointer(m_mtxCheckpointer);
+		progress = m_progress;
+	}
+};
@@ -0,0 +1,701 @@
+#pragma once
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+
+/*
+ * Replacement policies for LRUCache and ShardedLRUCache.
+ *
+ * A policy only tracks the uids of the resident objects (and, for 2Q and ARC, the uids of recently evicted ones);
+ * the cache owns the objects and its lock covers the policy as well. The interface is:
+ *
+ *	admit(uid)		- a new object entered the cache (created or loaded from the storage).
+ *	touch(uid)		- a resident object was accessed.
+ *	remove(uid)		- a resident object was dropped without being evicted (deleted from the tree).
+ *	relocate(old, new)	- the object was written to the storage and is known by a new uid from now on.
+ *	selectVictim(uid, fn)	- picks the next object to evict; fn(uid) tells whether it can be evicted (not pinned).
+ *				  Objects that cannot be evicted are passed over and the search goes on in the policy's order;
+ *				  the list based policies treat the ones passed over as recently used.
+ *				  The victim is removed from the resident set; false is returned when there is nothing to evict.
+ *	getResident(vt)		- appends the resident uids to vt, the next to be evicted first. A full flush writes in
+ *				  this order, which for the LRU order puts the children ahead of their parents.
+ *	size()			- number of resident objects.
+ */
+
+/*
+ * Intrusive doubly linked list of uids. The links are slot indices into a slab that only ever grows, and freed slots
+ * are chained for reuse, so once the slab has reached the working set a hit (moveToFront) and an eviction (popBack)
+ * neither allocate nor touch a reference count; the uid index is the only hashed structure.
+ */
+template <typename KeyType>
+class PolicyKeyList
+{
+	static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+	struct Link
+	{
+		KeyType m_key;
+		uint32_t m_nPrev;
+		uint32_t m_nNext;
+	};
+
+	std::vector<Link> m_vtLinks;
+	std::unordered_map<KeyType, uint32_t> m_mpKeys;
+
+	uint32_t m_nHead;	// most recent
+	uint32_t m_nTail;
+	uint32_t m_nFree;	// chained through m_nNext
+
+public:
+	PolicyKeyList(size_t nReserve = 0)
+		: m_nHead(NIL)
+		, m_nTail(NIL)
+		, m_nFree(NIL)
+	{
+		m_vtLinks.reserve(nReserve);
+		m_mpKeys.reserve(nReserve);
+	}
+
+	inline bool contains(const KeyType& key) const
+	{
+		return m_mpKeys.find(key) != m_mpKeys.end();
+	}
+
+	inline void pushFront(const KeyType& key)
+	{
+		uint32_t nLink;
+		if (m_nFree != NIL)
+		{
+			nLink = m_nFree;
+			m_nFree = m_vtLinks[nLink].m_nNext;
+			m_vtLinks[nLink].m_key = key;
+		}
+		else
+		{
+			nLink = (uint32_t)m_vtLinks.size();
+			m_vtLinks.push_back(Link{ key, NIL, NIL });
+		}
+
+		linkFront(nLink);
+		m_mpKeys[key] = nLink;
+	}
+
+	inline bool moveToFront(const KeyType& key)
+	{
+		auto it = m_mpKeys.find(key);
+		if (it == m_mpKeys.end())
+		{
+			return false;
+		}
+
+		if ((*it).second != m_nHead)
+		{
+			unlink((*it).second);
+			linkFront((*it).second);
+		}
+		return true;
+	}
+
+	inline bool remove(const KeyType& key)
+	{
+		auto it = m_mpKeys.find(key);
+		if (it == m_mpKeys.end())
+		{
+			return false;
+		}
+
+		release((*it).second);
+		m_mpKeys.erase(it);
+		return true;
+	}
+
+	inline bool rename(const KeyType& keyOld, const KeyType& keyNew)
+	{
+		auto it = m_mpKeys.find(keyOld);
+		if (it == m_mpKeys.end())
+		{
+			return false;
+		}
+
+		uint32_t nLink = (*it).second;
+		m_vtLinks[nLink].m_key = keyNew;
+
+		m_mpKeys.erase(it);
+		m_mpKeys[keyNew] = nLink;
+		return true;
+	}
+
+	inline const KeyType& back() const
+	{
+		return m_vtLinks[m_nTail].m_key;
+	}
+
+	/*
+	 * Removes the oldest key that fnAccept agrees to. The ones it rejects on the way are moved to the front: a key
+	 * held back is as good as recently used, and the next search does not have to walk over it again.
+	 */
+	template <typename Accept>
+	inline bool popOldest(KeyType& key, Accept fnAccept)
+	{
+		for (size_t nStep = 0, nKeys = m_mpKeys.size(); nStep < nKeys; nStep++)
+		{
+			uint32_t nLink = m_nTail;
+
+			if (fnAccept(m_vtLinks[nLink].m_key))
+			{
+				key = m_vtLinks[nLink].m_key;
+
+				m_mpKeys.erase(key);
+				release(nLink);
+				return true;
+			}
+
+			if (nLink != m_nHead)
+			{
+				unlink(nLink);
+				linkFront(nLink);
+			}
+		}
+
+		return false;
+	}
+
+	inline void popBack()
+	{
+		uint32_t nLink = m_nTail;
+
+		m_mpKeys.erase(m_vtLinks[nLink].m_key);
+		release(nLink);
+	}
+
+	inline size_t size() const
+	{
+		return m_mpKeys.size();
+	}
+
+	inline bool empty() const
+	{
+		return m_nTail == NIL;
+	}
+
+	inline void appendOldestFirst(std::vector<KeyType>& vtKeys) const
+	{
+		for (uint32_t nLink = m_nTail; nLink != NIL; nLink = m_vtLinks[nLink].m_nPrev)
+		{
+			vtKeys.push_back(m_vtLinks[nLink].m_key);
+		}
+	}
+
+private:
+	inline void linkFront(uint32_t nLink)
+	{
+		Link& link = m_vtLinks[nLink];
+
+		link.m_nPrev = NIL;
+		link.m_nNext = m_nHead;
+
+		if (m_nHead != NIL)
+		{
+			m_vtLinks[m_nHead].m_nPrev = nLink;
+		}
+		else
+		{
+			m_nTail = nLink;
+		}
+
+		m_nHead = nLink;
+	}
+
+	inline void unlink(uint32_t nLink)
+	{
+		Link& link = m_vtLinks[nLink];
+
+		if (link.m_nPrev != NIL)
+		{
+			m_vtLinks[link.m_nPrev].m_nNext = link.m_nNext;
+		}
+		else
+		{
+			m_nHead = link.m_nNext;
+		}
+
+		if (link.m_nNext != NIL)
+		{
+			m_vtLinks[link.m_nNext].m_nPrev = link.m_nPrev;
+		}
+		else
+		{
+			m_nTail = link.m_nPrev;
+		}
+	}
+
+	inline void release(uint32_t nLink)
+	{
+		unlink(nLink);
+
+		m_vtLinks[nLink].m_nPrev = NIL;
+		m_vtLinks[nLink].m_nNext = m_nFree;
+		m_nFree = nLink;
+	}
+};
+
+/*
+ * Promotes on every hit. The victim is the least recently used object that is not pinned.
+ */
+template <typename KeyType>
+class LRUPolicy
+{
+	PolicyKeyList<KeyType> m_lstResident;
+
+public:
+	LRUPolicy(size_t nCapacity)
+		: m_lstResident(nCapacity + 1)
+	{
+	}
+
+	inline void admit(const KeyType& key)
+	{
+		m_lstResident.pushFront(key);
+	}
+
+	inline void touch(const KeyType& key)
+	{
+		m_lstResident.moveToFront(key);
+	}
+
+	inline void remove(const KeyType& key)
+	{
+		m_lstResident.remove(key);
+	}
+
+	inline void relocate(const KeyType& keyOld, const KeyType& keyNew)
+	{
+		m_lstResident.rename(keyOld, keyNew);
+	}
+
+	template <typename IsEvictable>
+	inline bool selectVictim(KeyType& key, IsEvictable fnIsEvictable)
+	{
+		return m_lstResident.popOldest(key, fnIsEvictable);
+	}
+
+	inline void getResident(std::vector<KeyType>& vtKeys) const
+	{
+		m_lstResident.appendOldestFirst(vtKeys);
+	}
+
+	inline size_t size() const
+	{
+		return m_lstResident.size();
+	}
+};
+
+/*
+ * Second chance over a ring of slots. A hit only sets the reference bit, the ring is never reordered.
+ * New objects start unreferenced so that a one-off sweep is the first to go.
+ */
+template <typename KeyType>
+class CLOCKPolicy
+{
+	struct Slot
+	{
+		KeyType m_key;
+		bool m_bReferenced;
+		bool m_bOccupied;
+	};
+
+	std::vector<Slot> m_vtSlots;
+	std::vector<size_t> m_vtFreeSlots;
+	std::unordered_map<KeyType, size_t> m_mpSlots;
+
+	size_t m_nHand;
+
+public:
+	CLOCKPolicy(size_t nCapacity)
+		: m_nHand(0)
+	{
+		m_vtSlots.reserve(nCapacity + 1);
+	}
+
+	inline void admit(const KeyType& key)
+	{
+		size_t nSlot;
+		if (m_vtFreeSlots.size() > 0)
+		{
+			nSlot = m_vtFreeSlots.back();
+			m_vtFreeSlots.pop_back();
+		}
+		else
+		{
+			nSlot = m_vtSlots.size();
+			m_vtSlots.push_back(Slot());
+		}
+
+		m_vtSlots[nSlot].m_key = key;
+		m_vtSlots[nSlot].m_bReferenced = false;
+		m_vtSlots[nSlot].m_bOccupied = true;
+
+		m_mpSlots[key] = nSlot;
+	}
+
+	inline void touch(const KeyType& key)
+	{
+		auto it = m_mpSlots.find(key);
+		if (it != m_mpSlots.end())
+		{
+			m_vtSlots[(*it).second].m_bReferenced = true;
+		}
+	}
+
+	inline void remove(const KeyType& key)
+	{
+		auto it = m_mpSlots.find(key);
+		if (it != m_mpSlots.end())
+		{
+			release((*it).second);
+			m_mpSlots.erase(it);
+		}
+	}
+
+	inline void relocate(const KeyType& keyOld, const KeyType& keyNew)
+	{
+		auto it = m_mpSlots.find(keyOld);
+		if (it != m_mpSlots.end())
+		{
+			size_t nSlot = (*it).second;
+			m_mpSlots.erase(it);
+
+			m_vtSlots[nSlot].m_key = keyNew;
+			m_mpSlots[keyNew] = nSlot;
+		}
+	}
+
+	template <typename IsEvictable>
+	inline bool selectVictim(KeyType& key, IsEvictable fnIsEvictable)
+	{
+		if (m_mpSlots.size() == 0)
+		{
+			return false;
+		}
+
+		// Two full turns are enough to clear every reference bit once; objects in use are passed over.
+		for (size_t nStep = 0, nMaxSteps = 2 * m_vtSlots.size(); nStep < nMaxSteps; nStep++)
+		{
+			Slot& slot = m_vtSlots[m_nHand];
+			size_t nSlot = m_nHand;
+
+			m_nHand = (m_nHand + 1) % m_vtSlots.size();
+
+			if (!slot.m_bOccupied)
+			{
+				continue;
+			}
+
+			if (slot.m_bReferenced)
+			{
+				slot.m_bReferenced = false;
+				continue;
+			}
+
+			if (!fnIsEvictable(slot.m_key))
+			{
+				continue;
+			}
+
+			key = slot.m_key;
+
+			m_mpSlots.erase(key);
+			release(nSlot);
+			return true;
+		}
+
+		return false;
+	}
+
+	inline void getResident(std::vector<KeyType>& vtKeys) const
+	{
+		for (size_t nStep = 0; nStep < m_vtSlots.size(); nStep++)
+		{
+			const Slot& slot = m_vtSlots[(m_nHand + nStep) % m_vtSlots.size()];
+			if (slot.m_bOccupied)
+			{
+				vtKeys.push_back(slot.m_key);
+			}
+		}
+	}
+
+	inline size_t size() const
+	{
+		return m_mpSlots.size();
+	}
+
+private:
+	inline void release(size_t nSlot)
+	{
+		m_vtSlots[nSlot].m_bOccupied = false;
+		m_vtSlots[nSlot].m_bReferenced = false;
+		m_vtFreeSlots.push_back(nSlot);
+	}
+};
+
+/*
+ * Full 2Q (Johnson & Shasha). New objects enter the A1in FIFO, where hits are ignored; objects evicted from A1in are
+ * remembered in the A1out ghost queue and go straight to the Am LRU if they are loaded again. A single sweep
+ * therefore only ever cycles through A1in and leaves the hot set in Am alone.
+ */
+template <typename KeyType>
+class TwoQPolicy
+{
+	PolicyKeyList<KeyType> m_lstA1In;
+	PolicyKeyList<KeyType> m_lstA1Out;
+	PolicyKeyList<KeyType> m_lstAm;
+
+	size_t m_nKIn;
+	size_t m_nKOut;
+
+public:
+	TwoQPolicy(size_t nCapacity)
+		: m_lstA1In(nCapacity + 1)
+		, m_lstA1Out(nCapacity / 2 + 1)
+		, m_lstAm(nCapacity + 1)
+		, m_nKIn(std::max<size_t>(nCapacity / 4, 1))
+		, m_nKOut(std::max<size_t>(nCapacity / 2, 1))
+	{
+	}
+
+	inline void admit(const KeyType& key)
+	{
+		if (m_lstA1Out.remove(key))
+		{
+			m_lstAm.pushFront(key);
+		}
+		else
+		{
+			m_lstA1In.pushFront(key);
+		}
+	}
+
+	inline void touch(const KeyType& key)
+	{
+		m_lstAm.moveToFront(key);
+	}
+
+	inline void remove(const KeyType& key)
+	{
+		if (!m_lstA1In.remove(key))
+		{
+			m_lstAm.remove(key);
+		}
+	}
+
+	inline void relocate(const KeyType& keyOld, const KeyType& keyNew)
+	{
+		if (m_lstA1In.contains(keyNew) || m_lstAm.contains(keyNew))
+		{
+			// Reloaded under the new uid before the relocation was reported; the ghost is of no use anymore.
+			m_lstA1Out.remove(keyOld);
+			return;
+		}
+
+		if (!m_lstA1In.rename(keyOld, keyNew) && !m_lstAm.rename(keyOld, keyNew))
+		{
+			m_lstA1Out.rename(keyOld, keyNew);
+		}
+	}
+
+	template <typename IsEvictable>
+	inline bool selectVictim(KeyType& key, IsEvictable fnIsEvictable)
+	{
+		bool bFromA1In = m_lstA1In.size() > m_nKIn || m_lstAm.empty();
+
+		if (evictFrom(bFromA1In, key, fnIsEvictable) || evictFrom(!bFromA1In, key, fnIsEvictable))
+		{
+			return true;
+		}
+
+		return false;
+	}
+
+	inline void getResident(std::vector<KeyType>& vtKeys) const
+	{
+		m_lstA1In.appendOldestFirst(vtKeys);
+		m_lstAm.appendOldestFirst(vtKeys);
+	}
+
+	inline size_t size() const
+	{
+		return m_lstA1In.size() + m_lstAm.size();
+	}
+
+private:
+	template <typename IsEvictable>
+	inline bool evictFrom(bool bA1In, KeyType& key, IsEvictable fnIsEvictable)
+	{
+		PolicyKeyList<KeyType>& lstQueue = bA1In ? m_lstA1In : m_lstAm;
+
+		if (!lstQueue.popOldest(key, fnIsEvictable))
+		{
+			return false;
+		}
+
+		if (bA1In)
+		{
+			m_lstA1Out.pushFront(key);
+			if (m_lstA1Out.size() > m_nKOut)
+			{
+				m_lstA1Out.popBack();
+			}
+		}
+
+		return true;
+	}
+};
+
+/*
+ * ARC (Megiddo & Modha). T1 holds objects seen once, T2 objects seen at least twice; B1 and B2 remember what was
+ * evicted from them. A reload that hits B1 grows the share of T1 (p), a reload that hits B2 shrinks it.
+ * The cache decides when to evict, so REPLACE runs in selectVictim rather than on the miss itself.
+ */
+template <typename KeyType>
+class ARCPolicy
+{
+	PolicyKeyList<KeyType> m_lstT1;
+	PolicyKeyList<KeyType> m_lstT2;
+	PolicyKeyList<KeyType> m_lstB1;
+	PolicyKeyList<KeyType> m_lstB2;
+
+	size_t m_nCapacity;
+	size_t m_nTargetT1;
+
+public:
+	ARCPolicy(size_t nCapacity)
+		: m_lstT1(nCapacity + 1)
+		, m_lstT2(nCapacity + 1)
+		, m_lstB1(nCapacity + 1)
+		, m_lstB2(nCapacity + 1)
+		, m_nCapacity(std::max<size_t>(nCapacity, 1))
+		, m_nTargetT1(0)
+	{
+	}
+
+	inline void admit(const KeyType& key)
+	{
+		if (m_lstB1.contains(key))
+		{
+			size_t nDelta = std::max<size_t>(m_lstB2.size() / m_lstB1.size(), 1);
+			m_nTargetT1 = std::min(m_nCapacity, m_nTargetT1 + nDelta);
+
+			m_lstB1.remove(key);
+			m_lstT2.pushFront(key);
+			return;
+		}
+
+		if (m_lstB2.contains(key))
+		{
+			size_t nDelta = std::max<size_t>(m_lstB1.size() / m_lstB2.size(), 1);
+			m_nTargetT1 = m_nTargetT1 > nDelta ? m_nTargetT1 - nDelta : 0;
+
+			m_lstB2.remove(key);
+			m_lstT2.pushFront(key);
+			return;
+		}
+
+		m_lstT1.pushFront(key);
+	}
+
+	inline void touch(const KeyType& key)
+	{
+		if (m_lstT1.remove(key))
+		{
+			m_lstT2.pushFront(key);
+		}
+		else
+		{
+			m_lstT2.moveToFront(key);
+		}
+	}
+
+	inline void remove(const KeyType& key)
+	{
+		if (!m_lstT1.remove(key))
+		{
+			m_lstT2.remove(key);
+		}
+	}
+
+	inline void relocate(const KeyType& keyOld, const KeyType& keyNew)
+	{
+		if (m_lstT1.contains(keyNew) || m_lstT2.contains(keyNew))
+		{
+			// Reloaded under the new uid before the relocation was reported; the ghost is of no use anymore.
+			if (!m_lstB1.remove(keyOld))
+			{
+				m_lstB2.remove(keyOld);
+			}
+			return;
+		}
+
+		if (m_lstT1.rename(keyOld, keyNew) || m_lstT2.rename(keyOld, keyNew) || m_lstB1.rename(keyOld, keyNew))
+		{
+			return;
+		}
+
+		m_lstB2.rename(keyOld, keyNew);
+	}
+
+	template <typename IsEvictable>
+	inline bool selectVictim(KeyType& key, IsEvictable fnIsEvictable)
+	{
+		bool bFromT1 = !m_lstT1.empty() && (m_lstT1.size() > m_nTargetT1 || m_lstT2.empty());
+
+		if (evictFrom(bFromT1, key, fnIsEvictable) || evictFrom(!bFromT1, key, fnIsEvictable))
+		{
+			return true;
+		}
+
+		return false;
+	}
+
+	inline void getResident(std::vector<KeyType>& vtKeys) const
+	{
+		m_lstT1.appendOldestFirst(vtKeys);
+		m_lstT2.appendOldestFirst(vtKeys);
+	}
+
+	inline size_t size() const
+	{
+		return m_lstT1.size() + m_lstT2.size();
+	}
+
+private:
+	template <typename IsEvictable>
+	inline bool evictFrom(bool bT1, KeyType& key, IsEvictable fnIsEvictable)
+	{
+		PolicyKeyList<KeyType>& lstResident = bT1 ? m_lstT1 : m_lstT2;
+		PolicyKeyList<KeyType>& lstGhost = bT1 ? m_lstB1 : m_lstB2;
+
+		if (!lstResident.popOldest(key, fnIsEvictable))
+		{
+			return false;
+		}
+
+		lstGhost.pushFront(key);
+
+		// The ghosts together never remember more than the capacity.
+		while (m_lstB1.size() + m_lstB2.size() > m_nCapacity)
+		{
+			if (m_lstB1.size() > m_lstB2.size() || m_lstB2.empty())
+			{
+				m_lstB1.popBack();
+			}
+			else
+			{
+				m_lstB2.popBack();
+			}
+		}
+
+		return true;
+	}
+};
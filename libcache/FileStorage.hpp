@@ -2,14 +2,22 @@
 #include <memory>
 #include <iostream>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <cstddef>
+#include <algorithm>
 #include <fstream>
 #include <variant>
 #include <cmath>
 
 #include "ErrorCodes.h"
 #include "IFlushCallback.h"
+#include "AlignedBufferPool.hpp"
+#include "BlockAllocator.hpp"
 
 template<
 	typename ICallback,
@@ -26,15 +34,56 @@ public:
 	typedef ObjectUIDType_ ObjectUIDType;
 	typedef ObjectType_<CoreTypesMarshaller, ObjectCoreTypes...> ObjectType;
 
+	// Buffer addresses, file offsets and transfer sizes of O_DIRECT I/O are multiples of this.
+	static const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+	static const uint64_t SUPERBLOCK_MAGIC = 0x4853544F52450001ULL;
+	static const uint32_t FORMAT_VERSION = 3;
+
 private:
+	/*
+	 * The file starts with the header, written once when it is created, followed by the two root records and the two
+	 * copies of the allocation bitmap that commit alternates between (commit n uses record and copy n % 2). Each takes
+	 * whole blocks of its own, the allocator never hands those out.
+	 */
+	struct Header
+	{
+		uint64_t m_nMagic;
+		uint32_t m_nVersion;
+		uint32_t m_nPadding;
+		uint64_t m_nBlockSize;
+		uint64_t m_nFileSize;
+	};
+
+	struct RootRecord
+	{
+		uint64_t m_nSequence;	// of the commit, the intact record with the higher one is current
+		uint64_t m_nHeight;
+		uint64_t m_nFrontier;	// the copy of the bitmap written with the record covers the blocks up to it
+		uint32_t m_nDegree;
+		uint32_t m_nPadding;
+		uint64_t m_nLogSequence;	// of the last logged operation the tree takes in, see WriteAheadLog
+		ObjectUIDType m_uidRoot;
+		uint64_t m_nChecksum;	// of the bytes before it, a torn write does not match
+	};
+
 	size_t m_nFileSize;
 	size_t m_nBlockSize;
 
 	std::string m_stFilename;
-	std::fstream m_fsStorage;
+	int m_fdStorage;
+
+	BlockAllocator m_allocator;
+
+	RootRecord m_record;	// of the last commit; m_nSequence is 0 before the first
+
+	// Fills the gaps between the objects of a run, up to their block boundaries.
+	std::vector<char> m_vtPadding;
 
-	size_t m_nNextBlock;
-	std::vector<bool> m_vtAllocationTable;
+	// With O_DIRECT the page cache is bypassed, so node bytes are only cached once, by the cache above. Slots are
+	// whole aligned blocks and every transfer goes through a buffer of m_poolBuffers.
+	bool m_bDirectIO;
+	AlignedBufferPool m_poolBuffers;
 
 	ICallback* m_ptrCallback;
 
@@ -58,27 +107,43 @@ public:
 		m_mpObjects.clear();
 #endif __CONCURRENT__
 
-		m_fsStorage.close();
+		::close(m_fdStorage);
 	}
 
-	FileStorage(size_t nBlockSize, size_t nFileSize, const std::string& stFilename)
+	/*
+	 * With bDirectIO the block size is rounded up to a multiple of DIRECT_IO_ALIGNMENT. A file system that refuses
+	 * O_DIRECT (tmpfs, for one) gets the same aligned layout through the page cache; see isDirectIO. An existing file
+	 * is truncated.
+	 */
+	FileStorage(size_t nBlockSize, size_t nFileSize, const std::string& stFilename, bool bDirectIO = false)
 		: m_nFileSize(nFileSize)
-		, m_nBlockSize(nBlockSize)
+		, m_nBlockSize(bDirectIO ? ((nBlockSize + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT) * DIRECT_IO_ALIGNMENT : nBlockSize)
 		, m_stFilename(stFilename)
-		, m_nNextBlock(0)
+		, m_allocator(nFileSize / m_nBlockSize)
+		, m_record()
+		, m_bDirectIO(bDirectIO)
+		, m_poolBuffers(DIRECT_IO_ALIGNMENT)
 		, m_ptrCallback(NULL)
 	{
-		m_vtAllocationTable.resize(nFileSize/nBlockSize, false);
+		m_vtPadding.resize(m_nBlockSize, 0);
 
-		//m_fsStorage.rdbuf()->pubsetbuf(0, 0);
-		m_fsStorage.open(stFilename.c_str(), std::ios::out | std::ios::binary);
-		m_fsStorage.close();
+		m_fdStorage = ::open(stFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC | (bDirectIO ? O_DIRECT : 0), 0644);
+		if (m_fdStorage < 0 && bDirectIO && errno == EINVAL)
+		{
+			m_bDirectIO = false;
+			m_fdStorage = ::open(stFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		}
+
+		if (m_fdStorage < 0)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
 
-		m_fsStorage.open(stFilename.c_str(), std::ios::out | std::ios::binary | std::ios::in);
-		m_fsStorage.seekp(0);
-		m_fsStorage.seekg(0);
+		m_allocator.trackPages(m_nBlockSize * 8);
 
-		if (!m_fsStorage.is_open())
+		// The root records are left unwritten, a reopen before the first commit finds neither intact.
+		size_t nBlock = 0;
+		if (m_allocator.allocate(getReservedBlocks(), nBlock) != CacheErrorCode::Success || !writeHeader())
 		{
 			throw new std::logic_error("should not occur!");   // TODO: critical log.
 		}
@@ -89,6 +154,89 @@ public:
 #endif __CONCURRENT__
 	}
 
+	/*
+	 * Reopens a store the constructor above created, with the block size and the file size it was created with, as of
+	 * its last commit that made it to the disk. Nothing but the bitmap is read until the objects are asked for.
+	 */
+	FileStorage(const std::string& stFilename, bool bDirectIO = false)
+		: m_nFileSize(0)
+		, m_nBlockSize(0)
+		, m_stFilename(stFilename)
+		, m_allocator(0)
+		, m_record()
+		, m_bDirectIO(bDirectIO)
+		, m_poolBuffers(DIRECT_IO_ALIGNMENT)
+		, m_ptrCallback(NULL)
+	{
+		m_fdStorage = ::open(stFilename.c_str(), O_RDWR | (bDirectIO ? O_DIRECT : 0));
+		if (m_fdStorage < 0 && bDirectIO && errno == EINVAL)
+		{
+			m_bDirectIO = false;
+			m_fdStorage = ::open(stFilename.c_str(), O_RDWR);
+		}
+
+		Header header;
+		if (m_fdStorage < 0 || !readHeader(header))
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+
+		m_nBlockSize = header.m_nBlockSize;
+		m_nFileSize = header.m_nFileSize;
+
+		// Created without O_DIRECT, on blocks it cannot address.
+		if (m_bDirectIO && m_nBlockSize % DIRECT_IO_ALIGNMENT != 0)
+		{
+			::close(m_fdStorage);
+
+			m_bDirectIO = false;
+			m_fdStorage = ::open(stFilename.c_str(), O_RDWR);
+			if (m_fdStorage < 0)
+			{
+				throw new std::logic_error("should not occur!");   // TODO: critical log.
+			}
+		}
+
+		m_vtPadding.resize(m_nBlockSize, 0);
+
+		m_allocator.trackPages(m_nBlockSize * 8);
+
+		RootRecord arrRecords[2];
+		bool bIntact0 = readRecord(0, arrRecords[0]);
+		bool bIntact1 = readRecord(1, arrRecords[1]);
+
+		if (!bIntact0 && !bIntact1)
+		{
+			// Never committed, it starts out empty.
+			m_allocator.restore(m_nFileSize / m_nBlockSize, 0, nullptr);
+
+			size_t nBlock = 0;
+			if (m_allocator.allocate(getReservedBlocks(), nBlock) != CacheErrorCode::Success)
+			{
+				throw new std::logic_error("should not occur!");   // TODO: critical log.
+			}
+		}
+		else
+		{
+			size_t nCopy = !bIntact1 || (bIntact0 && arrRecords[0].m_nSequence > arrRecords[1].m_nSequence) ? 0 : 1;
+			m_record = arrRecords[nCopy];
+
+			size_t nBitmapSize = (m_record.m_nFrontier + 7) / 8;
+
+			AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(nBitmapSize);
+			if (!readAt(buffer.data(), m_bDirectIO ? buffer.size() : nBitmapSize, getBitmapOffset(nCopy)))
+			{
+				throw new std::logic_error("should not occur!");   // TODO: critical log.
+			}
+
+			m_allocator.restore(m_nFileSize / m_nBlockSize, m_record.m_nFrontier, (const uint8_t*)buffer.data());
+		}
+
+#ifdef __CONCURRENT__
+		m_bStopFlush = false;
+#endif __CONCURRENT__
+	}
+
 	template <typename... InitArgs>
 	CacheErrorCode init(ICallback* ptrCallback, InitArgs... args)
 	{
@@ -96,77 +244,114 @@ public:
 		return CacheErrorCode::Success;
 	}
 
+	/*
+	 * Reads are positioned (pread) into a buffer of their own, so neither the read nor the deserialization needs a
+	 * lock: concurrent misses go to the file in parallel. A uid is only handed out once its object has been written.
+	 */
 	std::shared_ptr<ObjectType> getObject(const ObjectUIDType& uidObject)
 	{
-		//char* szBuffer = new char[uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize + 1]; //2
-		//memset(szBuffer, '\0', uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize + 1); //2
+		size_t nSize = uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize;
 
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
+		if (m_bDirectIO)
+		{
+			// The slot is padded to whole blocks, so the aligned read stays within it.
+			AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(nSize);
 
-		m_fsStorage.seekg(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset);
-		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(m_fsStorage); //1
-		//m_fsStorage.read(szBuffer, uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize); //2
+			if (!readAt(buffer.data(), buffer.size(), uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset))
+			{
+				return nullptr;
+			}
 
-#ifdef __CONCURRENT__
-		lock_file_storage.unlock();
-#endif __CONCURRENT__
+			std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>((const char*)buffer.data());
 
+			ptrObject->dirty = false;
 
-		//std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(szBuffer); //2
+			return ptrObject;
+		}
+
+		std::unique_ptr<char[]> szBuffer(new char[nSize + 1]);
+		memset(szBuffer.get(), 0, nSize + 1);
+
+		if (!readAt(szBuffer.get(), nSize, uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset))
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>((const char*)szBuffer.get());
 		
 		ptrObject->dirty = false;
 
-		//delete[] szBuffer; //2
-
 		return ptrObject;
 	}
 
-	CacheErrorCode remove(const ObjectUIDType& ptrKey)
+	// Releases the blocks of an object that nothing refers to any more.
+	CacheErrorCode remove(const ObjectUIDType& uidObject)
 	{
-		//throw new std::logic_error("no implementation!");
+		// Never written.
+		if (uidObject.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Success;
+		}
+
+		m_allocator.deallocate(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset / m_nBlockSize, getRequiredBlocks(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize));
+
 		return CacheErrorCode::Success;
 	}
 
 	CacheErrorCode addObject(ObjectUIDType uidObject, std::shared_ptr<ObjectType> ptrObject, ObjectUIDType& uidUpdated)
 	{
+		if (m_bDirectIO)
+		{
+			return addObjectAligned(ptrObject, uidUpdated);
+		}
+
 		size_t nBufferSize = 0;
 		uint8_t uidObjectType = 0;
 		
-		//char* szBuffer = NULL; //2
-		//ptrObject->serialize(szBuffer, uidObjectType, nBufferSize); //2
-
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
+		char* szBuffer = NULL;
+		ptrObject->serialize(szBuffer, uidObjectType, nBufferSize);
 
-		m_fsStorage.seekp(m_nNextBlock * m_nBlockSize);
-		ptrObject->serialize(m_fsStorage, uidObjectType, nBufferSize); //1
-		//m_fsStorage.write(szBuffer, nBufferSize); //2
-		m_fsStorage.flush();
+		size_t nRequiredBlocks = getRequiredBlocks(nBufferSize + sizeof(uint8_t));
 
-		size_t nRequiredBlocks = std::ceil((nBufferSize + sizeof(uint8_t)) / (float)m_nBlockSize);
+		size_t nBlock = 0;
+		if (m_allocator.allocate(nRequiredBlocks, nBlock) != CacheErrorCode::Success)
+		{
+			delete[] szBuffer;
+			return CacheErrorCode::Error;
+		}
 
-#ifdef __CONCURRENT__
-		lock_file_storage.unlock();
-#endif __CONCURRENT__
+		// Padded to the end of the slot, like the runs of addObjects; the uid covers one byte more than the object.
+		std::vector<struct iovec> vtSlot;
+		vtSlot.push_back({ szBuffer, nBufferSize });
+		vtSlot.push_back({ m_vtPadding.data(), nRequiredBlocks * m_nBlockSize - nBufferSize });
 
-		//delete[] szBuffer; //2
+		bool bWritten = writeRun(vtSlot, nBlock * m_nBlockSize);
 
-		uidUpdated = ObjectUIDType::createAddressFromFileOffset(m_nNextBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
+		delete[] szBuffer;
 
-		for (int idx = 0; idx < nRequiredBlocks; idx++)
+		if (!bWritten)
 		{
-			m_vtAllocationTable[m_nNextBlock++] = true;
+			return CacheErrorCode::Error;
 		}
 
+		uidUpdated = ObjectUIDType::createAddressFromFileOffset(nBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
+
 		return CacheErrorCode::Success;
 	}
 
+	inline bool isDirectIO() const
+	{
+		return m_bDirectIO;
+	}
+
 	inline size_t getWritePos()
 	{
-		return m_nNextBlock;
+		return m_allocator.getFrontier();
+	}
+
+	inline BlockAllocator& getAllocator()
+	{
+		return m_allocator;
 	}
 
 	inline size_t getBlockSize()
@@ -179,36 +364,368 @@ public:
 		return ObjectUIDType::File;
 	}
 
-	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects, size_t nNewOffset)
+	/*
+	 * Makes uidRoot, and the objects written so far, the tree a reopen finds. The pages of the bitmap that changed go
+	 * to the copy this commit uses and are synced with the objects before the root record is written, and synced in
+	 * turn. A crash before that is on the disk leaves the previous commit, whose record and copy are not touched.
+	 */
+	CacheErrorCode commit(const ObjectUIDType& uidRoot, uint32_t nDegree, size_t nHeight, uint64_t nLogSequence)
 	{
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
+		size_t nCopy = (m_record.m_nSequence + 1) % 2;
 
-		m_nNextBlock = nNewOffset;
+		std::vector<std::pair<size_t, std::vector<uint8_t>>> vtPages;
+		size_t nFrontier = m_allocator.getStalePages(nCopy, vtPages);
+
+		// A page of the bitmap is a block.
+		AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(std::max(m_nBlockSize, sizeof(RootRecord)));
+
+		for (auto& prPage : vtPages)
+		{
+			memcpy(buffer.data(), prPage.second.data(), m_nBlockSize);
+
+			if (!writeAt(buffer.data(), m_nBlockSize, getBitmapOffset(nCopy) + prPage.first * m_nBlockSize))
+			{
+				m_allocator.invalidatePages();
+				return CacheErrorCode::Error;
+			}
+		}
+
+		if (::fdatasync(m_fdStorage) != 0)
+		{
+			m_allocator.invalidatePages();
+			return CacheErrorCode::Error;
+		}
+
+		RootRecord record = {};
+		record.m_nSequence = m_record.m_nSequence + 1;
+		record.m_nHeight = nHeight;
+		record.m_nFrontier = nFrontier;
+		record.m_nDegree = nDegree;
+		record.m_nLogSequence = nLogSequence;
+		record.m_uidRoot = uidRoot;
+		record.m_nChecksum = getChecksum(record);
+
+		memset(buffer.data(), 0, buffer.size());
+		memcpy(buffer.data(), &record, sizeof(RootRecord));
+
+		// Whole aligned blocks with O_DIRECT, still within the blocks of the record.
+		if (!writeAt(buffer.data(), m_bDirectIO ? m_poolBuffers.roundUp(sizeof(RootRecord)) : sizeof(RootRecord), getRecordOffset(nCopy))
+			|| ::fdatasync(m_fdStorage) != 0)
+		{
+			m_allocator.invalidatePages();
+			return CacheErrorCode::Error;
+		}
+
+		m_record = record;
+
+		m_allocator.commit();
+
+		return CacheErrorCode::Success;
+	}
+
+	// Of the last commit, or the one the store was reopened at; Error if there is none.
+	CacheErrorCode getCommittedRoot(ObjectUIDType& uidRoot, uint32_t& nDegree, size_t& nHeight, uint64_t& nLogSequence)
+	{
+		if (m_record.m_nSequence == 0)
+		{
+			return CacheErrorCode::Error;
+		}
+
+		uidRoot = m_record.m_uidRoot;
+		nDegree = m_record.m_nDegree;
+		nHeight = m_record.m_nHeight;
+		nLogSequence = m_record.m_nLogSequence;
+
+		return CacheErrorCode::Success;
+	}
+
+	/*
+	 * The objects are serialized up front, without the lock, and the ones that follow each other in the file (which
+	 * prepareFlush lays them out as) go out in a single pwritev per run. With O_DIRECT each object is serialized
+	 * straight into an aligned buffer the size of its slot.
+	 */
+	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects)
+	{
+		std::vector<std::unique_ptr<char[]>> vtBuffers;
+		std::vector<AlignedBufferPool::Buffer> vtAlignedBuffers;
+		std::vector<struct iovec> vtSerialized;
+		vtSerialized.reserve(vtObjects.size());
+
+		if (m_bDirectIO)
+		{
+			vtAlignedBuffers.reserve(vtObjects.size());
+		}
+		else
+		{
+			vtBuffers.reserve(vtObjects.size());
+		}
 
 		auto it = vtObjects.begin();
 		while (it != vtObjects.end())
 		{
-				m_fsStorage.seekp((*(*it).second.first).m_uid.FATPOINTER.m_ptrFile.m_nOffset);
-				//m_fsStorage.write( vtBuffer[idx], (*(m_vtObjects[idx].uidDetails.uidObject_Updated)).m_uid.FATPOINTER.m_ptrFile.m_nSize); //2
+			size_t nBufferSize = 0;
+			uint8_t uidObjectType = 0;
+
+			if (m_bDirectIO)
+			{
+				nBufferSize = (*it).second.second->getSize();
+				size_t nSlotSize = ((nBufferSize + m_nBlockSize - 1) / m_nBlockSize) * m_nBlockSize;
 
-				size_t nBufferSize = 0;
-				uint8_t uidObjectType = 0;
+				vtAlignedBuffers.push_back(m_poolBuffers.acquire(nSlotSize));
+				char* szBuffer = vtAlignedBuffers.back().data();
 
-				(*it).second.second->serialize(m_fsStorage, uidObjectType, nBufferSize);
+				(*it).second.second->serializeTo(szBuffer, uidObjectType);
+				memset(szBuffer + nBufferSize, 0, nSlotSize - nBufferSize);
 
-				//vtUIDUpdates.push_back(std::move(m_vtObjects[idx].uidDetails));
+				vtSerialized.push_back({ szBuffer, nSlotSize });
+			}
+			else
+			{
+				char* szBuffer = NULL;
+				(*it).second.second->serialize(szBuffer, uidObjectType, nBufferSize);
 
-				//delete[] vtBuffer[idx];
+				vtBuffers.emplace_back(szBuffer);
+				vtSerialized.push_back({ szBuffer, nBufferSize });
+			}
 
 			it++;
 		}
-		m_fsStorage.flush();
+
+		std::vector<struct iovec> vtRun;
+		size_t nRunOffset = 0;
+		size_t nRunEnd = 0;
+
+		for (size_t idx = 0; idx < vtObjects.size(); idx++)
+		{
+			size_t nOffset = (*vtObjects[idx].second.first).m_uid.FATPOINTER.m_ptrFile.m_nOffset;
+			size_t nBufferSize = vtSerialized[idx].iov_len;
+
+			if (vtRun.size() > 0 && (nOffset != nRunEnd || vtRun.size() + 2 > IOV_MAX))
+			{
+				if (!writeRun(vtRun, nRunOffset))
+				{
+					return CacheErrorCode::Error;
+				}
+
+				vtRun.clear();
+			}
+
+			if (vtRun.size() == 0)
+			{
+				nRunOffset = nOffset;
+			}
+
+			vtRun.push_back(vtSerialized[idx]);
+
+			// Up to the end of the slot, so that the next object of the run starts on its own block.
+			size_t nSlotSize = ((nBufferSize + m_nBlockSize - 1) / m_nBlockSize) * m_nBlockSize;
+			if (nSlotSize > nBufferSize)
+			{
+				vtRun.push_back({ m_vtPadding.data(), nSlotSize - nBufferSize });
+			}
+
+			nRunEnd = nOffset + nSlotSize;
+		}
+
+		if (vtRun.size() > 0 && !writeRun(vtRun, nRunOffset))
+		{
+			return CacheErrorCode::Error;
+		}
+
+		return CacheErrorCode::Success;
+	}
+
+private:
+	CacheErrorCode addObjectAligned(std::shared_ptr<ObjectType> ptrObject, ObjectUIDType& uidUpdated)
+	{
+		uint8_t uidObjectType = 0;
+		size_t nBufferSize = ptrObject->getSize();
+
+		size_t nRequiredBlocks = getRequiredBlocks(nBufferSize + sizeof(uint8_t));
+
+		AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(nRequiredBlocks * m_nBlockSize);
+		ptrObject->serializeTo(buffer.data(), uidObjectType);
+		memset(buffer.data() + nBufferSize, 0, buffer.size() - nBufferSize);
+
+		size_t nBlock = 0;
+		if (m_allocator.allocate(nRequiredBlocks, nBlock) != CacheErrorCode::Success)
+		{
+			return CacheErrorCode::Error;
+		}
+
+		if (!writeAt(buffer.data(), buffer.size(), nBlock * m_nBlockSize))
+		{
+			return CacheErrorCode::Error;
+		}
+
+		uidUpdated = ObjectUIDType::createAddressFromFileOffset(nBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
 
 		return CacheErrorCode::Success;
 	}
 
+	// The same count prepareFlush lays the objects out with.
+	inline size_t getRequiredBlocks(size_t nSize) const
+	{
+		return std::ceil(nSize / (float)m_nBlockSize);
+	}
+
+	inline size_t getBlocksFor(size_t nSize) const
+	{
+		return (nSize + m_nBlockSize - 1) / m_nBlockSize;
+	}
+
+	inline size_t getRecordOffset(size_t nCopy) const
+	{
+		return (getBlocksFor(sizeof(Header)) + nCopy * getBlocksFor(sizeof(RootRecord))) * m_nBlockSize;
+	}
+
+	inline size_t getBitmapOffset(size_t nCopy) const
+	{
+		size_t nBitmapBlocks = getBlocksFor((m_nFileSize / m_nBlockSize + 7) / 8);
+
+		return (getBlocksFor(sizeof(Header)) + 2 * getBlocksFor(sizeof(RootRecord)) + nCopy * nBitmapBlocks) * m_nBlockSize;
+	}
+
+	inline size_t getReservedBlocks() const
+	{
+		return getBitmapOffset(2) / m_nBlockSize;
+	}
+
+	// FNV-1a.
+	static inline uint64_t getChecksum(const RootRecord& record)
+	{
+		const uint8_t* szRecord = (const uint8_t*)&record;
+
+		uint64_t nChecksum = 0xcbf29ce484222325ULL;
+		for (size_t idx = 0; idx < offsetof(RootRecord, m_nChecksum); idx++)
+		{
+			nChecksum ^= szRecord[idx];
+			nChecksum *= 0x100000001b3ULL;
+		}
+
+		return nChecksum;
+	}
+
+	bool writeHeader()
+	{
+		Header header = {};
+		header.m_nMagic = SUPERBLOCK_MAGIC;
+		header.m_nVersion = FORMAT_VERSION;
+		header.m_nBlockSize = m_nBlockSize;
+		header.m_nFileSize = m_nFileSize;
+
+		AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(sizeof(Header));
+		memset(buffer.data(), 0, buffer.size());
+		memcpy(buffer.data(), &header, sizeof(Header));
+
+		return writeAt(buffer.data(), m_bDirectIO ? buffer.size() : sizeof(Header), 0);
+	}
+
+	bool readHeader(Header& header)
+	{
+		AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(sizeof(Header));
+		if (!readAt(buffer.data(), m_bDirectIO ? buffer.size() : sizeof(Header), 0))
+		{
+			return false;
+		}
+
+		memcpy(&header, buffer.data(), sizeof(Header));
+
+		return header.m_nMagic == SUPERBLOCK_MAGIC && header.m_nVersion == FORMAT_VERSION;
+	}
+
+	// False if the record was never written or is torn.
+	bool readRecord(size_t nCopy, RootRecord& record)
+	{
+		AlignedBufferPool::Buffer buffer = m_poolBuffers.acquire(sizeof(RootRecord));
+		if (!readAt(buffer.data(), m_bDirectIO ? buffer.size() : sizeof(RootRecord), getRecordOffset(nCopy)))
+		{
+			return false;
+		}
+
+		memcpy(&record, buffer.data(), sizeof(RootRecord));
+
+		return record.m_nSequence > 0 && record.m_nChecksum == getChecksum(record);
+	}
+
+	bool readAt(char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nRead = ::pread(m_fdStorage, szBuffer, nSize, nOffset);
+			if (nRead < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nRead <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nRead;
+			nSize -= nRead;
+			nOffset += nRead;
+		}
+
+		return true;
+	}
+
+	bool writeAt(const char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nWritten = ::pwrite(m_fdStorage, szBuffer, nSize, nOffset);
+			if (nWritten < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nWritten <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nWritten;
+			nSize -= nWritten;
+			nOffset += nWritten;
+		}
+
+		return true;
+	}
+
+	// A short pwritev leaves the rest of the run to be written piecewise.
+	bool writeRun(std::vector<struct iovec>& vtRun, size_t nOffset)
+	{
+		ssize_t nWritten = 0;
+		do
+		{
+			nWritten = ::pwritev(m_fdStorage, vtRun.data(), vtRun.size(), nOffset);
+		} while (nWritten < 0 && errno == EINTR);
+
+		if (nWritten < 0)
+		{
+			return false;
+		}
+
+		for (auto& iov : vtRun)
+		{
+			size_t nDone = std::min((size_t)nWritten, iov.iov_len);
+			nWritten -= nDone;
+			nOffset += nDone;
+
+			if (nDone < iov.iov_len && !writeAt((const char*)iov.iov_base + nDone, iov.iov_len - nDone, nOffset))
+			{
+				return false;
+			}
+
+			nOffset += iov.iov_len - nDone;
+		}
+
+		return true;
+	}
+
+public:
 #ifdef __CONCURRENT__
 	void performBatchFlush()
 	{
@@ -222,21 +739,17 @@ public:
 		{
 			std::tuple<uint8_t, const std::byte*, size_t> tpSerializedData = it->second->serialize();
 
-			m_fsStorage.seekp(m_nNextBlock * m_nBlockSize);
-			m_fsStorage.write((char*)(&std::get<0>(tpSerializedData)), sizeof(uint8_t));
-			m_fsStorage.write((char*)(std::get<1>(tpSerializedData)), std::get<2>(tpSerializedData));
-
 			size_t nBlockRequired = std::ceil(std::get<2>(tpSerializedData) / (float)m_nBlockSize);
 
+			size_t nBlock = 0;
+			m_allocator.allocate(nBlockRequired, nBlock);
+
+			writeAt((const char*)(&std::get<0>(tpSerializedData)), sizeof(uint8_t), nBlock * m_nBlockSize);
+			writeAt((const char*)(std::get<1>(tpSerializedData)), std::get<2>(tpSerializedData), nBlock * m_nBlockSize + sizeof(uint8_t));
+
 			ObjectUIDType uid = ObjectUIDType::createAddressFromFileOffset(m_nBlockSize, nBlockRequired * m_nBlockSize);
 			mpUpdatedUIDs[it->first] = uid;
-
-			for (int idx = 0; idx < nBlockRequired; idx++)
-			{
-				m_vtAllocationTable[m_nNextBlock++] = true;
-			}
 		}
-		m_fsStorage.flush();
 
 		m_ptrCallback->keysUpdate(mpUpdatedUIDs);
 	}
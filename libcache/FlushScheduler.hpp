@@ -0,0 +1,195 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "CacheStats.h"
+
+/*
+ * Paces the background flusher of a cache under __CONCURRENT__. The flusher sleeps until the cache reports that it
+ * went past its high watermark, then drains it down to the low watermark in passes of an adaptive batch: the batch
+ * doubles while a burst keeps it from draining in one pass and halves again once a pass is left mostly unused.
+ * A thread that finds the cache past its hard limit is held back until the flusher completes a pass. Never for
+ * longer, as the thread may hold the very objects the flusher would have to evict; and not at all while the flusher
+ * is stalled on such objects, it then backs off and retries on its own.
+ */
+template <size_t MIN_BATCH = 100, size_t MAX_BATCH = 100 * 16>
+class FlushScheduler
+{
+private:
+	std::mutex m_mtxFlusher;
+	std::condition_variable m_cvFlusher;
+	std::condition_variable m_cvWriters;
+
+	bool m_bStop;
+	bool m_bStalled;
+	std::atomic<bool> m_bRequested;
+
+	size_t m_nBatch;
+	size_t m_nPasses;
+
+	size_t m_nFlushedObjects;
+	size_t m_nFlushMicroseconds;
+	size_t m_nWriterStalls;
+	size_t m_nWriterStallMicroseconds;
+
+public:
+	FlushScheduler()
+		: m_bStop(false)
+		, m_bStalled(false)
+		, m_bRequested(false)
+		, m_nBatch(MIN_BATCH)
+		, m_nPasses(0)
+		, m_nFlushedObjects(0)
+		, m_nFlushMicroseconds(0)
+		, m_nWriterStalls(0)
+		, m_nWriterStallMicroseconds(0)
+	{
+	}
+
+	void stop()
+	{
+		{
+			std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+			m_bStop = true;
+		}
+
+		m_cvFlusher.notify_all();
+		m_cvWriters.notify_all();
+	}
+
+	/*
+	 * Called by the cache, without its own locks held, once an admission left it past the high watermark (bHigh) or
+	 * the hard limit (bHard).
+	 */
+	inline void admitted(bool bHigh, bool bHard)
+	{
+		if (bHard)
+		{
+			waitForPass();
+		}
+		else if (bHigh)
+		{
+			wake();
+		}
+	}
+
+	inline void wake()
+	{
+		// Already requested and not picked up yet; spares the lock while the flusher is busy draining.
+		if (m_bRequested.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+			m_bRequested.store(true, std::memory_order_relaxed);
+		}
+
+		m_cvFlusher.notify_one();
+	}
+
+	/*
+	 * Blocks the flusher until there is work or the cache goes down, in which case it returns false. After a drain
+	 * that stalled on objects in use the flusher waits out a fixed delay instead: the admissions that would wake it
+	 * do not free anything up, and nothing else might while the cache stays past its bounds.
+	 */
+	bool waitForWork()
+	{
+		std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+
+		if (m_bStalled)
+		{
+			m_cvFlusher.wait_for(lock_flusher, std::chrono::milliseconds(100), [this] { return m_bStop; });
+		}
+		else
+		{
+			m_cvFlusher.wait(lock_flusher, [this] { return m_bStop || m_bRequested.load(std::memory_order_relaxed); });
+		}
+
+		m_bRequested.store(false, std::memory_order_relaxed);
+
+		return !m_bStop;
+	}
+
+	inline size_t getBatchSize()
+	{
+		std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+		return m_nBatch;
+	}
+
+	/*
+	 * Accounts for a pass of the flusher and lets the threads held back by it go on.
+	 */
+	void completePass(size_t nFlushed, std::chrono::steady_clock::duration tmElapsed)
+	{
+		{
+			std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+
+			m_nPasses++;
+			m_nFlushedObjects += nFlushed;
+			m_nFlushMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(tmElapsed).count();
+		}
+
+		m_cvWriters.notify_all();
+	}
+
+	/*
+	 * Adapts the batch to the drain that just ended: nPasses it took, nLastPass objects evicted by the last one.
+	 */
+	void completeDrain(size_t nPasses, size_t nLastPass, bool bStalled)
+	{
+		std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+
+		m_bStalled = bStalled;
+		if (bStalled)
+		{
+			return;
+		}
+
+		if (nPasses > 1)
+		{
+			m_nBatch = std::min(m_nBatch * 2, MAX_BATCH);
+		}
+		else if (nLastPass < m_nBatch / 2)
+		{
+			m_nBatch = std::max(m_nBatch / 2, MIN_BATCH);
+		}
+	}
+
+	void getStats(CacheStats& stats)
+	{
+		std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+
+		stats.m_nFlushedObjects = m_nFlushedObjects;
+		stats.m_nFlushMicroseconds = m_nFlushMicroseconds;
+		stats.m_nFlushBatch = m_nBatch;
+		stats.m_nWriterStalls = m_nWriterStalls;
+		stats.m_nWriterStallMicroseconds = m_nWriterStallMicroseconds;
+	}
+
+private:
+	void waitForPass()
+	{
+		auto tmStart = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock_flusher(m_mtxFlusher);
+
+		size_t nPass = m_nPasses;
+
+		m_bRequested.store(true, std::memory_order_relaxed);
+		m_cvFlusher.notify_one();
+
+		if (m_bStalled)
+		{
+			return;
+		}
+
+		m_cvWriters.wait(lock_flusher, [this, nPass] { return m_bStop || m_nPasses != nPass; });
+
+		m_nWriterStalls++;
+		m_nWriterStallMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tmStart).count();
+	}
+};
@@ -1,17 +1,20 @@
 #pragma once
 #include <unordered_map>
 #include "CacheErrorCodes.h"
+#include "BlockAllocator.hpp"
 
 template <typename ObjectUIDType, typename ObjectType>
 class IFlushCallback
 {
 public:
 	virtual void applyExistingUpdates(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
-		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates) = 0;
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates
+		, std::vector<ObjectUIDType>& vtAppliedUIDs) = 0;
 
 	virtual void applyExistingUpdates(std::shared_ptr<ObjectType> ptrObject
-		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates) = 0;
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUIDUpdates
+		, std::vector<ObjectUIDType>& vtAppliedUIDs) = 0;
 
 	virtual void prepareFlush(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
-		, size_t& nPos, size_t nBlockSize, ObjectUIDType::Media nMediaType) = 0;
+		, BlockAllocator& allocator, size_t nBlockSize, ObjectUIDType::Media nMediaType, std::vector<ObjectUIDType>& vtAppliedUIDs) = 0;
 };
\ No newline at end of file
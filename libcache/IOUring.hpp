@@ -0,0 +1,270 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * A single io_uring instance driven through the raw system calls, so neither liburing nor any special hardware is
+ * needed: it works on any file of a kernel that has io_uring (5.1+). Requests are queued with prepareRead and
+ * prepareWritev, handed to the kernel by submit and come back, tagged with the caller's user data, from
+ * popCompletion. Not synchronized; the submission side and the completion side may each be driven by one thread
+ * at a time.
+ */
+class IOUring
+{
+private:
+	int m_fdRing;
+	unsigned m_nEntries;
+
+	void* m_ptrSQRing;
+	size_t m_nSQRingSize;
+	void* m_ptrCQRing;
+	size_t m_nCQRingSize;
+	struct io_uring_sqe* m_arrSQEs;
+	size_t m_nSQEsSize;
+
+	unsigned* m_ptrSQHead;
+	unsigned* m_ptrSQTail;
+	unsigned* m_ptrSQMask;
+	unsigned* m_ptrSQArray;
+
+	unsigned* m_ptrCQHead;
+	unsigned* m_ptrCQTail;
+	unsigned* m_ptrCQMask;
+	struct io_uring_cqe* m_arrCQEs;
+
+	unsigned m_nSQTail;		// queued up to here, published to the kernel by submit
+	unsigned m_nPending;	// queued and not submitted yet
+
+public:
+	IOUring()
+		: m_fdRing(-1)
+		, m_nEntries(0)
+		, m_ptrSQRing(MAP_FAILED)
+		, m_nSQRingSize(0)
+		, m_ptrCQRing(MAP_FAILED)
+		, m_nCQRingSize(0)
+		, m_arrSQEs((struct io_uring_sqe*)MAP_FAILED)
+		, m_nSQEsSize(0)
+		, m_nSQTail(0)
+		, m_nPending(0)
+	{
+	}
+
+	~IOUring()
+	{
+		close();
+	}
+
+	IOUring(const IOUring&) = delete;
+	IOUring& operator=(const IOUring&) = delete;
+
+	/*
+	 * Sets the ring up with room for nEntries requests in flight. Returns false if the kernel does not offer
+	 * io_uring (too old, or disabled e.g. by a seccomp profile).
+	 */
+	bool open(unsigned nEntries)
+	{
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		m_fdRing = (int)syscall(__NR_io_uring_setup, nEntries, &params);
+		if (m_fdRing < 0)
+		{
+			return false;
+		}
+
+		m_nEntries = params.sq_entries;
+
+		m_nSQRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_nCQRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		m_nSQEsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+		m_ptrSQRing = mmap(0, m_nSQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fdRing, IORING_OFF_SQ_RING);
+		m_ptrCQRing = mmap(0, m_nCQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fdRing, IORING_OFF_CQ_RING);
+		m_arrSQEs = (struct io_uring_sqe*)mmap(0, m_nSQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fdRing, IORING_OFF_SQES);
+
+		if (m_ptrSQRing == MAP_FAILED || m_ptrCQRing == MAP_FAILED || m_arrSQEs == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		m_ptrSQHead = (unsigned*)((char*)m_ptrSQRing + params.sq_off.head);
+		m_ptrSQTail = (unsigned*)((char*)m_ptrSQRing + params.sq_off.tail);
+		m_ptrSQMask = (unsigned*)((char*)m_ptrSQRing + params.sq_off.ring_mask);
+		m_ptrSQArray = (unsigned*)((char*)m_ptrSQRing + params.sq_off.array);
+
+		m_ptrCQHead = (unsigned*)((char*)m_ptrCQRing + params.cq_off.head);
+		m_ptrCQTail = (unsigned*)((char*)m_ptrCQRing + params.cq_off.tail);
+		m_ptrCQMask = (unsigned*)((char*)m_ptrCQRing + params.cq_off.ring_mask);
+		m_arrCQEs = (struct io_uring_cqe*)((char*)m_ptrCQRing + params.cq_off.cqes);
+
+		m_nSQTail = *m_ptrSQTail;
+
+		return true;
+	}
+
+	void close()
+	{
+		if (m_arrSQEs != MAP_FAILED)
+		{
+			munmap(m_arrSQEs, m_nSQEsSize);
+			m_arrSQEs = (struct io_uring_sqe*)MAP_FAILED;
+		}
+
+		if (m_ptrCQRing != MAP_FAILED)
+		{
+			munmap(m_ptrCQRing, m_nCQRingSize);
+			m_ptrCQRing = MAP_FAILED;
+		}
+
+		if (m_ptrSQRing != MAP_FAILED)
+		{
+			munmap(m_ptrSQRing, m_nSQRingSize);
+			m_ptrSQRing = MAP_FAILED;
+		}
+
+		if (m_fdRing >= 0)
+		{
+			::close(m_fdRing);
+			m_fdRing = -1;
+		}
+	}
+
+	inline bool isOpen() const
+	{
+		return m_fdRing >= 0;
+	}
+
+	inline unsigned getEntries() const
+	{
+		return m_nEntries;
+	}
+
+	inline bool prepareRead(int fd, void* ptrBuffer, size_t nSize, size_t nOffset, uint64_t nUserData)
+	{
+		struct io_uring_sqe* ptrSQE = nextSQE();
+		if (ptrSQE == nullptr)
+		{
+			return false;
+		}
+
+		ptrSQE->opcode = IORING_OP_READ;
+		ptrSQE->fd = fd;
+		ptrSQE->addr = (uint64_t)ptrBuffer;
+		ptrSQE->len = (uint32_t)nSize;
+		ptrSQE->off = nOffset;
+		ptrSQE->user_data = nUserData;
+
+		return true;
+	}
+
+	// The iovecs, and the memory they point to, have to stay valid until the request completes.
+	inline bool prepareWritev(int fd, const struct iovec* ptrIOVecs, unsigned nIOVecs, size_t nOffset, uint64_t nUserData)
+	{
+		struct io_uring_sqe* ptrSQE = nextSQE();
+		if (ptrSQE == nullptr)
+		{
+			return false;
+		}
+
+		ptrSQE->opcode = IORING_OP_WRITEV;
+		ptrSQE->fd = fd;
+		ptrSQE->addr = (uint64_t)ptrIOVecs;
+		ptrSQE->len = nIOVecs;
+		ptrSQE->off = nOffset;
+		ptrSQE->user_data = nUserData;
+
+		return true;
+	}
+
+	/*
+	 * Hands the queued requests to the kernel. Returns the number it took or -errno.
+	 */
+	int submit()
+	{
+		if (m_nPending == 0)
+		{
+			return 0;
+		}
+
+		std::atomic_ref<unsigned>(*m_ptrSQTail).store(m_nSQTail, std::memory_order_release);
+
+		int nSubmitted;
+		do
+		{
+			nSubmitted = (int)syscall(__NR_io_uring_enter, m_fdRing, m_nPending, 0, 0, nullptr, 0);
+		} while (nSubmitted < 0 && errno == EINTR);
+
+		if (nSubmitted < 0)
+		{
+			return -errno;
+		}
+
+		m_nPending -= nSubmitted;
+		return nSubmitted;
+	}
+
+	/*
+	 * Blocks until at least one completion is there to be popped.
+	 */
+	int waitForCompletion()
+	{
+		int nResult;
+		do
+		{
+			nResult = (int)syscall(__NR_io_uring_enter, m_fdRing, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		} while (nResult < 0 && errno == EINTR);
+
+		return nResult < 0 ? -errno : 0;
+	}
+
+	/*
+	 * Takes the next completion off the queue, if there is one; nResult is what the read or write system call
+	 * would have returned, -errno on failure.
+	 */
+	inline bool popCompletion(uint64_t& nUserData, int& nResult)
+	{
+		unsigned nHead = std::atomic_ref<unsigned>(*m_ptrCQHead).load(std::memory_order_relaxed);
+		if (nHead == std::atomic_ref<unsigned>(*m_ptrCQTail).load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		struct io_uring_cqe& cqe = m_arrCQEs[nHead & *m_ptrCQMask];
+		nUserData = cqe.user_data;
+		nResult = cqe.res;
+
+		std::atomic_ref<unsigned>(*m_ptrCQHead).store(nHead + 1, std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	inline struct io_uring_sqe* nextSQE()
+	{
+		unsigned nHead = std::atomic_ref<unsigned>(*m_ptrSQHead).load(std::memory_order_acquire);
+		if (m_nSQTail - nHead >= m_nEntries)
+		{
+			return nullptr;
+		}
+
+		unsigned nIndex = m_nSQTail & *m_ptrSQMask;
+
+		struct io_uring_sqe* ptrSQE = &m_arrSQEs[nIndex];
+		memset(ptrSQE, 0, sizeof(struct io_uring_sqe));
+
+		m_ptrSQArray[nIndex] = nIndex;
+		m_nSQTail++;
+		m_nPending++;
+
+		return ptrSQE;
+	}
+};
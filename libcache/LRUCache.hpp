@@ -14,17 +14,29 @@
 
 #include "IFlushCallback.h"
 #include "VariadicNthType.h"
+#include "EvictionPolicy.hpp"
+#include "CacheStats.h"
+#include "AccessMode.h"
+#include "ObjectPin.hpp"
+#include "ReadBuffer.hpp"
+#include "FlushScheduler.hpp"
+#include "CheckpointScheduler.hpp"
+#include "SingleFlight.hpp"
 
 #define FLUSH_COUNT 100
+#define CHECKPOINT_SLICE 100
 
 
 using namespace std::chrono_literals;
 
 
-template <typename ICallback, typename StorageType>
+/*
+ * The replacement policy is a template parameter (see EvictionPolicy.hpp); LRUPolicy keeps the original behaviour.
+ */
+template <typename ICallback, typename StorageType, typename EvictionPolicyType = LRUPolicy<typename StorageType::ObjectUIDType>>
 class LRUCache : public ICallback
 {
-	typedef LRUCache<ICallback, StorageType> SelfType;
+	typedef LRUCache<ICallback, StorageType, EvictionPolicyType> SelfType;
 
 public:
 	typedef StorageType::ObjectUIDType ObjectUIDType;
@@ -32,44 +44,29 @@ public:
 	typedef std::shared_ptr<ObjectType> ObjectTypePtr;
 
 private:
-	struct Item
-	{
-	public:
-		ObjectUIDType m_uidSelf;
-		ObjectTypePtr m_ptrObject;
-		std::shared_ptr<Item> m_ptrPrev;
-		std::shared_ptr<Item> m_ptrNext;
-
-		Item(const ObjectUIDType& key, const ObjectTypePtr ptrObject)
-			: m_ptrNext(nullptr)
-			, m_ptrPrev(nullptr)
-		{
-			m_uidSelf = key;
-			m_ptrObject = ptrObject;
-		}
-
-		~Item()
-		{
-			m_ptrPrev = nullptr;
-			m_ptrNext = nullptr;
-			m_ptrObject = nullptr;
-		}
-	};
-
 	ICallback* m_ptrCallback;
 
-	std::shared_ptr<Item> m_ptrHead;
-	std::shared_ptr<Item> m_ptrTail;
-
 	std::unique_ptr<StorageType> m_ptrStorage;
 
 	size_t m_nCacheCapacity;
-	std::unordered_map<ObjectUIDType, std::shared_ptr<Item>> m_mpObjects;
+	std::unordered_map<ObjectUIDType, ObjectTypePtr> m_mpObjects;
+
+	// Once the resident bytes go past the high watermark, eviction carries on down to the low one.
+	size_t m_nHighWatermarkBytes;
+	size_t m_nLowWatermarkBytes;
+	size_t m_nResidentBytes;
+
+	size_t m_nDirtyEvictions;
+	size_t m_nCleanEvictions;
+	size_t m_nPinnedSkips;
+	size_t m_nEvictionStalls;
+
+	EvictionPolicyType m_policy;
 
 	std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, ObjectTypePtr>> m_mpUpdatedUIDs;
 
 #ifdef __CONCURRENT__
-	bool m_bStop;
+	FlushScheduler<FLUSH_COUNT, FLUSH_COUNT * 16> m_flusher;
 
 	std::thread m_threadCacheFlush;
 
@@ -77,18 +74,32 @@ private:
 
 	mutable std::shared_mutex m_mtxCache;
 	mutable std::shared_mutex m_mtxStorage;
+
+	// Hits are recorded here under the shared m_mtxCache and applied to m_policy in batches, see drainReadBuffer.
+	ReadBuffer<ObjectUIDType> m_bufReads;
+
+	// Concurrent misses on the same uid share one load, see loadObject.
+	SingleFlight<ObjectUIDType, ObjectTypePtr> m_loads;
+
+	CheckpointScheduler m_checkpointer;
+
+	std::thread m_threadCheckpoint;
+
+	// Taken by a checkpoint slice and a pass of the flusher, neither ever sees the writes the other has in flight.
+	std::mutex m_mtxCheckpoint;
 #endif __CONCURRENT__
 
 public:
 	~LRUCache()
 	{
 #ifdef __CONCURRENT__
-		m_bStop = true;
+		m_checkpointer.stop();
+		m_threadCheckpoint.join();
+
+		m_flusher.stop();
 		m_threadCacheFlush.join();
 #endif __CONCURRENT__
 
-		m_ptrHead = nullptr;
-		m_ptrTail = nullptr;
 		m_ptrStorage = nullptr;
 
 		m_mpObjects.clear();
@@ -97,14 +108,23 @@ public:
 	template <typename... StorageArgs>
 	LRUCache(size_t nCapacity, StorageArgs... args)
 		: m_nCacheCapacity(nCapacity)
-		, m_ptrHead(nullptr)
-		, m_ptrTail(nullptr)
+		, m_nHighWatermarkBytes(0)
+		, m_nLowWatermarkBytes(0)
+		, m_nResidentBytes(0)
+		, m_nDirtyEvictions(0)
+		, m_nCleanEvictions(0)
+		, m_nPinnedSkips(0)
+		, m_nEvictionStalls(0)
+		, m_policy(nCapacity)
 	{
+		// The map briefly holds more than the capacity until the next eviction; sized so that it never rehashes.
+		m_mpObjects.reserve(nCapacity + FLUSH_COUNT);
+
 		m_ptrStorage = std::make_unique<StorageType>(args...);
 		
 #ifdef __CONCURRENT__
-		m_bStop = false;
 		m_threadCacheFlush = std::thread(handlerCacheFlush, this);
+		m_threadCheckpoint = std::thread(handlerCheckpoint, this);
 #endif __CONCURRENT__
 	}
 
@@ -123,45 +143,79 @@ public:
 
 	}
 
+	/*
+	 * Drops the object and releases its blocks. The uid may be one the object has been relocated from, a child reached
+	 * through the reference swizzled into its parent is not renamed there; the relocation goes then as well, together
+	 * with the object under its new uid.
+	 */
 	CacheErrorCode remove(const ObjectUIDType& uidObject)
 	{
 		CacheErrorCode errCode = CacheErrorCode::Error;
 
 #ifdef __CONCURRENT__
 		std::unique_lock<std::shared_mutex>  lock_cache(m_mtxCache);
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
 #endif __CONCURRENT__
 
-		auto it = m_mpObjects.find(uidObject);
-		if (it != m_mpObjects.end()) 
+		std::optional<ObjectUIDType> uidRelocated = std::nullopt;
+
+		auto itUpdated = m_mpUpdatedUIDs.find(uidObject);
+		if (itUpdated != m_mpUpdatedUIDs.end() && (*itUpdated).second.first != std::nullopt)
+		{
+			uidRelocated = (*itUpdated).second.first;
+			m_mpUpdatedUIDs.erase(itUpdated);
+		}
+
+		if (dropResident(uidObject))
 		{
-			removeFromLRU((*it).second);
-			m_mpObjects.erase((*it).first);
 			errCode = CacheErrorCode::Success;
 		}
 
 		m_ptrStorage->remove(uidObject);
 
+		if (uidRelocated != std::nullopt)
+		{
+			if (dropResident(*uidRelocated))
+			{
+				errCode = CacheErrorCode::Success;
+			}
+
+			m_ptrStorage->remove(*uidRelocated);
+		}
+
 		return errCode;
 	}
 
 	CacheErrorCode getObject(const ObjectUIDType uidObject, ObjectTypePtr & ptrObject, std::optional<ObjectUIDType>& uidUpdated)
 	{
 #ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache); // std::unique_lock due to LRU's linked-list update! is there any better way?
+		std::shared_lock<std::shared_mutex> lock_cache(m_mtxCache); // a hit only records the access, the policy is updated later.
 #endif __CONCURRENT__
 
-		if (m_mpObjects.find(uidObject) != m_mpObjects.end())
+		auto it = m_mpObjects.find(uidObject);
+		if (it != m_mpObjects.end())
 		{
-			std::shared_ptr<Item> ptrItem = m_mpObjects[uidObject];
-			moveToFront(ptrItem);
-			ptrObject = ptrItem->m_ptrObject;
+			ptrObject = (*it).second;
+
+#ifdef __CONCURRENT__
+			bool bDrain = !m_bufReads.record(uidObject);
+
+			lock_cache.unlock();
+
+			if (bDrain)
+			{
+				drainReadBuffer();
+			}
+#else __CONCURRENT__
+			m_policy.touch(uidObject);
+#endif __CONCURRENT__
 
 			//std::cout << std::endl;
 			return CacheErrorCode::Success;
 		}
 
 #ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage); // TODO: requesting the same key?
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
 		lock_cache.unlock();
 #endif __CONCURRENT__
 
@@ -172,8 +226,10 @@ public:
 		{
 
 #ifdef __CONCURRENT__
-			std::optional< ObjectUIDType >& _condition = m_mpUpdatedUIDs[uidObject].first;
-			cv.wait(lock_storage, [&_condition] { return _condition != std::nullopt; });
+			if (!waitForUpdatedUID(uidObject, lock_storage))
+			{
+				return CacheErrorCode::Error;
+			}
 #endif __CONCURRENT__
 
 			//cv.wait(lock_storage, [] { return m_mpUpdatedUIDs[uidObject].first != std::nullopt; });
@@ -182,53 +238,48 @@ public:
 
 			assert(uidUpdated != std::nullopt);
 
-			m_mpUpdatedUIDs.erase(uidObject);	// Applied.
+#ifndef __CONCURRENT__
+			retireUpdatedUID(uidObject);	// Applied.
+#endif __CONCURRENT__
 			_uidUpdated = *uidUpdated;
 		}
 //std::cout << _uidUpdated.toString().c_str() << " ,..... ";
 
 #ifdef __CONCURRENT__
 		lock_storage.unlock();
+
+		// Not resident and not listed as relocated (yet, or any more: another thread applied it), see BPlusStore::fetchNode.
+		if (_uidUpdated.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Error;
+		}
+#else __CONCURRENT__
+		// A flush relocates the objects it writes without evicting them, the new uid may still be resident.
+		it = m_mpObjects.find(_uidUpdated);
+		if (it != m_mpObjects.end())
+		{
+			m_policy.touch(_uidUpdated);
+			ptrObject = (*it).second;
+			return CacheErrorCode::Success;
+		}
 #endif __CONCURRENT__
 
+#ifdef __CONCURRENT__
+		std::shared_ptr<ObjectType> _ptrObject = loadObject(_uidUpdated);
+#else __CONCURRENT__
 		std::shared_ptr<ObjectType> _ptrObject = m_ptrStorage->getObject(_uidUpdated);
-
+#endif __CONCURRENT__
 
 		if (_ptrObject != nullptr)
 		{
-			std::shared_ptr<Item> ptrItem = std::make_shared<Item>(_uidUpdated, _ptrObject);
-
-#ifdef __CONCURRENT__
-			std::unique_lock<std::shared_mutex> re_lock_cache(m_mtxCache);
-
-			if (m_mpObjects.find(_uidUpdated) != m_mpObjects.end())
-			{
-				std::shared_ptr<Item> ptrItem = m_mpObjects[_uidUpdated];
-				moveToFront(ptrItem);
-				ptrObject = ptrItem->m_ptrObject;
-				return CacheErrorCode::Success;
-			}
+#ifndef __CONCURRENT__
+			m_mpObjects[_uidUpdated] = _ptrObject;
+			m_policy.admit(_uidUpdated);
+			charge(_ptrObject);
 #endif __CONCURRENT__
 
-			m_mpObjects[_uidUpdated] = ptrItem;
-
-			if (!m_ptrHead)
-			{
-				m_ptrHead = ptrItem;
-				m_ptrTail = ptrItem;
-			}
-			else
-			{
-				ptrItem->m_ptrNext = m_ptrHead;
-				m_ptrHead->m_ptrPrev = ptrItem;
-				m_ptrHead = ptrItem;
-			}
-
 			ptrObject = _ptrObject;
 
-#ifndef __CONCURRENT__
-			flushItemsToStorage();
-#endif __CONCURRENT__
 //std::cout << std::endl;
 			return CacheErrorCode::Success;
 		} else {
@@ -242,53 +293,87 @@ public:
 	CacheErrorCode reorder(std::vector<std::pair<ObjectUIDType, ObjectTypePtr>>& vt, bool ensure = true)
 	{
 #ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache); // std::unique_lock due to LRU's linked-list update! is there any better way?
+		// Recorded like the hits, see getObject, leaf first as below: a parent must never look older than a child it
+		// references, as the flusher writes the children out first. Hence the batch goes in whole or is applied here.
+		if (m_bufReads.recordAll(vt.rbegin(), vt.rend(), [](const std::pair<ObjectUIDType, ObjectTypePtr>& prNode) { return prNode.first; }))
+		{
+			vt.clear();
+			return CacheErrorCode::Success;
+		}
+
+		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+
+		applyReadBuffer();
 #endif __CONCURRENT__
 
 		while (vt.size() > 0)
 		{
 			std::pair<ObjectUIDType, ObjectTypePtr> prNode = vt.back();
 
-			if (m_mpObjects.find(prNode.first) != m_mpObjects.end())
+			auto it = m_mpObjects.find(prNode.first);
+			if (it != m_mpObjects.end())
 			{
-				std::shared_ptr<Item> ptrItem = m_mpObjects[prNode.first];
-				moveToFront(ptrItem);
+				m_policy.touch(prNode.first);
+				recharge((*it).second);
 			}
 			else
 			{
-				if (ensure) 
+#ifdef __CONCURRENT__
+				// The flusher runs on its own thread and may already have written out an object the operation created
+				// but does not hold (a split sibling); the parent picks its new uid up from m_mpUpdatedUIDs.
+#else __CONCURRENT__
+				if (ensure)
 				{
 					throw new std::logic_error("should not occur!");
 				}
+#endif __CONCURRENT__
 			}
 
 			vt.pop_back();
 		}
 
+#ifndef __CONCURRENT__
+		// Eviction is held back until the operation has reported everything it touched; an object it created but
+		// does not hold (a split sibling) must not be evicted half way, whatever the policy thinks of it.
+		flushItemsToStorage();
+#endif __CONCURRENT__
+
 		return CacheErrorCode::Success;
 	}
 
 	template <typename Type>
-	CacheErrorCode getObjectOfType(const ObjectUIDType key, Type& ptrObject, std::optional<ObjectUIDType>& uidUpdated)
+	CacheErrorCode getObjectOfType(const ObjectUIDType key, Type& ptrObject, std::optional<ObjectUIDType>& uidUpdated, AccessMode nMode)
 	{
 #ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+		std::shared_lock<std::shared_mutex> lock_cache(m_mtxCache); // a hit only records the access, the policy is updated later.
 #endif __CONCURRENT__
 
-		if (m_mpObjects.find(key) != m_mpObjects.end())
+		auto it = m_mpObjects.find(key);
+		if (it != m_mpObjects.end())
 		{
-			std::shared_ptr<Item> ptrItem = m_mpObjects[key];
+			ObjectTypePtr ptrValue = (*it).second;
 
-			moveToFront(ptrItem);
+#ifdef __CONCURRENT__
+			bool bDrain = !m_bufReads.record(key);
 
-//#ifdef __CONCURRENT__
-//			lock_cache.unlock();
-//#endif __CONCURRENT__
-			ptrItem->m_ptrObject->dirty = true; //todo fix it later..
+			lock_cache.unlock();
+
+			if (bDrain)
+			{
+				drainReadBuffer();
+			}
+#else __CONCURRENT__
+			m_policy.touch(key);
+#endif __CONCURRENT__
 
-			if (std::holds_alternative<Type>(*ptrItem->m_ptrObject->data))
+			if (nMode == AccessMode::Write)
 			{
-				ptrObject = std::get<Type>(*ptrItem->m_ptrObject->data);
+				ptrValue->dirty = true;
+			}
+
+			if (std::holds_alternative<Type>(*ptrValue->data))
+			{
+				ptrObject = std::get<Type>(*ptrValue->data);
 				return CacheErrorCode::Success;
 			}
 
@@ -304,80 +389,194 @@ public:
 		if (m_mpUpdatedUIDs.find(key) != m_mpUpdatedUIDs.end())
 		{
 #ifdef __CONCURRENT__
-			std::optional< ObjectUIDType >& _condition = m_mpUpdatedUIDs[key].first;
-			cv.wait(lock_storage, [&_condition] { return _condition != std::nullopt; });
+			if (!waitForUpdatedUID(key, lock_storage))
+			{
+				return CacheErrorCode::Error;
+			}
 #endif __CONCURRENT__
 
 			uidUpdated = m_mpUpdatedUIDs[key].first;
 
 			assert(uidUpdated != std::nullopt);
 
-			m_mpUpdatedUIDs.erase(key);	// Applied.
+			retireUpdatedUID(key);	// Applied.
 			_uidUpdated = *uidUpdated;
 		}
 
 #ifdef __CONCURRENT__
 		lock_storage.unlock();
+
+		// See getObject.
+		if (_uidUpdated.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Error;
+		}
+#else __CONCURRENT__
+		// See getObject.
+		it = m_mpObjects.find(_uidUpdated);
+		if (it != m_mpObjects.end())
+		{
+			m_policy.touch(_uidUpdated);
+
+			if (nMode == AccessMode::Write)
+			{
+				(*it).second->dirty = true;
+			}
+
+			if (std::holds_alternative<Type>(*(*it).second->data))
+			{
+				ptrObject = std::get<Type>(*(*it).second->data);
+				return CacheErrorCode::Success;
+			}
+
+			return CacheErrorCode::Error;
+		}
 #endif __CONCURRENT__
 
+#ifdef __CONCURRENT__
+		std::shared_ptr<ObjectType> ptrValue = loadObject(_uidUpdated);
+#else __CONCURRENT__
 		std::shared_ptr<ObjectType> ptrValue = m_ptrStorage->getObject(_uidUpdated);
+#endif __CONCURRENT__
 
 		if (ptrValue != nullptr)
 		{
-			std::shared_ptr<Item> ptrItem = std::make_shared<Item>(_uidUpdated, ptrValue);
+			if (nMode == AccessMode::Write)
+			{
+				ptrValue->dirty = true;
+			}
+
+#ifndef __CONCURRENT__
+			m_mpObjects[_uidUpdated] = ptrValue;
+			m_policy.admit(_uidUpdated);
+			charge(ptrValue);
+#endif __CONCURRENT__
 
-			ptrValue->dirty = true; //todo fix it later..
+			if (std::holds_alternative<Type>(*ptrValue->data))
+			{
+				ptrObject = std::get<Type>(*ptrValue->data);
+				return CacheErrorCode::Success;
+			}
+
+			return CacheErrorCode::Error;
+		}
+
+		return CacheErrorCode::Error;
+	}
 
 #ifdef __CONCURRENT__
-			std::unique_lock<std::shared_mutex> re_lock_cache(m_mtxCache);
+	/*
+	 * Waits, holding lock_storage, for the relocation of uidObject to be written out. The entry is looked up again on
+	 * every wake-up: a thread that saw it complete first may have applied it and dropped it (dropUpdatedUID) in the
+	 * meantime, in which case the parent holds the new uid and false is returned.
+	 */
+	inline bool waitForUpdatedUID(const ObjectUIDType& uidObject, std::unique_lock<std::shared_mutex>& lock_storage)
+	{
+		bool bListed = true;
+		cv.wait(lock_storage, [this, &uidObject, &bListed]
+			{
+				auto it = m_mpUpdatedUIDs.find(uidObject);
+				bListed = it != m_mpUpdatedUIDs.end();
+				return !bListed || (*it).second.first != std::nullopt;
+			});
+
+		return bListed;
+	}
 
-			if (m_mpObjects.find(_uidUpdated) != m_mpObjects.end())
+	/*
+	 * Returns the object uidObject names, admitting it if it has to be read from the storage. Concurrent misses on
+	 * the same uid wait for the first one's load (a hot upper level node after an eviction would otherwise be read
+	 * and deserialized by every thread that descends through it), and until they have it the table holds it as well,
+	 * which keeps the flusher off it. It is looked up first: the uid may be that of a relocation still listed, see
+	 * dropUpdatedUID, whose object is resident already.
+	 */
+	inline ObjectTypePtr loadObject(const ObjectUIDType& uidObject)
+	{
+		return m_loads.load(uidObject, [this, &uidObject]() -> ObjectTypePtr
 			{
-				std::shared_ptr<Item> ptrItem = m_mpObjects[_uidUpdated];
-				moveToFront(ptrItem);
+				{
+					std::shared_lock<std::shared_mutex> lock_cache(m_mtxCache);
+
+					auto it = m_mpObjects.find(uidObject);
+					if (it != m_mpObjects.end())
+					{
+						ObjectTypePtr ptrObject = (*it).second;
+						bool bDrain = !m_bufReads.record(uidObject);
+
+						lock_cache.unlock();
+
+						if (bDrain)
+						{
+							drainReadBuffer();
+						}
 
-				if (std::holds_alternative<Type>(*ptrItem->m_ptrObject->data))
+						return ptrObject;
+					}
+				}
+
+				ObjectTypePtr ptrObject = m_ptrStorage->getObject(uidObject);
+				if (ptrObject == nullptr)
 				{
-					ptrObject = std::get<Type>(*ptrItem->m_ptrObject->data);
-					return CacheErrorCode::Success;
+					return nullptr;
 				}
 
-				return CacheErrorCode::Error;
-			}
-#endif __CONCURRENT__
+				// Clean, what dirties it from here on is left for the next checkpoint.
+				ptrObject->checkpoint = m_checkpointer.getEpoch();
 
-			m_mpObjects[_uidUpdated] = ptrItem;
+				std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
 
-			if (!m_ptrHead)
-			{
-				m_ptrHead = ptrItem;
-				m_ptrTail = ptrItem;
-			}
-			else
-			{
-				ptrItem->m_ptrNext = m_ptrHead;
-				m_ptrHead->m_ptrPrev = ptrItem;
-				m_ptrHead = ptrItem;
-			}
+				auto it = m_mpObjects.find(uidObject);
+				if (it != m_mpObjects.end())
+				{
+					m_policy.touch(uidObject);
+					return (*it).second;
+				}
 
-//#ifdef __CONCURRENT__
-//			lock_cache.unlock();
-//#endif __CONCURRENT__
+				m_mpObjects[uidObject] = ptrObject;
+				m_policy.admit(uidObject);
+				charge(ptrObject);
 
-			if (std::holds_alternative<Type>(*ptrValue->data))
-			{
-				ptrObject = std::get<Type>(*ptrValue->data);
-				return CacheErrorCode::Success;
-			}
+				signalFlusher(lock_cache);
 
-#ifndef __CONCURRENT__
-			flushItemsToStorage();
+				return ptrObject;
+			});
+	}
+
+	/*
+	 * A relocation reported by getObject stays listed until the caller has applied it to the parent and drops it
+	 * here. Another thread sharing the parent may have read the old uid; as long as it finds the relocation it
+	 * follows it, and once it does not the parent already shows the new uid (see BPlusStore::fetchNode).
+	 * getObjectOfType drops it at once, its callers hold the parent exclusively.
+	 */
+	CacheErrorCode dropUpdatedUID(const ObjectUIDType& uidObject)
+	{
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+
+		retireUpdatedUID(uidObject);
+
+		return CacheErrorCode::Success;
+	}
 #endif __CONCURRENT__
 
-			return CacheErrorCode::Error;
+	/*
+	 * For an object fetched with AccessMode::Read that the caller went on to modify. The caller still holds the object,
+	 * so it is resident.
+	 */
+	CacheErrorCode markDirty(const ObjectUIDType& uidObject)
+	{
+#ifdef __CONCURRENT__
+		std::shared_lock<std::shared_mutex> lock_cache(m_mtxCache);
+#endif __CONCURRENT__
+
+		auto it = m_mpObjects.find(uidObject);
+		if (it == m_mpObjects.end())
+		{
+			return CacheErrorCode::KeyDoesNotExist;
 		}
 
-		return CacheErrorCode::Error;
+		(*it).second->dirty = true;
+
+		return CacheErrorCode::Success;
 	}
 
 	template<class Type, typename... ArgsType>
@@ -387,38 +586,30 @@ public:
 
 		uidObject = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
 
-		std::shared_ptr<Item> ptrItem = std::make_shared<Item>(*uidObject, ptrObject);
-
 #ifdef __CONCURRENT__
+		// Left for the next checkpoint, see writeCheckpoint.
+		ptrObject->checkpoint = m_checkpointer.getEpoch();
+
 		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
 #endif __CONCURRENT__
 
-		if (m_mpObjects.find(*uidObject) != m_mpObjects.end())
+		auto it = m_mpObjects.find(*uidObject);
+		if (it != m_mpObjects.end())
 		{
-			std::shared_ptr<Item> ptrItem = m_mpObjects[*uidObject];
-			ptrItem->m_ptrObject = ptrObject;
-			moveToFront(ptrItem);
+			m_nResidentBytes -= (*it).second->footprint;
+			(*it).second = ptrObject;
+			m_policy.touch(*uidObject);
 		}
 		else
 		{
-			m_mpObjects[*uidObject] = ptrItem;
-			if (!m_ptrHead) 
-			{
-				m_ptrHead = ptrItem;
-				m_ptrTail = ptrItem;
-			}
-			else 
-			{
-				ptrItem->m_ptrNext = m_ptrHead;
-				m_ptrHead->m_ptrPrev = ptrItem;
-				m_ptrHead = ptrItem;
-			}
+			m_mpObjects[*uidObject] = ptrObject;
+			m_policy.admit(*uidObject);
 		}
 
+		charge(ptrObject);
+
 #ifdef __CONCURRENT__
-		//..
-#else
-		flushItemsToStorage();
+		signalFlusher(lock_cache);
 #endif __CONCURRENT__
 
 		return CacheErrorCode::Success;
@@ -433,264 +624,419 @@ public:
 
 		uidObject = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
 
-		std::shared_ptr<Item> ptrItem = std::make_shared<Item>(*uidObject, ptrObject);
-
 #ifdef __CONCURRENT__
+		// Left for the next checkpoint, see writeCheckpoint.
+		ptrObject->checkpoint = m_checkpointer.getEpoch();
+
 		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
 #endif __CONCURRENT__
 
-		if (m_mpObjects.find(*uidObject) != m_mpObjects.end())
+		auto it = m_mpObjects.find(*uidObject);
+		if (it != m_mpObjects.end())
 		{
-			std::shared_ptr<Item> ptrItem = m_mpObjects[*uidObject];
-			ptrItem->m_ptrObject = ptrObject;
-			moveToFront(ptrItem);
+			m_nResidentBytes -= (*it).second->footprint;
+			(*it).second = ptrObject;
+			m_policy.touch(*uidObject);
 		}
 		else
 		{
-			m_mpObjects[*uidObject] = ptrItem;
-			if (!m_ptrHead)
-			{
-				m_ptrHead = ptrItem;
-				m_ptrTail = ptrItem;
-			}
-			else
-			{
-				ptrItem->m_ptrNext = m_ptrHead;
-				m_ptrHead->m_ptrPrev = ptrItem;
-				m_ptrHead = ptrItem;
-			}
+			m_mpObjects[*uidObject] = ptrObject;
+			m_policy.admit(*uidObject);
 		}
 
+		charge(ptrObject);
+
 #ifdef __CONCURRENT__
-		//..
-#else
-		flushItemsToStorage();
+		signalFlusher(lock_cache);
 #endif __CONCURRENT__
 
 		return CacheErrorCode::Success;
 	}
 
-	void getCacheState(size_t& lru, size_t& map)
+	/*
+	 * Creates the object and writes it straight to the storage without admitting it to the cache.
+	 * Used by the bulk loader so that finished nodes land in sequential blocks instead of going through eviction.
+	 */
+	template<class Type, typename... ArgsType>
+	CacheErrorCode createObjectOfTypeInStorage(std::optional<ObjectUIDType>& uidObject, const ArgsType... args)
 	{
-		lru = 0;
-		std::shared_ptr<Item> _ptrItem = m_ptrHead;
-		do
+		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(std::make_shared<Type>(args...));
+
+		ObjectUIDType uidVolatile = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
+		ObjectUIDType uidUpdated;
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+#endif __CONCURRENT__
+
+		if (m_ptrStorage->addObject(uidVolatile, ptrObject, uidUpdated) != CacheErrorCode::Success)
 		{
-			lru++;
-			_ptrItem = _ptrItem->m_ptrNext;
+			uidObject = std::nullopt;
+			return CacheErrorCode::Error;
+		}
 
-		} while (_ptrItem != nullptr);
+		uidObject = uidUpdated;
+
+		return CacheErrorCode::Success;
+	}
 
+	void getCacheState(size_t& lru, size_t& map)
+	{
+		lru = m_policy.size();
 		map = m_mpObjects.size();
 	}
 
-	CacheErrorCode flush()
+	/*
+	 * Bounds the cache by the serialized size of its objects in addition to their count. When the resident bytes
+	 * exceed nHighWatermarkBytes, objects are evicted until they are down to nLowWatermarkBytes. 0 turns it off.
+	 */
+	void setByteBudget(size_t nHighWatermarkBytes, size_t nLowWatermarkBytes)
 	{
-		flushCacheToStorage();
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+#endif __CONCURRENT__
 
-		return CacheErrorCode::Success;
+		m_nHighWatermarkBytes = nHighWatermarkBytes;
+		m_nLowWatermarkBytes = std::min(nLowWatermarkBytes, nHighWatermarkBytes);
 	}
 
-private:
-	void moveToTail(std::shared_ptr<Item> tail, std::shared_ptr<Item> nodeToMove) 
+	void getCacheStats(CacheStats& stats)
 	{
-		if (tail == nullptr || nodeToMove == nullptr)
-		{
-			return;
-		}
+#ifdef __CONCURRENT__
+		std::shared_lock<std::shared_mutex> lock_cache(m_mtxCache);
+#endif __CONCURRENT__
 
-		if (nodeToMove->m_ptrPrev != nullptr)
-		{
-			nodeToMove->m_ptrPrev->m_ptrNext = nodeToMove->m_ptrNext;
-		}
-		else
-		{
-			tail = nodeToMove->m_ptrNext;
-		}
+		stats.m_nObjects = m_mpObjects.size();
+		stats.m_nResidentBytes = m_nResidentBytes;
+		stats.m_nHighWatermarkBytes = m_nHighWatermarkBytes;
+		stats.m_nLowWatermarkBytes = m_nLowWatermarkBytes;
+		stats.m_nDirtyEvictions = m_nDirtyEvictions;
+		stats.m_nCleanEvictions = m_nCleanEvictions;
+		stats.m_nPinnedSkips = m_nPinnedSkips;
+		stats.m_nEvictionStalls = m_nEvictionStalls;
 
-		if (nodeToMove->m_ptrNext != nullptr)
-		{
-			nodeToMove->m_ptrNext->m_ptrPrev = nodeToMove->m_ptrPrev;
-		}
+#ifdef __CONCURRENT__
+		m_flusher.getStats(stats);
+		stats.m_nDeduplicatedLoads = m_loads.getDeduplicated();
+#else __CONCURRENT__
+		stats.m_nFlushedObjects = 0;
+		stats.m_nFlushMicroseconds = 0;
+		stats.m_nFlushBatch = 0;
+		stats.m_nWriterStalls = 0;
+		stats.m_nWriterStallMicroseconds = 0;
+		stats.m_nDeduplicatedLoads = 0;
+#endif __CONCURRENT__
 
-		if (tail != nullptr) 
-		{
-			tail->m_ptrNext = nodeToMove;
-			nodeToMove->m_ptrPrev = tail;
-			nodeToMove->m_ptrNext = nullptr;
-			tail = nodeToMove;
-		}
-		else 
-		{
-			tail = nodeToMove;
-		}
+		m_ptrStorage->getAllocator().getStats(stats);
 	}
 
-	void interchangeWithTail(std::shared_ptr<Item> currentNode) {
-		if (currentNode == nullptr || currentNode == m_ptrTail) 
-		{
-			return;
-		}
+	// Error if objects in use had to be left dirty, see flushCacheToStorage. bQuiesced only matters under __CONCURRENT__.
+	CacheErrorCode flush(bool bQuiesced = false)
+	{
+		return flushCacheToStorage(bQuiesced) ? CacheErrorCode::Success : CacheErrorCode::Error;
+	}
 
-		if (currentNode->m_ptrPrev) 
-		{
-			currentNode->m_ptrPrev->m_ptrNext = currentNode->m_ptrNext;
-		}
-		else 
-		{
-			m_ptrHead = currentNode->m_ptrNext;
-		}
+#ifdef __CONCURRENT__
+	/*
+	 * Has the background checkpointer write out what was dirtied up to now while the cache stays in use, see
+	 * writeCheckpoint. Returns the epoch of the checkpoint at once.
+	 */
+	size_t checkpoint()
+	{
+		return m_checkpointer.begin(true);
+	}
 
-		if (currentNode->m_ptrNext) 
-		{
-			currentNode->m_ptrNext->m_ptrPrev = currentNode->m_ptrPrev;
-		}
-
-		currentNode->m_ptrPrev = m_ptrTail;
-		currentNode->m_ptrNext = nullptr;
+	void waitForCheckpoint(size_t nEpoch)
+	{
+		m_checkpointer.waitFor(nEpoch);
+	}
 
-		m_ptrTail->m_ptrNext = currentNode;
+	// Objects written per second by the background checkpointer, 0 lifts the limit.
+	void setCheckpointRate(size_t nRate)
+	{
+		m_checkpointer.setRate(nRate);
+	}
 
-		m_ptrTail = currentNode;
+	void getCheckpointProgress(CheckpointProgress& progress)
+	{
+		m_checkpointer.getProgress(progress);
 	}
+#endif __CONCURRENT__
 
-	inline void moveToFront(std::shared_ptr<Item> ptrItem)
+	/*
+	 * Makes uidRoot the root the storage is reopened with, once a flush has written out the objects it refers to. A
+	 * storage that does not outlive the process cannot commit; Error, nothing has been made durable.
+	 */
+	CacheErrorCode commit(const ObjectUIDType& uidRoot, uint32_t nDegree, size_t nHeight, uint64_t nLogSequence)
 	{
-		if (ptrItem == m_ptrHead)
+		if constexpr (requires { m_ptrStorage->commit(uidRoot, nDegree, nHeight, nLogSequence); })
 		{
-			return;
-		}
+#ifdef __CONCURRENT__
+			std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+#endif __CONCURRENT__
 
-		if (ptrItem->m_ptrPrev) 
+			return m_ptrStorage->commit(uidRoot, nDegree, nHeight, nLogSequence);
+		}
+		else
 		{
-			ptrItem->m_ptrPrev->m_ptrNext = ptrItem->m_ptrNext;
+			return CacheErrorCode::Error;
 		}
+	}
 
-		if (ptrItem->m_ptrNext) 
+	CacheErrorCode getCommittedRoot(ObjectUIDType& uidRoot, uint32_t& nDegree, size_t& nHeight, uint64_t& nLogSequence)
+	{
+		if constexpr (requires { m_ptrStorage->getCommittedRoot(uidRoot, nDegree, nHeight, nLogSequence); })
 		{
-			ptrItem->m_ptrNext->m_ptrPrev = ptrItem->m_ptrPrev;
+			return m_ptrStorage->getCommittedRoot(uidRoot, nDegree, nHeight, nLogSequence);
 		}
-
-		if (ptrItem == m_ptrTail) 
+		else
 		{
-			m_ptrTail = ptrItem->m_ptrPrev;
+			return CacheErrorCode::Error;
 		}
+	}
 
-		ptrItem->m_ptrPrev = nullptr;
-		ptrItem->m_ptrNext = m_ptrHead;
+private:
+	inline void charge(const ObjectTypePtr& ptrObject)
+	{
+		ptrObject->footprint = ptrObject->getSize();
+		m_nResidentBytes += ptrObject->footprint;
+	}
 
-		if (m_ptrHead) 
+	// Nodes grow and shrink in place, so the charge is brought up to date whenever an operation reports the object.
+	inline void recharge(const ObjectTypePtr& ptrObject)
+	{
+#ifdef __CONCURRENT__
+		// Skip it if a writer still has it, the next operation that reports it will catch up.
+		if (!ptrObject->mutex.try_lock_shared())
 		{
-			m_ptrHead->m_ptrPrev = ptrItem;
+			return;
 		}
-		m_ptrHead = ptrItem;
+#endif __CONCURRENT__
+
+		size_t nSize = ptrObject->getSize();
+
+#ifdef __CONCURRENT__
+		ptrObject->mutex.unlock_shared();
+#endif __CONCURRENT__
+
+		m_nResidentBytes = m_nResidentBytes + nSize - ptrObject->footprint;
+		ptrObject->footprint = nSize;
 	}
 
-	inline void removeFromLRU(std::shared_ptr<Item> ptrItem)
+	// Under __CONCURRENT__ the caller holds m_mtxCache exclusively.
+	inline bool dropResident(const ObjectUIDType& uidObject)
 	{
-		if (ptrItem->m_ptrPrev != nullptr) 
+		auto it = m_mpObjects.find(uidObject);
+		if (it == m_mpObjects.end())
 		{
-			ptrItem->m_ptrPrev->m_ptrNext = ptrItem->m_ptrNext;
+			return false;
 		}
-		else 
+
+		m_policy.remove(uidObject);
+		m_nResidentBytes -= (*it).second->footprint;
+		(*it).second->epoch++;
+		m_mpObjects.erase(it);
+
+		return true;
+	}
+
+	/*
+	 * The relocation of uidObject has been applied to its parent: nothing refers to the old uid any more and its blocks
+	 * go back to the storage. Threads that applied the same relocation may all get here, only the first finds it.
+	 * Under __CONCURRENT__ the caller holds m_mtxStorage.
+	 */
+	inline void retireUpdatedUID(const ObjectUIDType& uidObject)
+	{
+		if (m_mpUpdatedUIDs.erase(uidObject) > 0)
 		{
-			m_ptrHead = ptrItem->m_ptrNext;
-			if (m_ptrHead != nullptr)
-			{
-				m_ptrHead->m_ptrPrev = nullptr;
-			}
+			m_ptrStorage->remove(uidObject);
 		}
+	}
 
-		if (ptrItem->m_ptrNext != nullptr) 
+	inline void retireUpdatedUIDs(const std::vector<ObjectUIDType>& vtUIDs)
+	{
+		for (const ObjectUIDType& uidObject : vtUIDs)
 		{
-			ptrItem->m_ptrNext->m_ptrPrev = ptrItem->m_ptrPrev;
+			retireUpdatedUID(uidObject);
 		}
-		else 
-		{
-			m_ptrTail = ptrItem->m_ptrPrev;
-			if (m_ptrTail != nullptr)
+	}
+
+#ifdef __CONCURRENT__
+	inline void drainReadBuffer()
+	{
+		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+
+		applyReadBuffer();
+	}
+
+	// The caller holds m_mtxCache exclusively. Objects evicted since they were recorded are skipped.
+	inline void applyReadBuffer()
+	{
+		m_bufReads.drain([this](const ObjectUIDType& uidObject)
 			{
-				m_ptrTail->m_ptrNext = nullptr;
-			}
-		}
+				auto it = m_mpObjects.find(uidObject);
+				if (it != m_mpObjects.end())
+				{
+					m_policy.touch(uidObject);
+					recharge((*it).second);
+				}
+			});
 	}
+#endif __CONCURRENT__
 
-	inline void flushItemsToStorage()
+	/*
+	 * Pinned either explicitly, see ObjectPin, or by a handle an operation still holds besides the one in the map. With
+	 * __CONCURRENT__ that includes the node itself, which getObjectOfType hands out without the object around it; the
+	 * flusher must not evict a node half way through an operation (otherwise eviction only runs between operations).
+	 */
+	static inline bool isPinned(const ObjectTypePtr& ptrObject)
 	{
 #ifdef __CONCURRENT__
+		return ptrObject->isPinned() || ptrObject.use_count() > 1 || ptrObject->isCoreShared();
+#else __CONCURRENT__
+		return ptrObject->isPinned() || ptrObject.use_count() > 1;
+#endif __CONCURRENT__
+	}
+
+	/*
+	 * A parent is not evicted while a child of it is resident and dirty (volatile ones are). The child's relocation is
+	 * then always applied to a resident parent, which flushCacheToStorage writes again; an evicted one would keep
+	 * referring to the old copy in the storage. The children the same pass evicts are no longer in the map.
+	 */
+	inline bool hasResidentDirtyChild(const ObjectTypePtr& ptrObject) const
+	{
+		return ptrObject->anyChild([this](const ObjectUIDType& uidChild)
+			{
+				auto it = m_mpObjects.find(uidChild);
+				return it != m_mpObjects.end() && (*it).second->dirty;
+			});
+	}
+
+	inline bool isOverBudget() const
+	{
+		return m_nHighWatermarkBytes > 0 && m_nResidentBytes > m_nHighWatermarkBytes;
+	}
+
+	inline bool hasToEvict(bool bOverBudget) const
+	{
+		return m_mpObjects.size() > m_nCacheCapacity || (bOverBudget && m_nResidentBytes > m_nLowWatermarkBytes);
+	}
+
+#ifdef __CONCURRENT__
+	/*
+	 * The flusher is woken past either high watermark, the capacity being the one for the object count, and drains the
+	 * cache down to the low ones. The caller holds m_mtxCache.
+	 */
+	inline bool isAboveHighWatermark() const
+	{
+		return m_mpObjects.size() > m_nCacheCapacity || isOverBudget();
+	}
+
+	inline bool isAboveLowWatermark() const
+	{
+		return m_mpObjects.size() > m_nCacheCapacity - m_nCacheCapacity / 8 || (m_nHighWatermarkBytes > 0 && m_nResidentBytes > m_nLowWatermarkBytes);
+	}
+
+	// Twice the bounds: the flusher is not keeping up, the admitting thread waits for it.
+	inline bool isAboveHardLimit() const
+	{
+		return m_mpObjects.size() > 2 * m_nCacheCapacity || (m_nHighWatermarkBytes > 0 && m_nResidentBytes > 2 * m_nHighWatermarkBytes);
+	}
+
+	// Called right after an admission, releases lock_cache.
+	inline void signalFlusher(std::unique_lock<std::shared_mutex>& lock_cache)
+	{
+		bool bHigh = isAboveHighWatermark();
+		bool bHard = isAboveHardLimit();
+
+		lock_cache.unlock();
+
+		m_flusher.admitted(bHigh, bHard);
+	}
+
+	/*
+	 * A pass of the flusher, evicts up to nBatch objects. Returns true while the cache is still above its low watermarks;
+	 * bStalled is set if the pass ran out of objects that are not in use.
+	 */
+	inline bool flushItemsToStorage(size_t nBatch, size_t& nEvicted, bool& bStalled)
+	{
 		std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>> vtObjects;
 
+		std::unique_lock<std::mutex> lock_checkpoint(m_mtxCheckpoint);
 		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
 //std::cout << m_mpObjects.size() << " , ";
-		if (m_mpObjects.size() < m_nCacheCapacity)
-			return;
+		// Bring the policy up to date first, or the victims would be picked on stale recency.
+		applyReadBuffer();
+
+		auto fnIsEvictable = [this](const ObjectUIDType& uidObject)
+			{
+				ObjectTypePtr& ptrObject = m_mpObjects[uidObject];
+
+				if (isPinned(ptrObject) || hasResidentDirtyChild(ptrObject))
+				{
+					m_nPinnedSkips++;
+					return false;
+				}
 
-		size_t nFlushCount = m_mpObjects.size() - m_nCacheCapacity;
+				// Check if the object is in use
+				if (!ptrObject->mutex.try_lock())
+				{
+					m_nPinnedSkips++;
+					return false;
+				}
 
-		if (nFlushCount > FLUSH_COUNT)	//todo: should push all the outstanding orders all together?
-			nFlushCount = FLUSH_COUNT;
+				ptrObject->mutex.unlock();
+				return true;
+			};
 
-		for (size_t idx = 0; idx < nFlushCount; idx++)
+		for (size_t idx = 0; idx < nBatch && isAboveLowWatermark(); idx++)
 		{
-			if (m_ptrTail->m_ptrObject.use_count() > 1)
+			ObjectUIDType uidVictim;
+			if (!m_policy.selectVictim(uidVictim, fnIsEvictable))
 			{
 				/* Info: 
-				 * Should proceed with the preceeding one?
-				 * But since each operation reorders the items at the end, therefore, the prceeding items would be in use as well!
-				 */
-				break; 
-			}
-
-			// Check if the object is in use
-			if (!m_ptrTail->m_ptrObject->mutex.try_lock())
-			{
-				/* Info:
-				 * Should proceed with the preceeding one?
-				 * But since each operation reorders the items at the end, therefore, the prceeding items would be in use as well!
+				 * Nothing left that is not in use.
 				 */
+				m_nEvictionStalls++;
+				bStalled = true;
 				break;
 			}
-			else
-			{
-				m_ptrTail->m_ptrObject->mutex.unlock();
-			}
-
-//std::cout << ptrItemToFlush->m_uidSelf.toString().c_str() << " , ";
-
-			std::shared_ptr<Item> ptrItemToFlush = m_ptrTail;
-
-			vtObjects.push_back(std::make_pair(ptrItemToFlush->m_uidSelf, std::make_pair(std::nullopt, ptrItemToFlush->m_ptrObject)));
 
-			m_mpObjects.erase(ptrItemToFlush->m_uidSelf);
+			auto it = m_mpObjects.find(uidVictim);
 
-			m_ptrTail = ptrItemToFlush->m_ptrPrev;
+			vtObjects.push_back(std::make_pair(uidVictim, std::make_pair(std::nullopt, (*it).second)));
 
-			ptrItemToFlush->m_ptrPrev = nullptr;
-			ptrItemToFlush->m_ptrNext = nullptr;
+			m_nResidentBytes -= (*it).second->footprint;
+			(*it).second->epoch++;
+			m_mpObjects.erase(it);
+		}
 
-			if (m_ptrTail)
-			{
-				m_ptrTail->m_ptrNext = nullptr;
-			}
-			else
-			{
-				m_ptrHead = nullptr;
-			}
+		if (vtObjects.size() == 0)
+		{
+			return isAboveLowWatermark();
 		}
 
+		// prepareFlush drops the clean ones from vtObjects.
+		size_t nVictims = vtObjects.size();
+		nEvicted = nVictims;
+
 		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
 
 		lock_cache.unlock();
 
 		if (m_mpUpdatedUIDs.size() > 0)
 		{
-			m_ptrCallback->applyExistingUpdates(vtObjects, m_mpUpdatedUIDs);
+			std::vector<ObjectUIDType> vtAppliedUIDs;
+			m_ptrCallback->applyExistingUpdates(vtObjects, m_mpUpdatedUIDs, vtAppliedUIDs);
+
+			retireUpdatedUIDs(vtAppliedUIDs);
 		}
 
-		// Important: Ensure that no other thread should write to the stroage as the nPos is use to generate the addresses.
-		size_t nPos = m_ptrStorage->getWritePos();
+		BlockAllocator& allocator = m_ptrStorage->getAllocator();
+		allocator.advance();
 
-		m_ptrCallback->prepareFlush(vtObjects, nPos, m_ptrStorage->getBlockSize(), m_ptrStorage->getMediaType());
+		std::vector<ObjectUIDType> vtAppliedUIDs;
+		m_ptrCallback->prepareFlush(vtObjects, allocator, m_ptrStorage->getBlockSize(), m_ptrStorage->getMediaType(), vtAppliedUIDs);
 
 		auto it = vtObjects.begin();
 		while (it != vtObjects.end())
@@ -714,7 +1060,20 @@ private:
 
 		lock_storage.unlock();
 		
-		m_ptrStorage->addObjects(vtObjects, nPos);
+		m_ptrStorage->addObjects(vtObjects);
+
+		// Reused blocks give uids out again. A thread that lost the race to apply a relocation may have loaded the copy
+		// the old uid named and left it resident (see BPlusStore::fetchNode); it must not turn up under the new uids.
+		lock_cache.lock();
+
+		for (auto& prObject : vtObjects)
+		{
+			dropResident(*prObject.second.first);
+		}
+
+		lock_cache.unlock();
+
+		lock_storage.lock();
 
 		it = vtObjects.begin();
 		while (it != vtObjects.end())
@@ -731,156 +1090,503 @@ private:
 			it++;
 		}
 
+		// The objects whose parents were written in the same batch are reached through the new copies of those only.
+		retireUpdatedUIDs(vtAppliedUIDs);
+
+		lock_storage.unlock();
+
 		cv.notify_all();
 
+		// Ghost entries (2Q, ARC) have to follow the objects to their storage uids to be recognized on reload.
+		lock_cache.lock();
+
+		m_nDirtyEvictions += vtObjects.size();
+		m_nCleanEvictions += nVictims - vtObjects.size();
+
+		it = vtObjects.begin();
+		while (it != vtObjects.end())
+		{
+			m_policy.relocate((*it).first, *(*it).second.first);
+			it++;
+		}
+
 		vtObjects.clear();
-#else
-		while (m_mpObjects.size() > m_nCacheCapacity)
+
+		return isAboveLowWatermark();
+	}
+
+	/*
+	 * Runs the flusher passes until the cache is below its low watermarks, or until everything left is in use.
+	 */
+	inline void drainToLowWatermark()
+	{
+		size_t nPasses = 0;
+		size_t nEvicted = 0;
+		bool bStalled = false;
+		bool bAbove = true;
+
+		while (bAbove && !bStalled)
 		{
-			if (m_ptrTail->m_ptrObject.use_count() > 1)
+			auto tmStart = std::chrono::steady_clock::now();
+
+			nEvicted = 0;
+			bAbove = flushItemsToStorage(m_flusher.getBatchSize(), nEvicted, bStalled);
+			nPasses++;
+
+			m_flusher.completePass(nEvicted, std::chrono::steady_clock::now() - tmStart);
+		}
+
+		m_flusher.completeDrain(nPasses, nEvicted, bStalled);
+	}
+
+	/*
+	 * Writes out the objects due for the checkpoint nEpoch: the dirty ones it has not written yet and that were resident
+	 * before it began, or with bQuiesced, where the caller keeps the tree from changing, all the dirty ones. Each pass
+	 * walks a snapshot of the resident objects in slices, which hold the cache only while they pick the objects and
+	 * while they take them back, not while they are written. Writing a child dirties its parent again, the passes are
+	 * repeated until one writes nothing. A background checkpoint is throttled and gives up once superseded. Returns
+	 * false if due objects in use had to be left dirty, or the checkpoint was superseded.
+	 */
+	inline bool writeCheckpoint(size_t nEpoch, bool bQuiesced, bool bBackground)
+	{
+		bool bWritten = true;
+		size_t nSkipped = 0;
+
+		while (bWritten)
+		{
+			bWritten = false;
+			nSkipped = 0;
+
+			// In the order the policy would evict them, see flushCacheToStorage.
+			std::vector<ObjectUIDType> vtUIDs;
 			{
-				/* Info:
-				 * Should proceed with the preceeding one?
-				 * But since each operation reorders the items at the end, therefore, the prceeding items would be in use as well!
-				 */
-				break;
+				std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+
+				applyReadBuffer();
+
+				vtUIDs.reserve(m_mpObjects.size());
+				m_policy.getResident(vtUIDs);
 			}
 
-			if (m_ptrTail->m_ptrObject->dirty)
+			m_checkpointer.beginPass(nEpoch, vtUIDs.size());
+
+			size_t nCursor = 0;
+			while (nCursor < vtUIDs.size())
 			{
-				if (m_mpUpdatedUIDs.size() > 0)
+				if (bBackground && m_checkpointer.isSuperseded(nEpoch))
 				{
-					m_ptrCallback->applyExistingUpdates(m_ptrTail->m_ptrObject, m_mpUpdatedUIDs);
+					return false;
 				}
 
-				ObjectUIDType uidUpdated;
-				if (m_ptrStorage->addObject(m_ptrTail->m_uidSelf, m_ptrTail->m_ptrObject, uidUpdated) != CacheErrorCode::Success)
+				auto tmStart = std::chrono::steady_clock::now();
+
+				size_t nVisited = nCursor;
+				size_t nWritten = 0;
+
+				bWritten = writeCheckpointSlice(vtUIDs, nCursor, nEpoch, bQuiesced, nWritten, nSkipped) || bWritten;
+
+				m_checkpointer.completeSlice(nEpoch, nCursor - nVisited, nWritten, std::chrono::steady_clock::now() - tmStart, bBackground);
+			}
+		}
+
+		m_checkpointer.complete(nEpoch, nSkipped);
+
+		return nSkipped == 0;
+	}
+
+	/*
+	 * A slice of the checkpoint nEpoch, over the next CHECKPOINT_SLICE uids of vtUIDs from nCursor on. An object not in
+	 * use first takes up the relocations of its children that are complete, as fetchNode would, and is written if it
+	 * is due then and none of its children still has to be. Like an evicted object it leaves the map while it is
+	 * written, a thread that looks it up waits for it (waitForUpdatedUID), and it comes back clean under its new uid.
+	 * Returns true if anything was written.
+	 */
+	inline bool writeCheckpointSlice(const std::vector<ObjectUIDType>& vtUIDs, size_t& nCursor, size_t nEpoch, bool bQuiesced, size_t& nWritten, size_t& nSkipped)
+	{
+		std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>> vtObjects;
+
+		// The uid each of them is listed as relocated under, see below.
+		std::vector<ObjectUIDType> vtListedUIDs;
+
+		std::unique_lock<std::mutex> lock_checkpoint(m_mtxCheckpoint);
+		std::unique_lock<std::shared_mutex> lock_cache(m_mtxCache);
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+
+		// The resident objects still reached through a relocation their parent has not taken up, and its old uid.
+		std::unordered_map<ObjectUIDType, ObjectUIDType> mpTargets;
+		for (const auto& prUpdated : m_mpUpdatedUIDs)
+		{
+			if (prUpdated.second.first != std::nullopt)
+			{
+				mpTargets[*prUpdated.second.first] = prUpdated.first;
+			}
+		}
+
+		auto fnIsRelocated = [this](const ObjectUIDType& uidChild)
+			{
+				return m_mpUpdatedUIDs.find(uidChild) != m_mpUpdatedUIDs.end();
+			};
+
+		auto fnIsInFlight = [this](const ObjectUIDType& uidChild)
+			{
+				auto it = m_mpUpdatedUIDs.find(uidChild);
+				return it != m_mpUpdatedUIDs.end() && (*it).second.first == std::nullopt;
+			};
+
+		auto fnIsDue = [this, nEpoch, bQuiesced, &fnIsRelocated](const ObjectTypePtr& ptrObject)
+			{
+				return (bQuiesced || ptrObject->checkpoint < nEpoch) && (ptrObject->dirty || ptrObject->anyChild(fnIsRelocated));
+			};
+
+		// A parent refers to the copies of its children in the storage, it waits for the ones still to be written.
+		auto fnHoldsBack = [this, &fnIsRelocated, &fnIsDue](const ObjectUIDType& uidChild)
+			{
+				if (fnIsRelocated(uidChild))
 				{
-					throw new std::logic_error("should not occur!");
+					return true;
+				}
+
+				auto it = m_mpObjects.find(uidChild);
+				return it != m_mpObjects.end() && (uidChild.m_uid.m_nMediaType == ObjectUIDType::Volatile || fnIsDue((*it).second));
+			};
+
+		size_t nEnd = std::min(nCursor + CHECKPOINT_SLICE, vtUIDs.size());
+		for (; nCursor < nEnd; nCursor++)
+		{
+			const ObjectUIDType& uidObject = vtUIDs[nCursor];
+
+			// Gone since the snapshot, or written by an earlier slice and back under its new uid.
+			auto it = m_mpObjects.find(uidObject);
+			if (it == m_mpObjects.end())
+			{
+				continue;
+			}
+
+			ObjectTypePtr& ptrObject = (*it).second;
+
+			bool bRelocatedChild = ptrObject->anyChild(fnIsRelocated);
+			if (!ptrObject->dirty && !bRelocatedChild)
+			{
+				continue;
+			}
+
+			if (isPinned(ptrObject) || !ptrObject->mutex.try_lock())
+			{
+				if (fnIsDue(ptrObject))
+				{
+					m_nPinnedSkips++;
+					nSkipped++;
 				}
+				continue;
+			}
+
+			ptrObject->mutex.unlock();
+
+			// Not while a child is being written by this slice, its relocation has no target yet.
+			if (bRelocatedChild && !ptrObject->anyChild(fnIsInFlight))
+			{
+				std::vector<ObjectUIDType> vtAppliedUIDs;
+				m_ptrCallback->applyExistingUpdates(ptrObject, m_mpUpdatedUIDs, vtAppliedUIDs);
 
-				if (m_mpUpdatedUIDs.find(m_ptrTail->m_uidSelf) != m_mpUpdatedUIDs.end())
+				for (const ObjectUIDType& uidApplied : vtAppliedUIDs)
 				{
-					throw new std::logic_error("should not occur!");
+					mpTargets.erase(*m_mpUpdatedUIDs[uidApplied].first);
+				}
+
+				retireUpdatedUIDs(vtAppliedUIDs);
+			}
+
+			if (!ptrObject->dirty || (!bQuiesced && ptrObject->checkpoint >= nEpoch) || ptrObject->anyChild(fnHoldsBack))
+			{
+				continue;
+			}
+
+			ObjectUIDType uidListed = uidObject;
+
+			auto itTarget = mpTargets.find(uidObject);
+			if (itTarget != mpTargets.end())
+			{
+				// A thread may have looked the relocation up and be about to apply it, the object stays where it leads
+				// until it has. With the tree quiesced there is none; the new copy takes over the relocation and the
+				// one in between is dropped.
+				if (!bQuiesced)
+				{
+					continue;
+				}
+
+				uidListed = (*itTarget).second;
+				mpTargets.erase(itTarget);
+			}
+			else if (m_mpUpdatedUIDs.find(uidObject) != m_mpUpdatedUIDs.end())
+			{
+				throw new std::logic_error("should not occur!");
+			}
+
+			// Stays in the policy and charged, the flusher is held off until the slice is done.
+			vtObjects.push_back(std::make_pair(uidObject, std::make_pair(std::nullopt, ptrObject)));
+			vtListedUIDs.push_back(uidListed);
+
+			m_mpUpdatedUIDs[uidListed] = std::make_pair(std::nullopt, ptrObject);
+			m_mpObjects.erase(it);
+		}
+
+		if (vtObjects.size() == 0)
+		{
+			return false;
+		}
+
+		BlockAllocator& allocator = m_ptrStorage->getAllocator();
+		allocator.advance();
+
+		// No parent is picked along with a child of it, nothing is applied within the slice; and none is clean.
+		std::vector<ObjectUIDType> vtAppliedUIDs;
+		m_ptrCallback->prepareFlush(vtObjects, allocator, m_ptrStorage->getBlockSize(), m_ptrStorage->getMediaType(), vtAppliedUIDs);
+
+		if (vtObjects.size() != vtListedUIDs.size())
+		{
+			throw new std::logic_error("should not occur!");
+		}
+
+		lock_storage.unlock();
+		lock_cache.unlock();
+
+		m_ptrStorage->addObjects(vtObjects);
+
+		lock_cache.lock();
+		lock_storage.lock();
+
+		for (size_t idx = 0; idx < vtObjects.size(); idx++)
+		{
+			const ObjectUIDType& uidUpdated = *vtObjects[idx].second.first;
+			const ObjectTypePtr& ptrObject = vtObjects[idx].second.second;
+
+			// See flushItemsToStorage.
+			dropResident(uidUpdated);
+
+			ptrObject->dirty = false;
+			ptrObject->checkpoint = nEpoch;
+			ptrObject->epoch++;
+
+			m_mpObjects[uidUpdated] = ptrObject;
+			m_policy.relocate(vtObjects[idx].first, uidUpdated);
+
+			m_mpUpdatedUIDs[vtListedUIDs[idx]] = std::make_pair(uidUpdated, ptrObject);
+
+			if (vtListedUIDs[idx] != vtObjects[idx].first)
+			{
+				m_ptrStorage->remove(vtObjects[idx].first);
+			}
+		}
+
+		retireUpdatedUIDs(vtAppliedUIDs);
+
+		nWritten = vtObjects.size();
+
+		lock_storage.unlock();
+		lock_cache.unlock();
+
+		cv.notify_all();
+
+		return true;
+	}
+#else __CONCURRENT__
+	inline void flushItemsToStorage()
+	{
+		auto fnIsEvictable = [this](const ObjectUIDType& uidObject)
+			{
+				ObjectTypePtr& ptrObject = m_mpObjects[uidObject];
+
+				if (isPinned(ptrObject) || hasResidentDirtyChild(ptrObject))
+				{
+					m_nPinnedSkips++;
+					return false;
 				}
 
-				m_mpUpdatedUIDs[m_ptrTail->m_uidSelf] = std::make_pair(uidUpdated, m_ptrTail->m_ptrObject);
+				return true;
+			};
+
+		bool bOverBudget = isOverBudget();
+
+		while (hasToEvict(bOverBudget))
+		{
+			ObjectUIDType uidVictim;
+			if (!m_policy.selectVictim(uidVictim, fnIsEvictable))
+			{
+				/* Info:
+				 * Nothing left that is not in use.
+				 */
+				m_nEvictionStalls++;
+				break;
 			}
 
-			m_mpObjects.erase(m_ptrTail->m_uidSelf);
+			auto it = m_mpObjects.find(uidVictim);
 
-			std::shared_ptr<Item> ptrTemp = m_ptrTail;
+			// A clean object that refers to relocated children is written again, its copy has the old uids.
+			if (m_mpUpdatedUIDs.size() > 0)
+			{
+				std::vector<ObjectUIDType> vtAppliedUIDs;
+				m_ptrCallback->applyExistingUpdates((*it).second, m_mpUpdatedUIDs, vtAppliedUIDs);
 
-			m_ptrTail = m_ptrTail->m_ptrPrev;
+				retireUpdatedUIDs(vtAppliedUIDs);
+			}
 
-			if (m_ptrTail)
+			if ((*it).second->dirty)
 			{
-				m_ptrTail->m_ptrNext = nullptr;
+				ObjectUIDType uidUpdated;
+				if (m_ptrStorage->addObject(uidVictim, (*it).second, uidUpdated) != CacheErrorCode::Success)
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				if (m_mpUpdatedUIDs.find(uidVictim) != m_mpUpdatedUIDs.end())
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				m_mpUpdatedUIDs[uidVictim] = std::make_pair(uidUpdated, (*it).second);
+
+				m_policy.relocate(uidVictim, uidUpdated);
+
+				m_nDirtyEvictions++;
 			}
 			else
 			{
-				m_ptrHead = nullptr;
+				m_nCleanEvictions++;
 			}
+
+			m_nResidentBytes -= (*it).second->footprint;
+			(*it).second->epoch++;
+			m_mpObjects.erase(it);
 		}
-#endif __CONCURRENT__
 	}
+#endif __CONCURRENT__
 
-	inline void flushCacheToStorage()
+	/*
+	 * Writes out every dirty object that is not in use. Applying the relocations to their parents dirties those again,
+	 * so the walk is repeated until there is nothing left to write: the copies in the storage then refer to each
+	 * other's current uids, only the relocation of the root is left for the tree to apply. Returns false if objects
+	 * in use, or their parents, had to be left dirty. Under __CONCURRENT__ it is a checkpoint run by the caller, see
+	 * writeCheckpoint; bQuiesced if the caller keeps the tree from changing.
+	 */
+	inline bool flushCacheToStorage(bool bQuiesced = false)
 	{
 #ifdef __CONCURRENT__
-		//The current implementation blocks the whole cache, should not be flush allowed at the node level!
-		//throw new std::logic_error("implementation missing!");
-		return; //fix this
+		return writeCheckpoint(m_checkpointer.begin(false), bQuiesced, false);
 #else __CONCURRENT__
 
-		std::shared_ptr<Item> ptrCurrentTail = m_ptrTail;
-		int i = 0;
 		std::cout << m_mpObjects.size() << std::endl;
 
-		while (ptrCurrentTail)
+		bool bWritten = true;
+		bool bSkipped = false;
+
+		while (bWritten)
 		{
-			//std::cout << i++ << std::endl;
-			if (ptrCurrentTail->m_ptrObject.use_count() > 1)
-			{
-				// Node in use.. technically this should not occur when flush is called.. anyhow abort the operation.. Also handle thsi case properly later!
-				/* Info:
-				 * Should proceed with the preceeding one?
-				 * But since each operation reorders the items at the end, therefore, the prceeding items would be in use as well!
-				 */
-				return;
-			}
+			bWritten = false;
+			bSkipped = false;
+
+			// The map is re-keyed as the objects get their storage uids, so walk a snapshot of the current ones,
+			// in the order the policy would evict them.
+			std::vector<ObjectUIDType> vtUIDs;
+			vtUIDs.reserve(m_mpObjects.size());
+
+			m_policy.getResident(vtUIDs);
 
-			if (ptrCurrentTail->m_ptrObject->dirty)
+			for (const ObjectUIDType& uidObject : vtUIDs)
 			{
+				auto it = m_mpObjects.find(uidObject);
+
+				// Clean ones too, see hasResidentDirtyChild.
 				if (m_mpUpdatedUIDs.size() > 0)
 				{
-					m_ptrCallback->applyExistingUpdates(ptrCurrentTail->m_ptrObject, m_mpUpdatedUIDs);
+					std::vector<ObjectUIDType> vtAppliedUIDs;
+					m_ptrCallback->applyExistingUpdates((*it).second, m_mpUpdatedUIDs, vtAppliedUIDs);
+
+					retireUpdatedUIDs(vtAppliedUIDs);
+				}
+
+				if (!(*it).second->dirty)
+				{
+					continue;
 				}
 
+				if (isPinned((*it).second) || hasResidentDirtyChild((*it).second))
+				{
+					// Stays resident and dirty; written by a later pass once its children are, or by a later eviction
+					// or flush once it is unpinned.
+					m_nPinnedSkips++;
+					bSkipped = true;
+					continue;
+				}
+
+				ObjectTypePtr ptrObject = (*it).second;
+
 				ObjectUIDType uidUpdated;
-				if (m_ptrStorage->addObject(ptrCurrentTail->m_uidSelf, ptrCurrentTail->m_ptrObject, uidUpdated) != CacheErrorCode::Success)
+				if (m_ptrStorage->addObject(uidObject, ptrObject, uidUpdated) != CacheErrorCode::Success)
 				{
 					throw new std::logic_error("should not occur!");
 				}
 
-				if (m_mpUpdatedUIDs.find(ptrCurrentTail->m_uidSelf) != m_mpUpdatedUIDs.end())
+				if (m_mpUpdatedUIDs.find(uidObject) != m_mpUpdatedUIDs.end())
 				{
 					throw new std::logic_error("should not occur!");
 				}
 
-				m_mpUpdatedUIDs[ptrCurrentTail->m_uidSelf] = std::make_pair(uidUpdated, ptrCurrentTail->m_ptrObject);
+				m_mpUpdatedUIDs[uidObject] = std::make_pair(uidUpdated, ptrObject);
 
-				m_mpObjects[uidUpdated] = ptrCurrentTail;
-				m_mpObjects.erase(ptrCurrentTail->m_uidSelf);
-			}
+				// The copy in the storage is current now, a later eviction need not write it again.
+				ptrObject->dirty = false;
+				ptrObject->epoch++;
 
-			//m_mpObjects.erase(m_ptrTail->m_uidSelf);
+				m_mpObjects.erase(uidObject);
+				m_mpObjects[uidUpdated] = ptrObject;
 
-			//std::shared_ptr<Item> ptrTemp = m_ptrTail;
+				m_policy.relocate(uidObject, uidUpdated);
 
-			ptrCurrentTail = ptrCurrentTail->m_ptrPrev;
-
-			//if (m_ptrTail)
-			//{
-			//	m_ptrTail->m_ptrNext = nullptr;
-			//}
-			//else
-			//{
-			//	m_ptrHead = nullptr;
-			//}
+				bWritten = true;
+			}
 		}
+
+		return !bSkipped;
 #endif __CONCURRENT__
 	}
 
 #ifdef __CONCURRENT__
 	static void handlerCacheFlush(SelfType* ptrSelf)
 	{
-		do
+		while (ptrSelf->m_flusher.waitForWork())
 		{
-			ptrSelf->flushItemsToStorage();
-
-			std::this_thread::sleep_for(100ms);
+			ptrSelf->drainToLowWatermark();
+		}
+	}
 
-		} while (!ptrSelf->m_bStop);
+	static void handlerCheckpoint(SelfType* ptrSelf)
+	{
+		size_t nEpoch = 0;
+		while (ptrSelf->m_checkpointer.waitForWork(nEpoch))
+		{
+			ptrSelf->writeCheckpoint(nEpoch, false, true);
+		}
 	}
 #endif __CONCURRENT__
 
 #ifdef __TREE_WITH_CACHE__
 public:
 	void applyExistingUpdates(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
-		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs)
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs
+		, std::vector<ObjectUIDType>& vtAppliedUIDs)
 	{
 
 	}
 
 	void applyExistingUpdates(std::shared_ptr<ObjectType> ptrObject
-		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs)
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs
+		, std::vector<ObjectUIDType>& vtAppliedUIDs)
 	{
 
 	}
 
 	void prepareFlush(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects
-		, size_t& nOffset, size_t nPointerSize, ObjectUIDType::Media nMediaType)
+		, BlockAllocator& allocator, size_t nPointerSize, ObjectUIDType::Media nMediaType, std::vector<ObjectUIDType>& vtAppliedUIDs)
 	{
 
 	}
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <shared_mutex>
 #include <syncstream>
@@ -11,6 +13,7 @@
 #include <fstream>
 
 #include "ErrorCodes.h"
+#include "OptimisticLock.hpp"
 
 template <typename T>
 std::shared_ptr<T> cloneSharedPtr(const std::shared_ptr<T>& source) {
@@ -40,13 +43,22 @@ private:
 
 public:
 	bool dirty;
+	size_t footprint;	// bytes the cache has charged for this object, as of its last getSize()
+	size_t epoch;		// bumped when the object is evicted or relocated, invalidates the swizzled references to it
+	size_t checkpoint;	// of the checkpoint that last wrote the object, or that was under way when it was created or read in
+	std::atomic<uint32_t> pins;	// held by ObjectPin, a pinned object is never picked for eviction
 	CoreTypesWrapperPtr data;
 	mutable std::shared_mutex mutex;
+	mutable OptimisticLock version;
 
 public:
 	template<class Type>
 	LRUCacheObject(std::shared_ptr<Type> ptrCoreObject)
 		: dirty(true)
+		, footprint(0)
+		, epoch(0)
+		, checkpoint(0)
+		, pins(0)
 	{
 		data = std::make_shared<CoreTypesWrapper>(ptrCoreObject);
 	}
@@ -54,22 +66,77 @@ public:
 	//template <typename Type>
 	LRUCacheObject(const LRUCacheObject& source)
 		: dirty(true)
+		, footprint(0)
+		, epoch(0)
+		, checkpoint(0)
+		, pins(0)
 	{
 		data = std::make_shared<CoreTypesWrapper>(cloneVariant(*source.data));
 	}
 
 	LRUCacheObject(std::fstream& is)
 		: dirty(true)
+		, footprint(0)
+		, epoch(0)
+		, checkpoint(0)
+		, pins(0)
 	{
 		CoreTypesMarshaller::template deserialize<CoreTypesWrapper, CoreTypes...>(is, data);
 	}
 
 	LRUCacheObject(const char* szBuffer)
 		: dirty(true)
+		, footprint(0)
+		, epoch(0)
+		, checkpoint(0)
+		, pins(0)
 	{
 		CoreTypesMarshaller::template deserialize<CoreTypesWrapper, CoreTypes...>(szBuffer, data);
 	}
 
+	inline void pin()
+	{
+		pins.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void unpin()
+	{
+		pins.fetch_sub(1, std::memory_order_release);
+	}
+
+	inline bool isPinned() const
+	{
+		return pins.load(std::memory_order_acquire) > 0;
+	}
+
+	// True while someone holds the node itself, as handed out by getObjectOfType, besides this object.
+	inline bool isCoreShared() const
+	{
+		return std::visit([](const auto& ptrCore) { return ptrCore.use_count() > 1; }, *data);
+	}
+
+	// True if fnChild holds for any of the uids the node references; false for the nodes that reference none.
+	template <typename Fn>
+	inline bool anyChild(Fn fnChild) const
+	{
+		return std::visit([&fnChild](const auto& ptrCore)
+			{
+				if constexpr (requires { ptrCore->getChildrenBeginIterator(); })
+				{
+					return std::any_of(ptrCore->getChildrenBeginIterator(), ptrCore->getChildrenEndIterator(), fnChild);
+				}
+				else
+				{
+					return false;
+				}
+			}, *data);
+	}
+
+	inline size_t getSize() const
+	{
+		return std::visit([](const auto& ptrCoreObject) -> size_t { return ptrCoreObject->getSize(); }, *data);
+	}
+
 	inline void serialize(std::fstream& os, uint8_t& uidObjectType, size_t& nBufferSize)
 	{
 		CoreTypesMarshaller::template serialize<CoreTypes...>(os, *data, uidObjectType, nBufferSize);
@@ -79,4 +146,10 @@ public:
 	{
 		CoreTypesMarshaller::template serialize<CoreTypes...>(szBuffer, *data, uidObjectType, nBufferSize);
 	}
+
+	// Into a buffer of the caller's of at least getSize() bytes.
+	inline void serializeTo(char* szBuffer, uint8_t& uidObjectType)
+	{
+		CoreTypesMarshaller::template serializeTo<CoreTypes...>(szBuffer, *data, uidObjectType);
+	}
 };
\ No newline at end of file
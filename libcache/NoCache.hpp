@@ -8,6 +8,8 @@
 #include <typeinfo>
 
 #include "CacheErrorCodes.h"
+#include "CacheStats.h"
+#include "AccessMode.h"
 #include "IFlushCallback.h"
 
 template<typename KeyType, template <typename...> typename ValueType, typename... ValueCoreTypes>
@@ -49,7 +51,7 @@ public:
 	}
 
 	template <typename Type>
-	CacheErrorCode getObjectOfType(ObjectUIDType objKey, Type& ptrObject)
+	CacheErrorCode getObjectOfType(ObjectUIDType objKey, Type& ptrObject, AccessMode nMode)
 	{
 		ObjectTypePtr ptrValue = reinterpret_cast<ObjectTypePtr>(objKey);
 
@@ -62,6 +64,11 @@ public:
 		return CacheErrorCode::Error;
 	}
 
+	CacheErrorCode markDirty(ObjectUIDType objKey)
+	{
+		return CacheErrorCode::Success;
+	}
+
 	template<class Type, typename... ArgsType>
 	CacheErrorCode createObjectOfType(std::optional<ObjectUIDType>& key, ArgsType... args)
 	{
@@ -79,6 +86,15 @@ public:
 		map = 1;
 	}
 
+	void setByteBudget(size_t nHighWatermarkBytes, size_t nLowWatermarkBytes)
+	{
+	}
+
+	void getCacheStats(CacheStats& stats)
+	{
+		stats = CacheStats{};
+	}
+
 	CacheErrorCode reorder(std::vector<std::pair<ObjectUIDType, ObjectTypePtr>>& vt, bool ensure = true)
 	{
 		return CacheErrorCode::Success;
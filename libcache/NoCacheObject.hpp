@@ -8,6 +8,7 @@
 #include <typeinfo>
 
 #include "ErrorCodes.h"
+#include "OptimisticLock.hpp"
 
 template <typename... ValueCoreTypes>
 class NoCacheObject
@@ -21,6 +22,7 @@ public:
 public:
 	CacheValueTypePtr data;
 	mutable std::shared_mutex mutex;
+	mutable OptimisticLock version;
 
 public:
 	NoCacheObject(CacheValueTypePtr ptrValue)
@@ -28,6 +30,20 @@ public:
 		data = ptrValue;
 	}
 
+	// Nothing is ever evicted without a cache, pins are accepted for ObjectPin's sake only.
+	inline void pin()
+	{
+	}
+
+	inline void unpin()
+	{
+	}
+
+	inline bool isPinned() const
+	{
+		return false;
+	}
+
 	template<class Type, typename... ArgsType>
 	static NoCacheObject* createObjectOfType(ArgsType... args)
 	{
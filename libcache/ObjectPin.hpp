@@ -0,0 +1,70 @@
+#pragma once
+#include <utility>
+
+/*
+ * Keeps a cache object resident for as long as the guard lives. The caches pass over a pinned object when they look
+ * for a victim and go on with the next one, so a long-lived pin costs one slot rather than holding up the eviction.
+ * The handles an operation holds while it works on a node pin it implicitly; an ObjectPin is for everything that has
+ * to outlive the operation.
+ */
+template <typename ObjectTypePtr>
+class ObjectPin
+{
+	ObjectTypePtr m_ptrObject;
+
+public:
+	ObjectPin()
+		: m_ptrObject(nullptr)
+	{
+	}
+
+	explicit ObjectPin(const ObjectTypePtr& ptrObject)
+		: m_ptrObject(ptrObject)
+	{
+		if (m_ptrObject != nullptr)
+		{
+			m_ptrObject->pin();
+		}
+	}
+
+	ObjectPin(ObjectPin&& other) noexcept
+		: m_ptrObject(std::move(other.m_ptrObject))
+	{
+		other.m_ptrObject = nullptr;
+	}
+
+	ObjectPin& operator=(ObjectPin&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+
+			m_ptrObject = std::move(other.m_ptrObject);
+			other.m_ptrObject = nullptr;
+		}
+
+		return *this;
+	}
+
+	ObjectPin(const ObjectPin&) = delete;
+	ObjectPin& operator=(const ObjectPin&) = delete;
+
+	~ObjectPin()
+	{
+		release();
+	}
+
+	void release()
+	{
+		if (m_ptrObject != nullptr)
+		{
+			m_ptrObject->unpin();
+			m_ptrObject = nullptr;
+		}
+	}
+
+	inline const ObjectTypePtr& get() const
+	{
+		return m_ptrObject;
+	}
+};
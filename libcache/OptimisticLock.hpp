@@ -0,0 +1,259 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+/*
+ * Version latch for optimistic lock coupling.
+ *
+ * A reader takes a snapshot of the version, reads the object without locking it and validates the snapshot
+ * afterwards, so it never writes to the cache line of the object. A writer sets the lock bit and bumps the
+ * version on unlock, which makes every reader that overlapped with the write restart.
+ *
+ * Bit 0 is the lock bit and the remaining bits hold the version; unlocking adds one to the locked value, which
+ * clears the bit and carries into the version. Nodes are never marked obsolete here since the operations that
+ * free nodes close the OptimisticGate first.
+ */
+class OptimisticLock
+{
+private:
+	static const uint64_t LOCKED = 0b1;
+
+	std::atomic<uint64_t> m_nVersion;
+
+public:
+	OptimisticLock()
+		: m_nVersion(0)
+	{
+	}
+
+	/*
+	 * Takes a snapshot of the version. Returns false (and the caller restarts) if a writer holds the lock.
+	 */
+	inline bool readLock(uint64_t& nVersion) const
+	{
+		nVersion = m_nVersion.load(std::memory_order_acquire);
+		return (nVersion & LOCKED) == 0;
+	}
+
+	/*
+	 * Returns true if nothing has been written to the object since nVersion was taken.
+	 */
+	inline bool validate(uint64_t nVersion) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return m_nVersion.load(std::memory_order_relaxed) == nVersion;
+	}
+
+	/*
+	 * Turns the snapshot into the lock; fails if the version has moved since nVersion was taken.
+	 */
+	inline bool tryUpgrade(uint64_t nVersion)
+	{
+		return m_nVersion.compare_exchange_strong(nVersion, nVersion | LOCKED, std::memory_order_acquire);
+	}
+
+	inline void lock()
+	{
+		uint64_t nVersion = m_nVersion.load(std::memory_order_relaxed);
+		while ((nVersion & LOCKED) != 0 || !m_nVersion.compare_exchange_weak(nVersion, nVersion | LOCKED, std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+			nVersion = m_nVersion.load(std::memory_order_relaxed);
+		}
+	}
+
+	/*
+	 * Releases the lock and moves to the next version.
+	 */
+	inline void unlock()
+	{
+		m_nVersion.fetch_add(LOCKED, std::memory_order_release);
+	}
+
+	/*
+	 * Releases the lock and restores the version it was taken at; only valid when the object was not modified.
+	 */
+	inline void unlockUnchanged()
+	{
+		m_nVersion.fetch_sub(LOCKED, std::memory_order_release);
+	}
+};
+
+/*
+ * Exclusive lock taken by the pessimistic writers: the mutex keeps out the other pessimistic paths and the
+ * lock bit of the version keeps out the optimistic ones. If the object was not modified (setModified was not
+ * called) the old version is put back on release, so readers that went through it are not restarted.
+ */
+template <typename MutexType>
+class ExclusiveLock
+{
+private:
+	MutexType* m_ptrMutex;
+	OptimisticLock* m_ptrVersion;
+	bool m_bModified;
+
+public:
+	ExclusiveLock(MutexType& mutex, OptimisticLock& version)
+		: m_ptrMutex(&mutex)
+		, m_ptrVersion(&version)
+		, m_bModified(false)
+	{
+		m_ptrMutex->lock();
+		m_ptrVersion->lock();
+	}
+
+	ExclusiveLock(ExclusiveLock&& source) noexcept
+		: m_ptrMutex(source.m_ptrMutex)
+		, m_ptrVersion(source.m_ptrVersion)
+		, m_bModified(source.m_bModified)
+	{
+		source.m_ptrMutex = nullptr;
+	}
+
+	ExclusiveLock& operator=(ExclusiveLock&& source) noexcept
+	{
+		if (this != &source)
+		{
+			release();
+
+			m_ptrMutex = source.m_ptrMutex;
+			m_ptrVersion = source.m_ptrVersion;
+			m_bModified = source.m_bModified;
+
+			source.m_ptrMutex = nullptr;
+		}
+
+		return *this;
+	}
+
+	ExclusiveLock(const ExclusiveLock&) = delete;
+	ExclusiveLock& operator=(const ExclusiveLock&) = delete;
+
+	~ExclusiveLock()
+	{
+		release();
+	}
+
+	inline void setModified()
+	{
+		m_bModified = true;
+	}
+
+private:
+	inline void release()
+	{
+		if (m_ptrMutex == nullptr)
+		{
+			return;
+		}
+
+		if (m_bModified)
+		{
+			m_ptrVersion->unlock();
+		}
+		else
+		{
+			m_ptrVersion->unlockUnchanged();
+		}
+
+		m_ptrMutex->unlock();
+		m_ptrMutex = nullptr;
+	}
+};
+
+/*
+ * Keeps the optimistic operations away from nodes that are being freed. An operation announces itself in a
+ * per-thread slot (each on its own cache line, so the readers do not contend), and an operation that releases
+ * nodes closes the gate and waits for the slots to drain before it starts.
+ */
+class OptimisticGate
+{
+private:
+	static const size_t SLOTS = 64;
+
+	struct alignas(64) Slot
+	{
+		std::atomic<uint32_t> m_nActive{ 0 };
+	};
+
+	Slot m_arrSlots[SLOTS];
+	alignas(64) std::atomic<uint32_t> m_nClosed{ 0 };
+
+public:
+	inline void enter()
+	{
+		Slot& slot = m_arrSlots[getSlot()];
+
+		while (true)
+		{
+			slot.m_nActive.fetch_add(1, std::memory_order_seq_cst);
+			if (m_nClosed.load(std::memory_order_seq_cst) == 0)
+			{
+				return;
+			}
+
+			slot.m_nActive.fetch_sub(1, std::memory_order_release);
+			while (m_nClosed.load(std::memory_order_acquire) != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	inline void leave()
+	{
+		m_arrSlots[getSlot()].m_nActive.fetch_sub(1, std::memory_order_release);
+	}
+
+	inline void close()
+	{
+		m_nClosed.fetch_add(1, std::memory_order_seq_cst);
+
+		for (size_t nIdx = 0; nIdx < SLOTS; nIdx++)
+		{
+			while (m_arrSlots[nIdx].m_nActive.load(std::memory_order_seq_cst) != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	inline void open()
+	{
+		m_nClosed.fetch_sub(1, std::memory_order_release);
+	}
+
+private:
+	static inline size_t getSlot()
+	{
+		static std::atomic<size_t> s_nNextSlot{ 0 };
+		thread_local size_t nSlot = s_nNextSlot.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+
+		return nSlot;
+	}
+};
+
+/*
+ * Keeps an OptimisticGate closed for its lifetime.
+ */
+class ClosedGate
+{
+private:
+	OptimisticGate& m_gate;
+
+public:
+	ClosedGate(OptimisticGate& gate)
+		: m_gate(gate)
+	{
+		m_gate.close();
+	}
+
+	~ClosedGate()
+	{
+		m_gate.open();
+	}
+
+	ClosedGate(const ClosedGate&) = delete;
+	ClosedGate& operator=(const ClosedGate&) = delete;
+};
@@ -9,6 +9,8 @@
 #include <cmath>
 #include <libpmem.h>
 
+#include "BlockAllocator.hpp"
+
 bool createMMapFile(void*& hMemory, const char* szPath, size_t nFileSize, size_t& nMappedLen, int& bIsPMem)
 {
 	if ((hMemory = pmem_map_file(szPath,
@@ -84,13 +86,11 @@ private:
 	size_t nMappedLen;
 	void* hMemory = NULL;
 
-	size_t m_nNextBlock;
-
 	size_t m_nBlockSize;
 	size_t m_nStorageSize;
 	std::string m_stFilename;
 
-	std::vector<bool> m_vtAllocationTable;
+	BlockAllocator m_allocator;
 
 	ICallback* m_ptrCallback;
 
@@ -121,7 +121,7 @@ public:
 		: m_nStorageSize(nStorageSize)
 		, m_nBlockSize(nBlockSize)
 		, m_stFilename(stFilename)
-		, m_nNextBlock(0)
+		, m_allocator(nStorageSize / nBlockSize)
 		, nMappedLen(0)		
 		, hMemory (nullptr)
 		, m_ptrCallback(NULL)
@@ -148,8 +148,6 @@ public:
 			throw new std::logic_error("Size mismatch!"); // TODO: critical log.
 		}
 
-		m_vtAllocationTable.resize(nStorageSize / nBlockSize, false);
-
 #ifdef __CONCURRENT__
 		m_bStopFlush = false;
 		//m_threadBatchFlush = std::thread(handlerBatchFlush, this);
@@ -192,9 +190,16 @@ public:
 		return ptrObject;
 	}
 
-	CacheErrorCode remove(const ObjectUIDType& ptrKey)
+	// See FileStorage::remove.
+	CacheErrorCode remove(const ObjectUIDType& uidObject)
 	{
-		//throw new std::logic_error("no implementation!");
+		if (uidObject.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Success;
+		}
+
+		m_allocator.deallocate(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset / m_nBlockSize, std::ceil(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize / (float)m_nBlockSize));
+
 		return CacheErrorCode::Success;
 	}
 
@@ -206,12 +211,17 @@ public:
 		char* szBuffer = NULL; //2
 		ptrObject->serialize(szBuffer, uidObjectType, nBufferSize); //2
 
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
+		size_t nRequiredBlocks = std::ceil((nBufferSize + sizeof(uint8_t)) / (float)m_nBlockSize);
+
+		size_t nBlock = 0;
+		if (m_allocator.allocate(nRequiredBlocks, nBlock) != CacheErrorCode::Success)
+		{
+			delete[] szBuffer;
+			return CacheErrorCode::Error;
+		}
 
-		// memcpy(m_szStorage + (m_nNextBlock * m_nBlockSize), szBuffer, nBufferSize);
-		if(!writeMMapFile(hMemory + ( m_nNextBlock * m_nBlockSize  ), szBuffer, nBufferSize))
+		// memcpy(m_szStorage + (nBlock * m_nBlockSize), szBuffer, nBufferSize);
+		if(!writeMMapFile(hMemory + ( nBlock * m_nBlockSize  ), szBuffer, nBufferSize))
 		{
 			throw new std::logic_error("failed to write data!");
 		}
@@ -223,27 +233,21 @@ public:
 		//m_fsStorage.write(szBuffer, nBufferSize); //2
 		//m_fsStorage.flush();
 
-		size_t nRequiredBlocks = std::ceil((nBufferSize + sizeof(uint8_t)) / (float)m_nBlockSize);
-
-#ifdef __CONCURRENT__
-		lock_file_storage.unlock();
-#endif __CONCURRENT__
-
 		delete[] szBuffer; //2
 
-		uidUpdated = ObjectUIDType::createAddressFromFileOffset(m_nNextBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
-
-		for (int idx = 0; idx < nRequiredBlocks; idx++)
-		{
-			m_vtAllocationTable[m_nNextBlock++] = true;
-		}
+		uidUpdated = ObjectUIDType::createAddressFromFileOffset(nBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
 
 		return CacheErrorCode::Success;
 	}
 
 	inline size_t getWritePos()
 	{
-		return m_nNextBlock;
+		return m_allocator.getFrontier();
+	}
+
+	inline BlockAllocator& getAllocator()
+	{
+		return m_allocator;
 	}
 
 	inline size_t getBlockSize()
@@ -256,13 +260,8 @@ public:
 		return ObjectUIDType::DRAM;
 	}
 
-	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects, size_t nNewOffset)
+	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects)
 	{
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
-
-		m_nNextBlock = nNewOffset;
 
 		auto it = vtObjects.begin();
 		while (it != vtObjects.end())
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+/*
+ * Lossy record of cache hits, split into per-thread stripes (each on its own cache line), in the manner of
+ * Caffeine's read buffers. A hit only appends the uid to the stripe of the calling thread; the replacement policy
+ * catches up later, in batches, under the exclusive cache lock. A hit that finds its stripe busy or full is
+ * dropped: recency is a hint, and losing a part of it under contention is cheaper than serializing every reader
+ * on the policy.
+ */
+template <typename KeyType, size_t STRIPES = 16, size_t STRIPE_SIZE = 32>
+class ReadBuffer
+{
+private:
+	struct alignas(64) Stripe
+	{
+		std::mutex m_mtxStripe;
+		size_t m_nCount = 0;
+		std::array<KeyType, STRIPE_SIZE> m_arrKeys;
+	};
+
+	std::array<Stripe, STRIPES> m_arrStripes;
+
+public:
+	/*
+	 * Returns false once the stripe of the calling thread is full, which is the cue to drain the buffer.
+	 */
+	inline bool record(const KeyType& key)
+	{
+		Stripe& stripe = m_arrStripes[getStripe()];
+
+		std::unique_lock<std::mutex> lock_stripe(stripe.m_mtxStripe, std::try_to_lock);
+		if (!lock_stripe.owns_lock())
+		{
+			return true;
+		}
+
+		if (stripe.m_nCount == STRIPE_SIZE)
+		{
+			return false;
+		}
+
+		stripe.m_arrKeys[stripe.m_nCount++] = key;
+
+		return stripe.m_nCount < STRIPE_SIZE;
+	}
+
+	/*
+	 * Records the keys fnKey yields for [itBegin, itEnd) in one piece, or none of them. A batch carries an order the
+	 * caller depends on (see LRUCache::reorder), so unlike a single hit it is never partly dropped; false means the
+	 * caller has to apply it itself.
+	 */
+	template <typename Iterator, typename Key>
+	inline bool recordAll(Iterator itBegin, Iterator itEnd, Key fnKey)
+	{
+		Stripe& stripe = m_arrStripes[getStripe()];
+
+		std::unique_lock<std::mutex> lock_stripe(stripe.m_mtxStripe, std::try_to_lock);
+		if (!lock_stripe.owns_lock())
+		{
+			return false;
+		}
+
+		if (stripe.m_nCount + std::distance(itBegin, itEnd) > STRIPE_SIZE)
+		{
+			return false;
+		}
+
+		for (Iterator it = itBegin; it != itEnd; it++)
+		{
+			stripe.m_arrKeys[stripe.m_nCount++] = fnKey(*it);
+		}
+
+		return true;
+	}
+
+	/*
+	 * Hands the recorded uids to fnApply, oldest first within a stripe, and empties the buffer.
+	 */
+	template <typename Apply>
+	inline void drain(Apply fnApply)
+	{
+		for (Stripe& stripe : m_arrStripes)
+		{
+			std::unique_lock<std::mutex> lock_stripe(stripe.m_mtxStripe);
+
+			for (size_t idx = 0; idx < stripe.m_nCount; idx++)
+			{
+				fnApply(stripe.m_arrKeys[idx]);
+			}
+
+			stripe.m_nCount = 0;
+		}
+	}
+
+private:
+	static inline size_t getStripe()
+	{
+		static std::atomic<size_t> s_nNextStripe{ 0 };
+		thread_local size_t nStripe = s_nNextStripe.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+
+		return nStripe;
+	}
+};
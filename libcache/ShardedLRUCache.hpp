@@ -0,0 +1,1247 @@
+#pragma once
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <variant>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <tuple>
+#include <condition_variable>
+
+#include "IFlushCallback.h"
+#include "VariadicNthType.h"
+#include "EvictionPolicy.hpp"
+#include "CacheStats.h"
+#include "AccessMode.h"
+#include "ObjectPin.hpp"
+#include "ReadBuffer.hpp"
+#include "FlushScheduler.hpp"
+#include "SingleFlight.hpp"
+
+#define FLUSH_COUNT 100
+#define CACHE_SHARD_COUNT 8
+
+using namespace std::chrono_literals;
+
+/*
+ * Drop-in replacement for LRUCache that splits the cache into shards keyed by the hash of ObjectUIDType.
+ * Each shard owns its map, LRU list, lock and a slice of the capacity, so lookups on different shards do not
+ * contend on a single mutex. The storage and the relocated UIDs map stay shared (guarded by m_mtxStorage), a
+ * relocation is applied by the parent on whichever shard that is.
+ * Every shard runs its own instance of the replacement policy over its slice of the capacity.
+ */
+template <typename ICallback, typename StorageType, typename EvictionPolicyType = LRUPolicy<typename StorageType::ObjectUIDType>>
+class ShardedLRUCache : public ICallback
+{
+	typedef ShardedLRUCache<ICallback, StorageType, EvictionPolicyType> SelfType;
+
+public:
+	typedef StorageType::ObjectUIDType ObjectUIDType;
+	typedef StorageType::ObjectType ObjectType;
+	typedef std::shared_ptr<ObjectType> ObjectTypePtr;
+
+private:
+	struct Shard
+	{
+	public:
+		size_t m_nCapacity;
+		std::unordered_map<ObjectUIDType, ObjectTypePtr> m_mpObjects;
+
+		// The byte budget is split evenly over the shards, like the capacity.
+		size_t m_nHighWatermarkBytes;
+		size_t m_nLowWatermarkBytes;
+		size_t m_nResidentBytes;
+
+		size_t m_nDirtyEvictions;
+		size_t m_nCleanEvictions;
+		size_t m_nPinnedSkips;
+		size_t m_nEvictionStalls;
+
+		EvictionPolicyType m_policy;
+
+#ifdef __CONCURRENT__
+		mutable std::shared_mutex m_mtxShard;
+
+		// Hits are recorded here under the shared m_mtxShard and applied to m_policy in batches.
+		ReadBuffer<ObjectUIDType> m_bufReads;
+#endif __CONCURRENT__
+
+		Shard(size_t nCapacity)
+			: m_nCapacity(nCapacity)
+			, m_nHighWatermarkBytes(0)
+			, m_nLowWatermarkBytes(0)
+			, m_nResidentBytes(0)
+			, m_nDirtyEvictions(0)
+			, m_nCleanEvictions(0)
+			, m_nPinnedSkips(0)
+			, m_nEvictionStalls(0)
+			, m_policy(nCapacity)
+		{
+			m_mpObjects.reserve(nCapacity + FLUSH_COUNT);
+		}
+
+		~Shard()
+		{
+			m_mpObjects.clear();
+		}
+
+		inline void charge(const ObjectTypePtr& ptrObject)
+		{
+			ptrObject->footprint = ptrObject->getSize();
+			m_nResidentBytes += ptrObject->footprint;
+		}
+
+		// Nodes grow and shrink in place, so the charge is brought up to date whenever an operation reports the object.
+		inline void recharge(const ObjectTypePtr& ptrObject)
+		{
+#ifdef __CONCURRENT__
+			// Skip it if a writer still has it, the next operation that reports it will catch up.
+			if (!ptrObject->mutex.try_lock_shared())
+			{
+				return;
+			}
+#endif __CONCURRENT__
+
+			size_t nSize = ptrObject->getSize();
+
+#ifdef __CONCURRENT__
+			ptrObject->mutex.unlock_shared();
+#endif __CONCURRENT__
+
+			m_nResidentBytes = m_nResidentBytes + nSize - ptrObject->footprint;
+			ptrObject->footprint = nSize;
+		}
+
+		// Under __CONCURRENT__ the caller holds m_mtxShard exclusively.
+		inline bool dropResident(const ObjectUIDType& uidObject)
+		{
+			auto it = m_mpObjects.find(uidObject);
+			if (it == m_mpObjects.end())
+			{
+				return false;
+			}
+
+			m_policy.remove(uidObject);
+			m_nResidentBytes -= (*it).second->footprint;
+			(*it).second->epoch++;
+			m_mpObjects.erase(it);
+
+			return true;
+		}
+
+#ifdef __CONCURRENT__
+		// The caller holds m_mtxShard exclusively. Objects evicted since they were recorded are skipped.
+		inline void applyReadBuffer()
+		{
+			m_bufReads.drain([this](const ObjectUIDType& uidObject)
+				{
+					auto it = m_mpObjects.find(uidObject);
+					if (it != m_mpObjects.end())
+					{
+						m_policy.touch(uidObject);
+						recharge((*it).second);
+					}
+				});
+		}
+
+		inline void drainReadBuffer()
+		{
+			std::unique_lock<std::shared_mutex> lock_shard(m_mtxShard);
+
+			applyReadBuffer();
+		}
+#endif __CONCURRENT__
+
+		inline bool isOverBudget() const
+		{
+			return m_nHighWatermarkBytes > 0 && m_nResidentBytes > m_nHighWatermarkBytes;
+		}
+
+		inline bool hasToEvict(bool bOverBudget) const
+		{
+			return m_mpObjects.size() > m_nCapacity || (bOverBudget && m_nResidentBytes > m_nLowWatermarkBytes);
+		}
+
+#ifdef __CONCURRENT__
+		// See LRUCache::isAboveHighWatermark; the caller holds m_mtxShard.
+		inline bool isAboveHighWatermark() const
+		{
+			return m_mpObjects.size() > m_nCapacity || isOverBudget();
+		}
+
+		inline bool isAboveLowWatermark() const
+		{
+			return m_mpObjects.size() > m_nCapacity - m_nCapacity / 8 || (m_nHighWatermarkBytes > 0 && m_nResidentBytes > m_nLowWatermarkBytes);
+		}
+
+		inline bool isAboveHardLimit() const
+		{
+			return m_mpObjects.size() > 2 * m_nCapacity || (m_nHighWatermarkBytes > 0 && m_nResidentBytes > 2 * m_nHighWatermarkBytes);
+		}
+#endif __CONCURRENT__
+	};
+
+	ICallback* m_ptrCallback;
+
+	std::vector<std::unique_ptr<Shard>> m_vtShards;
+
+	std::unique_ptr<StorageType> m_ptrStorage;
+
+	size_t m_nCacheCapacity;
+
+	std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, ObjectTypePtr>> m_mpUpdatedUIDs;
+
+#ifdef __CONCURRENT__
+	FlushScheduler<FLUSH_COUNT, FLUSH_COUNT * 16> m_flusher;
+
+	SingleFlight<ObjectUIDType, ObjectTypePtr> m_loads;
+
+	std::thread m_threadCacheFlush;
+
+	std::condition_variable_any cv;
+
+	mutable std::shared_mutex m_mtxStorage;
+#endif __CONCURRENT__
+
+public:
+	~ShardedLRUCache()
+	{
+#ifdef __CONCURRENT__
+		m_flusher.stop();
+		m_threadCacheFlush.join();
+#endif __CONCURRENT__
+
+		m_vtShards.clear();
+		m_ptrStorage = nullptr;
+	}
+
+	template <typename... StorageArgs>
+	ShardedLRUCache(size_t nCapacity, StorageArgs... args)
+		: m_nCacheCapacity(nCapacity)
+	{
+		// Each shard should be able to hold at least a handful of items, otherwise a single descent evicts its own path.
+		size_t nShards = std::clamp<size_t>(nCapacity / 8, 1, CACHE_SHARD_COUNT);
+
+		for (size_t idx = 0; idx < nShards; idx++)
+		{
+			m_vtShards.push_back(std::make_unique<Shard>(nCapacity / nShards + (idx < nCapacity % nShards ? 1 : 0)));
+		}
+
+		m_ptrStorage = std::make_unique<StorageType>(args...);
+
+#ifdef __CONCURRENT__
+		m_threadCacheFlush = std::thread(handlerCacheFlush, this);
+#endif __CONCURRENT__
+	}
+
+	template <typename... InitArgs>
+	CacheErrorCode init(ICallback* ptrCallback, InitArgs... args)
+	{
+		m_ptrCallback = ptrCallback;
+		return m_ptrStorage->init(this/*getNthElement<0>(args...)*/);
+	}
+
+	// See LRUCache::remove. The object under the new uid may be on another shard, the locks are taken one at a time.
+	CacheErrorCode remove(const ObjectUIDType& uidObject)
+	{
+		CacheErrorCode errCode = CacheErrorCode::Error;
+
+		std::optional<ObjectUIDType> uidRelocated = std::nullopt;
+
+		{
+#ifdef __CONCURRENT__
+			std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+#endif __CONCURRENT__
+
+			auto itUpdated = m_mpUpdatedUIDs.find(uidObject);
+			if (itUpdated != m_mpUpdatedUIDs.end() && (*itUpdated).second.first != std::nullopt)
+			{
+				uidRelocated = (*itUpdated).second.first;
+				m_mpUpdatedUIDs.erase(itUpdated);
+			}
+		}
+
+		if (dropResident(uidObject))
+		{
+			errCode = CacheErrorCode::Success;
+		}
+
+		m_ptrStorage->remove(uidObject);
+
+		if (uidRelocated != std::nullopt)
+		{
+			if (dropResident(*uidRelocated))
+			{
+				errCode = CacheErrorCode::Success;
+			}
+
+			m_ptrStorage->remove(*uidRelocated);
+		}
+
+		return errCode;
+	}
+
+	CacheErrorCode getObject(const ObjectUIDType uidObject, ObjectTypePtr& ptrObject, std::optional<ObjectUIDType>& uidUpdated)
+	{
+		ptrObject = lookup(uidObject);
+		if (ptrObject != nullptr)
+		{
+			return CacheErrorCode::Success;
+		}
+
+		ObjectUIDType _uidUpdated = uidObject;
+		if (!resolveUpdatedUID(uidObject, _uidUpdated, uidUpdated, false))
+		{
+			ptrObject = nullptr;
+			return CacheErrorCode::Error;
+		}
+
+#ifdef __CONCURRENT__
+		// See LRUCache::getObject.
+		if (_uidUpdated.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			ptrObject = nullptr;
+			return CacheErrorCode::Error;
+		}
+#endif __CONCURRENT__
+
+		ptrObject = loadObject(_uidUpdated);
+		if (ptrObject == nullptr)
+		{
+			return CacheErrorCode::Error;
+		}
+
+		return CacheErrorCode::Success;
+	}
+
+	CacheErrorCode reorder(std::vector<std::pair<ObjectUIDType, ObjectTypePtr>>& vt, bool ensure = true)
+	{
+		// Items are bucketed per shard so that each shard lock is taken once; the relative order within a shard is
+		// kept, which is the only order that matters for that shard's eviction.
+		std::vector<std::vector<ObjectUIDType>> vtPerShard(m_vtShards.size());
+
+		while (vt.size() > 0)
+		{
+			vtPerShard[getShardIndex(vt.back().first)].push_back(vt.back().first);
+			vt.pop_back();
+		}
+
+		for (size_t idx = 0; idx < vtPerShard.size(); idx++)
+		{
+			if (vtPerShard[idx].size() == 0)
+			{
+				continue;
+			}
+
+			Shard& shard = *m_vtShards[idx];
+
+#ifdef __CONCURRENT__
+			// Recorded like the hits, see lookup; in one piece or not at all, as in LRUCache::reorder.
+			if (shard.m_bufReads.recordAll(vtPerShard[idx].begin(), vtPerShard[idx].end(), [](const ObjectUIDType& uidObject) { return uidObject; }))
+			{
+				continue;
+			}
+
+			std::unique_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+
+			shard.applyReadBuffer();
+#endif __CONCURRENT__
+
+			auto it = vtPerShard[idx].begin();
+			while (it != vtPerShard[idx].end())
+			{
+				auto itObject = shard.m_mpObjects.find(*it);
+				if (itObject != shard.m_mpObjects.end())
+				{
+					shard.m_policy.touch(*it);
+					shard.recharge((*itObject).second);
+				}
+				else
+				{
+#ifdef __CONCURRENT__
+					// The flusher runs on its own thread and may already have written out an object the operation created
+					// but does not hold (a split sibling); the parent picks its new uid up from m_mpUpdatedUIDs.
+#else __CONCURRENT__
+					if (ensure)
+					{
+						throw new std::logic_error("should not occur!");
+					}
+#endif __CONCURRENT__
+				}
+				it++;
+			}
+		}
+
+#ifndef __CONCURRENT__
+		// Eviction is held back until the operation has reported everything it touched; an object it created but
+		// does not hold (a split sibling) must not be evicted half way, whatever the policy thinks of it.
+		for (auto& ptrShard : m_vtShards)
+		{
+			flushItemsToStorage(*ptrShard);
+		}
+#endif __CONCURRENT__
+
+		return CacheErrorCode::Success;
+	}
+
+	template <typename Type>
+	CacheErrorCode getObjectOfType(const ObjectUIDType key, Type& ptrObject, std::optional<ObjectUIDType>& uidUpdated, AccessMode nMode)
+	{
+		ObjectTypePtr ptrValue = lookup(key);
+		if (ptrValue == nullptr)
+		{
+			ObjectUIDType _uidUpdated = key;
+			if (!resolveUpdatedUID(key, _uidUpdated, uidUpdated, true))
+			{
+				return CacheErrorCode::Error;
+			}
+
+#ifdef __CONCURRENT__
+			// See LRUCache::getObject.
+			if (_uidUpdated.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+			{
+				return CacheErrorCode::Error;
+			}
+#endif __CONCURRENT__
+
+			ptrValue = loadObject(_uidUpdated);
+			if (ptrValue == nullptr)
+			{
+				return CacheErrorCode::Error;
+			}
+		}
+
+		if (nMode == AccessMode::Write)
+		{
+			ptrValue->dirty = true;
+		}
+
+		if (std::holds_alternative<Type>(*ptrValue->data))
+		{
+			ptrObject = std::get<Type>(*ptrValue->data);
+			return CacheErrorCode::Success;
+		}
+
+		return CacheErrorCode::Error;
+	}
+
+#ifdef __CONCURRENT__
+	// See LRUCache::dropUpdatedUID.
+	CacheErrorCode dropUpdatedUID(const ObjectUIDType& uidObject)
+	{
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+
+		retireUpdatedUID(uidObject);
+
+		return CacheErrorCode::Success;
+	}
+#endif __CONCURRENT__
+
+	// See LRUCache::markDirty.
+	CacheErrorCode markDirty(const ObjectUIDType& uidObject)
+	{
+		Shard& shard = getShard(uidObject);
+
+#ifdef __CONCURRENT__
+		std::shared_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+#endif __CONCURRENT__
+
+		auto it = shard.m_mpObjects.find(uidObject);
+		if (it == shard.m_mpObjects.end())
+		{
+			return CacheErrorCode::KeyDoesNotExist;
+		}
+
+		(*it).second->dirty = true;
+
+		return CacheErrorCode::Success;
+	}
+
+	template<class Type, typename... ArgsType>
+	CacheErrorCode createObjectOfType(std::optional<ObjectUIDType>& uidObject, const ArgsType... args)
+	{
+		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(std::make_shared<Type>(args...));
+
+		uidObject = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
+
+		place(*uidObject, ptrObject);
+
+		return CacheErrorCode::Success;
+	}
+
+	template<class Type, typename... ArgsType>
+	CacheErrorCode createObjectOfType(std::optional<ObjectUIDType>& uidObject, std::shared_ptr<Type>& ptrCoreObject, const ArgsType... args)
+	{
+		ptrCoreObject = std::make_shared<Type>(args...);
+
+		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(ptrCoreObject);
+
+		uidObject = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
+
+		place(*uidObject, ptrObject);
+
+		return CacheErrorCode::Success;
+	}
+
+	/*
+	 * Creates the object and writes it straight to the storage without admitting it to the cache.
+	 * Used by the bulk loader so that finished nodes land in sequential blocks instead of going through eviction.
+	 */
+	template<class Type, typename... ArgsType>
+	CacheErrorCode createObjectOfTypeInStorage(std::optional<ObjectUIDType>& uidObject, const ArgsType... args)
+	{
+		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(std::make_shared<Type>(args...));
+
+		ObjectUIDType uidVolatile = ObjectUIDType::createAddressFromVolatilePointer(reinterpret_cast<uintptr_t>(ptrObject.get()));
+		ObjectUIDType uidUpdated;
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+#endif __CONCURRENT__
+
+		if (m_ptrStorage->addObject(uidVolatile, ptrObject, uidUpdated) != CacheErrorCode::Success)
+		{
+			uidObject = std::nullopt;
+			return CacheErrorCode::Error;
+		}
+
+		uidObject = uidUpdated;
+
+		return CacheErrorCode::Success;
+	}
+
+	void getCacheState(size_t& lru, size_t& map)
+	{
+		lru = 0;
+		map = 0;
+
+		for (auto& ptrShard : m_vtShards)
+		{
+#ifdef __CONCURRENT__
+			std::shared_lock<std::shared_mutex> lock_shard(ptrShard->m_mtxShard);
+#endif __CONCURRENT__
+
+			lru += ptrShard->m_policy.size();
+			map += ptrShard->m_mpObjects.size();
+		}
+	}
+
+	/*
+	 * Bounds the cache by the serialized size of its objects in addition to their count. When the resident bytes
+	 * of a shard exceed its share of nHighWatermarkBytes, it evicts down to its share of nLowWatermarkBytes.
+	 * 0 turns it off.
+	 */
+	void setByteBudget(size_t nHighWatermarkBytes, size_t nLowWatermarkBytes)
+	{
+		nLowWatermarkBytes = std::min(nLowWatermarkBytes, nHighWatermarkBytes);
+
+		for (auto& ptrShard : m_vtShards)
+		{
+#ifdef __CONCURRENT__
+			std::unique_lock<std::shared_mutex> lock_shard(ptrShard->m_mtxShard);
+#endif __CONCURRENT__
+
+			ptrShard->m_nHighWatermarkBytes = nHighWatermarkBytes / m_vtShards.size();
+			ptrShard->m_nLowWatermarkBytes = nLowWatermarkBytes / m_vtShards.size();
+		}
+	}
+
+	void getCacheStats(CacheStats& stats)
+	{
+		stats = CacheStats{};
+
+		for (auto& ptrShard : m_vtShards)
+		{
+#ifdef __CONCURRENT__
+			std::shared_lock<std::shared_mutex> lock_shard(ptrShard->m_mtxShard);
+#endif __CONCURRENT__
+
+			stats.m_nObjects += ptrShard->m_mpObjects.size();
+			stats.m_nResidentBytes += ptrShard->m_nResidentBytes;
+			stats.m_nHighWatermarkBytes += ptrShard->m_nHighWatermarkBytes;
+			stats.m_nLowWatermarkBytes += ptrShard->m_nLowWatermarkBytes;
+			stats.m_nDirtyEvictions += ptrShard->m_nDirtyEvictions;
+			stats.m_nCleanEvictions += ptrShard->m_nCleanEvictions;
+			stats.m_nPinnedSkips += ptrShard->m_nPinnedSkips;
+			stats.m_nEvictionStalls += ptrShard->m_nEvictionStalls;
+		}
+
+#ifdef __CONCURRENT__
+		m_flusher.getStats(stats);
+		stats.m_nDeduplicatedLoads = m_loads.getDeduplicated();
+#else __CONCURRENT__
+		stats.m_nFlushedObjects = 0;
+		stats.m_nFlushMicroseconds = 0;
+		stats.m_nFlushBatch = 0;
+		stats.m_nWriterStalls = 0;
+		stats.m_nWriterStallMicroseconds = 0;
+		stats.m_nDeduplicatedLoads = 0;
+#endif __CONCURRENT__
+
+		m_ptrStorage->getAllocator().getStats(stats);
+	}
+
+	CacheErrorCode flush()
+	{
+		flushCacheToStorage();
+
+		return CacheErrorCode::Success;
+	}
+
+private:
+	// Locks the shard of uidObject, see Shard::dropResident.
+	inline bool dropResident(const ObjectUIDType& uidObject)
+	{
+		Shard& shard = getShard(uidObject);
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+#endif __CONCURRENT__
+
+		return shard.dropResident(uidObject);
+	}
+
+	// See LRUCache::retireUpdatedUID; under __CONCURRENT__ the caller holds m_mtxStorage.
+	inline void retireUpdatedUID(const ObjectUIDType& uidObject)
+	{
+		if (m_mpUpdatedUIDs.erase(uidObject) > 0)
+		{
+			m_ptrStorage->remove(uidObject);
+		}
+	}
+
+	inline void retireUpdatedUIDs(const std::vector<ObjectUIDType>& vtUIDs)
+	{
+		for (const ObjectUIDType& uidObject : vtUIDs)
+		{
+			retireUpdatedUID(uidObject);
+		}
+	}
+
+	inline size_t getShardIndex(const ObjectUIDType& uidObject) const
+	{
+		// std::hash of the volatile pointers is the identity on most implementations; mix the bits so that the
+		// alignment of the allocations does not map every object to the same shard.
+		size_t nHash = std::hash<ObjectUIDType>()(uidObject);
+		nHash ^= nHash >> 33;
+		nHash *= 0xff51afd7ed558ccdULL;
+		nHash ^= nHash >> 33;
+
+		return nHash % m_vtShards.size();
+	}
+
+	// See LRUCache::isPinned.
+	static inline bool isPinned(const ObjectTypePtr& ptrObject)
+	{
+#ifdef __CONCURRENT__
+		return ptrObject->isPinned() || ptrObject.use_count() > 1 || ptrObject->isCoreShared();
+#else __CONCURRENT__
+		return ptrObject->isPinned() || ptrObject.use_count() > 1;
+#endif __CONCURRENT__
+	}
+
+	inline Shard& getShard(const ObjectUIDType& uidObject)
+	{
+		return *m_vtShards[getShardIndex(uidObject)];
+	}
+
+	/*
+	 * A node is written out with the uids of its children, which it cannot have for a child that is still resident
+	 * under its volatile uid, e.g. a pinned one. The caller holds the lock of shard, the one of ptrObject.
+	 */
+	inline bool hasResidentVolatileChild(Shard& shard, const ObjectTypePtr& ptrObject)
+	{
+		return ptrObject->anyChild([this, &shard](const ObjectUIDType& uidChild)
+			{
+				if (uidChild.m_uid.m_nMediaType != ObjectUIDType::Volatile)
+				{
+					return false;
+				}
+
+				Shard& shardChild = getShard(uidChild);
+				if (&shardChild == &shard)
+				{
+					return shard.m_mpObjects.find(uidChild) != shard.m_mpObjects.end();
+				}
+
+#ifdef __CONCURRENT__
+				// Only the flusher ever holds two shard locks.
+				std::shared_lock<std::shared_mutex> lock_shard(shardChild.m_mtxShard);
+#endif __CONCURRENT__
+
+				return shardChild.m_mpObjects.find(uidChild) != shardChild.m_mpObjects.end();
+			});
+	}
+
+	inline ObjectTypePtr lookup(const ObjectUIDType& uidObject)
+	{
+		Shard& shard = getShard(uidObject);
+
+#ifdef __CONCURRENT__
+		std::shared_lock<std::shared_mutex> lock_shard(shard.m_mtxShard); // a hit only records the access, the policy is updated later.
+#endif __CONCURRENT__
+
+		auto it = shard.m_mpObjects.find(uidObject);
+		if (it == shard.m_mpObjects.end())
+		{
+			return nullptr;
+		}
+
+		ObjectTypePtr ptrObject = (*it).second;
+
+#ifdef __CONCURRENT__
+		bool bDrain = !shard.m_bufReads.record(uidObject);
+
+		lock_shard.unlock();
+
+		if (bDrain)
+		{
+			shard.drainReadBuffer();
+		}
+#else __CONCURRENT__
+		shard.m_policy.touch(uidObject);
+#endif __CONCURRENT__
+
+		return ptrObject;
+	}
+
+	// bApplied: the caller holds the parent exclusively, the relocation can go at once (see LRUCache::dropUpdatedUID).
+	// Returns false if the relocation was applied by another thread while this one waited for it.
+	inline bool resolveUpdatedUID(const ObjectUIDType& uidObject, ObjectUIDType& _uidUpdated, std::optional<ObjectUIDType>& uidUpdated, bool bApplied)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+#endif __CONCURRENT__
+
+		auto it = m_mpUpdatedUIDs.find(uidObject);
+		if (it == m_mpUpdatedUIDs.end())
+		{
+			return true;
+		}
+
+#ifdef __CONCURRENT__
+		// Looked up again on every wake-up, see LRUCache::waitForUpdatedUID.
+		cv.wait(lock_storage, [this, &uidObject, &it]
+			{
+				it = m_mpUpdatedUIDs.find(uidObject);
+				return it == m_mpUpdatedUIDs.end() || (*it).second.first != std::nullopt;
+			});
+
+		if (it == m_mpUpdatedUIDs.end())
+		{
+			return false;
+		}
+#endif __CONCURRENT__
+
+		uidUpdated = (*it).second.first;
+
+		assert(uidUpdated != std::nullopt);
+
+#ifdef __CONCURRENT__
+		if (!bApplied)
+		{
+			_uidUpdated = *uidUpdated;
+			return true;
+		}
+#endif __CONCURRENT__
+
+		retireUpdatedUID(uidObject);	// Applied.
+		_uidUpdated = *uidUpdated;
+
+		return true;
+	}
+
+	/*
+	 * Reads uidObject from the storage and admits it; concurrent misses on the same uid share the load, see
+	 * LRUCache::loadObject. Returns nullptr if the storage does not have it.
+	 */
+	inline ObjectTypePtr loadObject(const ObjectUIDType& uidObject)
+	{
+#ifdef __CONCURRENT__
+		return m_loads.load(uidObject, [this, &uidObject]() -> ObjectTypePtr
+			{
+				ObjectTypePtr ptrObject = lookup(uidObject);
+				if (ptrObject != nullptr)
+				{
+					return ptrObject;
+				}
+
+				ptrObject = m_ptrStorage->getObject(uidObject);
+				if (ptrObject == nullptr)
+				{
+					return nullptr;
+				}
+
+				return admit(uidObject, ptrObject);
+			});
+#else __CONCURRENT__
+		ObjectTypePtr ptrObject = m_ptrStorage->getObject(uidObject);
+		if (ptrObject == nullptr)
+		{
+			return nullptr;
+		}
+
+		return admit(uidObject, ptrObject);
+#endif __CONCURRENT__
+	}
+
+	/*
+	 * Adds an object loaded from the storage to its shard. If another thread has admitted the same uid
+	 * in the meantime, that copy wins and is returned instead.
+	 */
+	inline ObjectTypePtr admit(const ObjectUIDType& uidObject, std::shared_ptr<ObjectType> ptrObject)
+	{
+		Shard& shard = getShard(uidObject);
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+#endif __CONCURRENT__
+
+		auto it = shard.m_mpObjects.find(uidObject);
+		if (it != shard.m_mpObjects.end())
+		{
+			shard.m_policy.touch(uidObject);
+			return (*it).second;
+		}
+
+		shard.m_mpObjects[uidObject] = ptrObject;
+		shard.m_policy.admit(uidObject);
+		shard.charge(ptrObject);
+
+#ifdef __CONCURRENT__
+		signalFlusher(shard, lock_shard);
+#endif __CONCURRENT__
+
+		return ptrObject;
+	}
+
+	inline void place(const ObjectUIDType& uidObject, std::shared_ptr<ObjectType> ptrObject)
+	{
+		Shard& shard = getShard(uidObject);
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+#endif __CONCURRENT__
+
+		auto it = shard.m_mpObjects.find(uidObject);
+		if (it != shard.m_mpObjects.end())
+		{
+			shard.m_nResidentBytes -= (*it).second->footprint;
+			(*it).second = ptrObject;
+			shard.m_policy.touch(uidObject);
+		}
+		else
+		{
+			shard.m_mpObjects[uidObject] = ptrObject;
+			shard.m_policy.admit(uidObject);
+		}
+
+		shard.charge(ptrObject);
+
+#ifdef __CONCURRENT__
+		signalFlusher(shard, lock_shard);
+#endif __CONCURRENT__
+	}
+
+#ifdef __CONCURRENT__
+	// Called right after an admission to shard, releases lock_shard.
+	inline void signalFlusher(Shard& shard, std::unique_lock<std::shared_mutex>& lock_shard)
+	{
+		bool bHigh = shard.isAboveHighWatermark();
+		bool bHard = shard.isAboveHardLimit();
+
+		lock_shard.unlock();
+
+		m_flusher.admitted(bHigh, bHard);
+	}
+
+	// See LRUCache::flushItemsToStorage.
+	inline bool flushItemsToStorage(Shard& shard, size_t nBatch, size_t& nEvicted, bool& bStalled)
+	{
+		std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>> vtObjects;
+
+		std::unique_lock<std::shared_mutex> lock_shard(shard.m_mtxShard);
+
+		// Bring the policy up to date first, or the victims would be picked on stale recency.
+		shard.applyReadBuffer();
+
+		auto fnIsEvictable = [this, &shard](const ObjectUIDType& uidObject)
+			{
+				ObjectTypePtr& ptrObject = shard.m_mpObjects[uidObject];
+
+				if (isPinned(ptrObject) || hasResidentVolatileChild(shard, ptrObject))
+				{
+					shard.m_nPinnedSkips++;
+					return false;
+				}
+
+				// Check if the object is in use
+				if (!ptrObject->mutex.try_lock())
+				{
+					shard.m_nPinnedSkips++;
+					return false;
+				}
+
+				ptrObject->mutex.unlock();
+				return true;
+			};
+
+		for (size_t idx = 0; idx < nBatch && shard.isAboveLowWatermark(); idx++)
+		{
+			ObjectUIDType uidVictim;
+			if (!shard.m_policy.selectVictim(uidVictim, fnIsEvictable))
+			{
+				shard.m_nEvictionStalls++;
+				bStalled = true;
+				break;
+			}
+
+			auto it = shard.m_mpObjects.find(uidVictim);
+
+			vtObjects.push_back(std::make_pair(uidVictim, std::make_pair(std::nullopt, (*it).second)));
+
+			shard.m_nResidentBytes -= (*it).second->footprint;
+			(*it).second->epoch++;
+			shard.m_mpObjects.erase(it);
+		}
+
+		if (vtObjects.size() == 0)
+		{
+			return shard.isAboveLowWatermark();
+		}
+
+		// prepareFlush drops the clean ones from vtObjects.
+		size_t nVictims = vtObjects.size();
+		nEvicted = nVictims;
+
+		std::unique_lock<std::shared_mutex> lock_storage(m_mtxStorage);
+
+		lock_shard.unlock();
+
+		if (m_mpUpdatedUIDs.size() > 0)
+		{
+			std::vector<ObjectUIDType> vtAppliedUIDs;
+			m_ptrCallback->applyExistingUpdates(vtObjects, m_mpUpdatedUIDs, vtAppliedUIDs);
+
+			retireUpdatedUIDs(vtAppliedUIDs);
+		}
+
+		BlockAllocator& allocator = m_ptrStorage->getAllocator();
+		allocator.advance();
+
+		std::vector<ObjectUIDType> vtAppliedUIDs;
+		m_ptrCallback->prepareFlush(vtObjects, allocator, m_ptrStorage->getBlockSize(), m_ptrStorage->getMediaType(), vtAppliedUIDs);
+
+		auto it = vtObjects.begin();
+		while (it != vtObjects.end())
+		{
+			if ((*it).second.second.use_count() != 1)
+			{
+				throw new std::logic_error("should not occur!");
+			}
+
+			if (m_mpUpdatedUIDs.find((*it).first) != m_mpUpdatedUIDs.end())
+			{
+				throw new std::logic_error("should not occur!");
+			}
+			else
+			{
+				m_mpUpdatedUIDs[(*it).first] = std::make_pair(std::nullopt, (*it).second.second);
+			}
+
+			it++;
+		}
+
+		lock_storage.unlock();
+
+		m_ptrStorage->addObjects(vtObjects);
+
+		// See LRUCache::flushItemsToStorage.
+		for (auto& prObject : vtObjects)
+		{
+			dropResident(*prObject.second.first);
+		}
+
+		lock_storage.lock();
+
+		it = vtObjects.begin();
+		while (it != vtObjects.end())
+		{
+			if (m_mpUpdatedUIDs.find((*it).first) != m_mpUpdatedUIDs.end())
+			{
+				m_mpUpdatedUIDs[(*it).first] = std::make_pair((*it).second.first, (*it).second.second);
+			}
+			else
+			{
+				throw new std::logic_error("should not occur!");
+			}
+
+			it++;
+		}
+
+		// The objects whose parents were written in the same batch are reached through the new copies of those only.
+		retireUpdatedUIDs(vtAppliedUIDs);
+
+		lock_storage.unlock();
+
+		cv.notify_all();
+
+		// Ghost entries only follow the objects whose storage uid stays on this shard; the others age out.
+		lock_shard.lock();
+
+		shard.m_nDirtyEvictions += vtObjects.size();
+		shard.m_nCleanEvictions += nVictims - vtObjects.size();
+
+		it = vtObjects.begin();
+		while (it != vtObjects.end())
+		{
+			if (&getShard(*(*it).second.first) == &shard)
+			{
+				shard.m_policy.relocate((*it).first, *(*it).second.first);
+			}
+			it++;
+		}
+
+		return shard.isAboveLowWatermark();
+	}
+
+	// See LRUCache::drainToLowWatermark, the shards are drained one after the other.
+	/*
+	 * A shard may stall on parents whose children are resident on another shard, which a later shard's passes can
+	 * write out. The drain goes round the shards again for those and only reports a stall after a round that
+	 * evicted nothing.
+	 */
+	inline void drainToLowWatermark()
+	{
+		size_t nMostPasses = 0;
+		size_t nMostEvicted = 0;
+		bool bStalledAny = true;
+		bool bProgress = true;
+
+		while (bStalledAny && bProgress)
+		{
+			bStalledAny = false;
+			bProgress = false;
+
+			for (auto& ptrShard : m_vtShards)
+			{
+				size_t nPasses = 0;
+				bool bStalled = false;
+				bool bAbove = true;
+
+				while (bAbove && !bStalled)
+				{
+					auto tmStart = std::chrono::steady_clock::now();
+
+					size_t nEvicted = 0;
+					bAbove = flushItemsToStorage(*ptrShard, m_flusher.getBatchSize(), nEvicted, bStalled);
+					nPasses++;
+
+					m_flusher.completePass(nEvicted, std::chrono::steady_clock::now() - tmStart);
+
+					nMostEvicted = std::max(nMostEvicted, nEvicted);
+					bProgress = bProgress || nEvicted > 0;
+				}
+
+				nMostPasses = std::max(nMostPasses, nPasses);
+				bStalledAny = bStalledAny || bStalled;
+			}
+		}
+
+		m_flusher.completeDrain(nMostPasses, nMostEvicted, bStalledAny);
+	}
+#else __CONCURRENT__
+	inline void flushItemsToStorage(Shard& shard)
+	{
+		auto fnIsEvictable = [this, &shard](const ObjectUIDType& uidObject)
+			{
+				ObjectTypePtr& ptrObject = shard.m_mpObjects[uidObject];
+
+				if (isPinned(ptrObject) || hasResidentVolatileChild(shard, ptrObject))
+				{
+					shard.m_nPinnedSkips++;
+					return false;
+				}
+
+				return true;
+			};
+
+		bool bOverBudget = shard.isOverBudget();
+
+		while (shard.hasToEvict(bOverBudget))
+		{
+			ObjectUIDType uidVictim;
+			if (!shard.m_policy.selectVictim(uidVictim, fnIsEvictable))
+			{
+				shard.m_nEvictionStalls++;
+				break;
+			}
+
+			auto it = shard.m_mpObjects.find(uidVictim);
+
+			if ((*it).second->dirty)
+			{
+				if (m_mpUpdatedUIDs.size() > 0)
+				{
+					std::vector<ObjectUIDType> vtAppliedUIDs;
+					m_ptrCallback->applyExistingUpdates((*it).second, m_mpUpdatedUIDs, vtAppliedUIDs);
+
+					retireUpdatedUIDs(vtAppliedUIDs);
+				}
+
+				ObjectUIDType uidUpdated;
+				if (m_ptrStorage->addObject(uidVictim, (*it).second, uidUpdated) != CacheErrorCode::Success)
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				if (m_mpUpdatedUIDs.find(uidVictim) != m_mpUpdatedUIDs.end())
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				m_mpUpdatedUIDs[uidVictim] = std::make_pair(uidUpdated, (*it).second);
+
+				if (&getShard(uidUpdated) == &shard)
+				{
+					shard.m_policy.relocate(uidVictim, uidUpdated);
+				}
+
+				shard.m_nDirtyEvictions++;
+			}
+			else
+			{
+				shard.m_nCleanEvictions++;
+			}
+
+			shard.m_nResidentBytes -= (*it).second->footprint;
+			(*it).second->epoch++;
+			shard.m_mpObjects.erase(it);
+		}
+	}
+#endif __CONCURRENT__
+
+	inline void flushCacheToStorage()
+	{
+#ifdef __CONCURRENT__
+		//The current implementation blocks the whole cache, should not be flush allowed at the node level!
+		return; //fix this
+#else __CONCURRENT__
+		// Objects whose new uid hashes to a different shard are moved after the walk so that the walk itself
+		// does not run into them again.
+		std::vector<std::pair<ObjectUIDType, ObjectTypePtr>> vtRehome;
+
+		for (auto& ptrShard : m_vtShards)
+		{
+			// The map is re-keyed as the objects get their storage uids, so walk a snapshot of the current ones,
+			// in the order the policy would evict them.
+			std::vector<ObjectUIDType> vtUIDs;
+			vtUIDs.reserve(ptrShard->m_mpObjects.size());
+
+			ptrShard->m_policy.getResident(vtUIDs);
+
+			for (const ObjectUIDType& uidObject : vtUIDs)
+			{
+				if (isPinned(ptrShard->m_mpObjects[uidObject]) || hasResidentVolatileChild(*ptrShard, ptrShard->m_mpObjects[uidObject]))
+				{
+					// See LRUCache::flushCacheToStorage.
+					ptrShard->m_nPinnedSkips++;
+					continue;
+				}
+
+				ObjectTypePtr ptrObject = ptrShard->m_mpObjects[uidObject];
+
+				if (!ptrObject->dirty)
+				{
+					continue;
+				}
+
+				if (m_mpUpdatedUIDs.size() > 0)
+				{
+					std::vector<ObjectUIDType> vtAppliedUIDs;
+					m_ptrCallback->applyExistingUpdates(ptrObject, m_mpUpdatedUIDs, vtAppliedUIDs);
+
+					retireUpdatedUIDs(vtAppliedUIDs);
+				}
+
+				ObjectUIDType uidUpdated;
+				if (m_ptrStorage->addObject(uidObject, ptrObject, uidUpdated) != CacheErrorCode::Success)
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				if (m_mpUpdatedUIDs.find(uidObject) != m_mpUpdatedUIDs.end())
+				{
+					throw new std::logic_error("should not occur!");
+				}
+
+				m_mpUpdatedUIDs[uidObject] = std::make_pair(uidUpdated, ptrObject);
+
+				// The copy in the storage is current now, a later eviction need not write it again.
+				ptrObject->dirty = false;
+				ptrObject->epoch++;
+
+				ptrShard->m_mpObjects.erase(uidObject);
+
+				if (&getShard(uidUpdated) == ptrShard.get())
+				{
+					ptrShard->m_mpObjects[uidUpdated] = ptrObject;
+					ptrShard->m_policy.relocate(uidObject, uidUpdated);
+				}
+				else
+				{
+					ptrShard->m_policy.remove(uidObject);
+					ptrShard->m_nResidentBytes -= ptrObject->footprint;
+					vtRehome.push_back(std::make_pair(uidUpdated, ptrObject));
+				}
+			}
+		}
+
+		for (auto& prObject : vtRehome)
+		{
+			Shard& shard = getShard(prObject.first);
+
+			shard.m_mpObjects[prObject.first] = prObject.second;
+			shard.m_policy.admit(prObject.first);
+			shard.m_nResidentBytes += prObject.second->footprint;
+		}
+#endif __CONCURRENT__
+	}
+
+#ifdef __CONCURRENT__
+	static void handlerCacheFlush(SelfType* ptrSelf)
+	{
+		while (ptrSelf->m_flusher.waitForWork())
+		{
+			ptrSelf->drainToLowWatermark();
+		}
+	}
+#endif __CONCURRENT__
+
+#ifdef __TREE_WITH_CACHE__
+public:
+	void applyExistingUpdates(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtNodes
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs
+		, std::vector<ObjectUIDType>& vtAppliedUIDs)
+	{
+
+	}
+
+	void applyExistingUpdates(std::shared_ptr<ObjectType> ptrObject
+		, std::unordered_map<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>& mpUpdatedUIDs
+		, std::vector<ObjectUIDType>& vtAppliedUIDs)
+	{
+
+	}
+
+	void prepareFlush(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects
+		, BlockAllocator& allocator, size_t nPointerSize, ObjectUIDType::Media nMediaType, std::vector<ObjectUIDType>& vtAppliedUIDs)
+	{
+
+	}
+#endif __TREE_WITH_CACHE__
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+/*
+ * Loads in flight, by uid. The first thread to miss on a uid runs the load; the ones that miss on it in the meantime
+ * wait for its result instead of reading and deserializing the same node again. The result is published before the
+ * load leaves the table, so a thread is never left to start a second load of an object that is already on its way.
+ */
+template <typename KeyType, typename ValueType>
+class SingleFlight
+{
+private:
+	std::mutex m_mtxLoads;
+	std::unordered_map<KeyType, std::shared_future<ValueType>> m_mpLoads;
+
+	size_t m_nDeduplicated;
+
+public:
+	SingleFlight()
+		: m_nDeduplicated(0)
+	{
+	}
+
+	/*
+	 * Returns what fnLoad() returns for key, running it only if no other thread already is. An exception thrown by
+	 * fnLoad reaches the threads that waited for it as well.
+	 */
+	template <typename Load>
+	ValueType load(const KeyType& key, Load fnLoad)
+	{
+		std::unique_lock<std::mutex> lock_loads(m_mtxLoads);
+
+		auto it = m_mpLoads.find(key);
+		if (it != m_mpLoads.end())
+		{
+			std::shared_future<ValueType> ftLoad = (*it).second;
+			m_nDeduplicated++;
+
+			lock_loads.unlock();
+
+			return ftLoad.get();
+		}
+
+		std::promise<ValueType> prLoad;
+		m_mpLoads.emplace(key, prLoad.get_future().share());
+
+		lock_loads.unlock();
+
+		ValueType value;
+		try
+		{
+			value = fnLoad();
+		}
+		catch (...)
+		{
+			prLoad.set_exception(std::current_exception());
+			complete(key);
+			throw;
+		}
+
+		prLoad.set_value(value);
+		complete(key);
+
+		return value;
+	}
+
+	inline size_t getDeduplicated()
+	{
+		std::unique_lock<std::mutex> lock_loads(m_mtxLoads);
+		return m_nDeduplicated;
+	}
+
+private:
+	inline void complete(const KeyType& key)
+	{
+		std::unique_lock<std::mutex> lock_loads(m_mtxLoads);
+		m_mpLoads.erase(key);
+	}
+};
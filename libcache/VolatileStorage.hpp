@@ -10,6 +10,7 @@
 
 #include "ErrorCodes.h"
 #include "IFlushCallback.h"
+#include "BlockAllocator.hpp"
 
 template<
 	typename ICallback,
@@ -31,8 +32,7 @@ private:
 	size_t m_nStorageSize;
 	size_t m_nBlockSize;
 
-	size_t m_nNextBlock;
-	std::vector<bool> m_vtAllocationTable;
+	BlockAllocator m_allocator;
 
 	ICallback* m_ptrCallback;
 
@@ -62,7 +62,7 @@ public:
 	VolatileStorage(size_t nBlockSize, size_t nStorageSize)
 		: m_nStorageSize(nStorageSize)
 		, m_nBlockSize(nBlockSize)
-		, m_nNextBlock(0)
+		, m_allocator(nStorageSize / nBlockSize)
 		, m_ptrCallback(NULL)
 	{
 		m_szStorage = new(std::nothrow) char[m_nStorageSize];
@@ -73,9 +73,6 @@ public:
 			throw new std::logic_error("should not occur!"); // TODO: critical log.
 		}
 
-		m_vtAllocationTable.resize(nStorageSize / nBlockSize, false);
-
-
 #ifdef __CONCURRENT__
 		m_bStopFlush = false;
 		//m_threadBatchFlush = std::thread(handlerBatchFlush, this);
@@ -91,8 +88,6 @@ public:
 
 	std::shared_ptr<ObjectType> getObject(const ObjectUIDType& uidObject)
 	{
-		char* szBuffer = new char[uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize + 1]; //2
-		memset(szBuffer, 0, uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize + 1); //2
 		std::shared_ptr<ObjectType> ptrObject = std::make_shared<ObjectType>(m_szStorage + uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset); //1
 /* COW!
 #ifdef __CONCURRENT__
@@ -117,9 +112,16 @@ public:
 		return ptrObject;
 	}
 
-	CacheErrorCode remove(const ObjectUIDType& ptrKey)
+	// See FileStorage::remove. addObject names its objects as File uids, prepareFlush as DRAM ones; both are offsets.
+	CacheErrorCode remove(const ObjectUIDType& uidObject)
 	{
-		//throw new std::logic_error("no implementation!");
+		if (uidObject.m_uid.m_nMediaType == ObjectUIDType::Volatile)
+		{
+			return CacheErrorCode::Success;
+		}
+
+		m_allocator.deallocate(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nOffset / m_nBlockSize, std::ceil(uidObject.m_uid.FATPOINTER.m_ptrFile.m_nSize / (float)m_nBlockSize));
+
 		return CacheErrorCode::Success;
 	}
 
@@ -131,38 +133,37 @@ public:
 		char* szBuffer = NULL; //2
 		ptrObject->serialize(szBuffer, uidObjectType, nBufferSize); //2
 
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
+		size_t nRequiredBlocks = std::ceil((nBufferSize + sizeof(uint8_t)) / (float)m_nBlockSize);
 
-		memcpy(m_szStorage + (m_nNextBlock * m_nBlockSize), szBuffer, nBufferSize);
+		size_t nBlock = 0;
+		if (m_allocator.allocate(nRequiredBlocks, nBlock) != CacheErrorCode::Success)
+		{
+			delete[] szBuffer;
+			return CacheErrorCode::Error;
+		}
+
+		memcpy(m_szStorage + (nBlock * m_nBlockSize), szBuffer, nBufferSize);
 
 		//m_fsStorage.seekp(m_nNextBlock * m_nBlockSize);
 		//ptrObject->serialize(m_fsStorage, uidObjectType, nBufferSize); //1
 		//m_fsStorage.write(szBuffer, nBufferSize); //2
 		//m_fsStorage.flush();
 
-		size_t nRequiredBlocks = std::ceil((nBufferSize + sizeof(uint8_t)) / (float)m_nBlockSize);
-
-#ifdef __CONCURRENT__
-		lock_file_storage.unlock();
-#endif __CONCURRENT__
-
 		delete[] szBuffer; //2
 
-		uidUpdated = ObjectUIDType::createAddressFromFileOffset(m_nNextBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
-
-		for (int idx = 0; idx < nRequiredBlocks; idx++)
-		{
-			m_vtAllocationTable[m_nNextBlock++] = true;
-		}
+		uidUpdated = ObjectUIDType::createAddressFromFileOffset(nBlock, m_nBlockSize, nBufferSize + sizeof(uint8_t));
 
 		return CacheErrorCode::Success;
 	}
 
 	inline size_t getWritePos()
 	{
-		return m_nNextBlock;
+		return m_allocator.getFrontier();
+	}
+
+	inline BlockAllocator& getAllocator()
+	{
+		return m_allocator;
 	}
 
 	inline size_t getBlockSize()
@@ -175,13 +176,8 @@ public:
 		return ObjectUIDType::DRAM;
 	}
 
-	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects, size_t nNewOffset)
+	CacheErrorCode addObjects(std::vector<std::pair<ObjectUIDType, std::pair<std::optional<ObjectUIDType>, std::shared_ptr<ObjectType>>>>& vtObjects)
 	{
-#ifdef __CONCURRENT__
-		std::unique_lock<std::shared_mutex> lock_file_storage(m_mtxStorage);
-#endif __CONCURRENT__
-
-		m_nNextBlock = nNewOffset;
 		int j = 0;
 		auto it = vtObjects.begin();
 		while (it != vtObjects.end())
@@ -0,0 +1,573 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "CacheErrorCodes.h"
+
+enum class WALSyncMode
+{
+	None,			// written out in large chunks and never synced, a crash of the machine loses the tail.
+	PerBatch,		// group commit: the writers waiting when a sync starts all return after that one fdatasync.
+	PerOperation,	// every operation waits for an fdatasync of its own.
+};
+
+/*
+ * An append-only log of the logical operations (insert, remove) of a store, for them to be durable without writing
+ * out the nodes they touch. Records are fixed size and carry a log sequence number (LSN), consecutive from the first
+ * one in the file, and a checksum; replay stops at the first record that is torn or out of sequence and cuts the file
+ * there.
+ *
+ * append only copies the record into the pending buffer, so it can be called under the locks that order the
+ * operations; the I/O is done in sync, after those are released, which is what lets concurrent writers share one
+ * fdatasync. The file ranges of the batches are reserved in LSN order, their writes may overlap in time.
+ */
+template <typename KeyType, typename ValueType>
+class WriteAheadLog
+{
+public:
+	enum class Operation : uint8_t
+	{
+		Insert = 1,
+		Remove = 2,
+	};
+
+	static const uint64_t LOG_MAGIC = 0x48574C4F47000001ULL;
+	static const uint32_t FORMAT_VERSION = 1;
+
+	// LSN, operation, key, value and the checksum of the bytes before it.
+	static const size_t RECORD_SIZE = sizeof(uint64_t) + sizeof(uint8_t) + sizeof(KeyType) + sizeof(ValueType) + sizeof(uint64_t);
+
+	// Pending bytes WALSyncMode::None lets build up before writing them out.
+	static const size_t UNSYNCED_CHUNK = 1024 * 1024;
+
+private:
+	struct Header
+	{
+		uint64_t m_nMagic;
+		uint32_t m_nVersion;
+		uint32_t m_nRecordSize;
+	};
+
+	std::string m_stFilename;
+	int m_fdLog;
+
+	WALSyncMode m_nSyncMode;
+
+	std::vector<char> m_vtPending;	// records appended since the last batch was taken
+	size_t m_nOffset;				// where the pending records go in the file
+	uint64_t m_nLastLSN;			// of the last record appended
+	uint64_t m_nDurableLSN;			// synced up to here, or written up to here with WALSyncMode::None
+
+	bool m_bSyncing;	// a batch is being written and synced (WALSyncMode::PerBatch)
+	bool m_bFailed;		// a write or sync failed, what is pending can no longer be made durable
+
+	uint64_t m_nRecords;
+	uint64_t m_nSyncs;
+
+#ifdef __CONCURRENT__
+	std::mutex m_mtxLog;
+	std::mutex m_mtxSync;	// serializes the syncs of WALSyncMode::PerOperation
+	std::condition_variable m_cvSynced;
+#endif __CONCURRENT__
+
+public:
+	~WriteAheadLog()
+	{
+		// Written, not synced: a clean shutdown of a WALSyncMode::None log keeps its tail.
+		if (!m_bFailed && m_vtPending.size() > 0)
+		{
+			writeAt(m_vtPending.data(), m_vtPending.size(), m_nOffset);
+		}
+
+		::close(m_fdLog);
+	}
+
+	// Opens the log at stFilename, creating it if there is none; see replay before appending to an existing one.
+	WriteAheadLog(const std::string& stFilename, WALSyncMode nSyncMode)
+		: m_stFilename(stFilename)
+		, m_nSyncMode(nSyncMode)
+		, m_nOffset(sizeof(Header))
+		, m_nLastLSN(0)
+		, m_nDurableLSN(0)
+		, m_bSyncing(false)
+		, m_bFailed(false)
+		, m_nRecords(0)
+		, m_nSyncs(0)
+	{
+		// Here rather than on the class, a store that never opens a log may have other keys.
+		static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+			"keys and values are logged as their bytes");
+
+		m_fdLog = ::open(stFilename.c_str(), O_RDWR | O_CREAT, 0644);
+		if (m_fdLog < 0)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+
+		struct stat st;
+		if (::fstat(m_fdLog, &st) != 0)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+
+		Header header = {};
+		if (st.st_size == 0)
+		{
+			header.m_nMagic = LOG_MAGIC;
+			header.m_nVersion = FORMAT_VERSION;
+			header.m_nRecordSize = RECORD_SIZE;
+
+			if (!writeAt((const char*)&header, sizeof(Header), 0) || ::fdatasync(m_fdLog) != 0)
+			{
+				throw new std::logic_error("should not occur!");   // TODO: critical log.
+			}
+		}
+		else if (!readAt((char*)&header, sizeof(Header), 0)
+			|| header.m_nMagic != LOG_MAGIC || header.m_nVersion != FORMAT_VERSION || header.m_nRecordSize != RECORD_SIZE)
+		{
+			throw new std::logic_error("should not occur!");   // TODO: critical log.
+		}
+	}
+
+	/*
+	 * Hands the operations logged after nCommittedLSN to fnApply(operation, key, value), in order, and continues the
+	 * log after the last intact one. Records up to nCommittedLSN are already in the committed tree, a log that ends
+	 * there is emptied. Error if the log starts after nCommittedLSN + 1, it does not belong to the store.
+	 */
+	template <typename ApplyFn>
+	CacheErrorCode replay(uint64_t nCommittedLSN, ApplyFn fnApply)
+	{
+		struct stat st;
+		if (::fstat(m_fdLog, &st) != 0)
+		{
+			return CacheErrorCode::Error;
+		}
+
+		size_t nFileSize = st.st_size;
+		size_t nOffset = sizeof(Header);
+		uint64_t nLastLSN = 0;
+
+		std::vector<char> vtChunk(RECORD_SIZE * 4096);
+
+		while (nOffset + RECORD_SIZE <= nFileSize)
+		{
+			size_t nChunk = std::min(vtChunk.size(), ((nFileSize - nOffset) / RECORD_SIZE) * RECORD_SIZE);
+			if (!readAt(vtChunk.data(), nChunk, nOffset))
+			{
+				return CacheErrorCode::Error;
+			}
+
+			size_t nIdx = 0;
+			for (; nIdx < nChunk; nIdx += RECORD_SIZE)
+			{
+				uint64_t nLSN;
+				Operation nOperation;
+				KeyType key;
+				ValueType value;
+
+				if (!readRecord(vtChunk.data() + nIdx, nLSN, nOperation, key, value) || (nLastLSN != 0 && nLSN != nLastLSN + 1))
+				{
+					break;
+				}
+
+				if (nLastLSN == 0 && nLSN > nCommittedLSN + 1)
+				{
+					return CacheErrorCode::Error;
+				}
+
+				if (nLSN > nCommittedLSN)
+				{
+					fnApply(nOperation, key, value);
+				}
+
+				nLastLSN = nLSN;
+			}
+
+			nOffset += nIdx;
+
+			if (nIdx < nChunk)
+			{
+				break;
+			}
+		}
+
+		if (nLastLSN <= nCommittedLSN)
+		{
+			// Nothing past the commit; starting over keeps the LSNs of the file consecutive.
+			nOffset = sizeof(Header);
+			nLastLSN = nCommittedLSN;
+		}
+
+		if (nOffset < nFileSize && ::ftruncate(m_fdLog, nOffset) != 0)
+		{
+			return CacheErrorCode::Error;
+		}
+
+		m_nOffset = nOffset;
+		m_nLastLSN = nLastLSN;
+		m_nDurableLSN = nLastLSN;
+
+		return CacheErrorCode::Success;
+	}
+
+	// Returns the LSN of the record, to be passed to sync.
+	uint64_t append(Operation nOperation, const KeyType& key, const ValueType& value)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		uint64_t nLSN = ++m_nLastLSN;
+
+		size_t nPosition = m_vtPending.size();
+		m_vtPending.resize(nPosition + RECORD_SIZE);
+
+		writeRecord(m_vtPending.data() + nPosition, nLSN, nOperation, key, value);
+
+		m_nRecords++;
+
+		return nLSN;
+	}
+
+	// Returns once the record nLSN is as durable as the sync mode makes it.
+	CacheErrorCode sync(uint64_t nLSN)
+	{
+		switch (m_nSyncMode)
+		{
+		case WALSyncMode::None:
+			return syncNone();
+		case WALSyncMode::PerBatch:
+			return syncBatch(nLSN);
+		case WALSyncMode::PerOperation:
+			return syncOperation();
+		}
+
+		return CacheErrorCode::Error;
+	}
+
+	uint64_t getLastLSN()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		return m_nLastLSN;
+	}
+
+	/*
+	 * Drops every record, once a commit has taken them all in; the LSNs go on from where they were. No record may be
+	 * appended meanwhile (BPlusStore::commit holds the tree). A batch a sync is still writing out is left to land
+	 * where it was headed: its records are at or below the committed LSN, or out of sequence after the new ones.
+	 */
+	CacheErrorCode truncate()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		m_vtPending.clear();
+
+		// Left unsynced: records that come back after a crash are at or below the committed LSN and are skipped.
+		if (::ftruncate(m_fdLog, sizeof(Header)) != 0)
+		{
+			m_bFailed = true;
+			return CacheErrorCode::Error;
+		}
+
+		m_nOffset = sizeof(Header);
+		m_nDurableLSN = m_nLastLSN;
+
+		return CacheErrorCode::Success;
+	}
+
+	void getStats(uint64_t& nRecords, uint64_t& nSyncs)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		nRecords = m_nRecords;
+		nSyncs = m_nSyncs;
+	}
+
+private:
+	CacheErrorCode syncNone()
+	{
+		std::vector<char> vtBatch;
+		size_t nOffset = 0;
+		uint64_t nBatchLSN = 0;
+
+		{
+#ifdef __CONCURRENT__
+			std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+			if (m_bFailed)
+			{
+				return CacheErrorCode::Error;
+			}
+
+			if (m_vtPending.size() < UNSYNCED_CHUNK)
+			{
+				return CacheErrorCode::Success;
+			}
+
+			takePending(vtBatch, nOffset, nBatchLSN);
+		}
+
+		bool bSuccess = writeBatch(vtBatch, nOffset, false);
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		return completeBatch(nBatchLSN, bSuccess, false);
+	}
+
+	/*
+	 * The first writer to find its record not yet synced, with no sync under way, takes everything pending and syncs
+	 * it; the ones that append meanwhile wait for that sync to end and the next of them takes the lot.
+	 */
+	CacheErrorCode syncBatch(uint64_t nLSN)
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		while (m_nDurableLSN < nLSN)
+		{
+			if (m_bFailed)
+			{
+				return CacheErrorCode::Error;
+			}
+
+			if (m_bSyncing)
+			{
+#ifdef __CONCURRENT__
+				m_cvSynced.wait(lock_log);
+#endif __CONCURRENT__
+				continue;
+			}
+
+			std::vector<char> vtBatch;
+			size_t nOffset = 0;
+			uint64_t nBatchLSN = 0;
+
+			takePending(vtBatch, nOffset, nBatchLSN);
+
+			m_bSyncing = true;
+
+#ifdef __CONCURRENT__
+			lock_log.unlock();
+#endif __CONCURRENT__
+
+			bool bSuccess = writeBatch(vtBatch, nOffset, true);
+
+#ifdef __CONCURRENT__
+			lock_log.lock();
+#endif __CONCURRENT__
+
+			CacheErrorCode errCode = completeBatch(nBatchLSN, bSuccess, true);
+
+			m_bSyncing = false;
+
+#ifdef __CONCURRENT__
+			m_cvSynced.notify_all();
+#endif __CONCURRENT__
+
+			if (errCode != CacheErrorCode::Success)
+			{
+				return errCode;
+			}
+		}
+
+		return m_bFailed ? CacheErrorCode::Error : CacheErrorCode::Success;
+	}
+
+	// Syncs even when an earlier sync already took the record along, the operation does not share it.
+	CacheErrorCode syncOperation()
+	{
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_sync(m_mtxSync);
+#endif __CONCURRENT__
+
+		std::vector<char> vtBatch;
+		size_t nOffset = 0;
+		uint64_t nBatchLSN = 0;
+
+		{
+#ifdef __CONCURRENT__
+			std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+			if (m_bFailed)
+			{
+				return CacheErrorCode::Error;
+			}
+
+			takePending(vtBatch, nOffset, nBatchLSN);
+		}
+
+		bool bSuccess = writeBatch(vtBatch, nOffset, true);
+
+#ifdef __CONCURRENT__
+		std::unique_lock<std::mutex> lock_log(m_mtxLog);
+#endif __CONCURRENT__
+
+		return completeBatch(nBatchLSN, bSuccess, true);
+	}
+
+	// Under m_mtxLog: the pending records and the file range they are to be written to.
+	inline void takePending(std::vector<char>& vtBatch, size_t& nOffset, uint64_t& nBatchLSN)
+	{
+		vtBatch.swap(m_vtPending);
+
+		nOffset = m_nOffset;
+		nBatchLSN = m_nLastLSN;
+
+		m_nOffset += vtBatch.size();
+	}
+
+	// Without any lock held.
+	inline bool writeBatch(const std::vector<char>& vtBatch, size_t nOffset, bool bSync)
+	{
+		return writeAt(vtBatch.data(), vtBatch.size(), nOffset) && (!bSync || ::fdatasync(m_fdLog) == 0);
+	}
+
+	// Under m_mtxLog again.
+	inline CacheErrorCode completeBatch(uint64_t nBatchLSN, bool bSuccess, bool bSync)
+	{
+		if (!bSuccess)
+		{
+			m_bFailed = true;
+			return CacheErrorCode::Error;
+		}
+
+		m_nSyncs += bSync ? 1 : 0;
+		m_nDurableLSN = std::max(m_nDurableLSN, nBatchLSN);
+
+		return CacheErrorCode::Success;
+	}
+
+	inline void writeRecord(char* szRecord, uint64_t nLSN, Operation nOperation, const KeyType& key, const ValueType& value)
+	{
+		char* szPosition = szRecord;
+
+		memcpy(szPosition, &nLSN, sizeof(uint64_t));
+		szPosition += sizeof(uint64_t);
+
+		*szPosition = (char)nOperation;
+		szPosition += sizeof(uint8_t);
+
+		memcpy(szPosition, &key, sizeof(KeyType));
+		szPosition += sizeof(KeyType);
+
+		if (nOperation == Operation::Insert)
+		{
+			memcpy(szPosition, &value, sizeof(ValueType));
+		}
+		else
+		{
+			memset(szPosition, 0, sizeof(ValueType));
+		}
+		szPosition += sizeof(ValueType);
+
+		uint64_t nChecksum = getChecksum(szRecord, szPosition - szRecord);
+		memcpy(szPosition, &nChecksum, sizeof(uint64_t));
+	}
+
+	// False if the record is torn, or was never written.
+	inline bool readRecord(const char* szRecord, uint64_t& nLSN, Operation& nOperation, KeyType& key, ValueType& value)
+	{
+		const char* szPosition = szRecord;
+
+		memcpy(&nLSN, szPosition, sizeof(uint64_t));
+		szPosition += sizeof(uint64_t);
+
+		nOperation = (Operation)*szPosition;
+		szPosition += sizeof(uint8_t);
+
+		memcpy(&key, szPosition, sizeof(KeyType));
+		szPosition += sizeof(KeyType);
+
+		memcpy(&value, szPosition, sizeof(ValueType));
+		szPosition += sizeof(ValueType);
+
+		uint64_t nChecksum;
+		memcpy(&nChecksum, szPosition, sizeof(uint64_t));
+
+		return nLSN > 0 && (nOperation == Operation::Insert || nOperation == Operation::Remove)
+			&& nChecksum == getChecksum(szRecord, szPosition - szRecord);
+	}
+
+	// FNV-1a.
+	static inline uint64_t getChecksum(const char* szData, size_t nSize)
+	{
+		uint64_t nChecksum = 0xcbf29ce484222325ULL;
+		for (size_t idx = 0; idx < nSize; idx++)
+		{
+			nChecksum ^= (uint8_t)szData[idx];
+			nChecksum *= 0x100000001b3ULL;
+		}
+
+		return nChecksum;
+	}
+
+	bool readAt(char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nRead = ::pread(m_fdLog, szBuffer, nSize, nOffset);
+			if (nRead < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nRead <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nRead;
+			nSize -= nRead;
+			nOffset += nRead;
+		}
+
+		return true;
+	}
+
+	bool writeAt(const char* szBuffer, size_t nSize, size_t nOffset)
+	{
+		while (nSize > 0)
+		{
+			ssize_t nWritten = ::pwrite(m_fdLog, szBuffer, nSize, nOffset);
+			if (nWritten < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (nWritten <= 0)
+			{
+				return false;
+			}
+
+			szBuffer += nWritten;
+			nSize -= nWritten;
+			nOffset += nWritten;
+		}
+
+		return true;
+	}
+};
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <optional>
+#include <memory>
+#include <string>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "LRUCache.hpp"
+#include "LRUCacheObject.hpp"
+#include "FileStorage.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "TypeMarshaller.hpp"
+#include "TypeUID.h"
+#include "ObjectFatUID.h"
+#include "IFlushCallback.h"
+
+/*
+ * Uniform point lookups against a bulk loaded BPlusStore on FileStorage, buffered and O_DIRECT, at the same total
+ * memory budget. The page cache cannot be capped from here, so what it holds of the store file is measured (mincore)
+ * and counted against the buffered runs:
+ *
+ *	direct		- the whole budget goes to LRUCache; nothing of the file is in the page cache.
+ *	buffered	- the whole budget goes to LRUCache as well, the page cache comes on top of it.
+ *	buffered/2	- half of the budget goes to LRUCache, the other half is left to the page cache.
+ *
+ * The page cache of the file is dropped before every lookup phase, so each run starts cold.
+ *
+ * Usage: directio_bench [budget MiB] [degree] [entries] [lookups] [store path]
+ */
+
+typedef int64_t KeyType;
+typedef int64_t ValueType;
+typedef ObjectFatUID ObjectUIDType;
+
+typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT> DataNodeType;
+typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT> IndexNodeType;
+
+typedef LRUCacheObject<TypeMarshaller, DataNodeType, IndexNodeType> ObjectType;
+typedef IFlushCallback<ObjectUIDType, ObjectType> ICallback;
+
+typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, FileStorage<ICallback, ObjectUIDType, LRUCacheObject, TypeMarshaller, DataNodeType, IndexNodeType>>> BPlusStoreType;
+
+static const size_t BLOCK_SIZE = 4096;
+static const size_t FILE_SIZE = 8ULL * 1024 * 1024 * 1024;
+
+static inline uint64_t nextRandom(uint64_t& nState)
+{
+    // xorshift64*, cheap enough not to show up in the measurement.
+    nState ^= nState >> 12;
+    nState ^= nState << 25;
+    nState ^= nState >> 27;
+    return nState * 2685821657736338717ULL;
+}
+
+static void dropPageCache(const std::string& stPath)
+{
+    int fd = ::open(stPath.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+// Bytes of the file that are in the page cache.
+static size_t getPageCacheBytes(const std::string& stPath)
+{
+    size_t nResident = 0;
+
+    int fd = ::open(stPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+
+    size_t nFileSize = ::lseek(fd, 0, SEEK_END);
+    size_t nPageSize = ::sysconf(_SC_PAGESIZE);
+
+    void* ptrMap = nFileSize > 0 ? ::mmap(nullptr, nFileSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (ptrMap != MAP_FAILED)
+    {
+        std::vector<unsigned char> vtPages((nFileSize + nPageSize - 1) / nPageSize);
+        if (::mincore(ptrMap, nFileSize, vtPages.data()) == 0)
+        {
+            for (unsigned char nPage : vtPages)
+            {
+                nResident += (nPage & 1) ? nPageSize : 0;
+            }
+        }
+
+        ::munmap(ptrMap, nFileSize);
+    }
+
+    ::close(fd);
+
+    return nResident;
+}
+
+void run(const char* szMode, bool bDirectIO, size_t nCacheBudget, size_t nBudget, uint32_t nDegree, size_t nEntries, size_t nLookups, const std::string& stPath)
+{
+    // The node count is only a backstop (nodes are well over 512 bytes), the byte budget is what binds.
+    BPlusStoreType* ptrTree = new BPlusStoreType(nDegree, nCacheBudget / 512, BLOCK_SIZE, FILE_SIZE, stPath, bDirectIO);
+    ptrTree->init<DataNodeType>();
+    ptrTree->setCacheByteBudget(nCacheBudget, nCacheBudget - nCacheBudget / 8);
+
+    std::vector<std::pair<KeyType, ValueType>> vtEntries;
+    vtEntries.reserve(nEntries);
+    for (size_t nIdx = 0; nIdx < nEntries; nIdx++)
+    {
+        vtEntries.emplace_back(nIdx, nIdx);
+    }
+
+    ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end());
+    ptrTree->flush();
+
+    dropPageCache(stPath);
+
+    uint64_t nState = 0x9E3779B97F4A7C15ULL;
+    size_t nMismatches = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t nIdx = 0; nIdx < nLookups; nIdx++)
+    {
+        KeyType key = nextRandom(nState) % nEntries;
+
+        ValueType value = -1;
+        ptrTree->search(key, value);
+
+        nMismatches += value != key ? 1 : 0;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    size_t nPageCache = getPageCacheBytes(stPath);
+
+    std::cout << std::setw(12) << szMode
+        << std::setw(14) << nCacheBudget / (1024 * 1024)
+        << std::setw(14) << nPageCache / (1024 * 1024)
+        << std::setw(14) << (nCacheBudget + nPageCache) / (1024 * 1024)
+        << std::setw(10) << ((nCacheBudget + nPageCache) > nBudget ? "over" : "")
+        << std::setw(14) << std::fixed << std::setprecision(1) << nLookups / std::chrono::duration<double>(end - begin).count() / 1000
+        << std::setw(12) << nMismatches
+        << std::endl;
+
+    delete ptrTree;
+    std::filesystem::remove(stPath);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nBudget = (argc > 1 ? std::atoll(argv[1]) : 64) * 1024 * 1024;
+    uint32_t nDegree = argc > 2 ? std::atoi(argv[2]) : 200;
+    size_t nEntries = argc > 3 ? std::atoll(argv[3]) : 4000000;
+    size_t nLookups = argc > 4 ? std::atoll(argv[4]) : 1000000;
+    std::string stPath = argc > 5 ? argv[5] : (std::filesystem::current_path() / "directio_bench.hdb").string();
+
+    std::cout << "budget " << nBudget / (1024 * 1024) << " MiB, degree " << nDegree << ", " << nEntries << " entries, "
+        << nLookups << " uniform lookups, store " << stPath << std::endl;
+
+    std::cout << std::setw(12) << "mode" << std::setw(14) << "cache MiB" << std::setw(14) << "page MiB" << std::setw(14) << "total MiB"
+        << std::setw(10) << "" << std::setw(14) << "Klookups/s" << std::setw(12) << "mismatches" << std::endl;
+
+    run("direct", true, nBudget, nBudget, nDegree, nEntries, nLookups, stPath);
+    run("buffered", false, nBudget, nBudget, nDegree, nEntries, nLookups, stPath);
+    run("buffered/2", false, nBudget / 2, nBudget, nDegree, nEntries, nLookups, stPath);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_set>
+
+#include "EvictionPolicy.hpp"
+
+/*
+ * Hit ratio and throughput of the replacement policies in EvictionPolicy.hpp, driven directly (without a tree or a
+ * storage) by three synthetic traces over the same key space:
+ *
+ *	uniform	- every key is equally likely.
+ *	zipfian	- skewed towards a hot set (theta 0.99).
+ *	scan	- the zipfian trace with a sequential sweep over cold keys after every nScanPeriod accesses,
+ *		  which is what the Insert_v1 style loops look like to the cache.
+ *
+ * Usage: eviction_bench [capacity] [keys] [accesses]
+ */
+
+typedef uint64_t KeyType;
+
+static inline uint64_t nextRandom(uint64_t& nState)
+{
+    // xorshift64*, cheap enough not to show up in the measurement.
+    nState ^= nState >> 12;
+    nState ^= nState << 25;
+    nState ^= nState >> 27;
+    return nState * 2685821657736338717ULL;
+}
+
+static inline double nextUniform(uint64_t& nState)
+{
+    return (nextRandom(nState) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Zipfian generator from Gray et al., "Quickly Generating Billion-Record Synthetic Databases".
+ */
+class ZipfianGenerator
+{
+    size_t m_nKeys;
+    double m_nTheta;
+    double m_nAlpha;
+    double m_nZetaN;
+    double m_nEta;
+
+public:
+    ZipfianGenerator(size_t nKeys, double nTheta)
+        : m_nKeys(nKeys)
+        , m_nTheta(nTheta)
+    {
+        double nZeta2 = zeta(2);
+
+        m_nZetaN = zeta(nKeys);
+        m_nAlpha = 1.0 / (1.0 - nTheta);
+        m_nEta = (1.0 - std::pow(2.0 / nKeys, 1.0 - nTheta)) / (1.0 - nZeta2 / m_nZetaN);
+    }
+
+    size_t next(uint64_t& nState)
+    {
+        double nU = nextUniform(nState);
+        double nUZ = nU * m_nZetaN;
+
+        if (nUZ < 1.0)
+            return 0;
+
+        if (nUZ < 1.0 + std::pow(0.5, m_nTheta))
+            return 1;
+
+        return (size_t)(m_nKeys * std::pow(m_nEta * nU - m_nEta + 1.0, m_nAlpha)) % m_nKeys;
+    }
+
+private:
+    double zeta(size_t nKeys)
+    {
+        double nSum = 0;
+        for (size_t idx = 1; idx <= nKeys; idx++)
+        {
+            nSum += 1.0 / std::pow((double)idx, m_nTheta);
+        }
+        return nSum;
+    }
+};
+
+std::vector<KeyType> makeUniformTrace(size_t nKeys, size_t nAccesses)
+{
+    uint64_t nState = 0x9E3779B97F4A7C15ULL;
+
+    std::vector<KeyType> vtTrace;
+    vtTrace.reserve(nAccesses);
+
+    for (size_t idx = 0; idx < nAccesses; idx++)
+    {
+        vtTrace.push_back(nextRandom(nState) % nKeys);
+    }
+    return vtTrace;
+}
+
+std::vector<KeyType> makeZipfianTrace(size_t nKeys, size_t nAccesses)
+{
+    uint64_t nState = 0x9E3779B97F4A7C15ULL;
+    ZipfianGenerator zipf(nKeys, 0.99);
+
+    std::vector<KeyType> vtTrace;
+    vtTrace.reserve(nAccesses);
+
+    for (size_t idx = 0; idx < nAccesses; idx++)
+    {
+        // Spread the hot keys over the key space, the rank is not the key.
+        vtTrace.push_back((zipf.next(nState) * 0x9E3779B97F4A7C15ULL) % nKeys);
+    }
+    return vtTrace;
+}
+
+std::vector<KeyType> makeScanTrace(size_t nKeys, size_t nAccesses, size_t nScanPeriod, size_t nScanLength)
+{
+    uint64_t nState = 0x9E3779B97F4A7C15ULL;
+    ZipfianGenerator zipf(nKeys, 0.99);
+
+    std::vector<KeyType> vtTrace;
+    vtTrace.reserve(nAccesses);
+
+    // The sweeps run over keys that the zipfian part never touches, and each one continues where the last one ended.
+    KeyType nScanKey = nKeys;
+
+    while (vtTrace.size() < nAccesses)
+    {
+        for (size_t idx = 0; idx < nScanPeriod && vtTrace.size() < nAccesses; idx++)
+        {
+            vtTrace.push_back((zipf.next(nState) * 0x9E3779B97F4A7C15ULL) % nKeys);
+        }
+
+        for (size_t idx = 0; idx < nScanLength && vtTrace.size() < nAccesses; idx++)
+        {
+            vtTrace.push_back(nScanKey++);
+        }
+    }
+    return vtTrace;
+}
+
+template <typename PolicyType>
+void run(const char* szPolicy, const std::vector<KeyType>& vtTrace, size_t nCapacity)
+{
+    PolicyType policy(nCapacity);
+    std::unordered_set<KeyType> stResident;
+    stResident.reserve(nCapacity * 2);
+
+    size_t nHits = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (const KeyType& key : vtTrace)
+    {
+        if (stResident.find(key) != stResident.end())
+        {
+            nHits++;
+            policy.touch(key);
+            continue;
+        }
+
+        policy.admit(key);
+        stResident.insert(key);
+
+        if (stResident.size() > nCapacity)
+        {
+            KeyType keyVictim;
+            if (policy.selectVictim(keyVictim, [](const KeyType&) { return true; }))
+            {
+                stResident.erase(keyVictim);
+            }
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << std::setw(14) << szPolicy
+        << std::setw(14) << std::fixed << std::setprecision(4) << (double)nHits / vtTrace.size()
+        << std::setw(14) << std::fixed << std::setprecision(2) << vtTrace.size() / std::chrono::duration<double, std::micro>(end - begin).count()
+        << std::endl;
+}
+
+void runAll(const char* szTrace, const std::vector<KeyType>& vtTrace, size_t nCapacity)
+{
+    std::cout << szTrace << std::endl;
+    std::cout << std::setw(14) << "policy" << std::setw(14) << "hit ratio" << std::setw(14) << "Mops/s" << std::endl;
+
+    run<LRUPolicy<KeyType>>("LRU", vtTrace, nCapacity);
+    run<CLOCKPolicy<KeyType>>("CLOCK", vtTrace, nCapacity);
+    run<TwoQPolicy<KeyType>>("2Q", vtTrace, nCapacity);
+    run<ARCPolicy<KeyType>>("ARC", vtTrace, nCapacity);
+
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nCapacity = argc > 1 ? std::atoll(argv[1]) : 10000;
+    size_t nKeys = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    size_t nAccesses = argc > 3 ? std::atoll(argv[3]) : 10000000;
+
+    std::cout << "capacity " << nCapacity << ", " << nKeys << " keys, " << nAccesses << " accesses" << std::endl << std::endl;
+
+    runAll("uniform", makeUniformTrace(nKeys, nAccesses), nCapacity);
+    runAll("zipfian", makeZipfianTrace(nKeys, nAccesses), nCapacity);
+    runAll("scan", makeScanTrace(nKeys, nAccesses, nCapacity * 4, nCapacity * 2), nCapacity);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include "KeySearch.hpp"
+
+/*
+ * Compares the node search kernels per degree: the linear scan the nodes used before, std::upper_bound,
+ * and KeySearch::upperBound (what IndexNode::getChildNodeIdx uses now).
+ */
+
+template <typename KeyType>
+size_t linearScan(const std::vector<KeyType>& vtKeys, const KeyType& key)
+{
+    size_t nIdx = 0;
+    while (nIdx < vtKeys.size() && key >= vtKeys[nIdx])
+    {
+        nIdx++;
+    }
+    return nIdx;
+}
+
+template <typename KeyType, typename Fn>
+double measure(const std::vector<KeyType>& vtProbes, Fn fnSearch, size_t& nChecksum)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    for (const KeyType& key : vtProbes)
+    {
+        nChecksum += fnSearch(key);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / vtProbes.size();
+}
+
+template <typename KeyType>
+void bench(const char* szType)
+{
+    const size_t nProbes = 2000000;
+
+    std::cout << szType << std::endl;
+    std::cout << std::setw(8) << "degree" << std::setw(14) << "linear(ns)" << std::setw(14) << "stl(ns)" << std::setw(14) << "simd(ns)" << std::setw(12) << "speedup" << std::endl;
+
+    for (size_t nDegree : { 16, 32, 64, 128, 256, 512 })
+    {
+        std::mt19937_64 rng(nDegree);
+        std::uniform_int_distribution<KeyType> dist(0, std::numeric_limits<KeyType>::max() / 2);
+
+        std::vector<KeyType> vtKeys(nDegree);
+        for (auto& key : vtKeys)
+        {
+            key = dist(rng);
+        }
+        std::sort(vtKeys.begin(), vtKeys.end());
+
+        std::vector<KeyType> vtProbes(nProbes);
+        for (auto& key : vtProbes)
+        {
+            key = dist(rng);
+        }
+
+        size_t nChecksum[3] = { 0, 0, 0 };
+
+        double dLinear = measure(vtProbes, [&](const KeyType& key) { return linearScan(vtKeys, key); }, nChecksum[0]);
+        double dSTL = measure(vtProbes, [&](const KeyType& key) { return (size_t)(std::upper_bound(vtKeys.begin(), vtKeys.end(), key) - vtKeys.begin()); }, nChecksum[1]);
+        double dSIMD = measure(vtProbes, [&](const KeyType& key) { return KeySearch::upperBound(vtKeys.data(), vtKeys.size(), key); }, nChecksum[2]);
+
+        if (nChecksum[0] != nChecksum[1] || nChecksum[1] != nChecksum[2])
+        {
+            std::cout << "checksum mismatch!" << std::endl;
+        }
+
+        std::cout << std::setw(8) << nDegree
+            << std::setw(14) << std::fixed << std::setprecision(2) << dLinear
+            << std::setw(14) << dSTL
+            << std::setw(14) << dSIMD
+            << std::setw(11) << dLinear / dSIMD << "x" << std::endl;
+    }
+
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench<int32_t>("int32_t");
+    bench<int64_t>("int64_t");
+
+    return 0;
+}
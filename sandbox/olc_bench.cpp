@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <memory>
+#include <cstring>
+
+#include "NoCache.hpp"
+#include "NoCacheObject.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "TypeUID.h"
+
+/*
+ * Throughput of the concurrent BPlusStore (NoCache, optimistic lock coupling) from 1 to 32 threads.
+ * The tree is bulk loaded with the even keys in [0, 2 * nEntries) and every run starts from a fresh tree;
+ * inserts use odd keys, so they always land in existing leaves and split them over time.
+ *
+ * Usage: olc_bench [degree] [entries] [milliseconds per run]
+ */
+
+typedef int64_t KeyType;
+typedef int64_t ValueType;
+typedef uintptr_t ObjectUIDType;
+
+typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT> DataNodeType;
+typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT> IndexNodeType;
+
+typedef BPlusStore<KeyType, ValueType, NoCache<ObjectUIDType, NoCacheObject, DataNodeType, IndexNodeType>> BPlusStoreType;
+
+struct Workload
+{
+    const char* szName;
+    uint32_t nInsertPercent;
+};
+
+static inline uint64_t nextRandom(uint64_t& nState)
+{
+    // xorshift64*, cheap enough not to show up in the measurement.
+    nState ^= nState >> 12;
+    nState ^= nState << 25;
+    nState ^= nState >> 27;
+    return nState * 2685821657736338717ULL;
+}
+
+double run(uint32_t nDegree, size_t nEntries, size_t nThreads, uint32_t nInsertPercent, size_t nMilliseconds)
+{
+    BPlusStoreType* ptrTree = new BPlusStoreType(nDegree);
+    ptrTree->init<DataNodeType>();
+
+    std::vector<std::pair<KeyType, ValueType>> vtEntries;
+    vtEntries.reserve(nEntries);
+    for (size_t nIdx = 0; nIdx < nEntries; nIdx++)
+    {
+        vtEntries.push_back(std::make_pair(2 * nIdx, 2 * nIdx));
+    }
+
+    ptrTree->bulkLoad(vtEntries.cbegin(), vtEntries.cend(), 0.7f);
+
+    std::atomic<bool> bStart(false), bStop(false);
+    std::vector<size_t> vtOps(nThreads * 8, 0);   // one cache line apart
+    std::vector<std::thread> vtThreads;
+
+    for (size_t nThread = 0; nThread < nThreads; nThread++)
+    {
+        vtThreads.push_back(std::thread([&, nThread]()
+            {
+                uint64_t nState = 0x9E3779B97F4A7C15ULL * (nThread + 1);
+                size_t nOps = 0;
+
+                while (!bStart.load(std::memory_order_acquire));
+
+                while (!bStop.load(std::memory_order_relaxed))
+                {
+                    uint64_t nRandom = nextRandom(nState);
+                    KeyType key = 2 * (KeyType)((nRandom >> 8) % nEntries);
+
+                    if ((nRandom & 0xFF) % 100 < nInsertPercent)
+                    {
+                        ptrTree->insert(key + 1, key + 1);
+                    }
+                    else
+                    {
+                        ValueType value;
+                        if (ptrTree->search(key, value) != ErrorCode::Success || value != key)
+                        {
+                            std::cout << "lookup failed for " << key << std::endl;
+                            std::exit(1);
+                        }
+                    }
+
+                    nOps++;
+                }
+
+                vtOps[nThread * 8] = nOps;
+            }));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    bStart.store(true, std::memory_order_release);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(nMilliseconds));
+
+    bStop.store(true, std::memory_order_relaxed);
+    for (auto& thread : vtThreads)
+    {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    size_t nTotalOps = 0;
+    for (size_t nThread = 0; nThread < nThreads; nThread++)
+    {
+        nTotalOps += vtOps[nThread * 8];
+    }
+
+    delete ptrTree;
+
+    return nTotalOps / std::chrono::duration<double, std::micro>(end - begin).count();
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t nDegree = argc > 1 ? std::atoi(argv[1]) : 64;
+    size_t nEntries = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    size_t nMilliseconds = argc > 3 ? std::atoll(argv[3]) : 1000;
+
+    Workload vtWorkloads[] = { { "read-only", 0 }, { "95/5", 5 }, { "50/50", 50 }, { "insert-only", 100 } };
+
+    std::cout << "degree " << nDegree << ", " << nEntries << " entries, " << std::thread::hardware_concurrency() << " hardware threads (Mops/s)" << std::endl;
+    std::cout << std::setw(8) << "threads";
+    for (const auto& workload : vtWorkloads)
+    {
+        std::cout << std::setw(14) << workload.szName;
+    }
+    std::cout << std::endl;
+
+    for (size_t nThreads : { 1, 2, 4, 8, 16, 32 })
+    {
+        std::cout << std::setw(8) << nThreads;
+        for (const auto& workload : vtWorkloads)
+        {
+            std::cout << std::setw(14) << std::fixed << std::setprecision(2) << run(nDegree, nEntries, nThreads, workload.nInsertPercent, nMilliseconds) << std::flush;
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <optional>
+#include <memory>
+#include <string>
+#include <filesystem>
+
+#include "LRUCache.hpp"
+#include "LRUCacheObject.hpp"
+#include "FileStorage.hpp"
+#include "WriteAheadLog.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "TypeMarshaller.hpp"
+#include "TypeUID.h"
+#include "ObjectFatUID.h"
+#include "IFlushCallback.h"
+
+/*
+ * Acknowledged inserts per second into a BPlusStore on FileStorage with its write-ahead log in each sync mode, for a
+ * growing number of writer threads. Every insert returns only once its record is as durable as the mode makes it:
+ *
+ *	none		- written out in large chunks, never synced.
+ *	per-batch	- group commit, the writers waiting on a sync share it.
+ *	per-op		- one fdatasync per insert.
+ *
+ * records/sync is how many inserts an fdatasync covered on average.
+ *
+ * Usage: wal_bench [inserts] [max threads] [degree] [directory]
+ */
+
+typedef int64_t KeyType;
+typedef int64_t ValueType;
+typedef ObjectFatUID ObjectUIDType;
+
+typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT> DataNodeType;
+typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT> IndexNodeType;
+
+typedef LRUCacheObject<TypeMarshaller, DataNodeType, IndexNodeType> ObjectType;
+typedef IFlushCallback<ObjectUIDType, ObjectType> ICallback;
+
+typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, FileStorage<ICallback, ObjectUIDType, LRUCacheObject, TypeMarshaller, DataNodeType, IndexNodeType>>> BPlusStoreType;
+
+static const size_t BLOCK_SIZE = 4096;
+static const size_t FILE_SIZE = 1ULL * 1024 * 1024 * 1024;
+static const size_t CACHE_SIZE = 100000;	// nodes, the tree stays resident; the log is what is measured.
+
+void run(const char* szMode, WALSyncMode nSyncMode, size_t nThreads, uint32_t nDegree, size_t nInserts, const std::filesystem::path& fsDirectory)
+{
+    std::string stStore = (fsDirectory / "wal_bench.hdb").string();
+    std::string stLog = (fsDirectory / "wal_bench.wal").string();
+
+    std::filesystem::remove(stLog);
+
+    BPlusStoreType* ptrTree = new BPlusStoreType(nDegree, CACHE_SIZE, BLOCK_SIZE, FILE_SIZE, stStore);
+    ptrTree->init<DataNodeType>();
+
+    if (ptrTree->openLog(stLog, nSyncMode) != ErrorCode::Success)
+    {
+        std::cout << "cannot open " << stLog << std::endl;
+        delete ptrTree;
+        return;
+    }
+
+    std::vector<std::thread> vtThreads;
+    std::vector<size_t> vtFailures(nThreads, 0);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t nThread = 0; nThread < nThreads; nThread++)
+    {
+        vtThreads.emplace_back([ptrTree, nThread, nThreads, nInserts, &vtFailures]()
+            {
+                // Interleaved keys, the writers spread over the leaves.
+                for (size_t nKey = nThread; nKey < nInserts; nKey += nThreads)
+                {
+                    vtFailures[nThread] += ptrTree->insert(nKey, nKey) != ErrorCode::Success ? 1 : 0;
+                }
+            });
+    }
+
+    for (auto& thread : vtThreads)
+    {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    uint64_t nRecords = 0, nSyncs = 0;
+    ptrTree->getLogStats(nRecords, nSyncs);
+
+    size_t nFailures = 0;
+    for (size_t nFailed : vtFailures)
+    {
+        nFailures += nFailed;
+    }
+
+    std::cout << std::setw(12) << szMode
+        << std::setw(10) << nThreads
+        << std::setw(14) << std::fixed << std::setprecision(1) << nInserts / std::chrono::duration<double>(end - begin).count() / 1000
+        << std::setw(12) << nSyncs
+        << std::setw(14) << std::setprecision(1) << (nSyncs > 0 ? (double)nRecords / nSyncs : 0.0)
+        << std::setw(10) << nFailures
+        << std::endl;
+
+    delete ptrTree;
+
+    std::filesystem::remove(stStore);
+    std::filesystem::remove(stLog);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t nInserts = argc > 1 ? std::atoll(argv[1]) : 200000;
+    size_t nMaxThreads = argc > 2 ? std::atoll(argv[2]) : 16;
+    uint32_t nDegree = argc > 3 ? std::atoi(argv[3]) : 64;
+    std::filesystem::path fsDirectory = argc > 4 ? std::filesystem::path(argv[4]) : std::filesystem::current_path();
+
+    std::cout << nInserts << " inserts, degree " << nDegree << ", log in " << fsDirectory.string() << std::endl;
+
+    std::cout << std::setw(12) << "mode" << std::setw(10) << "threads" << std::setw(14) << "Kinserts/s"
+        << std::setw(12) << "syncs" << std::setw(14) << "records/sync" << std::setw(10) << "failures" << std::endl;
+
+    for (size_t nThreads = 1; nThreads <= nMaxThreads; nThreads *= 4)
+    {
+        run("none", WALSyncMode::None, nThreads, nDegree, nInserts, fsDirectory);
+        run("per-batch", WALSyncMode::PerBatch, nThreads, nDegree, nInserts, fsDirectory);
+        run("per-op", WALSyncMode::PerOperation, nThreads, nDegree, nInserts, fsDirectory);
+    }
+
+    return 0;
+}
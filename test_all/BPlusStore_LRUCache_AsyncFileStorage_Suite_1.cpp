@@ -0,0 +1,189 @@
+#include "pch.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <variant>
+#include <typeinfo>
+#include <type_traits>
+#include <fstream>
+#include <filesystem>
+#include <future>
+
+#include "glog/logging.h"
+
+#include "LRUCache.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "LRUCacheObject.hpp"
+#include "AsyncFileStorage.hpp"
+#include "TypeMarshaller.hpp"
+#include "TypeUID.h"
+#include "ObjectFatUID.h"
+#include "IFlushCallback.h"
+
+#ifdef __TREE_WITH_CACHE__
+namespace BPlusStore_LRUCache_AsyncFileStorage_Suite
+{
+    typedef int KeyType;
+    typedef int ValueType;
+
+    typedef ObjectFatUID ObjectUIDType;
+
+    typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT > DataNodeType;
+    typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT > InternalNodeType;
+
+    typedef LRUCacheObject<TypeMarshaller, DataNodeType, InternalNodeType> ObjectType;
+    typedef IFlushCallback<ObjectUIDType, ObjectType> ICallback;
+
+    typedef AsyncFileStorage<ICallback, ObjectUIDType, LRUCacheObject, TypeMarshaller, DataNodeType, InternalNodeType> StorageType;
+    typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, StorageType>> BPlusStoreType;
+
+    class BPlusStore_LRUCache_AsyncFileStorage_Suite_1 : public ::testing::TestWithParam<std::tuple<int, int, int, int, int, int>>
+    {
+    protected:
+        void SetUp() override
+        {
+            std::tie(nDegree, nBulkInsert_StartKey, nBulkInsert_EndKey, nCacheSize, nFileStoreBlockSize, nFileStoreSize) = GetParam();
+
+            m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, nFileStoreBlockSize, nFileStoreSize, fsTempFileStore.string());
+            m_ptrTree->init<DataNodeType>();
+        }
+
+        void TearDown() override
+        {
+            delete m_ptrTree;
+            std::filesystem::remove(fsTempFileStore);
+        }
+
+        BPlusStoreType* m_ptrTree = nullptr;
+
+        int nDegree;
+        int nBulkInsert_StartKey;
+        int nBulkInsert_EndKey;
+        int nCacheSize;
+        int nFileStoreBlockSize;
+        int nFileStoreSize;
+
+        std::filesystem::path fsTempFileStore = std::filesystem::temp_directory_path() / "tempasyncfilestore.hdb";
+    };
+
+    TEST_P(BPlusStore_LRUCache_AsyncFileStorage_Suite_1, Search_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_AsyncFileStorage_Suite_1, Delete_v2)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey + 1; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_AsyncFileStorage_Suite_1, Flush_Search_v1)
+    {
+        for (int nCntr = nBulkInsert_EndKey; nCntr >= nBulkInsert_StartKey; nCntr--)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_AsyncFileStorage_Suite_1, Overlapped_Reads_v1)
+    {
+        std::filesystem::path fsObjects = std::filesystem::temp_directory_path() / "tempasyncobjects.hdb";
+        StorageType storage(nFileStoreBlockSize, nFileStoreSize, fsObjects.string());
+
+        // More nodes than the ring has entries, so that queueing also has to wait for earlier reads to complete.
+        std::vector<ObjectUIDType> vtUIDs;
+        for (int nNode = 0; nNode < 2 * StorageType::DEFAULT_QUEUE_DEPTH + 1; nNode++)
+        {
+            std::shared_ptr<DataNodeType> ptrNode = std::make_shared<DataNodeType>();
+            for (int nKey = 0; nKey < nDegree; nKey++)
+            {
+                ptrNode->insert(nNode * nDegree + nKey, nNode);
+            }
+
+            ObjectUIDType uidNode;
+            ASSERT_EQ(storage.addObject(uidNode, std::make_shared<ObjectType>(ptrNode), uidNode), CacheErrorCode::Success);
+
+            vtUIDs.push_back(uidNode);
+        }
+
+        std::vector<std::future<std::shared_ptr<ObjectType>>> vtReads;
+        for (auto& uidNode : vtUIDs)
+        {
+            vtReads.push_back(storage.getObjectAsync(uidNode));
+        }
+
+        for (int nNode = vtReads.size() - 1; nNode >= 0; nNode--)
+        {
+            std::shared_ptr<ObjectType> ptrObject = vtReads[nNode].get();
+            ASSERT_NE(ptrObject, nullptr);
+            ASSERT_FALSE(ptrObject->dirty);
+
+            std::shared_ptr<DataNodeType> ptrNode = std::get<std::shared_ptr<DataNodeType>>(*ptrObject->data);
+            for (int nKey = 0; nKey < nDegree; nKey++)
+            {
+                int nValue = -1;
+                ASSERT_EQ(ptrNode->getValue(nNode * nDegree + nKey, nValue), ErrorCode::Success);
+                ASSERT_EQ(nValue, nNode);
+            }
+        }
+
+        std::filesystem::remove(fsObjects);
+    }
+
+    INSTANTIATE_TEST_CASE_P(
+        Insert_Search_Delete_Flush,
+        BPlusStore_LRUCache_AsyncFileStorage_Suite_1,
+        ::testing::Values(
+            std::make_tuple(3, 0, 99999, 100, 1024, 1024 * 1024 * 1024),
+            std::make_tuple(8, 0, 99999, 100, 1024, 1024 * 1024 * 1024),
+            std::make_tuple(16, 0, 199999, 100, 1024, 1024 * 1024 * 1024),
+            std::make_tuple(64, 0, 199999, 100, 2048, 1024 * 1024 * 1024)
+        ));
+}
+#endif __TREE_WITH_CACHE__
@@ -0,0 +1,323 @@
+#include "pch.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <variant>
+#include <typeinfo>
+#include <type_traits>
+
+#include "glog/logging.h"
+
+#include "LRUCache.hpp"
+#include "ShardedLRUCache.hpp"
+#include "EvictionPolicy.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "LRUCacheObject.hpp"
+#include "ObjectPin.hpp"
+#include "VolatileStorage.hpp"
+#include "TypeMarshaller.hpp"
+#include "TypeUID.h"
+#include "ObjectFatUID.h"
+
+#ifdef __TREE_WITH_CACHE__
+namespace BPlusStore_LRUCache_EvictionPolicy_Suite
+{
+    typedef int KeyType;
+    typedef int ValueType;
+    typedef ObjectFatUID ObjectUIDType;
+
+    typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT > DataNodeType;
+    typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT > InternalNodeType;
+
+    typedef LRUCacheObject<TypeMarshaller, DataNodeType, InternalNodeType> ObjectType;
+    typedef IFlushCallback<ObjectUIDType, ObjectType> ICallback;
+
+    typedef VolatileStorage<ICallback, ObjectUIDType, LRUCacheObject, TypeMarshaller, DataNodeType, InternalNodeType> StorageType;
+
+    typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, StorageType, LRUPolicy<ObjectUIDType>>> LRUStoreType;
+    typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, StorageType, CLOCKPolicy<ObjectUIDType>>> CLOCKStoreType;
+    typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, StorageType, TwoQPolicy<ObjectUIDType>>> TwoQStoreType;
+    typedef BPlusStore<ICallback, KeyType, ValueType, LRUCache<ICallback, StorageType, ARCPolicy<ObjectUIDType>>> ARCStoreType;
+    typedef BPlusStore<ICallback, KeyType, ValueType, ShardedLRUCache<ICallback, StorageType, ARCPolicy<ObjectUIDType>>> ShardedARCStoreType;
+
+    class BPlusStore_LRUCache_EvictionPolicy_Suite_1 : public ::testing::TestWithParam<std::tuple<int, int, int, int, int>>
+    {
+    protected:
+        void SetUp() override
+        {
+            std::tie(nDegree, nTotalEntries, nCacheSize, nBlockSize, nStorageSize) = GetParam();
+        }
+
+        template <typename StoreType>
+        void insert_search_delete()
+        {
+            StoreType* ptrTree = new StoreType(nDegree, nCacheSize, nBlockSize, nStorageSize);
+            ptrTree->template init<DataNodeType>();
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                ptrTree->insert(nCntr, nCntr);
+            }
+
+            // Reverse order, so that the lookups start at the other end of the trees than the inserts ended.
+            for (int nCntr = nTotalEntries - 1; nCntr >= 0; nCntr--)
+            {
+                int nValue = 0;
+                ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                ASSERT_EQ(nCntr, nValue);
+            }
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr += 2)
+            {
+                ErrorCode code = ptrTree->remove(nCntr);
+            }
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                int nValue = 0;
+                ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                if (nCntr % 2 == 0)
+                {
+                    ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+                }
+                else
+                {
+                    ASSERT_EQ(nCntr, nValue);
+                }
+            }
+
+            size_t nLRU, nMap;
+            ptrTree->getCacheState(nLRU, nMap);
+
+            ASSERT_EQ(nLRU, nMap);
+
+            delete ptrTree;
+        }
+
+        // A shard may have to hold a parent back for a child that is still resident on another shard, bStrict is false for those.
+        template <typename StoreType>
+        void pinned_leaf(bool bStrict = true)
+        {
+            StoreType* ptrTree = new StoreType(nDegree, nCacheSize, nBlockSize, nStorageSize);
+            ptrTree->template init<DataNodeType>();
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                ptrTree->insert(nCntr, nCntr);
+            }
+
+            // The leaf of the first key turns into the coldest object once the rest are read, the caches have to step
+            // over it and keep evicting.
+            ObjectPin<std::shared_ptr<ObjectType>> pin;
+            ASSERT_EQ(ptrTree->pinLeaf(0, pin), ErrorCode::Success);
+            ASSERT_NE(pin.get(), nullptr);
+
+            for (int nCntr = nTotalEntries - 1; nCntr >= 0; nCntr--)
+            {
+                int nValue = 0;
+                ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                ASSERT_EQ(nCntr, nValue);
+            }
+
+#ifndef __CONCURRENT__
+            // The flusher thread evicts at its own pace under __CONCURRENT__.
+            CacheStats stats;
+            ptrTree->getCacheStats(stats);
+
+            ASSERT_GT(stats.m_nPinnedSkips, 0);
+            if (bStrict)
+            {
+                ASSERT_EQ(stats.m_nEvictionStalls, 0);
+                ASSERT_LE(stats.m_nObjects, nCacheSize);
+            }
+#endif __CONCURRENT__
+
+            pin.release();
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                int nValue = 0;
+                ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                ASSERT_EQ(nCntr, nValue);
+            }
+
+            delete ptrTree;
+        }
+
+#ifdef __CONCURRENT__
+        template <typename StoreType>
+        void flusher_drains()
+        {
+            StoreType* ptrTree = new StoreType(nDegree, nCacheSize, nBlockSize, nStorageSize);
+            ptrTree->template init<DataNodeType>();
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                ptrTree->insert(nCntr, nCntr);
+            }
+
+            // Nothing is in use anymore, the flusher the last inserts woke has to bring the cache back within bounds.
+            CacheStats stats;
+            for (int nWait = 0; nWait < 500; nWait++)
+            {
+                ptrTree->getCacheStats(stats);
+                if (stats.m_nObjects <= nCacheSize)
+                {
+                    break;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            ASSERT_LE(stats.m_nObjects, nCacheSize);
+            ASSERT_GT(stats.m_nFlushedObjects, 0);
+            ASSERT_GE(stats.m_nFlushBatch, FLUSH_COUNT);
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                int nValue = 0;
+                ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                ASSERT_EQ(nCntr, nValue);
+            }
+
+            delete ptrTree;
+        }
+
+        // Every thread reads the same keys in the same order, so they miss on the same evicted nodes at about the same time.
+        template <typename StoreType>
+        void concurrent_misses()
+        {
+            StoreType* ptrTree = new StoreType(nDegree, nCacheSize, nBlockSize, nStorageSize);
+            ptrTree->template init<DataNodeType>();
+
+            for (int nCntr = 0; nCntr < nTotalEntries; nCntr++)
+            {
+                ptrTree->insert(nCntr, nCntr);
+            }
+
+            std::atomic<int> nMismatches(0);
+            std::vector<std::thread> vtThreads;
+            for (int nThread = 0; nThread < 8; nThread++)
+            {
+                vtThreads.emplace_back([ptrTree, &nMismatches, this]()
+                    {
+                        for (int nCntr = nTotalEntries - 1; nCntr >= 0; nCntr--)
+                        {
+                            int nValue = 0;
+                            ErrorCode code = ptrTree->search(nCntr, nValue);
+
+                            if (code != ErrorCode::Success || nValue != nCntr)
+                            {
+                                nMismatches++;
+                            }
+                        }
+                    });
+            }
+
+            for (auto& thread : vtThreads)
+            {
+                thread.join();
+            }
+
+            ASSERT_EQ(nMismatches, 0);
+
+            size_t nLRU, nMap;
+            ptrTree->getCacheState(nLRU, nMap);
+
+            ASSERT_EQ(nLRU, nMap);
+
+            delete ptrTree;
+        }
+#endif __CONCURRENT__
+
+        int nDegree;
+        int nTotalEntries;
+        int nCacheSize;
+        int nBlockSize;
+        int nStorageSize;
+    };
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, CLOCK_v1)
+    {
+        insert_search_delete<CLOCKStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, TwoQ_v1)
+    {
+        insert_search_delete<TwoQStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, ARC_v1)
+    {
+        insert_search_delete<ARCStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, Sharded_ARC_v1)
+    {
+        insert_search_delete<ShardedARCStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, LRU_Pinned_v1)
+    {
+        pinned_leaf<LRUStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, CLOCK_Pinned_v1)
+    {
+        pinned_leaf<CLOCKStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, TwoQ_Pinned_v1)
+    {
+        pinned_leaf<TwoQStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, ARC_Pinned_v1)
+    {
+        pinned_leaf<ARCStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, Sharded_ARC_Pinned_v1)
+    {
+        pinned_leaf<ShardedARCStoreType>(false);
+    }
+
+#ifdef __CONCURRENT__
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, LRU_Flusher_v1)
+    {
+        flusher_drains<LRUStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, Sharded_ARC_Flusher_v1)
+    {
+        flusher_drains<ShardedARCStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, LRU_Concurrent_Misses_v1)
+    {
+        concurrent_misses<LRUStoreType>();
+    }
+
+    TEST_P(BPlusStore_LRUCache_EvictionPolicy_Suite_1, Sharded_ARC_Concurrent_Misses_v1)
+    {
+        concurrent_misses<ShardedARCStoreType>();
+    }
+#endif __CONCURRENT__
+
+    INSTANTIATE_TEST_CASE_P(
+        Insert_Search_Delete,
+        BPlusStore_LRUCache_EvictionPolicy_Suite_1,
+        ::testing::Values(
+            std::make_tuple(3, 49999, 100, 1024, 900000000),
+            std::make_tuple(8, 49999, 100, 1024, 900000000),
+            std::make_tuple(64, 99999, 100, 1024, 900000000)));
+}
+#endif __TREE_WITH_CACHE__
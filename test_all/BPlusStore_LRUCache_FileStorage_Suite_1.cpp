@@ -8,6 +8,8 @@
 #include <type_traits>
 #include <fstream>
 #include <filesystem>
+#include <thread>
+#include <atomic>
 
 #include "glog/logging.h"
 
@@ -53,6 +55,7 @@ namespace BPlusStore_LRUCache_FileStorage_Suite
         {
             delete m_ptrTree;
             std::filesystem::remove(fsTempFileStore);
+            std::filesystem::remove(fsTempLog);
         }
 
         BPlusStoreType* m_ptrTree = nullptr;
@@ -65,6 +68,7 @@ namespace BPlusStore_LRUCache_FileStorage_Suite
         int nFileStoreSize;
 
         std::filesystem::path fsTempFileStore = std::filesystem::temp_directory_path() / "tempfilestore.hdb";
+        std::filesystem::path fsTempLog = std::filesystem::temp_directory_path() / "tempfilestore.wal";
     };
 
     TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Insert_v1) 
@@ -247,6 +251,226 @@ namespace BPlusStore_LRUCache_FileStorage_Suite
         }
     }
 
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Scan_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nBulkInsert_StartKey;
+        ErrorCode code = m_ptrTree->scan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nBulkInsert_EndKey + 1);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->remove(nCntr);
+        }
+
+        int nBegin = nBulkInsert_StartKey + (nBulkInsert_EndKey - nBulkInsert_StartKey) / 4;
+        int nEnd = nBulkInsert_EndKey - (nBulkInsert_EndKey - nBulkInsert_StartKey) / 4;
+
+        nExpected = nBegin + ((nBegin - nBulkInsert_StartKey) % 2 == 0 ? 1 : 0);
+        m_ptrTree->scan(nBegin, nEnd, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected = nExpected + 2;
+            return true;
+        });
+
+        ASSERT_GE(nExpected, nEnd);
+        ASSERT_LE(nExpected, nEnd + 1);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Scan_v2)
+    {
+        for (int nCntr = nBulkInsert_EndKey; nCntr >= nBulkInsert_StartKey; nCntr--)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nBulkInsert_EndKey;
+        ErrorCode code = m_ptrTree->reverseScan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected--;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nBulkInsert_StartKey - 1);
+
+        int nCount = 0;
+        nExpected = nBulkInsert_EndKey / 2 - 1;
+        m_ptrTree->reverseScan(nBulkInsert_StartKey, nBulkInsert_EndKey / 2, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected--;
+            return ++nCount < 10;
+        });
+
+        ASSERT_EQ(nCount, 10);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, BulkLoad_v1)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end());
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        int nExpected = nBulkInsert_StartKey;
+        m_ptrTree->scan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(nExpected, nBulkInsert_EndKey + 1);
+
+        ASSERT_EQ(m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end()), ErrorCode::Error);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, BulkLoad_v2)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end(), 0.7f);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey + 1; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, InsertBatch_v1)
+    {
+        std::vector<std::pair<int, int>> vtBatch;
+        for (int nCntr = nBulkInsert_EndKey; nCntr >= nBulkInsert_StartKey; nCntr--)
+        {
+            vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+            if (vtBatch.size() == 5000 || nCntr == nBulkInsert_StartKey)
+            {
+                ErrorCode code = m_ptrTree->insertBatch(vtBatch);
+                ASSERT_EQ(code, ErrorCode::Success);
+
+                vtBatch.clear();
+            }
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, InsertBatch_v2)
+    {
+        for (int nRound = 0; nRound < 2; nRound++)
+        {
+            std::vector<std::pair<int, int>> vtBatch;
+            for (int nCntr = nBulkInsert_StartKey + nRound; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+            {
+                vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+                if (vtBatch.size() == 10000)
+                {
+                    m_ptrTree->insertBatch(vtBatch);
+                    vtBatch.clear();
+                }
+            }
+
+            m_ptrTree->insertBatch(vtBatch);
+        }
+
+        std::vector<int> vtKeys;
+        for (int nCntr = nBulkInsert_EndKey + 100; nCntr >= nBulkInsert_StartKey; nCntr = nCntr - 3)
+        {
+            vtKeys.push_back(nCntr);
+        }
+
+        std::vector<int> vtValues;
+        std::vector<ErrorCode> vtResults;
+        ErrorCode code = m_ptrTree->searchBatch(vtKeys, vtValues, vtResults);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(vtValues.size(), vtKeys.size());
+
+        for (size_t nIdx = 0; nIdx < vtKeys.size(); nIdx++)
+        {
+            if (vtKeys[nIdx] > nBulkInsert_EndKey)
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::Success);
+                ASSERT_EQ(vtValues[nIdx], vtKeys[nIdx]);
+            }
+        }
+    }
+
     TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Flush_v1)
     {
         for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
@@ -285,6 +509,495 @@ namespace BPlusStore_LRUCache_FileStorage_Suite
         ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
     }
 
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Delete_EvictionCounters)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        CacheStats stats;
+        m_ptrTree->getCacheStats(stats);
+
+#ifndef __CONCURRENT__
+        // The nodes the searches brought back in were only read, so they are dropped without a write.
+        ASSERT_GT(stats.m_nCleanEvictions, 0);
+#endif __CONCURRENT__
+
+        // Siblings are only read unless they lend an entry or absorb the child; whatever is not marked must stay intact.
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            if ((nCntr - nBulkInsert_StartKey) % 2 == 0)
+            {
+                ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(nValue, nCntr);
+            }
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Flush_Search_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        // The flush relocates the resident nodes; the references swizzled by the inserts must not be followed anymore.
+        ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey + 1; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Reclaim_Rewrite_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+
+        CacheStats stats;
+        m_ptrTree->getCacheStats(stats);
+
+        size_t nWrittenOnce = stats.m_nStorageBlocks;
+
+        // Every round rewrites every leaf; the locations they move away from have to be reused.
+        for (int nRound = 0; nRound < 4; nRound++)
+        {
+            for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+            {
+                ASSERT_EQ(m_ptrTree->remove(nCntr), ErrorCode::Success);
+            }
+
+            for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+            {
+                m_ptrTree->insert(nCntr, nCntr);
+            }
+
+            ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        m_ptrTree->getCacheStats(stats);
+
+        ASSERT_GT(stats.m_nStorageUsedBlocks, 0);
+        ASSERT_LE(stats.m_nStorageUsedBlocks + stats.m_nStorageFreeBlocks, stats.m_nStorageBlocks);
+        ASSERT_GE(stats.m_dStorageFragmentation, 0.0);
+        ASSERT_LT(stats.m_dStorageFragmentation, 1.0);
+        ASSERT_LT(stats.m_nStorageBlocks, 2 * nWrittenOnce);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Log_Replay_v1)
+    {
+        std::filesystem::remove(fsTempLog);
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::None), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ASSERT_EQ(m_ptrTree->remove(nCntr), ErrorCode::Success);
+        }
+
+        // Nothing flushed or committed, the log is all there is.
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, nFileStoreBlockSize, nFileStoreSize, fsTempFileStore.string());
+        m_ptrTree->init<DataNodeType>();
+
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::None), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            if (nCntr % 2 == nBulkInsert_StartKey % 2)
+            {
+                ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(nValue, nCntr);
+            }
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Log_TornTail_v1)
+    {
+        const size_t nOperations = 1000;
+
+        std::filesystem::remove(fsTempLog);
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::PerBatch), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr < nBulkInsert_StartKey + nOperations; nCntr++)
+        {
+            ASSERT_EQ(m_ptrTree->insert(nCntr, nCntr), ErrorCode::Success);
+        }
+
+        uint64_t nRecords = 0, nSyncs = 0;
+        m_ptrTree->getLogStats(nRecords, nSyncs);
+
+        ASSERT_EQ(nRecords, nOperations);
+        ASSERT_EQ(nSyncs, nOperations);
+
+        delete m_ptrTree;
+
+        // The last record only made it half way.
+        std::filesystem::resize_file(fsTempLog, std::filesystem::file_size(fsTempLog) - 3);
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, nFileStoreBlockSize, nFileStoreSize, fsTempFileStore.string());
+        m_ptrTree->init<DataNodeType>();
+
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::PerBatch), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr < nBulkInsert_StartKey + nOperations - 1; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        int nValue = 0;
+        ASSERT_EQ(m_ptrTree->search(nBulkInsert_StartKey + nOperations - 1, nValue), ErrorCode::KeyDoesNotExist);
+
+        // Appended after the cut, the log goes on in sequence.
+        ASSERT_EQ(m_ptrTree->insert(nBulkInsert_StartKey + nOperations - 1, 0), ErrorCode::Success);
+
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, nFileStoreBlockSize, nFileStoreSize, fsTempFileStore.string());
+        m_ptrTree->init<DataNodeType>();
+
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::PerBatch), ErrorCode::Success);
+
+        ASSERT_EQ(m_ptrTree->search(nBulkInsert_StartKey + nOperations - 1, nValue), ErrorCode::Success);
+        ASSERT_EQ(nValue, 0);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Reopen_Search_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->commit(), ErrorCode::Success);
+
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        // The reopened tree writes around the blocks the first one left in use.
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ASSERT_EQ(m_ptrTree->remove(nCntr), ErrorCode::Success);
+        }
+
+        ASSERT_EQ(m_ptrTree->commit(), ErrorCode::Success);
+
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            if ((nCntr - nBulkInsert_StartKey) % 2 == 0)
+            {
+                ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(nValue, nCntr);
+            }
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Reopen_Uncommitted_v1)
+    {
+        m_ptrTree->insert(nBulkInsert_StartKey, nBulkInsert_StartKey);
+
+        ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+
+        delete m_ptrTree;
+
+        // Never committed, there is no root to open with.
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Error);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Commit_Crash_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->commit(), ErrorCode::Success);
+
+        // Written out by evictions and a flush but not committed; none of it may land on the blocks of the committed tree.
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ASSERT_EQ(m_ptrTree->remove(nCntr), ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_EndKey + 1; nCntr <= nBulkInsert_EndKey + (nBulkInsert_EndKey - nBulkInsert_StartKey) / 2; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->flush(), ErrorCode::Success);
+
+        // Gone without a commit, as after a crash.
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        int nValue = 0;
+        ASSERT_EQ(m_ptrTree->search(nBulkInsert_EndKey + 1, nValue), ErrorCode::KeyDoesNotExist);
+    }
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Log_Commit_v1)
+    {
+        size_t nMiddleKey = (nBulkInsert_StartKey + nBulkInsert_EndKey) / 2;
+
+        std::filesystem::remove(fsTempLog);
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::None), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nMiddleKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(m_ptrTree->commit(), ErrorCode::Success);
+
+        // Emptied by the commit.
+        size_t nEmptyLog = std::filesystem::file_size(fsTempLog);
+
+        for (size_t nCntr = nMiddleKey + 1; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nMiddleKey; nCntr = nCntr + 2)
+        {
+            ASSERT_EQ(m_ptrTree->remove(nCntr), ErrorCode::Success);
+        }
+
+        delete m_ptrTree;
+
+        ASSERT_GT(std::filesystem::file_size(fsTempLog), nEmptyLog);
+
+        // The committed half from the store, the rest from the log.
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Success);
+        ASSERT_EQ(m_ptrTree->openLog(fsTempLog.string(), WALSyncMode::None), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            if (nCntr <= nMiddleKey && nCntr % 2 == nBulkInsert_StartKey % 2)
+            {
+                ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(nValue, nCntr);
+            }
+        }
+    }
+
+#ifdef __CONCURRENT__
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, Checkpoint_Concurrent_v1)
+    {
+        const int nThreads = 4;
+
+        std::atomic<bool> bDone = false;
+
+        std::vector<std::thread> vtThreads;
+        for (int nThread = 0; nThread < nThreads; nThread++)
+        {
+            vtThreads.emplace_back([this, nThread, nThreads]()
+                {
+                    for (size_t nCntr = nBulkInsert_StartKey + nThread; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + nThreads)
+                    {
+                        m_ptrTree->insert(nCntr, nCntr);
+                    }
+                });
+        }
+
+        // Taken while the writers go on, each one supersedes whatever is left of the one before.
+        std::thread threadCheckpoints([this, &bDone]()
+            {
+                while (!bDone)
+                {
+                    m_ptrTree->waitForCheckpoint(m_ptrTree->checkpoint());
+                }
+            });
+
+        for (auto& thread : vtThreads)
+        {
+            thread.join();
+        }
+
+        bDone = true;
+        threadCheckpoints.join();
+
+        CheckpointProgress progress;
+        m_ptrTree->getCheckpointProgress(progress);
+
+        ASSERT_GT(progress.m_nCompleted, 0);
+
+        // Throttled, the last one still writes out everything that was dirty when it began.
+        m_ptrTree->setCheckpointRate(100000);
+
+        size_t nEpoch = m_ptrTree->checkpoint();
+        m_ptrTree->waitForCheckpoint(nEpoch);
+
+        m_ptrTree->getCheckpointProgress(progress);
+
+        ASSERT_EQ(progress.m_nEpoch, nEpoch);
+        ASSERT_FALSE(progress.m_bActive);
+        ASSERT_GT(progress.m_nPasses, 0);
+        ASSERT_GT(progress.m_nWritten, 0);
+        ASSERT_EQ(progress.m_nSkipped, 0);
+        ASSERT_EQ(progress.m_nRate, 100000);
+
+        ASSERT_EQ(m_ptrTree->commit(), ErrorCode::Success);
+
+        delete m_ptrTree;
+
+        m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, fsTempFileStore.string());
+        ASSERT_EQ(m_ptrTree->open(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+    }
+#endif __CONCURRENT__
+
+    TEST_P(BPlusStore_LRUCache_FileStorage_Suite_1, DirectIO_Flush_Search_v1)
+    {
+        // Its own tree, on an O_DIRECT file; the block size is rounded up to the alignment by the storage.
+        std::filesystem::path fsDirectFileStore = std::filesystem::temp_directory_path() / "tempdirectfilestore.hdb";
+        BPlusStoreType* ptrTree = new BPlusStoreType(nDegree, nCacheSize, nFileStoreBlockSize, nFileStoreSize, fsDirectFileStore.string(), true);
+        ptrTree->init<DataNodeType>();
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ptrTree->insert(nCntr, nCntr);
+        }
+
+        ASSERT_EQ(ptrTree->flush(), ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            ErrorCode code = ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = ptrTree->search(nCntr, nValue);
+
+            if ((nCntr - nBulkInsert_StartKey) % 2 == 0)
+            {
+                ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(nValue, nCntr);
+            }
+        }
+
+        delete ptrTree;
+        std::filesystem::remove(fsDirectFileStore);
+    }
+
     INSTANTIATE_TEST_CASE_P(
         Insert_Search_Delete_Flush,
         BPlusStore_LRUCache_FileStorage_Suite_1,
@@ -240,6 +240,262 @@ namespace BPlusStore_LRUCache_VolatileStorage_Suite
         }
     }
 
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, Scan_v1)
+    {
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nBulkInsert_StartKey;
+        ErrorCode code = m_ptrTree->scan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nBulkInsert_EndKey + 1);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->remove(nCntr);
+        }
+
+        int nBegin = nBulkInsert_StartKey + (nBulkInsert_EndKey - nBulkInsert_StartKey) / 4;
+        int nEnd = nBulkInsert_EndKey - (nBulkInsert_EndKey - nBulkInsert_StartKey) / 4;
+
+        nExpected = nBegin + ((nBegin - nBulkInsert_StartKey) % 2 == 0 ? 1 : 0);
+        m_ptrTree->scan(nBegin, nEnd, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected = nExpected + 2;
+            return true;
+        });
+
+        ASSERT_GE(nExpected, nEnd);
+        ASSERT_LE(nExpected, nEnd + 1);
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, Scan_v2)
+    {
+        for (int nCntr = nBulkInsert_EndKey; nCntr >= nBulkInsert_StartKey; nCntr--)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nBulkInsert_EndKey;
+        ErrorCode code = m_ptrTree->reverseScan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected--;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nBulkInsert_StartKey - 1);
+
+        int nCount = 0;
+        nExpected = nBulkInsert_EndKey / 2 - 1;
+        m_ptrTree->reverseScan(nBulkInsert_StartKey, nBulkInsert_EndKey / 2, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected--;
+            return ++nCount < 10;
+        });
+
+        ASSERT_EQ(nCount, 10);
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, BulkLoad_v1)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end());
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        int nExpected = nBulkInsert_StartKey;
+        m_ptrTree->scan(nBulkInsert_StartKey, nBulkInsert_EndKey + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(nExpected, nBulkInsert_EndKey + 1);
+
+        ASSERT_EQ(m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end()), ErrorCode::Error);
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, BulkLoad_v2)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end(), 0.7f);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBulkInsert_StartKey + 1; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, InsertBatch_v1)
+    {
+        std::vector<std::pair<int, int>> vtBatch;
+        for (int nCntr = nBulkInsert_EndKey; nCntr >= nBulkInsert_StartKey; nCntr--)
+        {
+            vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+            if (vtBatch.size() == 5000 || nCntr == nBulkInsert_StartKey)
+            {
+                ErrorCode code = m_ptrTree->insertBatch(vtBatch);
+                ASSERT_EQ(code, ErrorCode::Success);
+
+                vtBatch.clear();
+            }
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, InsertBatch_v2)
+    {
+        for (int nRound = 0; nRound < 2; nRound++)
+        {
+            std::vector<std::pair<int, int>> vtBatch;
+            for (int nCntr = nBulkInsert_StartKey + nRound; nCntr <= nBulkInsert_EndKey; nCntr = nCntr + 2)
+            {
+                vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+                if (vtBatch.size() == 10000)
+                {
+                    m_ptrTree->insertBatch(vtBatch);
+                    vtBatch.clear();
+                }
+            }
+
+            m_ptrTree->insertBatch(vtBatch);
+        }
+
+        std::vector<int> vtKeys;
+        for (int nCntr = nBulkInsert_EndKey + 100; nCntr >= nBulkInsert_StartKey; nCntr = nCntr - 3)
+        {
+            vtKeys.push_back(nCntr);
+        }
+
+        std::vector<int> vtValues;
+        std::vector<ErrorCode> vtResults;
+        ErrorCode code = m_ptrTree->searchBatch(vtKeys, vtValues, vtResults);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(vtValues.size(), vtKeys.size());
+
+        for (size_t nIdx = 0; nIdx < vtKeys.size(); nIdx++)
+        {
+            if (vtKeys[nIdx] > nBulkInsert_EndKey)
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::Success);
+                ASSERT_EQ(vtValues[nIdx], vtKeys[nIdx]);
+            }
+        }
+    }
+
+    TEST_P(BPlusStore_LRUCache_VolatileStorage_Suite_1, ByteBudget_v1)
+    {
+        // Room for a few dozen full nodes (more than a root-to-leaf path), below the object capacity for the larger degrees.
+        size_t nNodeBytes = sizeof(uint8_t) + 2 * sizeof(size_t) + nDegree * (sizeof(KeyType) + sizeof(ValueType));
+        m_ptrTree->setCacheByteBudget(64 * nNodeBytes, 48 * nNodeBytes);
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        CacheStats stats;
+        m_ptrTree->getCacheStats(stats);
+
+#ifndef __CONCURRENT__
+        // With __CONCURRENT__ the flusher thread catches up with the budget in the background.
+        ASSERT_LE(stats.m_nResidentBytes, stats.m_nHighWatermarkBytes);
+        ASSERT_LE(stats.m_nObjects, nCacheSize);
+#endif __CONCURRENT__
+
+        for (size_t nCntr = nBulkInsert_StartKey; nCntr <= nBulkInsert_EndKey; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        m_ptrTree->getCacheStats(stats);
+
+#ifndef __CONCURRENT__
+        ASSERT_LE(stats.m_nResidentBytes, stats.m_nHighWatermarkBytes);
+#endif __CONCURRENT__
+        ASSERT_GT(stats.m_nResidentBytes, 0);
+    }
+
     INSTANTIATE_TEST_CASE_P(
         Insert_Search_Delete,
         BPlusStore_LRUCache_VolatileStorage_Suite_1,
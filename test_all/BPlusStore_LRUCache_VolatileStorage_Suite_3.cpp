@@ -317,16 +317,16 @@ namespace BPlusStore_LRUCache_VolatileStorage_Suite
         Insert_Search_Delete,
         BPlusStore_LRUCache_VolatileStorage_Suite_3,
         ::testing::Values(
-            std::make_tuple(3, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(4, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(5, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(6, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(7, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(8, 2, 99999, 100, 1024, 20000000),
-            std::make_tuple(15, 2, 199999, 100, 1024, 20000000),
-            std::make_tuple(16, 2, 199999, 100, 1024, 20000000),
-            std::make_tuple(32, 2, 199999, 100, 1024, 20000000),
-            std::make_tuple(64, 2, 199999, 100, 1024, 20000000)));
+            std::make_tuple(3, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(4, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(5, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(6, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(7, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(8, 2, 99999, 100, 1024, 200000000),
+            std::make_tuple(15, 2, 199999, 100, 1024, 200000000),
+            std::make_tuple(16, 2, 199999, 100, 1024, 200000000),
+            std::make_tuple(32, 2, 199999, 100, 1024, 200000000),
+            std::make_tuple(64, 2, 199999, 100, 1024, 200000000)));
 #endif __CONCURRENT__
 }
 #endif __TREE_WITH_CACHE__
\ No newline at end of file
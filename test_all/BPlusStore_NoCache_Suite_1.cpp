@@ -230,6 +230,226 @@ namespace BPlusStore_NoCache_Suite
         }
     }
 
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_Scan_v1)
+    {
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nBegin_BulkInsert;
+        ErrorCode code = m_ptrTree->scan(nBegin_BulkInsert, nEnd_BulkInsert + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nEnd_BulkInsert + 1);
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr = nCntr + 2)
+        {
+            m_ptrTree->remove(nCntr);
+        }
+
+        int nBegin = nBegin_BulkInsert + (nEnd_BulkInsert - nBegin_BulkInsert) / 4;
+        int nEnd = nEnd_BulkInsert - (nEnd_BulkInsert - nBegin_BulkInsert) / 4;
+
+        nExpected = nBegin + ((nBegin - nBegin_BulkInsert) % 2 == 0 ? 1 : 0);
+        m_ptrTree->scan(nBegin, nEnd, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected = nExpected + 2;
+            return true;
+        });
+
+        ASSERT_GE(nExpected, nEnd);
+        ASSERT_LE(nExpected, nEnd + 1);
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_Scan_v2)
+    {
+        for (int nCntr = nEnd_BulkInsert; nCntr >= nBegin_BulkInsert; nCntr--)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        int nExpected = nEnd_BulkInsert;
+        ErrorCode code = m_ptrTree->reverseScan(nBegin_BulkInsert, nEnd_BulkInsert + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            EXPECT_EQ(value, nExpected);
+            nExpected--;
+            return true;
+        });
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(nExpected, nBegin_BulkInsert - 1);
+
+        int nCount = 0;
+        nExpected = nEnd_BulkInsert / 2 - 1;
+        m_ptrTree->reverseScan(nBegin_BulkInsert, nEnd_BulkInsert / 2, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected--;
+            return ++nCount < 10;
+        });
+
+        ASSERT_EQ(nCount, 10);
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_BulkLoad_v1)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end());
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        int nExpected = nBegin_BulkInsert;
+        m_ptrTree->scan(nBegin_BulkInsert, nEnd_BulkInsert + 1, [&](const int& key, const int& value) {
+            EXPECT_EQ(key, nExpected);
+            nExpected++;
+            return true;
+        });
+
+        ASSERT_EQ(nExpected, nEnd_BulkInsert + 1);
+
+        ASSERT_EQ(m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end()), ErrorCode::Error);
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_BulkLoad_v2)
+    {
+        std::vector<std::pair<int, int>> vtEntries;
+        for (int nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr = nCntr + 2)
+        {
+            vtEntries.push_back(std::make_pair(nCntr, nCntr));
+        }
+
+        ErrorCode code = m_ptrTree->bulkLoad(vtEntries.begin(), vtEntries.end(), 0.7f);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+
+        for (size_t nCntr = nBegin_BulkInsert + 1; nCntr <= nEnd_BulkInsert; nCntr = nCntr + 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::KeyDoesNotExist);
+        }
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_InsertBatch_v1)
+    {
+        std::vector<std::pair<int, int>> vtBatch;
+        for (int nCntr = nEnd_BulkInsert; nCntr >= nBegin_BulkInsert; nCntr--)
+        {
+            vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+            if (vtBatch.size() == 5000 || nCntr == nBegin_BulkInsert)
+            {
+                ErrorCode code = m_ptrTree->insertBatch(vtBatch);
+                ASSERT_EQ(code, ErrorCode::Success);
+
+                vtBatch.clear();
+            }
+        }
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = m_ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+            ASSERT_EQ(nValue, nCntr);
+        }
+
+        for (size_t nCntr = nBegin_BulkInsert; nCntr <= nEnd_BulkInsert; nCntr++)
+        {
+            ErrorCode code = m_ptrTree->remove(nCntr);
+
+            ASSERT_EQ(code, ErrorCode::Success);
+        }
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_1, Bulk_InsertBatch_v2)
+    {
+        for (int nRound = 0; nRound < 2; nRound++)
+        {
+            std::vector<std::pair<int, int>> vtBatch;
+            for (int nCntr = nBegin_BulkInsert + nRound; nCntr <= nEnd_BulkInsert; nCntr = nCntr + 2)
+            {
+                vtBatch.push_back(std::make_pair(nCntr, nCntr));
+
+                if (vtBatch.size() == 10000)
+                {
+                    m_ptrTree->insertBatch(vtBatch);
+                    vtBatch.clear();
+                }
+            }
+
+            m_ptrTree->insertBatch(vtBatch);
+        }
+
+        std::vector<int> vtKeys;
+        for (int nCntr = nEnd_BulkInsert + 100; nCntr >= nBegin_BulkInsert; nCntr = nCntr - 3)
+        {
+            vtKeys.push_back(nCntr);
+        }
+
+        std::vector<int> vtValues;
+        std::vector<ErrorCode> vtResults;
+        ErrorCode code = m_ptrTree->searchBatch(vtKeys, vtValues, vtResults);
+
+        ASSERT_EQ(code, ErrorCode::Success);
+        ASSERT_EQ(vtValues.size(), vtKeys.size());
+
+        for (size_t nIdx = 0; nIdx < vtKeys.size(); nIdx++)
+        {
+            if (vtKeys[nIdx] > nEnd_BulkInsert)
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::KeyDoesNotExist);
+            }
+            else
+            {
+                ASSERT_EQ(vtResults[nIdx], ErrorCode::Success);
+                ASSERT_EQ(vtValues[nIdx], vtKeys[nIdx]);
+            }
+        }
+    }
+
     INSTANTIATE_TEST_CASE_P(
         Bulk_Insert_Search_Delete,
         BPlusStore_NoCache_Suite_1,
@@ -88,6 +88,58 @@ namespace BPlusStore_NoCache_Suite
         }
     }
 
+    void insert_odd_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd) 
+    {
+        for (int nCntr = nRangeStart | 1; nCntr < nRangeEnd; nCntr += 2)
+        {
+            ptrTree->insert(nCntr, nCntr);
+        }
+    }
+
+    void search_even_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd) 
+    {
+        for (int nCntr = (nRangeStart + 1) & ~1; nCntr < nRangeEnd; nCntr += 2)
+        {
+            int nValue = 0;
+            ErrorCode errCode = ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(errCode, ErrorCode::Success);
+            ASSERT_EQ(nCntr, nValue);
+        }
+    }
+
+    void scan_even_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd, bool bReverse) 
+    {
+        // Odd keys come and go with the concurrent inserts; the even ones must show up exactly once and in order.
+        int nExpected = bReverse ? ((nRangeEnd - 1) & ~1) : ((nRangeStart + 1) & ~1);
+        std::optional<int> keyLast;
+
+        auto fnVisit = [&](const int& key, const int& value)
+            {
+                EXPECT_EQ(key, value);
+                EXPECT_TRUE(!keyLast || (bReverse ? key < *keyLast : *keyLast < key));
+                keyLast = key;
+
+                if (key % 2 == 0)
+                {
+                    EXPECT_EQ(key, nExpected);
+                    nExpected += bReverse ? -2 : 2;
+                }
+                return true;
+            };
+
+        if (bReverse)
+        {
+            ASSERT_EQ(ptrTree->reverseScan(nRangeStart, nRangeEnd, fnVisit), ErrorCode::Success);
+            ASSERT_EQ(nExpected, ((nRangeStart + 1) & ~1) - 2);
+        }
+        else
+        {
+            ASSERT_EQ(ptrTree->scan(nRangeStart, nRangeEnd, fnVisit), ErrorCode::Success);
+            ASSERT_EQ(nExpected, ((nRangeEnd - 1) & ~1) + 2);
+        }
+    }
+
     void delete_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd) 
     {
         for (size_t nCntr = nRangeStart; nCntr < nRangeEnd; nCntr++)
@@ -303,6 +355,91 @@ namespace BPlusStore_NoCache_Suite
         }
     }
 
+    TEST_P(BPlusStore_NoCache_Suite_3, Bulk_Insert_Search_v1) 
+    {
+        for (int nCntr = 0; nCntr < nTotalEntries; nCntr += 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        // Half of the threads split the leaves with the odd keys while the other half keep reading the even ones.
+        std::vector<std::thread> vtThreads;
+
+        for (int nIdx = 0; nIdx < nThreadCount; nIdx++)
+        {
+            int nTotal = nTotalEntries / nThreadCount;
+            if (nIdx % 2 == 0)
+            {
+                vtThreads.push_back(std::thread(insert_odd_concurent, m_ptrTree, nIdx * nTotal, nIdx * nTotal + nTotal));
+            }
+            else
+            {
+                vtThreads.push_back(std::thread(search_even_concurent, m_ptrTree, 0, nTotalEntries));
+            }
+        }
+
+        auto it = vtThreads.begin();
+        while (it != vtThreads.end())
+        {
+            (*it).join();
+            it++;
+        }
+
+        for (int nIdx = 0; nIdx < nThreadCount; nIdx++)
+        {
+            int nTotal = nTotalEntries / nThreadCount;
+            for (int nCntr = nIdx * nTotal; nCntr < nIdx * nTotal + nTotal; nCntr++)
+            {
+                int nValue = 0;
+                ErrorCode errCode = m_ptrTree->search(nCntr, nValue);
+
+                if (nCntr % 2 == 0 || nIdx % 2 == 0)
+                {
+                    ASSERT_EQ(errCode, ErrorCode::Success);
+                    ASSERT_EQ(nCntr, nValue);
+                }
+                else
+                {
+                    ASSERT_EQ(errCode, ErrorCode::KeyDoesNotExist);
+                }
+            }
+        }
+    }
+
+    TEST_P(BPlusStore_NoCache_Suite_3, Bulk_Insert_Scan_v1) 
+    {
+        for (int nCntr = 0; nCntr < nTotalEntries; nCntr += 2)
+        {
+            m_ptrTree->insert(nCntr, nCntr);
+        }
+
+        // The scans run across the leaves that are being split under them, in both directions.
+        std::vector<std::thread> vtThreads;
+
+        for (int nIdx = 0; nIdx < nThreadCount; nIdx++)
+        {
+            int nTotal = nTotalEntries / nThreadCount;
+            if (nIdx % 2 == 0)
+            {
+                vtThreads.push_back(std::thread(insert_odd_concurent, m_ptrTree, nIdx * nTotal, nIdx * nTotal + nTotal));
+            }
+            else
+            {
+                vtThreads.push_back(std::thread(scan_even_concurent, m_ptrTree, 0, nTotalEntries, nIdx % 4 == 3));
+            }
+        }
+
+        auto it = vtThreads.begin();
+        while (it != vtThreads.end())
+        {
+            (*it).join();
+            it++;
+        }
+
+        scan_even_concurent(m_ptrTree, 0, nTotalEntries, false);
+        scan_even_concurent(m_ptrTree, 0, nTotalEntries, true);
+    }
+
 #ifdef __CONCURRENT__
     INSTANTIATE_TEST_CASE_P(
         Bulk_Insert_Search_Delete,
@@ -0,0 +1,177 @@
+#include "pch.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <variant>
+#include <typeinfo>
+#include <type_traits>
+
+#include "glog/logging.h"
+
+#include "ShardedLRUCache.hpp"
+#include "IndexNode.hpp"
+#include "DataNode.hpp"
+#include "BPlusStore.hpp"
+#include "LRUCacheObject.hpp"
+#include "VolatileStorage.hpp"
+#include "TypeMarshaller.hpp"
+#include "TypeUID.h"
+#include "ObjectFatUID.h"
+
+#ifdef __TREE_WITH_CACHE__
+namespace BPlusStore_ShardedLRUCache_VolatileStorage_Suite
+{
+    typedef int KeyType;
+    typedef int ValueType;
+    typedef ObjectFatUID ObjectUIDType;
+
+    typedef DataNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::DATA_NODE_INT_INT > DataNodeType;
+    typedef IndexNode<KeyType, ValueType, ObjectUIDType, TYPE_UID::INDEX_NODE_INT_INT > InternalNodeType;
+
+    typedef LRUCacheObject<TypeMarshaller, DataNodeType, InternalNodeType> ObjectType;
+    typedef IFlushCallback<ObjectUIDType, ObjectType> ICallback;
+
+    typedef BPlusStore<ICallback, KeyType, ValueType, ShardedLRUCache<ICallback, VolatileStorage<ICallback, ObjectUIDType, LRUCacheObject, TypeMarshaller, DataNodeType, InternalNodeType>>> BPlusStoreType;
+
+    class BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1 : public ::testing::TestWithParam<std::tuple<int, int, int, int, int, int>>
+    {
+    protected:
+        void SetUp() override
+        {
+            std::tie(nDegree, nThreadCount, nTotalEntries, nCacheSize, nBlockSize, nStorageSize) = GetParam();
+
+            m_ptrTree = new BPlusStoreType(nDegree, nCacheSize, nBlockSize, nStorageSize);
+            m_ptrTree->init<DataNodeType>();
+        }
+
+        void TearDown() override {
+            delete m_ptrTree;
+        }
+
+        void run(void (*fnWorker)(BPlusStoreType*, int, int))
+        {
+            std::vector<std::thread> vtThreads;
+
+            for (int nIdx = 0; nIdx < nThreadCount; nIdx++)
+            {
+                int nTotal = nTotalEntries / nThreadCount;
+                vtThreads.push_back(std::thread(fnWorker, m_ptrTree, nIdx * nTotal, nIdx * nTotal + nTotal));
+            }
+
+            auto it = vtThreads.begin();
+            while (it != vtThreads.end())
+            {
+                (*it).join();
+                it++;
+            }
+        }
+
+        BPlusStoreType* m_ptrTree;
+
+        int nDegree;
+        int nThreadCount;
+        int nTotalEntries;
+        int nCacheSize;
+        int nBlockSize;
+        int nStorageSize;
+    };
+
+    void insert_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd)
+    {
+        for (size_t nCntr = nRangeStart; nCntr < nRangeEnd; nCntr++)
+        {
+            ptrTree->insert(nCntr, nCntr);
+        }
+    }
+
+    void reverse_insert_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd)
+    {
+        for (int nCntr = nRangeEnd - 1; nCntr >= nRangeStart; nCntr--)
+        {
+            ptrTree->insert(nCntr, nCntr);
+        }
+    }
+
+    void search_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd)
+    {
+        for (size_t nCntr = nRangeStart; nCntr < nRangeEnd; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode code = ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(nCntr, nValue);
+        }
+    }
+
+    void search_not_found_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd)
+    {
+        for (size_t nCntr = nRangeStart; nCntr < nRangeEnd; nCntr++)
+        {
+            int nValue = 0;
+            ErrorCode errCode = ptrTree->search(nCntr, nValue);
+
+            ASSERT_EQ(errCode, ErrorCode::KeyDoesNotExist);
+        }
+    }
+
+    void delete_concurent(BPlusStoreType* ptrTree, int nRangeStart, int nRangeEnd)
+    {
+        for (size_t nCntr = nRangeStart; nCntr < nRangeEnd; nCntr++)
+        {
+            ErrorCode code = ptrTree->remove(nCntr);
+        }
+    }
+
+    TEST_P(BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1, Search_v1)
+    {
+        run(insert_concurent);
+        run(search_concurent);
+    }
+
+    TEST_P(BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1, Search_v2)
+    {
+        run(reverse_insert_concurent);
+        run(search_concurent);
+    }
+
+    TEST_P(BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1, Delete_v1)
+    {
+        run(insert_concurent);
+        run(delete_concurent);
+        run(search_not_found_concurent);
+    }
+
+    TEST_P(BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1, CacheState_v1)
+    {
+        run(insert_concurent);
+
+        // Every shard keeps its list and map in step; the sum over the shards must agree as well.
+        size_t nLRU, nMap;
+        m_ptrTree->getCacheState(nLRU, nMap);
+
+        ASSERT_EQ(nLRU, nMap);
+        ASSERT_GT(nMap, 0);
+    }
+
+    INSTANTIATE_TEST_CASE_P(
+        Insert_Search_Delete,
+        BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1,
+        ::testing::Values(
+            std::make_tuple(3, 1, 99999, 100, 1024, 900000000),
+            std::make_tuple(8, 1, 99999, 100, 1024, 900000000),
+            std::make_tuple(32, 1, 199999, 100, 1024, 900000000),
+            std::make_tuple(64, 1, 199999, 8, 1024, 900000000)));
+
+#ifdef __CONCURRENT__
+    INSTANTIATE_TEST_CASE_P(
+        Concurrent_Insert_Search_Delete,
+        BPlusStore_ShardedLRUCache_VolatileStorage_Suite_1,
+        ::testing::Values(
+            std::make_tuple(3, 4, 99999, 100, 1024, 200000000),
+            std::make_tuple(8, 4, 99999, 100, 1024, 200000000),
+            std::make_tuple(16, 4, 199999, 100, 1024, 200000000),
+            std::make_tuple(64, 4, 199999, 100, 1024, 200000000)));
+#endif __CONCURRENT__
+}
+#endif __TREE_WITH_CACHE__
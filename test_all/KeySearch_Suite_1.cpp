@@ -0,0 +1,99 @@
+#include "pch.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+
+#include "KeySearch.hpp"
+
+namespace KeySearch_Suite
+{
+    class KeySearch_Suite_1 : public ::testing::TestWithParam<std::tuple<int>>
+    {
+    protected:
+        void SetUp() override
+        {
+            std::tie(nDegree) = GetParam();
+        }
+
+        template <typename KeyType>
+        void verify(KeyType nMin, KeyType nMax)
+        {
+            std::mt19937_64 rng(nDegree);
+            std::uniform_int_distribution<KeyType> dist(nMin, nMax);
+
+            std::vector<KeyType> vtKeys;
+            for (int nCntr = 0; nCntr < nDegree; nCntr++)
+            {
+                vtKeys.push_back(dist(rng));
+            }
+
+            // Duplicates and the extremes of the type are part of the input on purpose.
+            vtKeys.push_back(nMin);
+            vtKeys.push_back(nMax);
+            vtKeys.push_back(vtKeys[0]);
+            std::sort(vtKeys.begin(), vtKeys.end());
+
+            std::vector<KeyType> vtProbes(vtKeys);
+            vtProbes.push_back(nMin);
+            vtProbes.push_back(nMax);
+            for (int nCntr = 0; nCntr < nDegree; nCntr++)
+            {
+                vtProbes.push_back(dist(rng));
+            }
+
+            for (const KeyType& key : vtProbes)
+            {
+                size_t nExpectedLower = std::lower_bound(vtKeys.begin(), vtKeys.end(), key) - vtKeys.begin();
+                size_t nExpectedUpper = std::upper_bound(vtKeys.begin(), vtKeys.end(), key) - vtKeys.begin();
+
+                ASSERT_EQ(KeySearch::lowerBound(vtKeys.data(), vtKeys.size(), key), nExpectedLower);
+                ASSERT_EQ(KeySearch::upperBound(vtKeys.data(), vtKeys.size(), key), nExpectedUpper);
+            }
+
+            ASSERT_EQ(KeySearch::lowerBound(vtKeys.data(), 0, nMax), 0);
+            ASSERT_EQ(KeySearch::upperBound(vtKeys.data(), 0, nMin), 0);
+        }
+
+        int nDegree;
+    };
+
+    TEST_P(KeySearch_Suite_1, Int32)
+    {
+        verify<int32_t>(INT32_MIN, INT32_MAX);
+        verify<int32_t>(-100, 100);
+    }
+
+    TEST_P(KeySearch_Suite_1, UInt32)
+    {
+        verify<uint32_t>(0, UINT32_MAX);
+        verify<uint32_t>(0, 100);
+    }
+
+    TEST_P(KeySearch_Suite_1, Int64)
+    {
+        verify<int64_t>(INT64_MIN, INT64_MAX);
+        verify<int64_t>(-100, 100);
+    }
+
+    TEST_P(KeySearch_Suite_1, UInt64)
+    {
+        verify<uint64_t>(0, UINT64_MAX);
+        verify<uint64_t>(0, 100);
+    }
+
+    INSTANTIATE_TEST_CASE_P(
+        Lower_Upper_Bound,
+        KeySearch_Suite_1,
+        ::testing::Values(
+            std::make_tuple(1),
+            std::make_tuple(3),
+            std::make_tuple(7),
+            std::make_tuple(16),
+            std::make_tuple(33),
+            std::make_tuple(64),
+            std::make_tuple(128),
+            std::make_tuple(255),
+            std::make_tuple(512)));
+}